@@ -0,0 +1,153 @@
+// Arduino.h - the parts of the ESP8266 Arduino core the firmware uses, for the native build
+//
+// The firmware is built unchanged for the build machine, against this and the other headers in this
+// library, and runs on the simulated board in sim.cpp. Time is virtual: millis() and micros() only
+// move when the firmware waits (delay(), esp_delay()) or a test moves them on, so a simulated year
+// takes seconds. They don't wrap at 32 bits, as unsigned long is 64 bits here.
+//
+// time(), gettimeofday() and settimeofday() are macros for the simulated clock, which drifts as the
+// ESP's crystal would until the simulated SNTP client sets it. The C library's localtime() and
+// friends are used as they are, with the TZ rule configTime() is given.
+
+#ifndef _SIM_ARDUINO_H_
+#define _SIM_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <functional>
+#include "WString.h"
+#include "IPAddress.h"
+#include "coredecls.h"
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Flash strings are ordinary strings here
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+
+// The core's printf takes "%S" for a string in flash
+int vsnprintf_P(char *str, size_t size, PGM_P format, va_list args);
+int snprintf_P(char *str, size_t size, PGM_P format, ...);
+int sprintf_P(char *str, PGM_P format, ...);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t print(const char *str) { return write(str); }
+  size_t print(const String &str) { return write(str.c_str()); }
+  size_t print(long value) { return print(String(value)); }
+  size_t println(const char *str = "") { return print(str) + write("\r\n"); }
+  size_t println(const String &str) { return println(str.c_str()); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t printf_P(PGM_P format, ...);
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() { return 0; }
+  int read() { return -1; }
+  explicit operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+struct rst_info;
+
+class EspClass {
+public:
+  uint32_t getChipId();
+  uint32_t getFreeHeap();
+  uint32_t getMaxFreeBlockSize();
+  uint8_t getHeapFragmentation();
+  uint32_t getFreeSketchSpace();
+  String getResetReason();
+  struct rst_info *getResetInfoPtr();
+  void restart();
+  bool flashRead(uint32_t address, uint32_t *data, size_t size);
+  bool flashWrite(uint32_t address, const uint32_t *data, size_t size);
+  bool flashEraseSector(uint32_t sector);
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+uint64_t micros64();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+void configTime(const char *tz, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+
+// The simulated clock - see sim.cpp. Function-like, so (time)(0) is still the C library's
+time_t simTime(time_t *t);
+int simGettimeofday(struct timeval *tv, void *tz);
+int simSettimeofday(const struct timeval *tv, const void *tz);
+#define time(t) simTime(t)
+#define gettimeofday(tv, tz) simGettimeofday(tv, tz)
+#define settimeofday(tv, tz) simSettimeofday(tv, tz)
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,35 @@
+// ArduinoOTA.h - updates pushed by the IDE, which never come in the native build
+
+#ifndef _SIM_ARDUINOOTA_H_
+#define _SIM_ARDUINOOTA_H_
+
+#include <Arduino.h>
+
+typedef enum {
+  OTA_AUTH_ERROR,
+  OTA_BEGIN_ERROR,
+  OTA_CONNECT_ERROR,
+  OTA_RECEIVE_ERROR,
+  OTA_END_ERROR
+} ota_error_t;
+
+class ArduinoOTAClass {
+public:
+  void setHostname(const char *name);
+  void onStart(std::function<void()> fn) { startCB = fn; }
+  void onEnd(std::function<void()> fn) { endCB = fn; }
+  void onProgress(std::function<void(unsigned int, unsigned int)> fn) { progressCB = fn; }
+  void onError(std::function<void(ota_error_t)> fn) { errorCB = fn; }
+  void begin(bool useMDNS = true);
+  void handle() {}
+
+private:
+  std::function<void()> startCB;
+  std::function<void()> endCB;
+  std::function<void(unsigned int, unsigned int)> progressCB;
+  std::function<void(ota_error_t)> errorCB;
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
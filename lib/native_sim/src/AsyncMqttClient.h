@@ -0,0 +1,74 @@
+// AsyncMqttClient.h - an MQTT client, connected to the simulated broker, for the native build
+//
+// The broker (see simSetMqttBroker() in sim.h) takes a connection a moment after connect(), and
+// acknowledges each QoS 1 publish on the next pass of the simulation (unless simSetMqttAcks(false)).
+// What is published, and each connection attempt, is kept for the tests to look at.
+
+#ifndef _SIM_ASYNCMQTTCLIENT_H_
+#define _SIM_ASYNCMQTTCLIENT_H_
+
+#include <Arduino.h>
+#include <vector>
+
+enum class AsyncMqttClientDisconnectReason : uint8_t {
+  TCP_DISCONNECTED = 0,
+  MQTT_UNACCEPTABLE_PROTOCOL_VERSION = 1,
+  MQTT_IDENTIFIER_REJECTED = 2,
+  MQTT_SERVER_UNAVAILABLE = 3,
+  MQTT_MALFORMED_CREDENTIALS = 4,
+  MQTT_NOT_AUTHORIZED = 5
+};
+
+struct AsyncMqttClientMessageProperties {
+  uint8_t qos;
+  bool dup;
+  bool retain;
+};
+
+class AsyncMqttClient {
+public:
+  typedef std::function<void(bool sessionPresent)> OnConnectUserCallback;
+  typedef std::function<void(AsyncMqttClientDisconnectReason reason)> OnDisconnectUserCallback;
+  typedef std::function<void(uint16_t packetId)> OnPublishUserCallback;
+  typedef std::function<void(char *topic, char *payload, AsyncMqttClientMessageProperties properties,
+      size_t len, size_t index, size_t total)> OnMessageUserCallback;
+
+  AsyncMqttClient();
+  ~AsyncMqttClient();
+  AsyncMqttClient &onConnect(OnConnectUserCallback callback) { connectCB = callback; return *this; }
+  AsyncMqttClient &onDisconnect(OnDisconnectUserCallback callback) { disconnectCB = callback; return *this; }
+  AsyncMqttClient &onPublish(OnPublishUserCallback callback) { publishCB = callback; return *this; }
+  AsyncMqttClient &onMessage(OnMessageUserCallback callback) { messageCB = callback; return *this; }
+  AsyncMqttClient &setServer(const char *host, uint16_t port);
+  AsyncMqttClient &setClientId(const char *clientId);
+  AsyncMqttClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+  AsyncMqttClient &setWill(const char *topic, uint8_t qos, bool retain, const char *payload = nullptr, size_t length = 0);
+  void connect();
+  void disconnect(bool force = false);
+  bool connected() const { return isConnected; }
+  uint16_t subscribe(const char *topic, uint8_t qos);
+  uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload = nullptr,
+      size_t length = 0, bool dup = false, uint16_t messageId = 0);
+
+  // Driven by the simulated broker
+  void simPoll();
+  void simDeliver(const char *topic, const char *payload, bool retain);
+
+private:
+  OnConnectUserCallback connectCB;
+  OnDisconnectUserCallback disconnectCB;
+  OnPublishUserCallback publishCB;
+  OnMessageUserCallback messageCB;
+  String host;
+  uint16_t port = 0;
+  String clientId;
+  String willTopic;
+  bool isConnected = false;
+  bool connecting = false;
+  bool dropping = false;
+  unsigned long connectAt = 0;
+  uint16_t nextPacketId = 1;
+  std::vector<uint16_t> unacked;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// ESP8266WiFi.h - the WiFi station and access point, on the simulated network, for the native build
+//
+// The simulated access point is set up with simSetAccessPoint() - see sim.h. A connection attempt
+// (begin() or reconnect()) made while it is up completes after its connect delay, and the link goes
+// as soon as it goes down. Nothing reconnects by itself.
+
+#ifndef _SIM_ESP8266WIFI_H_
+#define _SIM_ESP8266WIFI_H_
+
+#include <Arduino.h>
+#include <memory>
+#include "WiFiUdp.h"
+
+typedef enum WiFiMode {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} WiFiMode_t;
+
+typedef enum WiFiSleepType {
+  WIFI_NONE_SLEEP = 0,
+  WIFI_LIGHT_SLEEP = 1,
+  WIFI_MODEM_SLEEP = 2
+} WiFiSleepType_t;
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+struct WiFiEventStationModeGotIP {
+  IPAddress ip;
+  IPAddress mask;
+  IPAddress gw;
+};
+
+class WiFiEventHandlerOpaque;
+typedef std::shared_ptr<WiFiEventHandlerOpaque> WiFiEventHandler;
+
+class ESP8266WiFiClass {
+public:
+  bool mode(WiFiMode_t m);
+  WiFiMode_t getMode();
+  bool enableAP(bool enable);
+  bool setSleepMode(WiFiSleepType_t type, uint8_t listenInterval = 0);
+  WiFiSleepType_t getSleepMode();
+  bool setHostname(const char *name);
+  String hostname();
+  bool setAutoReconnect(bool autoReconnect);
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+  wl_status_t begin(const String &ssid, const String &passphrase = String()) { return begin(ssid.c_str(), passphrase.c_str()); }
+  bool reconnect();
+  bool disconnect(bool wifioff = false);
+  bool isConnected();
+  wl_status_t status();
+  IPAddress localIP();
+  int32_t RSSI();
+  String SSID();
+  bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+  bool softAP(const char *ssid, const char *passphrase = nullptr);
+  IPAddress softAPIP();
+  WiFiEventHandler onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> handler);
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,22 @@
+// ESP8266mDNS.h - the mDNS responder ArduinoOTA starts, recording what is advertised, for the native build
+
+#ifndef _SIM_ESP8266MDNS_H_
+#define _SIM_ESP8266MDNS_H_
+
+#include <Arduino.h>
+
+class MDNSResponder {
+public:
+  typedef const void *hMDNSService;
+  typedef std::function<void(const hMDNSService)> MDNSDynamicServiceTxtCallbackFunc;
+
+  bool isRunning();
+  hMDNSService addService(const char *instance, const char *service, const char *protocol, uint16_t port);
+  bool addServiceTxt(const hMDNSService service, const char *key, const char *value);
+  bool addDynamicServiceTxt(const hMDNSService service, const char *key, const char *value);
+  bool setDynamicServiceTxtCallback(const hMDNSService service, MDNSDynamicServiceTxtCallbackFunc callback);
+};
+
+extern MDNSResponder MDNS;
+
+#endif
@@ -0,0 +1,20 @@
+// ESPAsyncTCP.h - the TCP connection behind a web request, for the native build
+
+#ifndef _SIM_ESPASYNCTCP_H_
+#define _SIM_ESPASYNCTCP_H_
+
+#include <Arduino.h>
+
+class AsyncClient {
+public:
+  explicit AsyncClient(IPAddress remote = IPAddress(), uint16_t port = 0) : remote(remote), port(port) {}
+  IPAddress remoteIP() const { return remote; }
+  uint16_t remotePort() const { return port; }
+  uint32_t getRemoteAddress() const { return remote.v4(); }
+
+private:
+  IPAddress remote;
+  uint16_t port;
+};
+
+#endif
@@ -0,0 +1,215 @@
+// ESPAsyncWebServer.h - the web server, answering requests made by the simulation, for the native build
+//
+// Requests come from the tests (simHttp() in sim.h). They are matched to handlers, parameters parsed
+// and uploads handed over in pieces as ESPAsyncWebServer does it; responses are pulled from their
+// fillers as the simulation runs, so one that returns RESPONSE_TRY_AGAIN waits for loop() as it
+// would on the clock.
+
+#ifndef _SIM_ESPASYNCWEBSERVER_H_
+#define _SIM_ESPASYNCWEBSERVER_H_
+
+#include <Arduino.h>
+#include <ESPAsyncTCP.h>
+#include <vector>
+
+typedef enum {
+  HTTP_GET     = 0b00000001,
+  HTTP_POST    = 0b00000010,
+  HTTP_DELETE  = 0b00000100,
+  HTTP_PUT     = 0b00001000,
+  HTTP_PATCH   = 0b00010000,
+  HTTP_HEAD    = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY     = 0b01111111
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<String(const String &)> AwsTemplateProcessor;
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index,
+    uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void()> ArDisconnectHandler;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool form = false, bool file = false, size_t size = 0)
+      : paramName(name), paramValue(value), paramSize(size), form(form), file(file) {}
+  const String &name() const { return paramName; }
+  const String &value() const { return paramValue; }
+  size_t size() const { return paramSize; }
+  bool isPost() const { return form; }
+  bool isFile() const { return file; }
+
+private:
+  String paramName;
+  String paramValue;
+  size_t paramSize;
+  bool form;
+  bool file;
+};
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &contentType, size_t length) : code(code), contentType(contentType), length(length) {}
+  virtual ~AsyncWebServerResponse() {}
+  void addHeader(const String &name, const String &value) { headers.push_back({ name, value }); }
+
+  // Up to maxLen bytes of the body from index - 0 at the end, or RESPONSE_TRY_AGAIN
+  virtual size_t fill(uint8_t *buffer, size_t maxLen, size_t index) = 0;
+
+  int code;
+  String contentType;
+  size_t length;                 // SIZE_MAX if not known - sent chunked
+  std::vector<std::pair<String, String>> headers;
+};
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String &url, IPAddress remote);
+  ~AsyncWebServerRequest();
+
+  AsyncClient *client() { return &connection; }
+  WebRequestMethodComposite method() const { return requestMethod; }
+  const String &url() const { return requestUrl; }
+  size_t contentLength() const { return bodyLength; }
+
+  size_t params() const { return parameters.size(); }
+  AsyncWebParameter *getParam(size_t num) const;
+  AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const;
+  bool hasParam(const String &name, bool post = false, bool file = false) const;
+  bool hasHeader(const String &name) const;
+  const String &header(const char *name) const;
+  void onDisconnect(ArDisconnectHandler fn) { disconnectHandlers.push_back(fn); }
+
+  void send(AsyncWebServerResponse *response);
+  void send(int code, const String &contentType = String(), const String &content = String());
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String());
+  AsyncWebServerResponse *beginResponse(const String &contentType, size_t len, AwsResponseFiller callback,
+      AwsTemplateProcessor templateCallback = nullptr);
+  AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len,
+      AwsTemplateProcessor callback = nullptr);
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller callback,
+      AwsTemplateProcessor templateCallback = nullptr);
+
+  // Filled in by the simulation
+  void simAddParam(const String &name, const String &value, bool post, bool file = false, size_t size = 0);
+  void simAddHeader(const String &name, const String &value) { headers.push_back({ name, value }); }
+  void simSetContentLength(size_t length) { bodyLength = length; }
+  AsyncWebServerResponse *simResponse() { return response; }
+  void simDisconnected();
+
+private:
+  AsyncClient connection;
+  WebRequestMethodComposite requestMethod;
+  String requestUrl;
+  size_t bodyLength = 0;
+  std::vector<AsyncWebParameter *> parameters;
+  std::vector<std::pair<String, String>> headers;
+  std::vector<ArDisconnectHandler> disconnectHandlers;
+  AsyncWebServerResponse *response = nullptr;
+};
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) = 0;
+  virtual void handleRequest(AsyncWebServerRequest *request) = 0;
+  virtual void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data,
+      size_t len, bool final) {}
+  virtual bool hasUploadHandler() const { return false; }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+  AsyncCallbackWebHandler(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+      ArUploadHandlerFunction onUpload) : uri(uri), methods(method), onRequest(onRequest), onUpload(onUpload) {}
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data,
+      size_t len, bool final) override;
+  bool hasUploadHandler() const override { return (bool)onUpload; }
+
+private:
+  String uri;
+  WebRequestMethodComposite methods;
+  ArRequestHandlerFunction onRequest;
+  ArUploadHandlerFunction onUpload;
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port);
+  ~AsyncWebServer();
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+      ArUploadHandlerFunction onUpload = nullptr);
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+  void begin() { started = true; }
+
+  // The handler for a request, or 0 for a 404
+  AsyncWebHandler *simFindHandler(AsyncWebServerRequest *request);
+  bool simStarted() const { return started; }
+
+private:
+  std::vector<AsyncWebHandler *> handlers;
+  std::vector<AsyncCallbackWebHandler *> owned;
+  bool started = false;
+};
+
+class AsyncEventSource;
+
+// A browser listening to an event source. It takes its events at the rate it was connected with
+class AsyncEventSourceClient {
+public:
+  AsyncEventSourceClient(AsyncEventSource *source, uint32_t millisPerEvent) : source(source), millisPerEvent(millisPerEvent) {}
+  void close() { open = false; }
+  bool connected() const { return open; }
+  size_t packetsWaiting() const { return queue.size(); }
+  void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+
+  // Driven by the simulation
+  void simDrain();
+  uint64_t simNextTake() const { return queue.empty() ? UINT64_MAX : lastTaken + millisPerEvent * 1000ULL; }
+  const std::vector<String> &simReceived() const { return received; }
+
+private:
+  AsyncEventSource *source;
+  uint32_t millisPerEvent;
+  bool open = true;
+  uint64_t lastTaken = 0;
+  std::vector<String> queue;
+  std::vector<String> received;
+};
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncEventSource : public AsyncWebHandler {
+public:
+  explicit AsyncEventSource(const String &url);
+  ~AsyncEventSource();
+  const char *url() const { return sourceUrl.c_str(); }
+  void onConnect(ArEventHandlerFunction cb) { connectCB = cb; }
+  void close();
+  void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+  size_t count() const;
+  size_t avgPacketsWaiting() const;
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+
+  // Driven by the simulation - a browser connects, taking an event every millisPerEvent
+  AsyncEventSourceClient *simConnect(uint32_t millisPerEvent);
+  void simPoll();
+  uint64_t simNextEvent() const;
+
+private:
+  String sourceUrl;
+  ArEventHandlerFunction connectCB;
+  std::vector<AsyncEventSourceClient *> clients;
+};
+
+#endif
@@ -0,0 +1,47 @@
+// IPAddress.h - an IPv4 address, held as lwIP holds it (network order), for the native build
+
+#ifndef _SIM_IPADDRESS_H_
+#define _SIM_IPADDRESS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+class IPAddress {
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d; }
+  IPAddress(uint32_t address) { setAddress(address); }
+  operator uint32_t() const { return v4(); }
+  uint32_t v4() const { return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24); }
+  bool isSet() const { return v4() != 0; }
+  bool operator==(const IPAddress &other) const { return v4() == other.v4(); }
+  bool operator!=(const IPAddress &other) const { return v4() != other.v4(); }
+  bool operator==(uint32_t address) const { return v4() == address; }
+  uint8_t operator[](int index) const { return bytes[index]; }
+  uint8_t &operator[](int index) { return bytes[index]; }
+
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(buf);
+  }
+
+  bool fromString(const char *address) {
+    unsigned a, b, c, d;
+    char extra;
+    if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4) return false;
+    if ((a > 255) || (b > 255) || (c > 255) || (d > 255)) return false;
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+  bool fromString(const String &address) { return fromString(address.c_str()); }
+
+private:
+  void setAddress(uint32_t address) {
+    for (int i = 0 ; i < 4 ; i++) bytes[i] = address >> (8 * i);
+  }
+  uint8_t bytes[4] = { 0, 0, 0, 0 };
+};
+
+#endif
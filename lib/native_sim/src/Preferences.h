@@ -0,0 +1,30 @@
+// Preferences.h - key/value storage, kept in memory, for the native build
+
+#ifndef _SIM_PREFERENCES_H_
+#define _SIM_PREFERENCES_H_
+
+#include <Arduino.h>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+  size_t putChar(const char *key, int8_t value);
+  size_t putShort(const char *key, int16_t value);
+  size_t putString(const char *key, const char *value);
+  size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+  size_t putBytes(const char *key, const void *value, size_t len);
+  int8_t getChar(const char *key, int8_t defaultValue = 0);
+  int16_t getShort(const char *key, int16_t defaultValue = 0);
+  String getString(const char *key, const String &defaultValue = String());
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  String name;
+};
+
+#endif
@@ -0,0 +1,33 @@
+// Updater.h - writing a new firmware image, kept in memory for the tests, for the native build
+
+#ifndef _SIM_UPDATER_H_
+#define _SIM_UPDATER_H_
+
+#include <Arduino.h>
+
+#define U_FLASH 0
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_SPACE 4
+#define UPDATE_ERROR_SIZE 5
+
+class UpdaterClass {
+public:
+  UpdaterClass &runAsync(bool async) { return *this; }
+  bool begin(size_t size, int command = U_FLASH, int ledPin = -1, uint8_t ledOn = LOW);
+  size_t write(uint8_t *data, size_t len);
+  bool end(bool evenIfRemaining = false);
+  bool isRunning() { return running; }
+  bool hasError() { return error != UPDATE_ERROR_OK; }
+  uint8_t getError() { return error; }
+
+private:
+  bool running = false;
+  uint8_t error = UPDATE_ERROR_OK;
+  size_t expected = 0;
+  size_t written = 0;
+};
+
+extern UpdaterClass Update;
+
+#endif
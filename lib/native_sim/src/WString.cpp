@@ -0,0 +1,157 @@
+// WString.cpp - the Arduino String class, for the native build
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "WString.h"
+
+/**
+ * Format an unsigned number in any base from 2 to 36, as the core's utoa() does
+ */
+static std::string formatUnsigned(unsigned long long value, unsigned char base) {
+  char buf[65];
+  char *p = buf + sizeof(buf) - 1;
+  if ((base < 2) || (base > 36)) base = 10;
+  *p = 0;
+  do {
+    unsigned digit = value % base;
+    *--p = (digit < 10) ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  return std::string(p);
+}
+
+/**
+ * Format a signed number - negative ones only get a '-' in base 10, as with the core's ltoa()
+ */
+static std::string formatSigned(long long value, unsigned char base) {
+  if ((base == 10) && (value < 0)) return "-" + formatUnsigned(-(unsigned long long)value, base);
+  return formatUnsigned((unsigned long long)value, base);
+}
+
+String::String(unsigned char value, unsigned char base) : s(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s(formatUnsigned(value, base)) {}
+String::String(long long value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : s(formatUnsigned(value, base)) {}
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned char decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  s = buf;
+}
+
+bool String::equalsIgnoreCase(const String &str) const {
+  return (s.length() == str.s.length()) && !strcasecmp(s.c_str(), str.s.c_str());
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+  return (offset <= s.length()) && (s.compare(offset, prefix.s.length(), prefix.s) == 0);
+}
+
+bool String::endsWith(const String &suffix) const {
+  return (s.length() >= suffix.s.length()) && (s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s) == 0);
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const {
+  size_t n;
+  if (!bufsize || !buf) return;
+  n = (index < s.length()) ? s.copy(buf, bufsize - 1, index) : 0;
+  buf[n] = 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  size_t at = s.find(c, fromIndex);
+  return (at == std::string::npos) ? -1 : (int)at;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const {
+  size_t at = s.find(str.s, fromIndex);
+  return (at == std::string::npos) ? -1 : (int)at;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t at = s.rfind(c);
+  return (at == std::string::npos) ? -1 : (int)at;
+}
+
+int String::lastIndexOf(const String &str) const {
+  size_t at = s.rfind(str.s);
+  return (at == std::string::npos) ? -1 : (int)at;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if (beginIndex >= s.length()) return String();
+  if (endIndex > s.length()) endIndex = s.length();
+  return String(s.c_str() + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace) {
+  for (char &c : s) if (c == find) c = replace;
+}
+
+void String::replace(const String &find, const String &replace) {
+  size_t at = 0;
+  if (find.s.empty()) return;
+  while ((at = s.find(find.s, at)) != std::string::npos) {
+    s.replace(at, find.s.length(), replace.s);
+    at += replace.s.length();
+  }
+}
+
+void String::toLowerCase() {
+  for (char &c : s) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+  for (char &c : s) c = toupper((unsigned char)c);
+}
+
+void String::trim() {
+  size_t first = 0;
+  size_t last = s.length();
+  while ((first < last) && isspace((unsigned char)s[first])) first++;
+  while ((last > first) && isspace((unsigned char)s[last - 1])) last--;
+  s = s.substr(first, last - first);
+}
+
+long String::toInt() const {
+  return atol(s.c_str());
+}
+
+float String::toFloat() const {
+  return atof(s.c_str());
+}
+
+double String::toDouble() const {
+  return atof(s.c_str());
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String ans(lhs);
+  ans.concat(rhs);
+  return ans;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+  String ans(lhs);
+  ans.concat(rhs);
+  return ans;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  String ans(lhs);
+  ans.concat(rhs);
+  return ans;
+}
+
+String operator+(const String &lhs, char rhs) {
+  String ans(lhs);
+  ans.concat(rhs);
+  return ans;
+}
@@ -0,0 +1,104 @@
+// WString.h - the Arduino String class, for the native build
+//
+// Kept to what the firmware uses, and backed by std::string. Numbers are formatted as the core does.
+
+#ifndef _SIM_WSTRING_H_
+#define _SIM_WSTRING_H_
+
+#include <stddef.h>
+#include <string>
+
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s) FPSTR(s)
+
+class String {
+public:
+  String(const char *cstr = "") : s(cstr ? cstr : "") {}
+  String(const char *cstr, size_t length) : s(cstr, length) {}
+  String(const __FlashStringHelper *str) : s(reinterpret_cast<const char *>(str)) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return s.length(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+  const char *c_str() const { return s.c_str(); }
+  char *begin() { return &s[0]; }
+  char *end() { return &s[0] + s.length(); }
+  const char *begin() const { return s.c_str(); }
+  const char *end() const { return s.c_str() + s.length(); }
+
+  bool concat(const String &str) { s += str.s; return true; }
+  bool concat(const char *cstr) { if (cstr) s += cstr; return true; }
+  bool concat(const char *cstr, unsigned int length) { s.append(cstr, length); return true; }
+  bool concat(const __FlashStringHelper *str) { return concat(reinterpret_cast<const char *>(str)); }
+  bool concat(char c) { s += c; return true; }
+  bool concat(unsigned char value) { return concat(String(value)); }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  bool concat(long long value) { return concat(String(value)); }
+  bool concat(unsigned long long value) { return concat(String(value)); }
+  bool concat(float value) { return concat(String(value)); }
+  bool concat(double value) { return concat(String(value)); }
+  template <typename T> String &operator+=(const T &value) { concat(value); return *this; }
+
+  bool equals(const String &str) const { return s == str.s; }
+  bool equals(const char *cstr) const { return s == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String &str) const;
+  bool operator==(const String &str) const { return equals(str); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &str) const { return !equals(str); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &str) const { return s < str.s; }
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.length(), prefix.s) == 0; }
+  bool startsWith(const String &prefix, unsigned int offset) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const { return (index < s.length()) ? s[index] : 0; }
+  void setCharAt(unsigned int index, char c) { if (index < s.length()) s[index] = c; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return s[index]; }
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String &str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String &str) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, s.length()); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String &find, const String &replace);
+  void remove(unsigned int index) { if (index < s.length()) s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s.length()) s.erase(index, count); }
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+private:
+  std::string s;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+template <typename T> String operator+(const String &lhs, T rhs) { String ans(lhs); ans.concat(rhs); return ans; }
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+
+#endif
@@ -0,0 +1,47 @@
+// WiFiUdp.h - UDP sockets on the simulated network, for the native build
+//
+// Packets sent to port 123 of anywhere but ourselves are answered by the simulated NTP server; the
+// rest are kept for the tests to look at (simTakeUDP()). Tests send packets in with simSendUDP().
+
+#ifndef _SIM_WIFIUDP_H_
+#define _SIM_WIFIUDP_H_
+
+#include <Arduino.h>
+#include <vector>
+
+class WiFiUDP : public Print {
+public:
+  ~WiFiUDP();
+  uint8_t begin(uint16_t port);
+  uint8_t beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port);
+  void stop();
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char *host, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int parsePacket();
+  int available();
+  int read();
+  int read(unsigned char *buffer, size_t len);
+  int read(char *buffer, size_t len) { return read((unsigned char *)buffer, len); }
+  void flush();
+  IPAddress remoteIP();
+  uint16_t remotePort();
+  uint16_t localPort() { return port; }
+
+private:
+  uint16_t port = 0;
+  IPAddress multicastGroup;
+  IPAddress sendTo;
+  uint16_t sendToPort = 0;
+  std::vector<uint8_t> sending;
+  bool building = false;
+  std::vector<uint8_t> received;
+  size_t readPosition = 0;
+  IPAddress receivedFrom;
+  uint16_t receivedFromPort = 0;
+};
+
+#endif
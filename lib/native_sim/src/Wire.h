@@ -0,0 +1,26 @@
+// Wire.h - the I2C bus, with the simulated TM1650 display on it, for the native build
+
+#ifndef _SIM_WIRE_H_
+#define _SIM_WIRE_H_
+
+#include <Arduino.h>
+#include <vector>
+
+class TwoWire {
+public:
+  void begin(int sda, int scl);
+  void begin();
+  void setClock(uint32_t frequency) {}
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t quantity);
+  uint8_t endTransmission(bool sendStop = true);
+
+private:
+  uint8_t address = 0;
+  std::vector<uint8_t> data;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,21 @@
+// bearssl/bearssl_hash.h - BearSSL's SHA-256, for the native build
+
+#ifndef _SIM_BEARSSL_HASH_H_
+#define _SIM_BEARSSL_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define br_sha256_SIZE 32
+
+typedef struct {
+  uint8_t buf[64];
+  uint64_t count;
+  uint32_t val[8];
+} br_sha256_context;
+
+void br_sha256_init(br_sha256_context *ctx);
+void br_sha256_update(br_sha256_context *ctx, const void *data, size_t len);
+void br_sha256_out(const br_sha256_context *ctx, void *out);
+
+#endif
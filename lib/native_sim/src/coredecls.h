@@ -0,0 +1,21 @@
+// coredecls.h - the ESP8266 core's scheduling and time hooks, for the native build
+
+#ifndef _SIM_COREDECLS_H_
+#define _SIM_COREDECLS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// Wait up to ms, or until blocked() returns false after esp_schedule() - in virtual time
+void esp_delay(unsigned long ms);
+void esp_delay(unsigned long ms, const std::function<bool()> &blocked);
+void esp_schedule();
+void esp_yield();
+
+// Called whenever the time of day is set - by the SNTP client, or settimeofday()
+void settimeofday_cb(const std::function<void()> &cb);
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0xffffffff);
+
+#endif
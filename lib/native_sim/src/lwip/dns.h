@@ -0,0 +1,15 @@
+// lwip/dns.h - lwIP's DNS resolver, answered by the simulated network, for the native build
+
+#ifndef _SIM_LWIP_DNS_H_
+#define _SIM_LWIP_DNS_H_
+
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+// ERR_OK with *addr filled in for a dotted quad or a name already looked up, otherwise
+// ERR_INPROGRESS and found() is called later - with 0 if the name couldn't be found
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg);
+
+#endif
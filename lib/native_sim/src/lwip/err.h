@@ -0,0 +1,16 @@
+// lwip/err.h - lwIP's error codes, for the native build
+
+#ifndef _SIM_LWIP_ERR_H_
+#define _SIM_LWIP_ERR_H_
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_INPROGRESS -5
+#define ERR_VAL -6
+#define ERR_ARG -16
+
+#endif
@@ -0,0 +1,17 @@
+// lwip/ip_addr.h - lwIP's IPv4 address, as the core builds it (without IPv6), for the native build
+
+#ifndef _SIM_LWIP_IP_ADDR_H_
+#define _SIM_LWIP_IP_ADDR_H_
+
+#include <stdint.h>
+
+typedef struct ip4_addr {
+  uint32_t addr;                 // Network order
+} ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+
+#define ip_addr_get_ip4_u32(ipaddr) ((ipaddr)->addr)
+#define ip_addr_set_ip4_u32(ipaddr, val) ((ipaddr)->addr = (val))
+#define IP_IS_V4(ipaddr) 1
+
+#endif
@@ -0,0 +1,598 @@
+// sim.cpp - virtual time, the ESP itself and the board around it, for running the firmware natively
+//
+// micros() is simply a counter. The firmware's waits (esp_delay(), delay()) move it on to the end of
+// the wait, or to the next thing due elsewhere in the simulation if that is sooner, and do that thing;
+// a wait that can be cut short (by esp_schedule()) ends when it is. loop() passes themselves take
+// simSetLoopCostMicros(), so there is always some time between them.
+//
+// micros() is the ESP's crystal, and the system clock runs from it, as on the ESP - the clock is kept
+// as the time it was last set to and when. The drift is in the true time instead, which runs slow
+// (or fast) against micros() by it, so the ESP's clock gains what the drift says.
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Wire.h>
+#include <user_interface.h>
+#include "sim_internal.h"
+
+#define SIM_FLASH_SIZE (1024 * 1024)
+#define SIM_FLASH_SECTOR_SIZE 4096
+#define SIM_RTC_USER_BYTES 512
+#define SIM_PINS 17
+#define SIM_TM1650_CONTROL 0x24
+#define SIM_TM1650_DIGITS 0x34
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+
+// Time - see the top of the file
+static std::atomic<uint64_t> nowMicros(0);
+static int64_t trueSetTo = 1735689600LL * 1000000LL;       // 2025-01-01 00:00:00 UTC
+static uint64_t trueSetAt = 0;
+static int64_t leapMicros = 0;                              // When the true time steps for a leap second
+static int8_t leapSeconds = 0;
+static int64_t systemSetTo = 0;                             // The ESP's clock starts at 1970 plus its uptime
+static uint64_t systemSetAt = 0;
+static double driftPPM = 0;
+static uint32_t loopCostMicros = 50;
+static uint64_t loops = 0;
+static uint64_t oversleepMicros = 0;                       // Added to the next wait
+static std::function<void()> timeSetCB;
+
+// The board
+static uint8_t pinLevels[SIM_PINS];
+static void (*pinHandlers[SIM_PINS])(void);
+static int pinModes[SIM_PINS];
+static bool pinsSetUp = false;
+static uint32_t randomState = 303;
+
+// The flash, RTC memory and resets
+static std::vector<uint8_t> flash(SIM_FLASH_SIZE, 0xFF);
+static std::vector<uint32_t> flashErases(SIM_FLASH_SIZE / SIM_FLASH_SECTOR_SIZE, 0);
+static uint32_t flashBitViolations = 0;
+static uint32_t flashEraseMillis = 40;
+static uint8_t rtcMemory[SIM_RTC_USER_BYTES];
+static bool rtcSetUp = false;
+static uint32_t restarts = 0;
+static struct rst_info resetInfo = { REASON_DEFAULT_RST, 0, 0, 0, 0, 0, 0 };
+
+// The TM1650
+static std::vector<SimDisplayWrite> displayWrites;
+static uint8_t displayDigits[4] = { 0, 0, 0, 0 };
+static uint8_t displayControl = 0;
+
+// ---- Time ----
+
+unsigned long millis() {
+  return nowMicros / 1000;
+}
+
+unsigned long micros() {
+  return nowMicros;
+}
+
+uint64_t micros64() {
+  return nowMicros;
+}
+
+uint64_t simMicros() {
+  return nowMicros;
+}
+
+/**
+ * The true time, before any leap second
+ */
+static int64_t trueMicrosSinceSet() {
+  uint64_t elapsed = nowMicros - trueSetAt;
+  return trueSetTo + (int64_t)elapsed - (int64_t)llround(elapsed * driftPPM / (1e6 + driftPPM));
+}
+
+int64_t simTrueMicros() {
+  int64_t ans = trueMicrosSinceSet();
+  return (leapSeconds && (ans >= leapMicros)) ? ans - leapSeconds * 1000000LL : ans;
+}
+
+/**
+ * Take the true time as set now, with any leap second that has passed
+ */
+static void setTrueTimeHere() {
+  int64_t now = simTrueMicros();
+  if (leapSeconds && (trueMicrosSinceSet() >= leapMicros)) leapSeconds = 0;
+  trueSetTo = now;
+  trueSetAt = nowMicros;
+}
+
+void simSetTrueTime(time_t t, uint32_t usec) {
+  trueSetTo = (int64_t)t * 1000000LL + usec;
+  trueSetAt = nowMicros;
+  leapSeconds = 0;
+}
+
+void simLeapSecond(time_t midnight, int8_t leap) {
+  setTrueTimeHere();
+  // A removed second is 23:59:59 - the time goes straight from 23:59:58 to midnight
+  leapMicros = ((int64_t)midnight - ((leap < 0) ? 1 : 0)) * 1000000LL;
+  leapSeconds = leap;
+}
+
+int64_t simSystemMicros() {
+  return systemSetTo + (int64_t)(nowMicros - systemSetAt);
+}
+
+void simSetDriftPPM(double ppm) {
+  setTrueTimeHere();
+  driftPPM = ppm;
+}
+
+void simSetSystemMicros(int64_t micros) {
+  systemSetTo = micros;
+  systemSetAt = nowMicros;
+  if (timeSetCB) timeSetCB();
+}
+
+time_t simTime(time_t *t) {
+  time_t now = simSystemMicros() / 1000000LL;
+  if (t) *t = now;
+  return now;
+}
+
+int simGettimeofday(struct timeval *tv, void *tz) {
+  int64_t now = simSystemMicros();
+  tv->tv_sec = now / 1000000LL;
+  tv->tv_usec = now % 1000000LL;
+  return 0;
+}
+
+int simSettimeofday(const struct timeval *tv, const void *tz) {
+  if (!tv) return -1;
+  simSetSystemMicros((int64_t)tv->tv_sec * 1000000LL + tv->tv_usec);
+  return 0;
+}
+
+void settimeofday_cb(const std::function<void()> &cb) {
+  timeSetCB = cb;
+}
+
+/**
+ * When the next thing is due anywhere in the simulation
+ */
+static uint64_t nextEvent() {
+  return std::min(simNetworkNextEvent(), simWebNextEvent());
+}
+
+/**
+ * Do everything that is due
+ */
+static void pollAll() {
+  simNetworkPoll();
+  simWebPoll();
+}
+
+void simWaitUntil(uint64_t until, const std::function<bool()> *blocked) {
+  until += oversleepMicros;
+  oversleepMicros = 0;
+  pollAll();
+  while (nowMicros < until) {
+    if (blocked && !(*blocked)()) return;
+    nowMicros = std::max((uint64_t)nowMicros, std::min(until, nextEvent()));
+    pollAll();
+  }
+}
+
+void esp_delay(unsigned long ms) {
+  simWaitUntil(nowMicros + ms * 1000ULL, nullptr);
+}
+
+void esp_delay(unsigned long ms, const std::function<bool()> &blocked) {
+  simWaitUntil(nowMicros + ms * 1000ULL, &blocked);
+}
+
+void esp_schedule() {
+  // blocked() is asked after everything the simulation does, so there is nothing to wake
+}
+
+void esp_yield() {
+  pollAll();
+}
+
+void delay(unsigned long ms) {
+  esp_delay(ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  nowMicros += us;
+}
+
+void yield() {
+  pollAll();
+}
+
+void simAdvanceMicros(uint64_t us) {
+  nowMicros += us;
+}
+
+void simSetLoopCostMicros(uint32_t us) {
+  loopCostMicros = us;
+}
+
+uint64_t simLoopCount() {
+  return loops;
+}
+
+void simRun(uint64_t ms) {
+  uint64_t until = nowMicros + ms * 1000ULL;
+  while (nowMicros < until) {
+    loop();
+    nowMicros += loopCostMicros;
+    loops++;
+  }
+}
+
+bool simRunUntil(const std::function<bool()> &done, uint64_t maxMs) {
+  uint64_t until = nowMicros + maxMs * 1000ULL;
+  while (!done()) {
+    if (nowMicros >= until) return false;
+    loop();
+    nowMicros += loopCostMicros;
+    loops++;
+  }
+  return true;
+}
+
+void simRunUntilTrue(int64_t trueMicros) {
+  while (simTrueMicros() < trueMicros) {
+    loop();
+    nowMicros += loopCostMicros;
+    loops++;
+  }
+}
+
+void simOversleep(uint64_t ms) {
+  oversleepMicros = ms * 1000ULL;
+}
+
+void simWarp(uint64_t ms) {
+  nowMicros += ms * 1000ULL;
+  pollAll();
+}
+
+// ---- The ESP ----
+
+uint32_t EspClass::getChipId() {
+  return 0x303c1c;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return 38000;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() {
+  return 30000;
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+  return 5;
+}
+
+uint32_t EspClass::getFreeSketchSpace() {
+  return 0x73000;
+}
+
+String EspClass::getResetReason() {
+  static const char *reasons[] = { "Power On", "Hardware Watchdog", "Exception", "Software Watchdog",
+      "Software/System restart", "Deep-Sleep Wake", "External System" };
+  return String((resetInfo.reason <= REASON_EXT_SYS_RST) ? reasons[resetInfo.reason] : "Unknown");
+}
+
+struct rst_info *EspClass::getResetInfoPtr() {
+  return &resetInfo;
+}
+
+void EspClass::restart() {
+  restarts++;
+}
+
+uint32_t simRestartCount() {
+  return restarts;
+}
+
+void simSetResetReason(uint32_t reason) {
+  resetInfo.reason = reason;
+}
+
+/**
+ * Flash and RTC memory are read and written in whole, aligned, 32 bit words
+ */
+static bool flashRange(uint32_t address, size_t size) {
+  return !(address & 3) && !(size & 3) && (address + (uint64_t)size <= SIM_FLASH_SIZE);
+}
+
+bool EspClass::flashRead(uint32_t address, uint32_t *data, size_t size) {
+  if (!flashRange(address, size)) return false;
+  memcpy(data, &flash[address], size);
+  return true;
+}
+
+bool EspClass::flashWrite(uint32_t address, const uint32_t *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  if (!flashRange(address, size)) return false;
+  for (size_t i = 0 ; i < size ; i++) {
+    // NOR flash can only clear bits - setting one takes an erase
+    if ((flash[address + i] & bytes[i]) != bytes[i]) flashBitViolations++;
+    flash[address + i] &= bytes[i];
+  }
+  return true;
+}
+
+bool EspClass::flashEraseSector(uint32_t sector) {
+  if (sector >= flashErases.size()) return false;
+  memset(&flash[sector * SIM_FLASH_SECTOR_SIZE], 0xFF, SIM_FLASH_SECTOR_SIZE);
+  flashErases[sector]++;
+  nowMicros += flashEraseMillis * 1000ULL; // The CPU waits for it
+  return true;
+}
+
+uint32_t simFlashErases(uint32_t sector) {
+  return (sector < flashErases.size()) ? flashErases[sector] : 0;
+}
+
+uint32_t simFlashBitViolations() {
+  return flashBitViolations;
+}
+
+void simSetFlashEraseMillis(uint32_t ms) {
+  flashEraseMillis = ms;
+}
+
+/**
+ * RTC memory comes up holding rubbish after a power cut
+ */
+static void setUpRTC() {
+  if (rtcSetUp) return;
+  for (size_t i = 0 ; i < sizeof(rtcMemory) ; i++) rtcMemory[i] = random(256);
+  rtcSetUp = true;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size) {
+  setUpRTC();
+  if (!size || (offset * 4 + size > SIM_RTC_USER_BYTES)) return false;
+  memcpy(data, rtcMemory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size) {
+  setUpRTC();
+  if (!size || (offset * 4 + size > SIM_RTC_USER_BYTES)) return false;
+  memcpy(rtcMemory + offset * 4, data, size);
+  return true;
+}
+
+void simPowerCut() {
+  rtcSetUp = false;
+  resetInfo.reason = REASON_DEFAULT_RST;
+}
+
+// ---- The board ----
+
+/**
+ * The buttons rest at their pull-ups (and GPIO15's pull-down)
+ */
+static void setUpPins() {
+  if (pinsSetUp) return;
+  for (int i = 0 ; i < SIM_PINS ; i++) pinLevels[i] = ((i == 0) || (i == 4)) ? HIGH : LOW;
+  pinsSetUp = true;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  setUpPins();
+  if (pin < SIM_PINS) pinModes[pin] = mode;
+}
+
+int digitalRead(uint8_t pin) {
+  setUpPins();
+  return (pin < SIM_PINS) ? pinLevels[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  setUpPins();
+  if ((pin < SIM_PINS) && (pinModes[pin] == OUTPUT)) pinLevels[pin] = value ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin < SIM_PINS) {
+    pinHandlers[pin] = handler;
+    pinModes[pin] = (pinModes[pin] & 0xFF) | (mode << 8);
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < SIM_PINS) pinHandlers[pin] = nullptr;
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+void simSetButton(uint8_t pin, bool pressed) {
+  uint8_t level = (pin == 15) ? pressed : !pressed;
+  int mode;
+  setUpPins();
+  if ((pin >= SIM_PINS) || (pinLevels[pin] == level)) return;
+  pinLevels[pin] = level;
+  mode = pinModes[pin] >> 8;
+  if (pinHandlers[pin] && ((mode == CHANGE) || ((mode == RISING) && level) || ((mode == FALLING) && !level))) {
+    pinHandlers[pin]();
+  }
+}
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  // xorshift32 - the same sequence every run
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState % howBig;
+}
+
+long random(long howSmall, long howBig) {
+  return (howSmall >= howBig) ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed) randomState = seed;
+}
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  // As the core does it - most significant bit first, no final inversion
+  while (length--) {
+    uint8_t c = *bytes++;
+    for (uint32_t i = 0x80 ; i > 0 ; i >>= 1) {
+      bool bit = crc & 0x80000000;
+      if (c & i) bit = !bit;
+      crc <<= 1;
+      if (bit) crc ^= 0x04c11db7;
+    }
+  }
+  return crc;
+}
+
+// ---- The TM1650 ----
+
+void TwoWire::begin(int sda, int scl) {}
+void TwoWire::begin() {}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  this->address = address;
+  data.clear();
+}
+
+size_t TwoWire::write(uint8_t value) {
+  data.push_back(value);
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *values, size_t quantity) {
+  data.insert(data.end(), values, values + quantity);
+  return quantity;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  // The TM1650 answers at 0x24 (its control register) and 0x34 .. 0x37 (the digits), one byte each
+  if ((address != SIM_TM1650_CONTROL) && ((address < SIM_TM1650_DIGITS) || (address > SIM_TM1650_DIGITS + 3))) return 2;
+  if (data.size() != 1) return 4;
+  displayWrites.push_back({ nowMicros, address, data[0] });
+  if (address == SIM_TM1650_CONTROL) {
+    displayControl = data[0];
+  } else {
+    displayDigits[address - SIM_TM1650_DIGITS] = data[0];
+  }
+  return 0;
+}
+
+const std::vector<SimDisplayWrite> &simDisplayWrites() {
+  return displayWrites;
+}
+
+void simClearDisplayWrites() {
+  displayWrites.clear();
+}
+
+void simDisplayFrame(uint8_t *digits) {
+  memcpy(digits, displayDigits, sizeof(displayDigits));
+}
+
+char simDecodeSegments(uint8_t bitmap) {
+  // The board's wiring - bits b f a e d c g dp from the top
+  static const uint8_t digits[10] = { 0xFC, 0x84, 0xBA, 0xAE, 0xC6, 0x6E, 0x7E, 0xA4, 0xFE, 0xEE };
+  bitmap &= ~1;
+  if (!bitmap) return ' ';
+  if (bitmap == 0x02) return '-';
+  for (int i = 0 ; i < 10 ; i++) if (bitmap == digits[i]) return '0' + i;
+  return '?';
+}
+
+String simDisplayText() {
+  String ans;
+  for (int i = 0 ; i < 4 ; i++) ans.concat(simDecodeSegments(displayDigits[i]));
+  return ans;
+}
+
+bool simDisplayColon() {
+  return displayDigits[1] & 1;
+}
+
+uint8_t simDisplayBrightness() {
+  return ((displayControl >> 4) + 7) & 7;
+}
+
+bool simDisplayLit() {
+  return displayControl & 1;
+}
+
+// ---- Serial and printf ----
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  return write(buf);
+}
+
+size_t Print::printf_P(PGM_P format, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf_P(buf, sizeof(buf), format, args);
+  va_end(args);
+  return write(buf);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+int vsnprintf_P(char *str, size_t size, PGM_P format, va_list args) {
+  // "%S" is a string in flash to the core, and a wide string to the C library
+  std::string translated(format);
+  for (size_t i = 0 ; i < translated.length() ; i++) {
+    if (translated[i] != '%') continue;
+    i++;
+    while ((i < translated.length()) && strchr("-+ #0123456789.*hlLqjzt", translated[i])) i++;
+    if ((i < translated.length()) && (translated[i] == 'S')) translated[i] = 's';
+  }
+  return vsnprintf(str, size, translated.c_str(), args);
+}
+
+int snprintf_P(char *str, size_t size, PGM_P format, ...) {
+  va_list args;
+  int n;
+  va_start(args, format);
+  n = vsnprintf_P(str, size, format, args);
+  va_end(args);
+  return n;
+}
+
+int sprintf_P(char *str, PGM_P format, ...) {
+  va_list args;
+  int n;
+  va_start(args, format);
+  n = vsnprintf_P(str, SIZE_MAX, format, args);
+  va_end(args);
+  return n;
+}
@@ -0,0 +1,143 @@
+// sim.h - the simulated 303WIFILC01 board and its network, for running the firmware natively
+//
+// The firmware is built unchanged against the stand-in core and library headers in this directory
+// and runs here on virtual time. Nothing happens between loop() passes but waiting, so the
+// simulation jumps straight to the end of each wait (or the next thing to happen on the network,
+// whichever is sooner): a day of the clock takes a fraction of a second. simWarp() skips time
+// without running loop() at all, for getting to next year's DST change.
+//
+// Around the firmware there are
+//
+//   a clock        the ESP's time of day, which drifts at simSetDriftPPM() from the true time
+//                  (simSetTrueTime()) until the SNTP client sets it
+//   an NTP server  answers the SNTP client every SNTP_UPDATE_DELAY (an hour), and any NTP request
+//                  sent to port 123, with the true time and the leap indicator of simSetLeapIndicator()
+//                  - except those to the addresses the test answers itself (simTestNTPServer())
+//   an access point, DNS, mDNS, an MQTT broker, a syslog server and browsers
+//   the TM1650     every write to it is recorded with its time, and decoded into what it shows
+//   the flash      NOR flash - a write can only clear bits, and each sector's erases are counted
+//   the buttons    SET (GPIO0) and UP (GPIO4) pull low when pressed, DOWN (GPIO15) pulls high
+//
+// Time is in microseconds since boot (simMicros()) or true UTC microseconds (simTrueMicros()).
+//
+// The firmware's state is in its static variables, so each test program boots one clock - with
+// setup() - and runs it through its scenarios in turn.
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+// ---- Time ----
+
+void simSetTrueTime(time_t t, uint32_t usec = 0);   // The true UTC time, now
+int64_t simTrueMicros();                            // The true UTC time, in microseconds
+int64_t simSystemMicros();                          // What gettimeofday() says
+uint64_t simMicros();                               // Since boot
+void simSetDriftPPM(double ppm);                    // How fast the ESP's clock runs - positive is fast
+void simLeapSecond(time_t midnight, int8_t leap);   // The true (Unix) time goes back a second at midnight, or on one at 23:59:59
+void simRun(uint64_t ms);                           // Run loop() for this long
+bool simRunUntil(const std::function<bool()> &done, uint64_t maxMs); // Run until done(), or maxMs
+void simRunUntilTrue(int64_t trueMicros);           // Run until the true time reaches trueMicros
+void simWarp(uint64_t ms);                          // Skip time without running loop()
+void simOversleep(uint64_t ms);                     // Make the clock's next wait this much longer, as if it slept through it
+void simAdvanceMicros(uint64_t us);                 // Time passing within a loop() pass - work being done
+void simSetLoopCostMicros(uint32_t us);             // What each loop() pass takes - 50 us to start with
+uint64_t simLoopCount();                            // loop() passes since boot
+
+// ---- Network ----
+
+void simSetAccessPoint(bool up);                    // Can the station connect? Initially up
+void simSetConnectMillis(uint32_t ms);              // How long a connection takes - 3 s to start with
+bool simWiFiConnected();
+void simSetSNTPReachable(bool reachable);           // Does the NTP server answer? Initially yes
+void simSetSNTPErrorMicros(int32_t us);             // How far off the server's time is
+void simSetSNTPIntervalMillis(uint32_t ms);         // Time between syncs - an hour to start with
+uint32_t simSNTPSyncCount();
+void simSetLeapIndicator(uint8_t li);               // In the NTP server's replies - 0, 1 (insert) or 2 (delete)
+void simTestNTPServer(IPAddress address);           // NTP requests to address go to simTakeUDP(), for the test to answer
+void simSetHostAddress(const char *name, IPAddress address); // What DNS says a name is
+void simSetHostMissing(const char *name, bool missing);      // DNS can't find the name
+std::string simMDNSTxt(const char *service, const char *key); // A TXT record advertised for "_303clock._tcp", say - empty if none
+
+typedef struct SimPacket_t {
+  uint64_t at;                                      // simMicros() when it was sent or is due
+  IPAddress from;
+  uint16_t fromPort;
+  IPAddress to;
+  uint16_t toPort;
+  std::vector<uint8_t> data;
+} SimPacket;
+
+// A packet to one of the clock's UDP ports, delivered delayMillis from now
+void simSendUDP(IPAddress from, uint16_t fromPort, uint16_t toPort, const uint8_t *data, size_t len,
+    uint32_t delayMillis = 0);
+// The packets the clock has sent (other than to the NTP server), oldest first, forgetting them
+std::vector<SimPacket> simTakeUDP();
+
+void simSetMqttBroker(bool up);                     // Does the broker take connections? Initially yes
+void simSetMqttAcks(bool ack);                      // Does it acknowledge QoS 1 publishes? Initially yes
+typedef struct SimMqttMessage_t {
+  std::string topic;
+  std::string payload;
+  uint8_t qos;
+  bool retain;
+  bool dup;
+  uint16_t packetId;                                // 0 for QoS 0
+} SimMqttMessage;
+std::vector<SimMqttMessage> simTakeMqtt();          // Published since last asked
+std::vector<uint64_t> simTakeMqttConnects();        // simMicros() of each connection attempt since last asked
+void simMqttCommand(const char *topic, const char *payload, bool retain = false); // The broker delivers a message
+
+// ---- Web ----
+
+typedef struct SimHttpResult_t {
+  int status = 0;                                   // 0 if the request hasn't been answered
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+  std::string header(const char *name) const;
+} SimHttpResult;
+
+// A request to the web server. The body is sent as a form unless contentType says otherwise; a
+// multipart body goes to the upload handler in pieces. Runs loop() until it is answered (up to
+// maxMs), as a response can wait for it
+SimHttpResult simHttp(const char *method, const char *url, const std::string &body = std::string(),
+    const std::vector<std::pair<std::string, std::string>> &headers = {},
+    const char *contentType = "application/x-www-form-urlencoded", uint64_t maxMs = 10000);
+// A browser connecting to the event source at url, taking an event every millisPerEvent
+class AsyncEventSourceClient;
+AsyncEventSourceClient *simConnectEvents(const char *url, uint32_t millisPerEvent);
+
+// ---- The TM1650 ----
+
+typedef struct SimDisplayWrite_t {
+  uint64_t at;                                      // simMicros()
+  uint8_t address;                                  // 0x24 control, 0x34 .. 0x37 digits
+  uint8_t value;
+} SimDisplayWrite;
+
+const std::vector<SimDisplayWrite> &simDisplayWrites(); // Every write since boot, or simClearDisplayWrites()
+void simClearDisplayWrites();
+void simDisplayFrame(uint8_t *digits);              // The 4 segment bitmaps being shown
+String simDisplayText();                            // Decoded - '?' for a pattern that isn't a character
+bool simDisplayColon();
+uint8_t simDisplayBrightness();                     // 0 .. 7
+bool simDisplayLit();
+char simDecodeSegments(uint8_t bitmap);             // The character a bitmap shows, ignoring the dp
+
+// ---- Flash, RTC memory and restarts ----
+
+uint32_t simFlashErases(uint32_t sector);
+uint32_t simFlashBitViolations();                   // Writes that tried to set a cleared bit
+void simSetFlashEraseMillis(uint32_t ms);           // How long an erase stops the CPU - 40 ms to start with
+void simPowerCut();                                 // RTC memory is lost - call before setup() again
+uint32_t simRestartCount();                         // ESP.restart() calls
+void simSetResetReason(uint32_t reason);            // For the next boot - REASON_ in user_interface.h
+
+// ---- Buttons ----
+
+void simSetButton(uint8_t pin, bool pressed);
+
+#endif
@@ -0,0 +1,21 @@
+// sim_internal.h - how the parts of the simulation work together. Not for the tests - see sim.h
+
+#ifndef _SIM_INTERNAL_H_
+#define _SIM_INTERNAL_H_
+
+#include "sim.h"
+
+#define SIM_NEVER UINT64_MAX
+
+// Each part says when it next has something to do (SIM_NEVER for nothing), and does whatever is due
+uint64_t simNetworkNextEvent();
+void simNetworkPoll();
+uint64_t simWebNextEvent();
+void simWebPoll();
+
+// Set the ESP's clock, as the SNTP client does, and tell the firmware
+void simSetSystemMicros(int64_t micros);
+// Let time pass until the firmware can go on - see esp_delay()
+void simWaitUntil(uint64_t until, const std::function<bool()> *blocked);
+
+#endif
@@ -0,0 +1,294 @@
+// sim_libs.cpp - the libraries the firmware uses that aren't about the network: the stored
+// configuration, the updater, ArduinoOTA and mDNS, and BearSSL's SHA-256
+
+#include <map>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <Updater.h>
+#include <ArduinoOTA.h>
+#include <ESP8266mDNS.h>
+#include <ESP8266WiFi.h>
+#include <bearssl/bearssl_hash.h>
+#include "sim_internal.h"
+
+UpdaterClass Update;
+ArduinoOTAClass ArduinoOTA;
+MDNSResponder MDNS;
+
+// ---- Preferences ----
+
+// Each namespace's keys, with the type each was stored as - Preferences won't read a key back as
+// another type
+typedef struct StoredValue_t {
+  char type;                            // 'c', 's', 'S' (string) or 'b' (bytes)
+  std::vector<uint8_t> data;
+} StoredValue;
+static std::map<std::string, std::map<std::string, StoredValue>> stored;
+
+static StoredValue *findValue(const String &name, const char *key, char type) {
+  auto space = stored.find(name.c_str());
+  if (space == stored.end()) return nullptr;
+  auto value = space->second.find(key);
+  if ((value == space->second.end()) || (type && (value->second.type != type))) return nullptr;
+  return &value->second;
+}
+
+static size_t putValue(const String &name, const char *key, char type, const void *data, size_t len) {
+  if (!name.length() || !key || (strlen(key) > 15)) return 0;
+  StoredValue &value = stored[name.c_str()][key];
+  value.type = type;
+  value.data.assign((const uint8_t *)data, (const uint8_t *)data + len);
+  return len;
+}
+
+bool Preferences::begin(const char *name, bool readOnly) {
+  this->name = name;
+  return true;
+}
+
+void Preferences::end() {
+  name = String();
+}
+
+bool Preferences::clear() {
+  stored.erase(name.c_str());
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  auto space = stored.find(name.c_str());
+  return (space != stored.end()) && space->second.erase(key);
+}
+
+bool Preferences::isKey(const char *key) {
+  return findValue(name, key, 0) != nullptr;
+}
+
+size_t Preferences::putChar(const char *key, int8_t value) {
+  return putValue(name, key, 'c', &value, sizeof(value));
+}
+
+size_t Preferences::putShort(const char *key, int16_t value) {
+  return putValue(name, key, 's', &value, sizeof(value));
+}
+
+size_t Preferences::putString(const char *key, const char *value) {
+  return putValue(name, key, 'S', value, strlen(value));
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  return putValue(name, key, 'b', value, len);
+}
+
+int8_t Preferences::getChar(const char *key, int8_t defaultValue) {
+  StoredValue *value = findValue(name, key, 'c');
+  return value ? (int8_t)value->data[0] : defaultValue;
+}
+
+int16_t Preferences::getShort(const char *key, int16_t defaultValue) {
+  StoredValue *value = findValue(name, key, 's');
+  int16_t ans;
+  if (!value) return defaultValue;
+  memcpy(&ans, value->data.data(), sizeof(ans));
+  return ans;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+  StoredValue *value = findValue(name, key, 'S');
+  if (!value) return defaultValue;
+  return String(std::string(value->data.begin(), value->data.end()).c_str());
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  StoredValue *value = findValue(name, key, 'b');
+  return value ? value->data.size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  StoredValue *value = findValue(name, key, 'b');
+  if (!value || (value->data.size() > maxLen)) return 0;
+  memcpy(buf, value->data.data(), value->data.size());
+  return value->data.size();
+}
+
+// ---- The updater ----
+
+bool UpdaterClass::begin(size_t size, int command, int ledPin, uint8_t ledOn) {
+  if (running) return false;
+  error = UPDATE_ERROR_OK;
+  if (size > ESP.getFreeSketchSpace()) {
+    error = UPDATE_ERROR_SPACE;
+    return false;
+  }
+  expected = size;
+  written = 0;
+  running = true;
+  return true;
+}
+
+size_t UpdaterClass::write(uint8_t *data, size_t len) {
+  if (!running || (error != UPDATE_ERROR_OK)) return 0;
+  if (written + len > expected) {
+    error = UPDATE_ERROR_SPACE;
+    return 0;
+  }
+  written += len;
+  return len;
+}
+
+bool UpdaterClass::end(bool evenIfRemaining) {
+  bool ok = running && (error == UPDATE_ERROR_OK) && (evenIfRemaining || (written == expected));
+  if (running && !ok && (error == UPDATE_ERROR_OK)) error = UPDATE_ERROR_SIZE;
+  running = false;
+  return ok;
+}
+
+// ---- ArduinoOTA and mDNS ----
+
+// What is advertised, as a browser would see it: each service's TXT records, with the dynamic
+// ones asked for afresh at each query
+typedef struct SimService_t {
+  std::string name;
+  std::map<std::string, std::string> txt;
+  std::map<std::string, std::string> dynamicTxt;
+  MDNSResponder::MDNSDynamicServiceTxtCallbackFunc dynamicCallback;
+} SimService;
+
+static bool mdnsRunning = false;
+static std::vector<SimService> mdnsServices;
+
+static SimService *mdnsService(const MDNSResponder::hMDNSService service) {
+  size_t i = (size_t)service;
+  return (i && (i <= mdnsServices.size())) ? &mdnsServices[i - 1] : nullptr;
+}
+
+void ArduinoOTAClass::setHostname(const char *name) {
+  WiFi.setHostname(name);
+}
+
+void ArduinoOTAClass::begin(bool useMDNS) {
+  // ArduinoOTA starts the mDNS responder, which needs an address to answer from
+  if (useMDNS && WiFi.isConnected()) mdnsRunning = true;
+}
+
+bool MDNSResponder::isRunning() {
+  return mdnsRunning;
+}
+
+MDNSResponder::hMDNSService MDNSResponder::addService(const char *instance, const char *service, const char *protocol,
+    uint16_t port) {
+  if (!mdnsRunning) return nullptr;
+  mdnsServices.push_back({ std::string("_") + service + "._" + protocol, {}, {}, nullptr });
+  return (hMDNSService)mdnsServices.size();
+}
+
+bool MDNSResponder::addServiceTxt(const hMDNSService service, const char *key, const char *value) {
+  SimService *s = mdnsService(service);
+  if (s) s->txt[key] = value;
+  return s != nullptr;
+}
+
+bool MDNSResponder::addDynamicServiceTxt(const hMDNSService service, const char *key, const char *value) {
+  SimService *s = mdnsService(service);
+  if (s) s->dynamicTxt[key] = value;
+  return s != nullptr;
+}
+
+bool MDNSResponder::setDynamicServiceTxtCallback(const hMDNSService service, MDNSDynamicServiceTxtCallbackFunc callback) {
+  SimService *s = mdnsService(service);
+  if (s) s->dynamicCallback = callback;
+  return s != nullptr;
+}
+
+std::string simMDNSTxt(const char *service, const char *key) {
+  for (size_t i = 0 ; i < mdnsServices.size() ; i++) {
+    SimService &s = mdnsServices[i];
+    if (s.name != service) continue;
+    s.dynamicTxt.clear();
+    if (s.dynamicCallback) s.dynamicCallback((MDNSResponder::hMDNSService)(i + 1));
+    if (s.dynamicTxt.count(key)) return s.dynamicTxt[key];
+    return s.txt.count(key) ? s.txt[key] : std::string();
+  }
+  return std::string();
+}
+
+// ---- SHA-256 (FIPS 180-4) ----
+
+static const uint32_t sha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t ror(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(uint32_t *val, const uint8_t *block) {
+  uint32_t w[64];
+  uint32_t v[8];
+  for (int i = 0 ; i < 16 ; i++) {
+    w[i] = ((uint32_t)block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+  for (int i = 16 ; i < 64 ; i++) {
+    uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  memcpy(v, val, sizeof(v));
+  for (int i = 0 ; i < 64 ; i++) {
+    uint32_t t1 = v[7] + (ror(v[4], 6) ^ ror(v[4], 11) ^ ror(v[4], 25)) + ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256K[i] + w[i];
+    uint32_t t2 = (ror(v[0], 2) ^ ror(v[0], 13) ^ ror(v[0], 22)) + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+    memmove(v + 1, v, 7 * sizeof(uint32_t));
+    v[4] += t1;
+    v[0] = t1 + t2;
+  }
+  for (int i = 0 ; i < 8 ; i++) val[i] += v[i];
+}
+
+void br_sha256_init(br_sha256_context *ctx) {
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(ctx->val, initial, sizeof(initial));
+  ctx->count = 0;
+}
+
+void br_sha256_update(br_sha256_context *ctx, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (len) {
+    size_t used = ctx->count & 63;
+    size_t n = std::min(len, 64 - used);
+    memcpy(ctx->buf + used, p, n);
+    ctx->count += n;
+    p += n;
+    len -= n;
+    if (!(ctx->count & 63)) sha256Block(ctx->val, ctx->buf);
+  }
+}
+
+void br_sha256_out(const br_sha256_context *ctx, void *out) {
+  // Pad a copy, so more can still be added to the context
+  br_sha256_context copy = *ctx;
+  uint64_t bits = ctx->count * 8;
+  uint8_t pad = 0x80;
+  uint8_t length[8];
+  br_sha256_update(&copy, &pad, 1);
+  pad = 0;
+  while ((copy.count & 63) != 56) br_sha256_update(&copy, &pad, 1);
+  for (int i = 0 ; i < 8 ; i++) length[i] = bits >> (56 - 8 * i);
+  br_sha256_update(&copy, length, 8);
+  for (int i = 0 ; i < 8 ; i++) {
+    ((uint8_t *)out)[i * 4] = copy.val[i] >> 24;
+    ((uint8_t *)out)[i * 4 + 1] = copy.val[i] >> 16;
+    ((uint8_t *)out)[i * 4 + 2] = copy.val[i] >> 8;
+    ((uint8_t *)out)[i * 4 + 3] = copy.val[i];
+  }
+}
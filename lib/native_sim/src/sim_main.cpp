@@ -0,0 +1,197 @@
+// sim_main.cpp - a simulated clock as a program, with its web server on a real TCP port
+//
+// "pio run -e native" builds this (the tests bring their own main()). It boots one clock on the
+// simulated board and network, runs it in step with the wall clock, and passes each HTTP request
+// made to 127.0.0.1:<port> on to its web server through simHttp(), so the clock can be driven by
+// the same tools as a real one:
+//
+//   .pio/build/native/program --port 8301 --hostname clock1
+//   tools/clockctl.py --hosts 127.0.0.1:8301 list
+//
+// Connections are taken one at a time and closed after each response. The configuration is kept in
+// memory, for as long as the program runs. tools/sim_fleet.py starts several of these.
+
+#ifndef PIO_UNIT_TESTING
+
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include "sim.h"
+
+#define SIM_MAX_REQUEST_BYTES (2 * 1024 * 1024)   // A firmware image, and then some
+#define SIM_STEP_MILLIS 10
+
+// The build machine's clock - gettimeofday() is the simulated clock's here
+static uint64_t wallMillis() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+}
+
+static bool sendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+/**
+ * Read a request - its head, and a body of Content-Length bytes. False if the connection went
+ * before it was all there, or it is bigger than we take
+ */
+static bool readRequest(int fd, std::string &method, std::string &url,
+    std::vector<std::pair<std::string, std::string>> &headers, std::string &contentType, std::string &body) {
+  std::string data;
+  size_t headEnd;
+  size_t length = 0;
+  size_t lineStart;
+  char buf[4096];
+  while ((headEnd = data.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if ((n <= 0) || (data.size() > 65536)) return false;
+    data.append(buf, n);
+  }
+  lineStart = data.find("\r\n") + 2;
+  {
+    std::string line = data.substr(0, lineStart - 2);
+    size_t space1 = line.find(' ');
+    size_t space2 = line.find(' ', space1 + 1);
+    if ((space1 == std::string::npos) || (space2 == std::string::npos)) return false;
+    method = line.substr(0, space1);
+    url = line.substr(space1 + 1, space2 - space1 - 1);
+  }
+  contentType = "application/x-www-form-urlencoded";
+  while (lineStart < headEnd) {
+    size_t lineEnd = data.find("\r\n", lineStart);
+    std::string line = data.substr(lineStart, lineEnd - lineStart);
+    size_t colon = line.find(':');
+    lineStart = lineEnd + 2;
+    if (colon == std::string::npos) continue;
+    std::string name = line.substr(0, colon);
+    std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+    if (!strcasecmp(name.c_str(), "Content-Length")) {
+      length = strtoul(value.c_str(), nullptr, 10);
+    } else if (!strcasecmp(name.c_str(), "Content-Type")) {
+      contentType = value;
+    } else if (strcasecmp(name.c_str(), "Connection") && strcasecmp(name.c_str(), "Host")) {
+      headers.push_back({ name, value });
+    }
+  }
+  if (length > SIM_MAX_REQUEST_BYTES) return false;
+  body = data.substr(headEnd + 4);
+  while (body.size() < length) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return false;
+    body.append(buf, n);
+  }
+  body.resize(length);
+  return true;
+}
+
+/**
+ * Answer one connection through the simulated web server
+ */
+static void serve(int fd) {
+  std::string method;
+  std::string url;
+  std::string contentType;
+  std::string body;
+  std::vector<std::pair<std::string, std::string>> headers;
+  SimHttpResult result;
+  std::string response;
+  if (!readRequest(fd, method, url, headers, contentType, body)) return;
+  result = simHttp(method.c_str(), url.c_str(), body, headers, contentType.c_str());
+  if (!result.status) {
+    sendAll(fd, "HTTP/1.1 504 Gateway Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    return;
+  }
+  response = "HTTP/1.1 " + std::to_string(result.status) + " -\r\n";
+  for (auto &h : result.headers) {
+    if (strcasecmp(h.first.c_str(), "Content-Length")) response += h.first + ": " + h.second + "\r\n";
+  }
+  response += "Content-Length: " + std::to_string((method == "HEAD") ? 0 : result.body.size()) + "\r\nConnection: close\r\n\r\n";
+  if (method != "HEAD") response += result.body;
+  sendAll(fd, response);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [--port N] [--hostname NAME] [--zone ZONE]\n", name);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  int port = 8301;
+  std::string hostname = "clock";
+  std::string zone = "Europe/London";
+  struct sockaddr_in address;
+  int listener;
+  int one = 1;
+  uint64_t wallStart;
+  uint64_t simStart;
+  for (int i = 1 ; i < argc ; i++) {
+    if (i + 1 >= argc) usage(argv[0]);
+    if (!strcmp(argv[i], "--port")) {
+      port = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--hostname")) {
+      hostname = argv[++i];
+    } else if (!strcmp(argv[i], "--zone")) {
+      zone = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if ((bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0) || (listen(listener, 16) < 0)) {
+    fprintf(stderr, "Can't listen on port %d: %s\n", port, strerror(errno));
+    return 1;
+  }
+
+  // CFG_SSID, CFG_HOSTNAME, CFG_NTP_SERVER_1 and CFG_ZONE in the firmware's config.h
+  prefs.begin("303Clock");
+  prefs.putString("SSID", "sim");
+  prefs.putString("HOST", hostname.c_str());
+  prefs.putString("NTP1", "pool.ntp.org");
+  prefs.putString("ZONE", zone.c_str());
+  prefs.end();
+  simSetTrueTime((time)(nullptr));         // The C library's time(), not the simulated clock's
+  setup();
+  fprintf(stderr, "%s on 127.0.0.1:%d\n", hostname.c_str(), port);
+
+  // Virtual time is kept with the wall clock, apart from the time a request takes to answer - the
+  // web server's handlers run in between loop() passes, as they do on the ESP
+  wallStart = wallMillis();
+  simStart = simMicros() / 1000;
+  for (;;) {
+    struct pollfd fds = { listener, POLLIN, 0 };
+    uint64_t due;
+    if (poll(&fds, 1, SIM_STEP_MILLIS) > 0) {
+      int fd = accept(listener, nullptr, nullptr);
+      if (fd >= 0) {
+        serve(fd);
+        close(fd);
+      }
+    }
+    due = simStart + wallMillis() - wallStart;
+    if (due > simMicros() / 1000) simRun(due - simMicros() / 1000);
+  }
+}
+
+#endif
@@ -0,0 +1,763 @@
+// sim_net.cpp - the simulated network: access point, UDP, DNS, the NTP server and the MQTT broker
+//
+// Everything here happens at a time (simMicros()) - a connection completing, a packet arriving, a
+// name being found, the SNTP client's next poll - and simNetworkPoll() does what is due.
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <AsyncMqttClient.h>
+#include <sntp.h>
+#include <lwip/dns.h>
+#include "sim_internal.h"
+
+#define SIM_LOCAL_IP IPAddress(192, 168, 1, 50)
+#define SIM_SOFT_AP_IP IPAddress(192, 168, 200, 1)
+#define SIM_NTP_PORT 123
+#define SIM_NTP_PACKET_SIZE 48
+#define SIM_NTP_UNIX_OFFSET 2208988800ULL
+#define SIM_NTP_ROUND_TRIP_MICROS 20000ULL
+#define SIM_SNTP_STARTUP_MICROS 100000ULL
+#define SIM_SNTP_RETRY_MICROS 15000000ULL
+#define SIM_DNS_MICROS 20000ULL
+#define SIM_DNS_TTL_MICROS 3600000000ULL
+#define SIM_MQTT_CONNECT_MICROS 50000ULL
+#define SIM_EPHEMERAL_PORT 49152
+
+ESP8266WiFiClass WiFi;
+
+class WiFiEventHandlerOpaque {
+public:
+  explicit WiFiEventHandlerOpaque(std::function<void(const WiFiEventStationModeGotIP &)> handler) : handler(handler) {}
+  std::function<void(const WiFiEventStationModeGotIP &)> handler;
+};
+
+// The access point and the station
+static bool accessPointUp = true;
+static uint32_t connectMillis = 3000;
+static WiFiMode_t wifiMode = WIFI_OFF;
+static WiFiSleepType_t sleepType = WIFI_NONE_SLEEP;
+static bool stationConnected = false;
+static uint64_t connectAt = SIM_NEVER;
+static bool softAPUp = false;
+static String hostName;
+static std::vector<std::weak_ptr<WiFiEventHandlerOpaque>> gotIPHandlers;
+
+// UDP - the packets on their way, and each socket's
+static std::vector<SimPacket> inFlight;
+static std::vector<SimPacket> sent;
+static uint16_t nextEphemeralPort = SIM_EPHEMERAL_PORT;
+
+// The firmware's sockets are static objects, whose destructors run at exit after this map would have
+// been destroyed - so it never is
+static std::map<WiFiUDP *, std::deque<SimPacket>> &sockets() {
+  static std::map<WiFiUDP *, std::deque<SimPacket>> *ans = new std::map<WiFiUDP *, std::deque<SimPacket>>();
+  return *ans;
+}
+
+// DNS
+typedef struct Lookup_t {
+  uint64_t at;
+  std::string name;
+  dns_found_callback found;
+  void *arg;
+} Lookup;
+static std::map<std::string, IPAddress> hostAddresses;
+static std::map<std::string, bool> hostsMissing;
+static std::map<std::string, uint64_t> dnsCache;          // When each name was found
+static std::vector<Lookup> lookups;
+
+// The SNTP client and the NTP server
+static bool sntpRunning = false;
+static uint64_t sntpNextAt = SIM_NEVER;
+static const char *sntpNames[SNTP_MAX_SERVERS];
+static ip_addr_t sntpAddresses[SNTP_MAX_SERVERS];
+static uint64_t sntpIntervalMicros = 3600000000ULL;   // SNTP_UPDATE_DELAY
+static bool sntpReachable = true;
+static int32_t sntpErrorMicros = 0;
+static uint32_t sntpSyncs = 0;
+static uint8_t leapIndicator = 0;
+static std::vector<IPAddress> testNTPServers;     // The test answers these itself
+
+// The MQTT broker
+static bool brokerUp = true;
+static bool brokerAcks = true;
+
+// The firmware's MQTT client is a static object, which may be constructed before this list would be
+static std::vector<AsyncMqttClient *> &mqttClients() {
+  static std::vector<AsyncMqttClient *> ans;
+  return ans;
+}
+
+static std::vector<SimMqttMessage> mqttPublished;
+static std::vector<uint64_t> mqttConnects;
+
+// ---- DNS ----
+
+/**
+ * What DNS says a name is - unless the test has said otherwise, an address made up from the name
+ */
+static IPAddress hostAddress(const std::string &name) {
+  auto known = hostAddresses.find(name);
+  uint32_t hash = 2166136261u;
+  if (known != hostAddresses.end()) return known->second;
+  for (char c : name) hash = (hash ^ (uint8_t)c) * 16777619u;
+  return IPAddress(10, 1 + hash % 250, 1 + (hash >> 8) % 250, 1 + (hash >> 16) % 250);
+}
+
+void simSetHostAddress(const char *name, IPAddress address) {
+  hostAddresses[name] = address;
+}
+
+void simSetHostMissing(const char *name, bool missing) {
+  hostsMissing[name] = missing;
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg) {
+  IPAddress address;
+  auto cached = dnsCache.find(hostname);
+  if (!hostname || !*hostname) return ERR_ARG;
+  if (address.fromString(hostname)) {
+    addr->addr = address.v4();
+    return ERR_OK;
+  }
+  if ((cached != dnsCache.end()) && (simMicros() - cached->second < SIM_DNS_TTL_MICROS)) {
+    addr->addr = hostAddress(hostname).v4();
+    return ERR_OK;
+  }
+  if (!stationConnected) return ERR_VAL;
+  lookups.push_back({ simMicros() + SIM_DNS_MICROS, hostname, found, callback_arg });
+  return ERR_INPROGRESS;
+}
+
+/**
+ * Answer the lookups that are due
+ */
+static void pollDNS() {
+  std::vector<Lookup> due;
+  for (size_t i = 0 ; i < lookups.size() ; ) {
+    if (lookups[i].at <= simMicros()) {
+      due.push_back(lookups[i]);
+      lookups.erase(lookups.begin() + i);
+    } else {
+      i++;
+    }
+  }
+  for (Lookup &lookup : due) {
+    ip_addr_t address;
+    if (!stationConnected || hostsMissing[lookup.name]) {
+      if (lookup.found) lookup.found(lookup.name.c_str(), nullptr, lookup.arg);
+      continue;
+    }
+    address.addr = hostAddress(lookup.name).v4();
+    dnsCache[lookup.name] = simMicros();
+    if (lookup.found) lookup.found(lookup.name.c_str(), &address, lookup.arg);
+  }
+}
+
+// ---- The access point and the station ----
+
+void simSetAccessPoint(bool up) {
+  accessPointUp = up;
+  if (!up) {
+    stationConnected = false;
+    connectAt = SIM_NEVER;
+  }
+}
+
+void simSetConnectMillis(uint32_t ms) {
+  connectMillis = ms;
+}
+
+bool simWiFiConnected() {
+  return stationConnected;
+}
+
+/**
+ * Try to join the access point - which only works if it is there to be found now
+ */
+static void startConnecting() {
+  stationConnected = false;
+  connectAt = accessPointUp ? simMicros() + connectMillis * 1000ULL : SIM_NEVER;
+}
+
+/**
+ * The connection has been made - tell everyone who asked
+ */
+static void pollStation() {
+  WiFiEventStationModeGotIP event;
+  if ((connectAt == SIM_NEVER) || (connectAt > simMicros())) return;
+  connectAt = SIM_NEVER;
+  if (!accessPointUp || !(wifiMode & WIFI_STA)) return;
+  stationConnected = true;
+  event.ip = SIM_LOCAL_IP;
+  event.mask = IPAddress(255, 255, 255, 0);
+  event.gw = IPAddress(192, 168, 1, 1);
+  for (auto &handler : gotIPHandlers) {
+    std::shared_ptr<WiFiEventHandlerOpaque> live = handler.lock();
+    if (live) live->handler(event);
+  }
+}
+
+bool ESP8266WiFiClass::mode(WiFiMode_t m) {
+  wifiMode = m;
+  if (!(m & WIFI_STA)) {
+    stationConnected = false;
+    connectAt = SIM_NEVER;
+  }
+  if (!(m & WIFI_AP)) softAPUp = false;
+  return true;
+}
+
+WiFiMode_t ESP8266WiFiClass::getMode() {
+  return wifiMode;
+}
+
+bool ESP8266WiFiClass::enableAP(bool enable) {
+  return mode((WiFiMode_t)(enable ? (wifiMode | WIFI_AP) : (wifiMode & ~WIFI_AP)));
+}
+
+bool ESP8266WiFiClass::setSleepMode(WiFiSleepType_t type, uint8_t listenInterval) {
+  sleepType = type;
+  return true;
+}
+
+WiFiSleepType_t ESP8266WiFiClass::getSleepMode() {
+  return sleepType;
+}
+
+bool ESP8266WiFiClass::setHostname(const char *name) {
+  hostName = name;
+  return true;
+}
+
+String ESP8266WiFiClass::hostname() {
+  return hostName;
+}
+
+bool ESP8266WiFiClass::setAutoReconnect(bool autoReconnect) {
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char *ssid, const char *passphrase) {
+  if (!(wifiMode & WIFI_STA)) mode((WiFiMode_t)(wifiMode | WIFI_STA));
+  startConnecting();
+  return status();
+}
+
+bool ESP8266WiFiClass::reconnect() {
+  if (!(wifiMode & WIFI_STA)) return false;
+  startConnecting();
+  return true;
+}
+
+bool ESP8266WiFiClass::disconnect(bool wifioff) {
+  stationConnected = false;
+  connectAt = SIM_NEVER;
+  if (wifioff) mode(WIFI_OFF);
+  return true;
+}
+
+bool ESP8266WiFiClass::isConnected() {
+  return stationConnected;
+}
+
+wl_status_t ESP8266WiFiClass::status() {
+  if (stationConnected) return WL_CONNECTED;
+  return (connectAt == SIM_NEVER) ? WL_DISCONNECTED : WL_IDLE_STATUS;
+}
+
+IPAddress ESP8266WiFiClass::localIP() {
+  return stationConnected ? SIM_LOCAL_IP : IPAddress();
+}
+
+int32_t ESP8266WiFiClass::RSSI() {
+  return stationConnected ? -60 : 31;
+}
+
+String ESP8266WiFiClass::SSID() {
+  return String("sim");
+}
+
+bool ESP8266WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) {
+  return true;
+}
+
+bool ESP8266WiFiClass::softAP(const char *ssid, const char *passphrase) {
+  if (!(wifiMode & WIFI_AP)) mode((WiFiMode_t)(wifiMode | WIFI_AP));
+  softAPUp = true;
+  return true;
+}
+
+IPAddress ESP8266WiFiClass::softAPIP() {
+  return softAPUp ? SIM_SOFT_AP_IP : IPAddress();
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> handler) {
+  WiFiEventHandler ans = std::make_shared<WiFiEventHandlerOpaque>(handler);
+  gotIPHandlers.push_back(ans);
+  return ans;
+}
+
+// ---- The NTP server ----
+
+static void putTimestamp(uint8_t *at, int64_t unixMicros) {
+  uint64_t seconds = unixMicros / 1000000LL + SIM_NTP_UNIX_OFFSET;
+  uint32_t fraction = (uint32_t)(((unixMicros % 1000000LL) << 32) / 1000000LL);
+  for (int i = 0 ; i < 4 ; i++) {
+    at[i] = seconds >> (24 - 8 * i);
+    at[4 + i] = fraction >> (24 - 8 * i);
+  }
+}
+
+/**
+ * Answer an NTP request, as a stratum 1 server would. The reply is on its way for a round trip
+ */
+static void answerNTP(const SimPacket &request) {
+  SimPacket reply;
+  int64_t now = simTrueMicros() + sntpErrorMicros;
+  if ((request.data.size() < SIM_NTP_PACKET_SIZE) || ((request.data[0] & 7) != 3) || !sntpReachable) return;
+  reply.at = simMicros() + SIM_NTP_ROUND_TRIP_MICROS;
+  reply.from = request.to;
+  reply.fromPort = SIM_NTP_PORT;
+  reply.to = request.from;
+  reply.toPort = request.fromPort;
+  reply.data.assign(SIM_NTP_PACKET_SIZE, 0);
+  reply.data[0] = (leapIndicator << 6) | (4 << 3) | 4;
+  reply.data[1] = 1;                                  // Stratum 1
+  reply.data[2] = request.data[2];
+  reply.data[3] = 0xEC;                               // About a microsecond
+  memcpy(&reply.data[12], "GPS", 3);
+  putTimestamp(&reply.data[16], now - 16000000LL);
+  memcpy(&reply.data[24], &request.data[40], 8);      // Their transmit time is our originate time
+  putTimestamp(&reply.data[32], now + SIM_NTP_ROUND_TRIP_MICROS / 2);
+  putTimestamp(&reply.data[40], now + SIM_NTP_ROUND_TRIP_MICROS / 2);
+  inFlight.push_back(reply);
+}
+
+void simTestNTPServer(IPAddress address) {
+  testNTPServers.push_back(address);
+}
+
+/**
+ * Is a packet for the simulated NTP server, rather than the test?
+ */
+static bool toNTPServer(IPAddress to, uint16_t toPort) {
+  if ((toPort != SIM_NTP_PORT) || (to == SIM_LOCAL_IP) || (to[0] >= 224) || (to[3] == 255)) return false;
+  for (const IPAddress &address : testNTPServers) {
+    if (address == to) return false;
+  }
+  return true;
+}
+
+void simSetSNTPReachable(bool reachable) {
+  sntpReachable = reachable;
+}
+
+void simSetSNTPErrorMicros(int32_t us) {
+  sntpErrorMicros = us;
+}
+
+void simSetSNTPIntervalMillis(uint32_t ms) {
+  sntpIntervalMicros = ms * 1000ULL;
+  if (sntpRunning && (sntpNextAt != SIM_NEVER)) sntpNextAt = std::min(sntpNextAt, simMicros() + sntpIntervalMicros);
+}
+
+uint32_t simSNTPSyncCount() {
+  return sntpSyncs;
+}
+
+void simSetLeapIndicator(uint8_t li) {
+  leapIndicator = li & 3;
+}
+
+// ---- The SNTP client ----
+
+void sntp_init(void) {
+  if (sntpRunning) return;
+  sntpRunning = true;
+  sntpNextAt = simMicros() + SIM_SNTP_STARTUP_MICROS;
+}
+
+void sntp_stop(void) {
+  sntpRunning = false;
+  sntpNextAt = SIM_NEVER;
+}
+
+uint8_t sntp_enabled(void) {
+  return sntpRunning;
+}
+
+void sntp_setservername(uint8_t idx, const char *server) {
+  if (idx < SNTP_MAX_SERVERS) sntpNames[idx] = server;
+}
+
+const char *sntp_getservername(uint8_t idx) {
+  return (idx < SNTP_MAX_SERVERS) ? sntpNames[idx] : nullptr;
+}
+
+void sntp_setserver(uint8_t idx, const ip_addr_t *addr) {
+  if (idx >= SNTP_MAX_SERVERS) return;
+  sntpNames[idx] = nullptr;
+  sntpAddresses[idx].addr = addr ? addr->addr : 0;
+}
+
+const ip_addr_t *sntp_getserver(uint8_t idx) {
+  return (idx < SNTP_MAX_SERVERS) ? &sntpAddresses[idx] : nullptr;
+}
+
+/**
+ * The SNTP client's poll - it asks the first server it has, looking the name up if it was given one,
+ * and sets the clock from the answer. If there is no answer it tries again later
+ */
+static void pollSNTP() {
+  int server = -1;
+  if (!sntpRunning || (sntpNextAt > simMicros())) return;
+  for (int i = 0 ; (i < SNTP_MAX_SERVERS) && (server < 0) ; i++) {
+    if ((sntpNames[i] && *sntpNames[i]) || sntpAddresses[i].addr) server = i;
+  }
+  sntpNextAt = simMicros() + SIM_SNTP_RETRY_MICROS;
+  if ((server < 0) || !stationConnected || !sntpReachable) return;
+  if (sntpNames[server]) {
+    if (hostsMissing[sntpNames[server]]) return;
+    sntpAddresses[server].addr = hostAddress(sntpNames[server]).v4();
+  }
+  sntpSyncs++;
+  sntpNextAt = simMicros() + sntpIntervalMicros;
+  simSetSystemMicros(simTrueMicros() + sntpErrorMicros);
+}
+
+void configTime(const char *tz, const char *server1, const char *server2, const char *server3) {
+  sntp_stop();
+  sntp_setservername(0, server1);
+  sntp_setservername(1, server2);
+  sntp_setservername(2, server3);
+  setenv("TZ", tz, 1);
+  tzset();
+  sntp_init();
+}
+
+// ---- UDP ----
+
+WiFiUDP::~WiFiUDP() {
+  stop();
+}
+
+/**
+ * Is a port already taken by another socket?
+ */
+static bool portTaken(uint16_t port) {
+  for (auto &socket : sockets()) if (socket.first->localPort() == port) return true;
+  return false;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  if (!port) {
+    do {
+      port = nextEphemeralPort++;
+      if (!nextEphemeralPort) nextEphemeralPort = SIM_EPHEMERAL_PORT;
+    } while (portTaken(port));
+  } else if (portTaken(port)) {
+    return 0;
+  }
+  this->port = port;
+  sockets()[this];
+  return 1;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port) {
+  if (!begin(port)) return 0;
+  multicastGroup = multicast;
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  sockets().erase(this);
+  port = 0;
+  multicastGroup = IPAddress();
+  received.clear();
+  readPosition = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  sendTo = ip;
+  sendToPort = port;
+  sending.clear();
+  building = true;
+  return 1;
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+  IPAddress address;
+  if (!address.fromString(host)) address = hostAddress(host);
+  return beginPacket(address, port);
+}
+
+int WiFiUDP::endPacket() {
+  SimPacket packet;
+  building = false;
+  // Without a link there is no route
+  if (!stationConnected) return 0;
+  packet.at = simMicros();
+  packet.from = SIM_LOCAL_IP;
+  packet.fromPort = port;
+  packet.to = sendTo;
+  packet.toPort = sendToPort;
+  packet.data = sending;
+  if (toNTPServer(sendTo, sendToPort)) {
+    answerNTP(packet);
+  } else {
+    sent.push_back(packet);
+  }
+  return 1;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+  if (!building) return 0;
+  sending.push_back(c);
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  if (!building) return 0;
+  sending.insert(sending.end(), buffer, buffer + size);
+  return size;
+}
+
+int WiFiUDP::parsePacket() {
+  auto socket = sockets().find(this);
+  received.clear();
+  readPosition = 0;
+  if ((socket == sockets().end()) || socket->second.empty()) return 0;
+  SimPacket &packet = socket->second.front();
+  received = packet.data;
+  receivedFrom = packet.from;
+  receivedFromPort = packet.fromPort;
+  socket->second.pop_front();
+  return received.size();
+}
+
+int WiFiUDP::available() {
+  return received.size() - readPosition;
+}
+
+int WiFiUDP::read() {
+  return (readPosition < received.size()) ? received[readPosition++] : -1;
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t len) {
+  size_t n = std::min(len, received.size() - readPosition);
+  memcpy(buffer, received.data() + readPosition, n);
+  readPosition += n;
+  return n;
+}
+
+void WiFiUDP::flush() {
+  readPosition = received.size();
+}
+
+IPAddress WiFiUDP::remoteIP() {
+  return receivedFrom;
+}
+
+uint16_t WiFiUDP::remotePort() {
+  return receivedFromPort;
+}
+
+void simSendUDP(IPAddress from, uint16_t fromPort, uint16_t toPort, const uint8_t *data, size_t len, uint32_t delayMillis) {
+  SimPacket packet;
+  packet.at = simMicros() + delayMillis * 1000ULL;
+  packet.from = from;
+  packet.fromPort = fromPort;
+  packet.to = SIM_LOCAL_IP;
+  packet.toPort = toPort;
+  packet.data.assign(data, data + len);
+  inFlight.push_back(packet);
+}
+
+std::vector<SimPacket> simTakeUDP() {
+  std::vector<SimPacket> ans;
+  ans.swap(sent);
+  return ans;
+}
+
+/**
+ * Hand the packets that have arrived to the sockets listening for them. Without a link, or a
+ * socket, they are lost
+ */
+static void pollUDP() {
+  for (size_t i = 0 ; i < inFlight.size() ; ) {
+    SimPacket &packet = inFlight[i];
+    if (packet.at > simMicros()) {
+      i++;
+      continue;
+    }
+    if (stationConnected) {
+      for (auto &socket : sockets()) {
+        if (socket.first->localPort() == packet.toPort) {
+          socket.second.push_back(packet);
+          break;
+        }
+      }
+    }
+    inFlight.erase(inFlight.begin() + i);
+  }
+}
+
+// ---- The MQTT broker ----
+
+AsyncMqttClient::AsyncMqttClient() {
+  mqttClients().push_back(this);
+}
+
+AsyncMqttClient::~AsyncMqttClient() {
+  mqttClients().erase(std::remove(mqttClients().begin(), mqttClients().end(), this), mqttClients().end());
+}
+
+AsyncMqttClient &AsyncMqttClient::setServer(const char *host, uint16_t port) {
+  this->host = host;
+  this->port = port;
+  return *this;
+}
+
+AsyncMqttClient &AsyncMqttClient::setClientId(const char *clientId) {
+  this->clientId = clientId;
+  return *this;
+}
+
+AsyncMqttClient &AsyncMqttClient::setWill(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) {
+  willTopic = topic;
+  return *this;
+}
+
+void AsyncMqttClient::connect() {
+  if (isConnected || connecting) return;
+  mqttConnects.push_back(simMicros());
+  connecting = true;
+  connectAt = simMicros() + SIM_MQTT_CONNECT_MICROS;
+}
+
+void AsyncMqttClient::disconnect(bool force) {
+  if (!isConnected && !connecting) return;
+  isConnected = false;
+  connecting = false;
+  dropping = true;
+  unacked.clear();
+}
+
+uint16_t AsyncMqttClient::subscribe(const char *topic, uint8_t qos) {
+  uint16_t id = nextPacketId++;
+  if (!isConnected) return 0;
+  if (!nextPacketId) nextPacketId = 1;
+  return id;
+}
+
+uint16_t AsyncMqttClient::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length,
+    bool dup, uint16_t messageId) {
+  uint16_t id = 1;
+  if (!isConnected) return 0;
+  if (!length && payload) length = strlen(payload);
+  if (qos) {
+    id = messageId ? messageId : nextPacketId++;
+    if (!nextPacketId) nextPacketId = 1;
+    unacked.push_back(id);
+  }
+  mqttPublished.push_back({ topic, std::string(payload ? payload : "", length), qos, retain, dup, qos ? id : (uint16_t)0 });
+  return id;
+}
+
+/**
+ * The broker's side of the connection - it takes connections, acknowledges QoS 1 messages, and
+ * drops the connection when the link or the broker goes
+ */
+void AsyncMqttClient::simPoll() {
+  if (dropping) {
+    dropping = false;
+    if (disconnectCB) disconnectCB(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+  }
+  if (connecting && (connectAt <= simMicros())) {
+    connecting = false;
+    if (stationConnected && brokerUp && host.length()) {
+      isConnected = true;
+      if (connectCB) connectCB(false);
+    } else if (disconnectCB) {
+      disconnectCB(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+    }
+  }
+  if (isConnected && (!stationConnected || !brokerUp)) {
+    isConnected = false;
+    unacked.clear();
+    if (disconnectCB) disconnectCB(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+  }
+  if (isConnected && brokerAcks && !unacked.empty()) {
+    std::vector<uint16_t> acked;
+    acked.swap(unacked);
+    for (uint16_t id : acked) if (publishCB) publishCB(id);
+  }
+}
+
+void AsyncMqttClient::simDeliver(const char *topic, const char *payload, bool retain) {
+  AsyncMqttClientMessageProperties properties = { 1, false, retain };
+  size_t len = strlen(payload);
+  std::vector<char> topicCopy(topic, topic + strlen(topic) + 1);
+  std::vector<char> payloadCopy(payload, payload + len + 1);
+  if (isConnected && messageCB) messageCB(topicCopy.data(), payloadCopy.data(), properties, len, 0, len);
+}
+
+void simSetMqttBroker(bool up) {
+  brokerUp = up;
+}
+
+void simSetMqttAcks(bool ack) {
+  brokerAcks = ack;
+}
+
+std::vector<SimMqttMessage> simTakeMqtt() {
+  std::vector<SimMqttMessage> ans;
+  ans.swap(mqttPublished);
+  return ans;
+}
+
+std::vector<uint64_t> simTakeMqttConnects() {
+  std::vector<uint64_t> ans;
+  ans.swap(mqttConnects);
+  return ans;
+}
+
+void simMqttCommand(const char *topic, const char *payload, bool retain) {
+  for (AsyncMqttClient *client : mqttClients()) client->simDeliver(topic, payload, retain);
+}
+
+/**
+ * When the MQTT broker next has something to do for a client
+ */
+static uint64_t mqttNextEvent() {
+  uint64_t ans = SIM_NEVER;
+  for (AsyncMqttClient *client : mqttClients()) {
+    if (client->connected()) ans = std::min(ans, simMicros() + 1000);
+  }
+  return ans;
+}
+
+// ---- Everything ----
+
+uint64_t simNetworkNextEvent() {
+  uint64_t ans = std::min(connectAt, sntpRunning ? sntpNextAt : SIM_NEVER);
+  for (const SimPacket &packet : inFlight) ans = std::min(ans, packet.at);
+  for (const Lookup &lookup : lookups) ans = std::min(ans, lookup.at);
+  return std::min(ans, mqttNextEvent());
+}
+
+void simNetworkPoll() {
+  pollStation();
+  pollDNS();
+  pollUDP();
+  pollSNTP();
+  for (AsyncMqttClient *client : mqttClients()) client->simPoll();
+}
@@ -0,0 +1,453 @@
+// sim_web.cpp - the web server and the browsers that use it
+//
+// simHttp() plays the part of ESPAsyncWebServer and a browser: it parses the request the way the
+// library does (query parameters, then the form fields of the body, with files going to the upload
+// handler a segment at a time), hands it to the handler, and pulls the response out of its filler,
+// running loop() whenever the filler asks to be tried again.
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "sim_internal.h"
+
+#define SIM_SEGMENT_SIZE 1460           // What one TCP segment carries
+#define SIM_CHUNK_FRAMING 12            // A chunk's length line and trailing CRLF, taken out of a segment
+#define SIM_SSE_MAX_QUEUED 32           // SSE_MAX_QUEUED_MESSAGES - more than this are dropped
+#define SIM_BROWSER_IP IPAddress(192, 168, 1, 100)
+
+// The firmware's servers and event sources are static objects, constructed before main() in no
+// particular order along with these lists - so the lists are made when first used
+static std::vector<AsyncWebServer *> &servers() {
+  static std::vector<AsyncWebServer *> ans;
+  return ans;
+}
+
+static std::vector<AsyncEventSource *> &eventSources() {
+  static std::vector<AsyncEventSource *> ans;
+  return ans;
+}
+
+// ---- Responses ----
+
+/**
+ * A response with its body in memory - send(code, type, content), or beginResponse_P()
+ */
+class SimBasicResponse : public AsyncWebServerResponse {
+public:
+  SimBasicResponse(int code, const String &contentType, const std::string &content)
+      : AsyncWebServerResponse(code, contentType, content.size()), content(content) {}
+  size_t fill(uint8_t *buffer, size_t maxLen, size_t index) override {
+    size_t n = (index < content.size()) ? std::min(maxLen, content.size() - index) : 0;
+    memcpy(buffer, content.data() + index, n);
+    return n;
+  }
+
+private:
+  std::string content;
+};
+
+/**
+ * A response whose body comes from a filler - with a length, or chunked if it isn't known
+ */
+class SimCallbackResponse : public AsyncWebServerResponse {
+public:
+  SimCallbackResponse(const String &contentType, size_t length, AwsResponseFiller filler)
+      : AsyncWebServerResponse(200, contentType, length), filler(filler) {}
+  size_t fill(uint8_t *buffer, size_t maxLen, size_t index) override {
+    return filler(buffer, maxLen, index);
+  }
+
+private:
+  AwsResponseFiller filler;
+};
+
+// ---- Requests ----
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String &url, IPAddress remote)
+    : connection(remote, 50000), requestMethod(method), requestUrl(url) {
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  for (AsyncWebParameter *param : parameters) delete param;
+  delete response;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(size_t num) const {
+  return (num < parameters.size()) ? parameters[num] : nullptr;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  for (AsyncWebParameter *param : parameters) {
+    if ((param->name() == name) && (param->isPost() == post) && (param->isFile() == file)) return param;
+  }
+  return nullptr;
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+  return getParam(name, post, file) != nullptr;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String &name) const {
+  for (auto &h : headers) if (h.first.equalsIgnoreCase(name)) return true;
+  return false;
+}
+
+const String &AsyncWebServerRequest::header(const char *name) const {
+  static const String none;
+  for (auto &h : headers) if (h.first.equalsIgnoreCase(name)) return h.second;
+  return none;
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  // The library sends the first response it is given, and deletes any other
+  if (this->response) {
+    delete response;
+    return;
+  }
+  this->response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+  send(beginResponse(code, contentType, content));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+  return new SimBasicResponse(code, contentType, std::string(content.c_str(), content.length()));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const String &contentType, size_t len,
+    AwsResponseFiller callback, AwsTemplateProcessor templateCallback) {
+  return new SimCallbackResponse(contentType, len, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType,
+    const uint8_t *content, size_t len, AwsTemplateProcessor callback) {
+  return new SimBasicResponse(code, contentType, std::string((const char *)content, len));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &contentType,
+    AwsResponseFiller callback, AwsTemplateProcessor templateCallback) {
+  return new SimCallbackResponse(contentType, SIZE_MAX, callback);
+}
+
+void AsyncWebServerRequest::simAddParam(const String &name, const String &value, bool post, bool file, size_t size) {
+  parameters.push_back(new AsyncWebParameter(name, value, post, file, size));
+}
+
+void AsyncWebServerRequest::simDisconnected() {
+  std::vector<ArDisconnectHandler> handlers;
+  handlers.swap(disconnectHandlers);
+  for (ArDisconnectHandler &handler : handlers) handler();
+}
+
+// ---- Handlers and the server ----
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (!(methods & request->method())) return false;
+  return (request->url() == uri) || request->url().startsWith(uri + "/");
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  if (onRequest) {
+    onRequest(request);
+  } else {
+    request->send(500);
+  }
+}
+
+void AsyncCallbackWebHandler::handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index,
+    uint8_t *data, size_t len, bool final) {
+  if (onUpload) onUpload(request, filename, index, data, len, final);
+}
+
+AsyncWebServer::AsyncWebServer(uint16_t port) {
+  servers().push_back(this);
+}
+
+AsyncWebServer::~AsyncWebServer() {
+  servers().erase(std::remove(servers().begin(), servers().end(), this), servers().end());
+  for (AsyncCallbackWebHandler *handler : owned) delete handler;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+    ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload) {
+  AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler(uri, method, onRequest, onUpload);
+  owned.push_back(handler);
+  handlers.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler) {
+  handlers.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler *AsyncWebServer::simFindHandler(AsyncWebServerRequest *request) {
+  for (AsyncWebHandler *handler : handlers) if (handler->canHandle(request)) return handler;
+  return nullptr;
+}
+
+// ---- Server-Sent Events ----
+
+void AsyncEventSourceClient::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+  String record;
+  if (!open) return;
+  if (queue.size() >= SIM_SSE_MAX_QUEUED) return;
+  if (event) record = String("event: ") + event + "\n";
+  record += String("data: ") + message + "\n\n";
+  queue.push_back(record);
+}
+
+/**
+ * The browser takes an event, if it is ready for one
+ */
+void AsyncEventSourceClient::simDrain() {
+  if (simMicros() < simNextTake()) return;
+  lastTaken = simMicros();
+  received.push_back(queue.front());
+  queue.erase(queue.begin());
+}
+
+AsyncEventSource::AsyncEventSource(const String &url) : sourceUrl(url) {
+  eventSources().push_back(this);
+}
+
+AsyncEventSource::~AsyncEventSource() {
+  eventSources().erase(std::remove(eventSources().begin(), eventSources().end(), this), eventSources().end());
+  for (AsyncEventSourceClient *client : clients) delete client;
+}
+
+void AsyncEventSource::close() {
+  for (AsyncEventSourceClient *client : clients) client->close();
+}
+
+void AsyncEventSource::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+  for (AsyncEventSourceClient *client : clients) client->send(message, event, id, reconnect);
+}
+
+size_t AsyncEventSource::count() const {
+  size_t ans = 0;
+  for (AsyncEventSourceClient *client : clients) if (client->connected()) ans++;
+  return ans;
+}
+
+size_t AsyncEventSource::avgPacketsWaiting() const {
+  size_t waiting = 0;
+  size_t n = 0;
+  for (AsyncEventSourceClient *client : clients) {
+    if (!client->connected()) continue;
+    waiting += client->packetsWaiting();
+    n++;
+  }
+  return n ? (waiting + n / 2) / n : 0;
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) {
+  return (request->method() == HTTP_GET) && (request->url() == sourceUrl);
+}
+
+void AsyncEventSource::handleRequest(AsyncWebServerRequest *request) {
+  // A one-off request gets the stream's headers and nothing more - browsers use simConnectEvents()
+  AsyncWebServerResponse *response = request->beginResponse(200, "text/event-stream", String());
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+AsyncEventSourceClient *AsyncEventSource::simConnect(uint32_t millisPerEvent) {
+  // Closed clients are kept, so that the tests can look at what they got
+  AsyncEventSourceClient *client = new AsyncEventSourceClient(this, millisPerEvent);
+  clients.push_back(client);
+  if (connectCB) connectCB(client);
+  return client;
+}
+
+void AsyncEventSource::simPoll() {
+  for (AsyncEventSourceClient *client : clients) if (client->connected()) client->simDrain();
+}
+
+AsyncEventSourceClient *simConnectEvents(const char *url, uint32_t millisPerEvent) {
+  for (AsyncEventSource *source : eventSources()) {
+    if (!strcmp(source->url(), url)) return source->simConnect(millisPerEvent);
+  }
+  return nullptr;
+}
+
+uint64_t AsyncEventSource::simNextEvent() const {
+  uint64_t ans = SIM_NEVER;
+  for (AsyncEventSourceClient *client : clients) if (client->connected()) ans = std::min(ans, client->simNextTake());
+  return ans;
+}
+
+uint64_t simWebNextEvent() {
+  uint64_t ans = SIM_NEVER;
+  for (AsyncEventSource *source : eventSources()) ans = std::min(ans, source->simNextEvent());
+  return ans;
+}
+
+void simWebPoll() {
+  for (AsyncEventSource *source : eventSources()) source->simPoll();
+}
+
+// ---- Browsers ----
+
+std::string SimHttpResult::header(const char *name) const {
+  for (auto &h : headers) if (!strcasecmp(h.first.c_str(), name)) return h.second;
+  return std::string();
+}
+
+static std::string urlDecode(const std::string &s) {
+  std::string ans;
+  for (size_t i = 0 ; i < s.size() ; i++) {
+    if (s[i] == '+') {
+      ans += ' ';
+    } else if ((s[i] == '%') && (i + 2 < s.size()) && isxdigit(s[i + 1]) && isxdigit(s[i + 2])) {
+      ans += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      ans += s[i];
+    }
+  }
+  return ans;
+}
+
+/**
+ * Add the name=value pairs of a query string or urlencoded form
+ */
+static void addParams(AsyncWebServerRequest *request, const std::string &pairs, bool post) {
+  size_t start = 0;
+  while (start < pairs.size()) {
+    size_t end = pairs.find('&', start);
+    std::string pair = pairs.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+    size_t eq = pair.find('=');
+    if (!pair.empty()) {
+      request->simAddParam(urlDecode(pair.substr(0, eq)).c_str(),
+          (eq == std::string::npos) ? "" : urlDecode(pair.substr(eq + 1)).c_str(), post);
+    }
+    if (end == std::string::npos) break;
+    start = end + 1;
+  }
+}
+
+/**
+ * A multipart form - fields become parameters, and files go to the upload handler a segment at a time
+ */
+static void addMultipart(AsyncWebServerRequest *request, AsyncWebHandler *handler, const std::string &body,
+    const std::string &boundary) {
+  std::string delimiter = "--" + boundary;
+  size_t at = body.find(delimiter);
+  while (at != std::string::npos) {
+    size_t headersStart = at + delimiter.size();
+    size_t headersEnd;
+    size_t next;
+    std::string partHeaders;
+    std::string content;
+    std::string name;
+    std::string filename;
+    size_t field;
+    if (body.compare(headersStart, 2, "--") == 0) break;
+    headersEnd = body.find("\r\n\r\n", headersStart);
+    if (headersEnd == std::string::npos) break;
+    next = body.find("\r\n" + delimiter, headersEnd + 4);
+    if (next == std::string::npos) break;
+    partHeaders = body.substr(headersStart, headersEnd - headersStart);
+    content = body.substr(headersEnd + 4, next - headersEnd - 4);
+    if ((field = partHeaders.find("name=\"")) != std::string::npos) {
+      name = partHeaders.substr(field + 6, partHeaders.find('"', field + 6) - field - 6);
+    }
+    if ((field = partHeaders.find("filename=\"")) != std::string::npos) {
+      filename = partHeaders.substr(field + 10, partHeaders.find('"', field + 10) - field - 10);
+      for (size_t index = 0 ; ; index += SIM_SEGMENT_SIZE) {
+        size_t len = std::min((size_t)SIM_SEGMENT_SIZE, content.size() - index);
+        bool final = index + len >= content.size();
+        handler->handleUpload(request, filename.c_str(), index, (uint8_t *)&content[index], len, final);
+        if (final) break;
+      }
+      request->simAddParam(name.c_str(), filename.c_str(), true, true, content.size());
+    } else {
+      request->simAddParam(name.c_str(), content.c_str(), true);
+    }
+    at = next + 2;
+  }
+}
+
+/**
+ * Take the response's body, as the library would send it - running loop() while the filler says to
+ * try again
+ */
+static bool readBody(AsyncWebServerResponse *response, std::string &body, uint64_t deadline) {
+  uint8_t buffer[SIM_SEGMENT_SIZE];
+  bool chunked = response->length == SIZE_MAX;
+  size_t maxLen = chunked ? SIM_SEGMENT_SIZE - SIM_CHUNK_FRAMING : SIM_SEGMENT_SIZE;
+  while (chunked || (body.size() < response->length)) {
+    size_t n = response->fill(buffer, chunked ? maxLen : std::min(maxLen, response->length - body.size()), body.size());
+    if (n == RESPONSE_TRY_AGAIN) {
+      if (simMicros() >= deadline) return false;
+      simRun(1);
+      continue;
+    }
+    if (!n) return chunked;
+    body.append((const char *)buffer, n);
+  }
+  return true;
+}
+
+SimHttpResult simHttp(const char *method, const char *url, const std::string &body,
+    const std::vector<std::pair<std::string, std::string>> &headers, const char *contentType, uint64_t maxMs) {
+  static const struct { const char *name; WebRequestMethodComposite method; } methods[] = {
+    { "GET", HTTP_GET }, { "POST", HTTP_POST }, { "DELETE", HTTP_DELETE }, { "PUT", HTTP_PUT },
+    { "PATCH", HTTP_PATCH }, { "HEAD", HTTP_HEAD }, { "OPTIONS", HTTP_OPTIONS }
+  };
+  SimHttpResult ans;
+  WebRequestMethodComposite requestMethod = HTTP_GET;
+  std::string path = url;
+  std::string query;
+  size_t q = path.find('?');
+  IPAddress remote = SIM_BROWSER_IP;
+  AsyncWebServerRequest *request;
+  AsyncWebHandler *handler = nullptr;
+  AsyncWebServerResponse *response;
+  uint64_t deadline = simMicros() + maxMs * 1000;
+  for (auto &m : methods) if (!strcmp(m.name, method)) requestMethod = m.method;
+  if (q != std::string::npos) {
+    query = path.substr(q + 1);
+    path.erase(q);
+  }
+  // The browser's address can be given as a Remote-Addr header, which isn't passed on
+  for (auto &h : headers) if (!strcasecmp(h.first.c_str(), "Remote-Addr")) remote.fromString(h.second.c_str());
+
+  request = new AsyncWebServerRequest(requestMethod, path.c_str(), remote);
+  for (auto &h : headers) {
+    if (strcasecmp(h.first.c_str(), "Remote-Addr")) request->simAddHeader(h.first.c_str(), h.second.c_str());
+  }
+  if (!body.empty()) request->simAddHeader("Content-Type", contentType);
+  request->simSetContentLength(body.size());
+  addParams(request, query, false);
+  for (AsyncWebServer *server : servers()) {
+    if (server->simStarted() && ((handler = server->simFindHandler(request)) != nullptr)) break;
+  }
+  if (!handler) {
+    request->send(404);
+  } else {
+    if (!strncmp(contentType, "multipart/form-data", 19) && !body.empty()) {
+      const char *boundary = strstr(contentType, "boundary=");
+      addMultipart(request, handler, body, boundary ? boundary + 9 : "");
+    } else if (!strcmp(contentType, "application/x-www-form-urlencoded")) {
+      addParams(request, body, true);
+    }
+    handler->handleRequest(request);
+  }
+  // A handler that hasn't answered yet might on a later pass
+  simRunUntil([request]() { return request->simResponse() != nullptr; }, maxMs);
+  response = request->simResponse();
+  if (response) {
+    ans.status = response->code;
+    if (response->contentType.length()) ans.headers.push_back({ "Content-Type", response->contentType.c_str() });
+    if (response->length != SIZE_MAX) ans.headers.push_back({ "Content-Length", std::to_string(response->length) });
+    for (auto &h : response->headers) ans.headers.push_back({ h.first.c_str(), h.second.c_str() });
+    if (!readBody(response, ans.body, deadline)) ans.status = 0;
+  }
+  request->simDisconnected();
+  delete request;
+  return ans;
+}
@@ -0,0 +1,19 @@
+// sntp.h - lwIP's SNTP client, answered by the simulated NTP server, for the native build
+
+#ifndef _SIM_SNTP_H_
+#define _SIM_SNTP_H_
+
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+
+#define SNTP_MAX_SERVERS 3
+
+void sntp_init(void);
+void sntp_stop(void);
+uint8_t sntp_enabled(void);
+void sntp_setservername(uint8_t idx, const char *server);
+const char *sntp_getservername(uint8_t idx);
+void sntp_setserver(uint8_t idx, const ip_addr_t *addr);
+const ip_addr_t *sntp_getserver(uint8_t idx);
+
+#endif
@@ -0,0 +1,28 @@
+// user_interface.h - the SDK's reset information, for the native build
+
+#ifndef _SIM_USER_INTERFACE_H_
+#define _SIM_USER_INTERFACE_H_
+
+#include <stdint.h>
+
+enum rst_reason {
+  REASON_DEFAULT_RST = 0,      // Power on
+  REASON_WDT_RST = 1,
+  REASON_EXCEPTION_RST = 2,
+  REASON_SOFT_WDT_RST = 3,
+  REASON_SOFT_RESTART = 4,
+  REASON_DEEP_SLEEP_AWAKE = 5,
+  REASON_EXT_SYS_RST = 6
+};
+
+struct rst_info {
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t epc2;
+  uint32_t epc3;
+  uint32_t excvaddr;
+  uint32_t depc;
+};
+
+#endif
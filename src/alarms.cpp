@@ -0,0 +1,231 @@
+// alarms.cpp - go off at set local times, on chosen days of the week or just once
+//
+// When each alarm next goes off is worked out once, as a UTC time, and the alarms are kept in a
+// min-heap ordered by it, so each loop only has to look at the one at the top. The times are only
+// worked out again when an alarm goes off, when the configuration changes, or when daylight saving
+// starts or ends (which moves the UTC time of a local one). The day the clocks go back has its
+// last hour of summer time twice over, so each alarm remembers the local day it last went off on,
+// and doesn't go off again that day.
+//
+// An alarm flashes the display and the red LED until SET is pressed, or for ALARM_RING_MILLIS.
+
+#include <Arduino.h>
+#include <time.h>
+#include "alarms.h"
+#include "config.h"
+#include "display.h"
+#include "led.h"
+#include "timekeeping.h"
+#include "syslog.h"
+#include "mqtt.h"
+#include "debug.h"
+
+#define ALARM_RING_MILLIS (5UL * 60UL * 1000UL)
+#define ALARM_FLASH_MILLIS 250UL
+
+typedef struct AlarmTime_t {
+    time_t at;
+    uint8_t index;          // Into alarms[]
+} AlarmTime;
+
+static Alarm alarms[ALARM_COUNT];
+static uint32_t rangOn[ALARM_COUNT];    // localDay() each alarm last went off, 0 if it hasn't since it was set
+static AlarmTime heap[ALARM_COUNT];
+static uint8_t heapSize = 0;
+static bool loaded = false;
+static uint32_t loadedGeneration = 0;
+static int8_t loadedIsDST = -1;
+static time_t lastMinute = 0;
+// Ringing state
+static bool ringing = false;
+static bool flashOn = true;
+static bool ledWasOn = false;
+static unsigned long ringingSince = 0;
+static unsigned long lastFlash = 0;
+
+/**
+ * A number for a local date, one more each day
+ */
+static uint32_t localDay(const struct tm &date) {
+    return date.tm_year * 366 + date.tm_yday + 1;
+}
+
+/**
+ * The first time after `after` that alarm index should go off, or 0 for never
+ *
+ * mktime() is left to work out whether daylight saving applies on each day. A time that doesn't
+ * exist, because the clocks go forward over it, comes out an hour later
+ */
+static time_t nextAlarmTime(uint8_t index, time_t after) {
+    const Alarm &alarm = alarms[index];
+    struct tm today = *localtime(&after);
+    for (int i = 0 ; i <= 7 ; i++) {
+        struct tm day = today;
+        time_t at;
+        day.tm_mday += i;
+        day.tm_hour = alarm.minuteOfDay / 60;
+        day.tm_min = alarm.minuteOfDay % 60;
+        day.tm_sec = 0;
+        day.tm_isdst = -1;
+        at = mktime(&day); // Also sets tm_wday and tm_yday for the day
+        if ((at <= after) || (localDay(day) == rangOn[index])) continue;
+        if (!alarm.days || (alarm.days & (1 << day.tm_wday))) return at;
+    }
+    return 0;
+}
+
+/**
+ * Move the heap entry at i down until neither of its children is earlier
+ */
+static void siftDown(uint8_t i) {
+    for (;;) {
+        uint8_t earliest = i;
+        uint8_t child = 2 * i + 1;
+        if ((child < heapSize) && (heap[child].at < heap[earliest].at)) earliest = child;
+        if ((child + 1 < heapSize) && (heap[child + 1].at < heap[earliest].at)) earliest = child + 1;
+        if (earliest == i) return;
+        AlarmTime t = heap[i];
+        heap[i] = heap[earliest];
+        heap[earliest] = t;
+        i = earliest;
+    }
+}
+
+/**
+ * Add an alarm time to the heap
+ */
+static void push(time_t at, uint8_t index) {
+    uint8_t i = heapSize++;
+    heap[i] = { at, index };
+    while (i && (heap[(i - 1) / 2].at > heap[i].at)) {
+        AlarmTime t = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = t;
+        i = (i - 1) / 2;
+    }
+}
+
+/**
+ * Remove the earliest alarm time from the heap
+ */
+static void pop() {
+    heap[0] = heap[--heapSize];
+    siftDown(0);
+}
+
+/**
+ * (Re)load the alarms, and work out when each goes off next
+ */
+static void loadAlarms(time_t now) {
+    Alarm was[ALARM_COUNT];
+    memcpy(was, alarms, sizeof(was));
+    getAlarms(alarms);
+    heapSize = 0;
+    for (uint8_t i = 0 ; i < ALARM_COUNT ; i++) {
+        time_t at;
+        // An alarm that has been changed can go off again today
+        if (memcmp(&was[i], &alarms[i], sizeof(Alarm))) rangOn[i] = 0;
+        if (!alarms[i].enabled) continue;
+        at = nextAlarmTime(i, now);
+        if (at) push(at, i);
+    }
+    loaded = true;
+    loadedGeneration = getConfigGeneration();
+    loadedIsDST = localtime(&now)->tm_isdst;
+    DEBUG("%u alarms set, next at %ld\n", heapSize, heapSize ? (long)heap[0].at : 0L)
+}
+
+/**
+ * Stop flashing, and put the display and LED back as they were
+ */
+static void stopRinging() {
+    ringing = false;
+    setDisplayOn(true);
+    if (ledWasOn) setRedLEDOn(); else setRedLEDOff();
+}
+
+/**
+ * Start flashing the display and LED - also used when a countdown finishes
+ */
+void startRinging() {
+    if (!ringing) {
+        ringing = true;
+        ledWasOn = redLEDIsOn();
+        lastFlash = millis() - ALARM_FLASH_MILLIS;
+        flashOn = true;
+    }
+    ringingSince = millis();
+}
+
+/**
+ * Go off
+ */
+static void ring() {
+    uint8_t index = heap[0].index;
+    time_t at = heap[0].at;
+    DEBUG("Alarm %u going off\n", index)
+    rangOn[index] = localDay(*localtime(&at));
+    logMessage(SYSLOG_INFO, "alarm", "Alarm %u going off", index);
+    mqttEvent("alarm", String(index).c_str());
+    startRinging();
+    if (alarms[index].days) {
+        // Work out the next time after this one - or after now, if we have missed some while the time was stepped
+        heap[0].at = nextAlarmTime(index, max(at, time(0)));
+        if (heap[0].at) siftDown(0); else pop();
+    } else {
+        pop();
+        alarms[index].enabled = 0;
+        setAlarms(alarms);
+        loadedGeneration = getConfigGeneration(); // The heap is already up to date
+    }
+}
+
+/**
+ * Alarm polling loop
+ */
+void alarmPoll() {
+    time_t now;
+    if (ringing) {
+        if ((millis() - ringingSince) >= ALARM_RING_MILLIS) {
+            stopRinging();
+        } else if ((millis() - lastFlash) >= ALARM_FLASH_MILLIS) {
+            lastFlash = millis();
+            flashOn = !flashOn;
+            setDisplayOn(flashOn);
+            if (flashOn) setRedLEDOn(); else setRedLEDOff();
+        }
+    }
+    if (!timeIsSynced()) return;
+    now = time(0);
+    if (!loaded || (loadedGeneration != getConfigGeneration())) loadAlarms(now);
+    if ((now / 60) != lastMinute) {
+        // Local alarm times move when daylight saving starts or ends
+        lastMinute = now / 60;
+        if (localtime(&now)->tm_isdst != loadedIsDST) loadAlarms(now);
+    }
+    if (heapSize && (now >= heap[0].at)) ring();
+}
+
+/**
+ * Acknowledge a ringing alarm - returns false if there wasn't one
+ */
+bool acknowledgeAlarm() {
+    if (!ringing) return false;
+    DEBUG("Alarm acknowledged\n")
+    stopRinging();
+    return true;
+}
+
+/**
+ * Is an alarm going off?
+ */
+bool alarmIsRinging() {
+    return ringing;
+}
+
+/**
+ * When the next alarm goes off, as a UTC time, or 0 if none are set
+ */
+time_t getNextAlarmTime() {
+    return heapSize ? heap[0].at : 0;
+}
@@ -0,0 +1,13 @@
+#ifndef _ALARMS_H_
+#define _ALARMS_H_
+
+#include <Arduino.h>
+#include <time.h>
+
+void alarmPoll();
+bool acknowledgeAlarm();
+void startRinging();
+bool alarmIsRinging();
+time_t getNextAlarmTime();
+
+#endif
@@ -0,0 +1,154 @@
+// bench.cpp - time the things the clock spends its time doing, on the real hardware
+//
+// Flash chips, the state of the configuration store and the I2C pull-ups all vary from unit to
+// unit, so these give a way to compare them in the field. The benchmarks run from loop(), just
+// after the display has changed to a new second, so they finish well before the next one.
+
+#include <Arduino.h>
+#include <time.h>
+#include "bench.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "timer.h"
+#include "pages.h"
+#include "webserver.h"
+#include "syslog.h"
+#include "debug.h"
+
+#define BENCH_REPEATS 20
+#define BENCH_WRITE_REPEATS 4           // Each of these is a flash write
+// Run straight away if no second has started within this long - e.g. we don't have the time yet
+#define BENCH_WAIT_MILLIS 2000UL
+// How soon after a second has started the benchmarks may begin
+#define BENCH_TICK_WINDOW_MILLIS 50UL
+#define BENCH_PAGE_TICKS 60             // A minute of the display's ticks
+#define BENCH_PAGE_ROTATE_SECONDS 2     // Each page's turn, for the rotating pages benchmark
+#define BENCH_RESULTS_SIZE 448
+
+static bool pending = false;
+static unsigned long requestedAt = 0;
+static uint32_t runs = 0;
+static char results[BENCH_RESULTS_SIZE] = "{}";
+
+/**
+ * The average time, in microseconds, to do something
+ */
+template <typename F> static uint32_t averageMicros(uint16_t repeats, F f) {
+    uint32_t start = micros();
+    for (uint16_t i = 0 ; i < repeats ; i++) f(i);
+    return (micros() - start) / repeats;
+}
+
+/**
+ * The average time for one of the display's ticks, showing pages for the given seconds each, over a
+ * minute of them from now. The display transactions the minute took, blinking the colon included,
+ * are left in *transactions
+ */
+static uint32_t pageTickMicros(time_t now, const uint8_t *seconds, uint32_t *transactions) {
+    uint32_t before = getDisplayTransactionCount();
+    uint32_t average;
+    setPageSeconds(seconds);
+    average = averageMicros(BENCH_PAGE_TICKS, [now](uint16_t i) {
+        showPage(now + i);
+        setColon(false);
+    });
+    setPageSeconds(0);
+    *transactions = getDisplayTransactionCount() - before;
+    return average;
+}
+
+/**
+ * Run all the benchmarks, leaving the results as JSON
+ */
+static void runBenchmarks() {
+    char shown[5];
+    bool display = !displayIsScrolling() && !timerIsActive(); // Writing to the display would get in the way
+    int32_t frameMicros = -1;
+    int32_t digitMicros = -1;
+    int32_t setDigitMicros = -1;
+    int32_t pageMicros = -1;
+    int32_t rotateMicros = -1;
+    uint32_t pageWrites = 0;
+    uint32_t rotateWrites = 0;
+    uint32_t readStringMicros, readInt8Micros, writeInt8Micros, localtimeMicros, renderMicros, logMicros;
+    size_t renderBytes = 0;
+    time_t now = time(0);
+
+    if (display) {
+        getDisplayedText(shown);
+        // Every digit changes each time, so each frame is four bus transactions
+        frameMicros = averageMicros(BENCH_REPEATS, [](uint16_t i) {
+            if (i & 1) setLEDSegments('8', '8', '8', '8'); else setLEDSegments(' ', ' ', ' ', ' ');
+        });
+        // Only the last digit changes, so this is a single transaction
+        digitMicros = averageMicros(BENCH_REPEATS, [](uint16_t i) {
+            setLEDSegments(' ', ' ', ' ', (i & 1) ? '8' : ' ');
+        });
+        // The same change through setDigit(), which the colon and the timer use
+        setDigitMicros = averageMicros(BENCH_REPEATS, [](uint16_t i) { setDigit(3, (i & 1) ? ' ' : '8', false); });
+        // A minute of showing the time, then of every page in turn
+        if (timeIsSynced()) {
+            const uint8_t timeOnly[PAGE_COUNT] = { PAGE_DEFAULT_TIME_SECONDS };
+            uint8_t rotating[PAGE_COUNT];
+            memset(rotating, BENCH_PAGE_ROTATE_SECONDS, sizeof(rotating));
+            pageMicros = pageTickMicros(now, timeOnly, &pageWrites);
+            rotateMicros = pageTickMicros(now, rotating, &rotateWrites);
+        }
+        showText(shown);
+    }
+    readStringMicros = averageMicros(BENCH_REPEATS, [](uint16_t i) { getStringConfig(CFG_NTP_SERVER_1); });
+    readInt8Micros = averageMicros(BENCH_REPEATS, [](uint16_t i) { getInt8Config(CFG_DEFAULT_BRIGHTNESS, LED_DEFAULT_BRIGHTNESS); });
+    // Scratch writes, so nothing thinks the configuration has changed and works itself out again
+    writeInt8Micros = averageMicros(BENCH_WRITE_REPEATS, [](uint16_t i) { setScratchConfig(CFG_BENCHMARK, i); });
+    removeScratchConfig(CFG_BENCHMARK);
+    localtimeMicros = averageMicros(BENCH_REPEATS, [now](uint16_t i) {
+        time_t t = now + i;
+        localtime(&t);
+    });
+    renderMicros = averageMicros(1, [&renderBytes](uint16_t i) { renderBytes = renderHomePage(); });
+    // One message, which is sent to the syslog server if there is one - so it's not repeated
+    logMicros = averageMicros(1, [](uint16_t i) { logMessage(SYSLOG_INFO, "bench", "Benchmark run %u", runs + 1); });
+    snprintf_P(results, sizeof(results), PSTR("{\"run\":%u,\"frameUs\":%d,\"digitUs\":%d,\"setDigitUs\":%d,\"readStringUs\":%u,"
+        "\"readInt8Us\":%u,\"writeInt8Us\":%u,\"localtimeUs\":%u,\"renderUs\":%u,\"renderBytes\":%u,"
+        "\"logUs\":%u,\"pageUs\":%d,\"pageWrites\":%u,\"rotateUs\":%d,\"rotateWrites\":%u,"
+        "\"heap\":%u,\"maxBlock\":%u,\"fragmentation\":%u}"),
+        runs + 1, frameMicros, digitMicros, setDigitMicros, readStringMicros, readInt8Micros, writeInt8Micros,
+        localtimeMicros, renderMicros, renderBytes, logMicros, pageMicros, pageWrites, rotateMicros, rotateWrites,
+        ESP.getFreeHeap(), ESP.getMaxFreeBlockSize(), ESP.getHeapFragmentation());
+    DEBUG("Benchmarks: %s\n", results)
+}
+
+/**
+ * Ask for the benchmarks to be run
+ */
+void startBenchmark() {
+    if (pending) return;
+    pending = true;
+    requestedAt = millis();
+}
+
+/**
+ * Benchmark polling loop - runs the benchmarks once a second has just started
+ */
+void benchPoll() {
+    if (!pending) return;
+    if (timeIsSynced() && (millisSinceTick() > BENCH_TICK_WINDOW_MILLIS) && ((millis() - requestedAt) < BENCH_WAIT_MILLIS)) return;
+    runBenchmarks();
+    pending = false;
+    runs++;
+}
+
+/**
+ * How many times the benchmarks have been run since boot
+ */
+uint32_t getBenchmarkRuns() {
+    return runs;
+}
+
+/**
+ * The results of the last run, as JSON
+ */
+const char *getBenchmarkResults() {
+    return results;
+}
@@ -0,0 +1,11 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <Arduino.h>
+
+void startBenchmark();
+void benchPoll();
+uint32_t getBenchmarkRuns();
+const char *getBenchmarkResults();
+
+#endif
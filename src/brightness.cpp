@@ -0,0 +1,163 @@
+// brightness.cpp - dim the display at night, either at fixed times or between sunset and sunrise
+
+#include <Arduino.h>
+#include <math.h>
+#include <time.h>
+#include "brightness.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "stats.h"
+#include "debug.h"
+
+// How often to check whether it has become day or night
+#define BRIGHTNESS_CHECK_MILLIS 10000UL
+// How long each brightness level is held for when fading between day and night
+#define BRIGHTNESS_STEP_MILLIS 400UL
+
+static Dimming_Schedule schedule;
+static int8_t isNight = -1;               // -1 until we have worked out whether it is night
+static uint8_t targetLevel = 0;
+static bool fading = false;
+static unsigned long lastCheck = 0;
+static unsigned long lastStep = 0;
+// Sunset and sunrise, as minutes of the local day, calculated once a day
+static int sunDay = -1;
+static int sunsetMinute = 0;
+static int sunriseMinute = 0;
+
+/**
+ * Normalise a value into the range 0 .. range
+ */
+static float wrap(float value, float range) {
+    value = fmodf(value, range);
+    return (value < 0) ? value + range : value;
+}
+
+/**
+ * Calculate the time of sunrise or sunset, in minutes after UTC midnight
+ *
+ * Ref: Almanac for Computers, 1990, Nautical Almanac Office, US Naval Observatory
+ *
+ * Returns -1 if the sun doesn't rise or set that day
+ */
+static int sunEventMinuteUTC(int dayOfYear, float latitude, float longitude, bool rising) {
+    const float rad = M_PI / 180.0f;
+    float lngHour = longitude / 15.0f;
+    float t = dayOfYear + ((rising ? 6.0f : 18.0f) - lngHour) / 24.0f;
+    float m = 0.9856f * t - 3.289f;
+    float l = wrap(m + 1.916f * sinf(m * rad) + 0.020f * sinf(2 * m * rad) + 282.634f, 360.0f);
+    float ra = wrap(atanf(0.91764f * tanf(l * rad)) / rad, 360.0f);
+    float sinDec, cosDec, cosH, h;
+    ra = (ra + floorf(l / 90.0f) * 90.0f - floorf(ra / 90.0f) * 90.0f) / 15.0f;
+    sinDec = 0.39782f * sinf(l * rad);
+    cosDec = cosf(asinf(sinDec));
+    cosH = (cosf(90.833f * rad) - sinDec * sinf(latitude * rad)) / (cosDec * cosf(latitude * rad));
+    if ((cosH > 1.0f) || (cosH < -1.0f)) return -1;
+    h = acosf(cosH) / rad;
+    if (rising) h = 360.0f - h;
+    return (int)(wrap(h / 15.0f + ra - 0.06571f * t - 6.622f - lngHour, 24.0f) * 60.0f);
+}
+
+/**
+ * Is it night time, according to the schedule?
+ */
+static bool nightNow() {
+    time_t now = time(0);
+    struct tm local = *localtime(&now);
+    int minute = local.tm_hour * 60 + local.tm_min;
+    int start = schedule.startMinute;
+    int end = schedule.endMinute;
+    if (schedule.mode == DIMMING_SUN) {
+        if (local.tm_yday != sunDay) {
+            struct tm *utc = gmtime(&now);
+            int offset = minute - (utc->tm_hour * 60 + utc->tm_min);
+            int sunset = sunEventMinuteUTC(local.tm_yday + 1, schedule.latitude / 100.0f, schedule.longitude / 100.0f, false);
+            int sunrise = sunEventMinuteUTC(local.tm_yday + 1, schedule.latitude / 100.0f, schedule.longitude / 100.0f, true);
+            if (local.tm_year != utc->tm_year) {
+                offset += (local.tm_year > utc->tm_year) ? 1440 : -1440;
+            } else {
+                offset += (local.tm_yday - utc->tm_yday) * 1440;
+            }
+            sunDay = local.tm_yday;
+            if ((sunset < 0) || (sunrise < 0)) {
+                // Midnight sun or polar night - fall back to the fixed times
+                sunsetMinute = sunriseMinute = -1;
+            } else {
+                sunsetMinute = (sunset + offset + 1440) % 1440;
+                sunriseMinute = (sunrise + offset + 1440) % 1440;
+            }
+            DEBUG("Sunset at %d, sunrise at %d (local minutes)\n", sunsetMinute, sunriseMinute)
+        }
+        if (sunsetMinute >= 0) {
+            start = sunsetMinute;
+            end = sunriseMinute;
+        }
+    }
+    if (start > end) return (minute >= start) || (minute < end);
+    return (minute >= start) && (minute < end);
+}
+
+/**
+ * (Re)load the dimming schedule from the stored configuration
+ */
+void initBrightnessSchedule() {
+    getDimmingSchedule(&schedule);
+    sunDay = -1;
+    lastCheck = millis() - BRIGHTNESS_CHECK_MILLIS; // Check straight away
+    if ((isNight > 0) && ((schedule.level & 7) != targetLevel)) {
+        // The night level changed while it is night - fade to the new one now, rather than tomorrow
+        targetLevel = schedule.level & 7;
+        fading = true;
+        lastStep = millis() - BRIGHTNESS_STEP_MILLIS;
+    }
+}
+
+/**
+ * Set the brightness from a button press or a command, and keep it - as the night level if it is
+ * night, so it is still there tomorrow night and the daytime brightness is left alone
+ */
+void setBrightness(int level) {
+    setDisplayBrightness(level);
+    targetLevel = getDisplayBrightness();
+    fading = false;
+    if (isNight > 0) {
+        schedule.level = targetLevel;
+        setDimmingSchedule(&schedule);
+    } else {
+        setInt8Config(CFG_DEFAULT_BRIGHTNESS, targetLevel);
+    }
+    statsCount(STATS_BRIGHTNESS_CHANGES);
+}
+
+/**
+ * Brightness polling loop
+ *
+ * When it turns from day to night or back, the display fades one level at a time to the night
+ * level or the stored default brightness. Button presses in between are left alone. Nothing here
+ * writes to the stored configuration - that is setBrightness()
+ */
+void brightnessPoll() {
+    if (fading && ((millis() - lastStep) >= BRIGHTNESS_STEP_MILLIS)) {
+        uint8_t level = getDisplayBrightness();
+        lastStep = millis();
+        if (level < targetLevel) {
+            setDisplayBrightness(level + 1);
+        } else if (level > targetLevel) {
+            setDisplayBrightness(level - 1);
+        }
+        fading = getDisplayBrightness() != targetLevel;
+    }
+    if ((millis() - lastCheck) < BRIGHTNESS_CHECK_MILLIS) return;
+    lastCheck = millis();
+    if (!timeIsSynced()) return;
+    bool night = (schedule.mode != DIMMING_OFF) && nightNow();
+    if ((int8_t)night == isNight) return;
+    bool scheduled = isNight >= 0; // Rather than just worked out after starting up
+    isNight = night;
+    targetLevel = (night ? schedule.level : getInt8Config(CFG_DEFAULT_BRIGHTNESS, LED_DEFAULT_BRIGHTNESS)) & 7;
+    if (scheduled && (targetLevel != getDisplayBrightness())) statsCount(STATS_BRIGHTNESS_CHANGES);
+    DEBUG("It is now %s - fading to brightness %u\n", night ? "night" : "day", targetLevel)
+    fading = true;
+    lastStep = millis() - BRIGHTNESS_STEP_MILLIS;
+}
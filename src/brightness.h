@@ -0,0 +1,8 @@
+#ifndef _BRIGHTNESS_H_
+#define _BRIGHTNESS_H_
+
+void initBrightnessSchedule();
+void brightnessPoll();
+void setBrightness(int level);
+
+#endif
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "buttons.h"
+#include "power.h"
 
 // Debounce period is 8 x BUTTON_SCAN_MILLIS
 #define BUTTON_SCAN_MILLIS 20
@@ -9,17 +10,29 @@ uint8_t upButtonDebounce = 0;
 uint8_t downButtonDebounce = 0;
 uint8_t buttonsPressedMask = 0;
 uint64_t lastButtonScan = 0UL;
+volatile uint8_t buttonsLatched = 0;     // Buttons seen pressed by the interrupt handler since the last scan
 
 /**
- * Low level "is a button pressed" check
+ * Low level "is a button pressed" check. In IRAM, so it can be called from an interrupt handler
  */
-bool buttonPressed(uint8_t button) {
+bool IRAM_ATTR buttonPressed(uint8_t button) {
     if (button == DOWN_BUTTON_PIN) {
         return digitalRead(DOWN_BUTTON_PIN);
     }
     return !digitalRead(button);
 }
 
+/**
+ * Interrupt handler for a change on any of the buttons. Remembers which are pressed, so a press that
+ * is over before the next scan still counts, and wakes loop() to scan them
+ */
+void IRAM_ATTR buttonChanged() {
+    if (buttonPressed(SET_BUTTON_PIN)) buttonsLatched |= 1;
+    if (buttonPressed(UP_BUTTON_PIN)) buttonsLatched |= 2;
+    if (buttonPressed(DOWN_BUTTON_PIN)) buttonsLatched |= 4;
+    powerWake();
+}
+
 /**
  * Check a button state
  * mask is the button's mask in buttonsPressedMask
@@ -44,18 +57,30 @@ void checkButton(uint8_t mask, uint8_t debounceState, void (*cb)(void)) {
  */
 void buttonScan() {
     if ((millis() - lastButtonScan) < BUTTON_SCAN_MILLIS) return; // We only check once every BUTTON_SCAN_MILLIS
+    uint8_t latched;
     lastButtonScan = millis();
+    noInterrupts();
+    latched = buttonsLatched;
+    buttonsLatched = 0;
+    interrupts();
     setButtonDebounce <<= 1;
     upButtonDebounce <<= 1;
     downButtonDebounce <<= 1;
-    if (buttonPressed(SET_BUTTON_PIN)) setButtonDebounce |= 1;
-    if (buttonPressed(UP_BUTTON_PIN)) upButtonDebounce |= 1;
-    if (buttonPressed(DOWN_BUTTON_PIN)) downButtonDebounce |= 1;
+    if (buttonPressed(SET_BUTTON_PIN) || (latched & 1)) setButtonDebounce |= 1;
+    if (buttonPressed(UP_BUTTON_PIN) || (latched & 2)) upButtonDebounce |= 1;
+    if (buttonPressed(DOWN_BUTTON_PIN) || (latched & 4)) downButtonDebounce |= 1;
     checkButton(1, setButtonDebounce, setPressedCB);
     checkButton(2, upButtonDebounce, upPressedCB);
     checkButton(4, downButtonDebounce, downPressedCB);
 }
 
+/**
+ * Is a button pressed, or being debounced? If so, loop() must keep scanning
+ */
+bool buttonsBusy() {
+    return setButtonDebounce || upButtonDebounce || downButtonDebounce || buttonsLatched;
+}
+
 /**
  * Set up the system for checking the buttons
  */
@@ -64,4 +89,7 @@ void buttonSetup() {
     pinMode(UP_BUTTON_PIN, INPUT_PULLUP);
     pinMode(DOWN_BUTTON_PIN, INPUT);
     lastButtonScan = millis();
+    attachInterrupt(digitalPinToInterrupt(SET_BUTTON_PIN), buttonChanged, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(UP_BUTTON_PIN), buttonChanged, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(DOWN_BUTTON_PIN), buttonChanged, CHANGE);
 }
\ No newline at end of file
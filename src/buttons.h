@@ -12,4 +12,5 @@ void setPressedCB();
 void buttonScan();
 void buttonSetup();
 bool buttonPressed(uint8_t button);
+bool buttonsBusy();
 #endif
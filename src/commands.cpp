@@ -0,0 +1,127 @@
+// commands.cpp - pass work from the web server's callbacks to the main loop
+//
+// The web server callbacks run in the network stack's context, and can interrupt loop() part way
+// through talking to the display or writing to flash. So they only queue commands, which loop()
+// then runs. The queue is single producer (the network stack) single consumer (loop()), so it
+// needs no locking - each side only ever writes its own index
+
+#include <Arduino.h>
+#include <atomic>
+#include "commands.h"
+#include "config.h"
+#include "display.h"
+#include "brightness.h"
+#include "ota.h"
+#include "webserver.h"
+#include "bench.h"
+#include "alarms.h"
+#include "syslog.h"
+#include "mqtt.h"
+#include "stats.h"
+#include "power.h"
+#include "debug.h"
+
+static Command queue[COMMAND_QUEUE_SIZE];
+static std::atomic<uint8_t> head(0); // Next slot to be written - only changed by the producer
+static std::atomic<uint8_t> tail(0); // Next slot to be read - only changed by the consumer
+
+/**
+ * Add a parameter. Returns false if there is no room
+ */
+bool CommandParams::add(const String &name, const String &value) {
+    if (count >= COMMAND_MAX_PARAMS) return false;
+    names[count] = name;
+    values[count++] = value;
+    return true;
+}
+
+/**
+ * Is there a parameter with this name?
+ */
+bool CommandParams::has(const char *name) const {
+    for (uint8_t i = 0 ; i < count ; i++) {
+        if (names[i] == name) return true;
+    }
+    return false;
+}
+
+/**
+ * Get the value of a parameter, or an empty string if there isn't one
+ */
+const String &CommandParams::get(const char *name) const {
+    static const String none;
+    for (uint8_t i = 0 ; i < count ; i++) {
+        if (names[i] == name) return values[i];
+    }
+    return none;
+}
+
+/**
+ * Queue a command for loop() to run. Returns false (and deletes params) if the queue is full
+ */
+bool queueCommand(uint8_t type, int16_t value, CommandParams *params) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    if ((uint8_t)(h - tail.load(std::memory_order_acquire)) >= COMMAND_QUEUE_SIZE) {
+        DEBUG("Command queue full - dropping command %u\n", type)
+        delete params;
+        return false;
+    }
+    queue[h & (COMMAND_QUEUE_SIZE - 1)] = { type, value, params };
+    head.store(h + 1, std::memory_order_release);
+    notePowerActivity(); // Have loop() run it now
+    return true;
+}
+
+/**
+ * Run a command
+ */
+static void runCommand(const Command &command) {
+    DEBUG("Running command %u\n", command.type)
+    switch (command.type) {
+        case COMMAND_SET_BRIGHTNESS:
+            setBrightness(command.value);
+            break;
+        case COMMAND_APPLY_CONFIG:
+            if (command.params) {
+                applyConfigParams(*command.params);
+                char hash[9];
+                snprintf(hash, sizeof(hash), "%08x", getConfigHash());
+                logMessage(SYSLOG_NOTICE, "config", "Configuration changed, hash %s", hash);
+                mqttEvent("config", hash);
+            }
+            break;
+        case COMMAND_RESTART:
+            scheduleRestart();
+            break;
+        case COMMAND_SHOW_PROGRESS:
+            showPercentage(command.value);
+            break;
+        case COMMAND_BENCHMARK:
+            startBenchmark();
+            break;
+        case COMMAND_SET_ALARMS:
+            if (command.params) applyAlarmParams(*command.params);
+            break;
+        case COMMAND_ACK_ALARM:
+            acknowledgeAlarm();
+            break;
+        case COMMAND_TIMER:
+            if (command.params) applyTimerParams(*command.params);
+            break;
+        default: ;
+    }
+}
+
+/**
+ * Command polling loop - runs all the commands that have been queued
+ */
+void commandPoll() {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    while (t != head.load(std::memory_order_acquire)) {
+        Command command = queue[t & (COMMAND_QUEUE_SIZE - 1)];
+        queue[t & (COMMAND_QUEUE_SIZE - 1)].params = 0;
+        tail.store(++t, std::memory_order_release);
+        runCommand(command);
+        delete command.params;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef _COMMANDS_H_
+#define _COMMANDS_H_
+
+#include <Arduino.h>
+
+#define COMMAND_SET_BRIGHTNESS 1  // value is the brightness level
+#define COMMAND_APPLY_CONFIG 2    // params holds the new configuration, as form parameters
+#define COMMAND_RESTART 3
+#define COMMAND_SHOW_PROGRESS 4   // value is the percentage
+#define COMMAND_BENCHMARK 5
+#define COMMAND_SET_ALARMS 6       // params holds the alarms, as form parameters
+#define COMMAND_ACK_ALARM 7
+#define COMMAND_TIMER 8            // params holds the timer settings, as form parameters
+
+#define COMMAND_QUEUE_SIZE 16     // Must be a power of 2
+#define COMMAND_MAX_PARAMS 40
+
+/**
+ * A set of name/value parameters, copied out of a web request so it can outlive it
+ */
+class CommandParams {
+public:
+    bool add(const String &name, const String &value);
+    bool has(const char *name) const;
+    const String &get(const char *name) const;
+private:
+    uint8_t count = 0;
+    String names[COMMAND_MAX_PARAMS];
+    String values[COMMAND_MAX_PARAMS];
+};
+
+typedef struct Command_t {
+    uint8_t type;
+    int16_t value;
+    CommandParams *params; // Owned by the queue once queued - deleted after the command is run
+} Command;
+
+bool queueCommand(uint8_t type, int16_t value = 0, CommandParams *params = 0);
+void commandPoll();
+
+#endif
@@ -5,6 +5,7 @@
 
 Preferences prefs;
 int8_t cfgBits = 0; // The value of CFG_BOOL_CONFIGS
+static uint32_t generation = 0; // Bumped whenever the stored configuration changes
 
 /**
  * Initialise the stored configuration system
@@ -40,6 +41,27 @@ int8_t getInt8Config(const char *tag, int8_t defaultValue) {
 #endif
 }
 
+/**
+ * Get a 16 bit integer value from the stored configuration
+ */
+int16_t getInt16Config(const char *tag, int16_t defaultValue) {
+#ifdef DEBUGGING
+    int16_t ans = prefs.getShort(tag, defaultValue);
+    DEBUG("\"%s\" = %d\n", tag, ans);
+    return ans;
+#else
+    return prefs.getShort(tag, defaultValue);
+#endif
+}
+
+/**
+ * Get the manually configured timezone, in minutes east of Greenwich
+ */
+int16_t getTimezoneMinutes() {
+    if (hasConfig(CFG_TZ_MINUTES)) return getInt16Config(CFG_TZ_MINUTES, 0);
+    return getInt8Config(CFG_TIMEZONE, 0) * 60; // Stored by older firmware
+}
+
 /**
  * Get a string value from the stored configuration
  */
@@ -61,6 +83,22 @@ void getDSTTransition(bool start, DST_Transition *ans) {
     DEBUG("DST %s transition is dow %u wk %u mon %u tm %u\n", start ? "start" : "end", ans->dow, ans->dowNumber, ans->month, ans->timeOfDay)
 }
 
+/**
+ * Get the night dimming schedule from the stored configuration
+ */
+void getDimmingSchedule(Dimming_Schedule *ans) {
+    memset(ans, 0, sizeof(Dimming_Schedule));
+    if (prefs.isKey(CFG_DIMMING)) prefs.getBytes(CFG_DIMMING, ans, sizeof(Dimming_Schedule));
+}
+
+/**
+ * Get the alarms from the stored configuration - always ALARM_COUNT of them
+ */
+void getAlarms(Alarm *ans) {
+    memset(ans, 0, sizeof(Alarm) * ALARM_COUNT);
+    if (prefs.isKey(CFG_ALARMS)) prefs.getBytes(CFG_ALARMS, ans, sizeof(Alarm) * ALARM_COUNT);
+}
+
 /**
  * Store an integer value in the stored configuration
  */
@@ -68,6 +106,17 @@ void setInt8Config(const char *tag, int8_t value) {
     if ((prefs.isKey(tag)) && (prefs.getChar(tag) == value)) return;
     DEBUG("Setting \"%s\" to %d\n", tag, value)
     prefs.putChar(tag, value);
+    generation++;
+}
+
+/**
+ * Store a 16 bit integer value in the stored configuration
+ */
+void setInt16Config(const char *tag, int16_t value) {
+    if ((prefs.isKey(tag)) && (prefs.getShort(tag) == value)) return;
+    DEBUG("Setting \"%s\" to %d\n", tag, value)
+    prefs.putShort(tag, value);
+    generation++;
 }
 
 /**
@@ -77,6 +126,7 @@ void setStringConfig(const char *tag, String value) {
     if ((prefs.isKey(tag)) && (prefs.getString(tag) == value)) return;
     DEBUG("Setting \"%s\" to \"%s\"\n", tag, value.c_str())
     prefs.putString(tag, value);
+    generation++;
 }
 
 /**
@@ -91,6 +141,56 @@ void setDSTConfig(DST_Transition value, bool start) {
     }
     DEBUG("Setting %s transition to dow %u wk %u mon %u tm %u\n", tag, value.dow, value.dowNumber, value.month, value.timeOfDay)
     prefs.putBytes(tag, &value, sizeof(DST_Transition));
+    generation++;
+}
+
+/**
+ * Store the night dimming schedule in the stored configuration
+ */
+void setDimmingSchedule(const Dimming_Schedule *value) {
+    Dimming_Schedule current;
+    getDimmingSchedule(&current);
+    if (!memcmp(&current, value, sizeof(Dimming_Schedule))) return;
+    DEBUG("Setting dimming schedule mode %u level %u\n", value->mode, value->level)
+    prefs.putBytes(CFG_DIMMING, value, sizeof(Dimming_Schedule));
+    generation++;
+}
+
+/**
+ * Store the alarms in the stored configuration - always ALARM_COUNT of them
+ */
+void setAlarms(const Alarm *value) {
+    Alarm current[ALARM_COUNT];
+    getAlarms(current);
+    if (!memcmp(current, value, sizeof(current))) return;
+    DEBUG("Setting alarms\n")
+    prefs.putBytes(CFG_ALARMS, value, sizeof(current));
+    generation++;
+}
+
+/**
+ * Remove one value from the stored configuration
+ */
+void removeConfig(const char *tag) {
+    if (!prefs.isKey(tag)) return;
+    DEBUG("Removing \"%s\"\n", tag)
+    prefs.remove(tag);
+    generation++;
+}
+
+/**
+ * Write a scratch value, which isn't part of the configuration, to the configuration store. This is
+ * always a flash write, and nothing that depends on the configuration is told it has changed
+ */
+void setScratchConfig(const char *tag, int8_t value) {
+    prefs.putChar(tag, value);
+}
+
+/**
+ * Remove a scratch value written by setScratchConfig()
+ */
+void removeScratchConfig(const char *tag) {
+    if (prefs.isKey(tag)) prefs.remove(tag);
 }
 
 /**
@@ -100,6 +200,67 @@ void resetConfig() {
     DEBUG("Resetting config")
     prefs.clear();
     cfgBits = 0;
+    generation++;
+}
+
+/**
+ * A number that changes whenever the stored configuration does, so anything worked out from the
+ * configuration can tell when it needs working out again. It starts again at boot
+ */
+uint32_t getConfigGeneration() {
+    return generation;
+}
+
+/**
+ * Mix some bytes into an FNV-1a hash
+ */
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len) {
+    while (len--) {
+        hash ^= *data++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * A hash of the entire stored configuration, so that clocks configured identically can be recognised
+ *
+ * The WiFi password is deliberately left out, as the hash is published on the network
+ */
+uint32_t getConfigHash() {
+    static const char *stringTags[] = { CFG_SSID, CFG_HOSTNAME, CFG_NTP_SERVER_1, CFG_NTP_SERVER_2,
+        CFG_NTP_SERVER_3, CFG_TZ_NAME, CFG_DST_NAME, CFG_ZONE, CFG_SYSLOG_HOST, CFG_MQTT_BROKER };
+    static const char *int8Tags[] = { CFG_BOOL_CONFIGS, CFG_DEFAULT_BRIGHTNESS, CFG_TIMEZONE, CFG_AP_AFTER_MINUTES, CFG_LEAP, CFG_POWER,
+        CFG_PAGE_TIME, CFG_PAGE_DATE, CFG_PAGE_WEEKDAY, CFG_PAGE_SYNC, CFG_PAGE_IP };
+    uint32_t hash = 2166136261UL;
+    for (const char *tag : stringTags) {
+        String value = getStringConfig(tag);
+        hash = fnv1a(hash, (const uint8_t *)value.c_str(), value.length() + 1);
+    }
+    for (const char *tag : int8Tags) {
+        int8_t value = getInt8Config(tag, 0);
+        hash = fnv1a(hash, (const uint8_t *)&value, 1);
+    }
+    {
+        int16_t minutes = getInt16Config(CFG_TZ_MINUTES, 0);
+        hash = fnv1a(hash, (const uint8_t *)&minutes, sizeof(minutes));
+    }
+    {
+        Dimming_Schedule schedule;
+        getDimmingSchedule(&schedule);
+        hash = fnv1a(hash, (const uint8_t *)&schedule, sizeof(schedule));
+    }
+    {
+        Alarm alarms[ALARM_COUNT];
+        getAlarms(alarms);
+        hash = fnv1a(hash, (const uint8_t *)alarms, sizeof(alarms));
+    }
+    for (int start = 0 ; start < 2 ; start++) {
+        DST_Transition transition = { 0, 0, 0, 0 };
+        if (hasConfig(start ? CFG_DST_START : CFG_DST_END)) getDSTTransition(start, &transition);
+        hash = fnv1a(hash, (const uint8_t *)&transition, sizeof(transition));
+    }
+    return hash;
 }
 
 /**
@@ -5,6 +5,8 @@
 #define CFG_MASK_24H 1
 //#define CFG_MASK_MONTHNAMES 2
 //#define CFG_MASK_OTA_UPDATE 4
+#define CFG_MASK_NTP_SERVER 8
+#define CFG_MASK_NTP_BROADCAST 16
 
 #define CFG_SSID "SSID"
 #define CFG_PASSWORD "PW"
@@ -14,11 +16,32 @@
 #define CFG_NTP_SERVER_3 "NTP3"
 #define CFG_BOOL_CONFIGS "CFG"
 #define CFG_DEFAULT_BRIGHTNESS "BRI"
-#define CFG_TIMEZONE "TZ"
+#define CFG_TIMEZONE "TZ"        // Whole hours east of Greenwich - superseded by CFG_TZ_MINUTES
+#define CFG_TZ_MINUTES "TZMIN"   // Minutes east of Greenwich
+#define CFG_ZONE "ZONE"          // IANA timezone name, from the built-in zone database
 #define CFG_DST_START "DSTS"
 #define CFG_DST_END "DSTE"
 #define CFG_TZ_NAME "TZNAM"
 #define CFG_DST_NAME "DSTNAM"
+#define CFG_DIMMING "DIM"
+#define CFG_AP_AFTER_MINUTES "APMIN" // Minutes offline before the configuration access point comes back, 0 for never
+#define CFG_BENCHMARK "BENCH"    // Scratch value written by the benchmarks, removed afterwards
+#define CFG_ALARMS "ALARM"
+#define CFG_SYSLOG_HOST "LOGHOST" // Syslog server, "host" or "host:port", empty for none
+#define CFG_MQTT_BROKER "MQTT"   // MQTT broker, "host" or "host:port", empty for none
+#define CFG_LEAP "LEAP"          // What to do about leap seconds - one of the LEAP_ values in leap.h
+#define CFG_POWER "POWER"        // How hard to save power - one of the POWER_ values in power.h
+#define CFG_PAGE_TIME "PGTIME"   // Seconds each display page is shown for, 0 to leave it out - see pages.h
+#define CFG_PAGE_DATE "PGDATE"
+#define CFG_PAGE_WEEKDAY "PGDAY"
+#define CFG_PAGE_SYNC "PGSYNC"
+#define CFG_PAGE_IP "PGIP"
+
+#define DIMMING_OFF 0
+#define DIMMING_FIXED 1
+#define DIMMING_SUN 2
+
+#define ALARM_COUNT 8
 
 typedef struct DST_Transition_t {
     uint8_t dow;
@@ -27,15 +50,42 @@ typedef struct DST_Transition_t {
     uint8_t timeOfDay;
 } DST_Transition;
 
+typedef struct Dimming_Schedule_t {
+    uint8_t mode;           // One of the DIMMING_ values
+    uint8_t level;          // Brightness at night
+    uint16_t startMinute;   // Minute of the (local) day that night starts, for DIMMING_FIXED
+    uint16_t endMinute;     // Minute of the (local) day that night ends, for DIMMING_FIXED
+    int16_t latitude;       // Hundredths of a degree north, for DIMMING_SUN
+    int16_t longitude;      // Hundredths of a degree east, for DIMMING_SUN
+} Dimming_Schedule;
+
+typedef struct Alarm_t {
+    uint16_t minuteOfDay;   // Local time
+    uint8_t days;           // Bit 0 for Sunday .. bit 6 for Saturday, or 0 for a one-shot at the next minuteOfDay
+    uint8_t enabled;        // One-shots are disabled once they have gone off
+} Alarm;
+
 void initConfig();
 bool hasConfig(const char *tag);
 int8_t getInt8Config(const char *tag, int8_t defaultValue);
+int16_t getInt16Config(const char *tag, int16_t defaultValue);
+int16_t getTimezoneMinutes();
 String getStringConfig(const char *tag, String defaultValue = String());
 void getDSTTransition(bool start, DST_Transition *ans);
+void getDimmingSchedule(Dimming_Schedule *ans);
+void getAlarms(Alarm *ans);
 void setInt8Config(const char *tag, int8_t value);
+void setInt16Config(const char *tag, int16_t value);
 void setStringConfig(const char *tag, String value);
 void setDSTConfig(DST_Transition value, bool start);
+void setDimmingSchedule(const Dimming_Schedule *value);
+void setAlarms(const Alarm *value);
+void setScratchConfig(const char *tag, int8_t value);
+void removeScratchConfig(const char *tag);
 void resetConfig();
+void removeConfig(const char *tag);
+uint32_t getConfigHash();
+uint32_t getConfigGeneration();
 
 bool cfgBitIsSet(uint8_t mask);
 void setCfgBit(uint8_t mask);
@@ -2,9 +2,12 @@
 #define _DEBUG_H_
 
 // #define DEBUGGING
+// Record every write to the display, for GET /trace
+// #define DISPLAY_TRACE
 
+// The format strings are kept in flash - in RAM they would take several KB
 #ifdef DEBUGGING
-#define DEBUG(...) Serial.printf(__VA_ARGS__);
+#define DEBUG(format, ...) Serial.printf_P(PSTR(format), ##__VA_ARGS__);
 #else
 #define DEBUG(...)
 #endif
@@ -0,0 +1,40 @@
+// discovery.cpp - advertise the clock over mDNS/DNS-SD so a fleet of them can be found and managed
+
+#include <Arduino.h>
+#include <ESP8266mDNS.h>
+#include "discovery.h"
+#include "config.h"
+#include "version.h"
+#include "debug.h"
+
+static bool isSetup = false;
+
+/**
+ * Add the TXT records that can change while we are running. These are generated each time
+ * we answer a query, so a configuration change shows up without re-registering the service
+ */
+static void addDynamicTxt(MDNSResponder::hMDNSService service) {
+    char hash[9];
+    snprintf(hash, sizeof(hash), "%08x", getConfigHash());
+    MDNS.addDynamicServiceTxt(service, "cfg", hash);
+}
+
+/**
+ * Discovery polling loop
+ *
+ * ArduinoOTA starts the mDNS responder under our configured hostname (and keeps it updated), so
+ * all we need to do is wait for it and then add our own service
+ */
+void discoveryPoll() {
+    MDNSResponder::hMDNSService service;
+    if (isSetup || !MDNS.isRunning()) return;
+    service = MDNS.addService(0, "303clock", "tcp", 80);
+    if (service) {
+        MDNS.addServiceTxt(service, "version", FIRMWARE_VERSION);
+        MDNS.addServiceTxt(service, "path", "/config");
+        MDNS.setDynamicServiceTxtCallback(service, addDynamicTxt);
+        MDNS.addService(0, "http", "tcp", 80);
+        DEBUG("Advertising 303clock service over mDNS\n")
+    }
+    isSetup = true;
+}
@@ -0,0 +1,6 @@
+#ifndef _DISCOVERY_H_
+#define _DISCOVERY_H_
+
+void discoveryPoll();
+
+#endif
@@ -4,6 +4,7 @@
 #include <Wire.h>
 #include "display.h"
 #include "config.h"
+#include "debug.h"
 
 // The bitmap for lighting bits in the LED display goes as (big endian) b f a e  d c g dp
 //
@@ -27,47 +28,184 @@
 //  4   2
 //   333   0
 
-static const uint8_t ledCharBitmaps[] = {
-  0b11111100, // 0
-  0b10000100, // 1
-  0b10111010, // 2
-  0b10101110, // 3
-  0b11000110, // 4
-  0b01101110, // 5
-  0b01111110, // 6
-  0b10100100, // 7
-  0b11111110, // 8
-  0b11101110, // 9
-  0b00000000, // <space>
-  0b01111000, // C
-  0b00011110, // o
-  0b00010110, // n
-  0b01110010, // F
-  0b01011110, // b - for "boot"
-  0b01011010, // t - for "boot"
-  0b11110010, // P - for "ntP" - replacing with "SynC"
-  0b01101110, // S - for "SynC"
-  0b11001110  // y
+/**
+ * The bitmap bit for a segment letter
+ */
+constexpr uint8_t segmentBit(char s) {
+  return s == 'a' ? 0x20 : s == 'b' ? 0x80 : s == 'c' ? 0x04 : s == 'd' ? 0x08 :
+         s == 'e' ? 0x10 : s == 'f' ? 0x40 : s == 'g' ? 0x02 : 0;
+}
+
+/**
+ * The bitmap for a string of segment letters, evaluated at compile time
+ */
+constexpr uint8_t seg(const char *segments) {
+  return *segments ? segmentBit(*segments) | seg(segments+1) : 0;
+}
+
+// Font for ASCII 0x20 - 0x7f. Characters that can't be shown sensibly on 7 segments are blank
+#define FONT_FIRST ' '
+#define FONT_LAST 0x7f
+static const uint8_t ledFont[] PROGMEM = {
+  seg(""),       seg("bc"),     seg("bf"),     seg(""),       // <space> ! " #
+  seg(""),       seg(""),       seg(""),       seg("b"),      // $ % & '
+  seg("adef"),   seg("abcd"),   seg(""),       seg(""),       // ( ) * +
+  seg("c"),      seg("g"),      seg(""),       seg("beg"),    // , - . /
+  seg("abcdef"), seg("bc"),     seg("abdeg"),  seg("abcdg"),  // 0 1 2 3
+  seg("bcfg"),   seg("acdfg"),  seg("acdefg"), seg("abc"),    // 4 5 6 7
+  seg("abcdefg"),seg("abcdfg"), seg(""),       seg(""),       // 8 9 : ;
+  seg("dg"),     seg("dg"),     seg("cdg"),    seg("abeg"),   // < = > ?
+  seg("abdef"),  seg("abcefg"), seg("cdefg"),  seg("adef"),   // @ A B C
+  seg("bcdeg"),  seg("adefg"),  seg("aefg"),   seg("acdef"),  // D E F G
+  seg("bcefg"),  seg("ef"),     seg("bcde"),   seg("acefg"),  // H I J K
+  seg("def"),    seg("aceg"),   seg("abcef"),  seg("abcdef"), // L M N O
+  seg("abefg"),  seg("abcfg"),  seg("eg"),     seg("acdfg"),  // P Q R S
+  seg("defg"),   seg("bcdef"),  seg("cde"),    seg("bdf"),    // T U V W
+  seg("bcefg"),  seg("bcdfg"),  seg("abdeg"),  seg("adef"),   // X Y Z [
+  seg("cfg"),    seg("abcd"),   seg("abf"),    seg("d"),      // \ ] ^ _
+  seg("f"),      seg("abcdeg"), seg("cdefg"),  seg("deg"),    // ` a b c
+  seg("bcdeg"),  seg("abdefg"), seg("aefg"),   seg("abcdfg"), // d e f g
+  seg("cefg"),   seg("c"),      seg("cd"),     seg("acefg"),  // h i j k
+  seg("ef"),     seg("aceg"),   seg("ceg"),    seg("cdeg"),   // l m n o
+  seg("abefg"),  seg("abcfg"),  seg("eg"),     seg("acdfg"),  // p q r s
+  seg("defg"),   seg("cde"),    seg("cde"),    seg("bdf"),    // t u v w
+  seg("bcefg"),  seg("bcdfg"),  seg("abdeg"),  seg("bcef"),   // x y z {
+  seg("ef"),     seg("adef"),   seg("a"),      seg("")        // | } ~ <del>
 };
 
 // The I2C connections on the 303WIFILC01 board
 #define SCL_PIN 12
 #define SDA_PIN 13
 
-// Need to save the character of the 2nd LED so we can flash the colon easily
-uint8_t digit2Char = LED_CHAR_SPACE;
+// Longest text that can be scrolled, including the leading blanks
+#define SCROLL_MAX_GLYPHS 48
+
 uint8_t displayBrightness = LED_DEFAULT_BRIGHTNESS;
+bool brightnessUnknown = true;
+bool displayOn = true;
+// What is currently on each digit - the character, and the bitmap actually sent to the TM1650
+char digitChars[4] = { ' ', ' ', ' ', ' ' };
+uint8_t frame[4] = { 0, 0, 0, 0 };
+// Set until the first frame has been sent, as the TM1650 keeps its contents over an ESP restart
+bool frameUnknown = true;
+
+// Marquee scroller state
+static uint8_t scrollGlyphs[SCROLL_MAX_GLYPHS];
+static char scrollChars[SCROLL_MAX_GLYPHS];
+static uint8_t scrollLength = 0;
+static uint8_t scrollPosition = 0;
+static uint16_t scrollStepMillis = 0;
+static unsigned long lastScrollStep = 0;
+static bool scrolling = false;
+
+// Every transaction sent to the TM1650, for spotting changes that make the display chattier
+static uint32_t transactionCount = 0;
+#ifdef DISPLAY_TRACE
+static DisplayTransaction trace[DISPLAY_TRACE_SIZE];
+static uint16_t traceNext = 0;
+static bool traceWrapped = false;
+#endif
+
+/**
+ * Send one byte to the TM1650. All writes to the display go through here
+ *
+ * Not in IRAM - Wire and the core's I2C bit-banging run from flash, so this would still wait on the
+ * flash cache for them. Only code called from interrupt handlers needs to be in IRAM
+ */
+static void writeDisplay(uint8_t address, uint8_t value) {
+  Wire.beginTransmission(address);
+  Wire.write(value);
+  Wire.endTransmission();
+  transactionCount++;
+#ifdef DISPLAY_TRACE
+  trace[traceNext].timestamp = millis();
+  trace[traceNext].address = address;
+  trace[traceNext].value = value;
+  if (++traceNext >= DISPLAY_TRACE_SIZE) {
+    traceNext = 0;
+    traceWrapped = true;
+  }
+#endif
+}
+
+/**
+ * How many transactions have been sent to the TM1650 since boot
+ */
+uint32_t getDisplayTransactionCount() {
+  return transactionCount;
+}
+
+#ifdef DISPLAY_TRACE
+/**
+ * Copy the recorded transactions, oldest first, into buf. Returns how many were copied
+ */
+size_t getDisplayTrace(DisplayTransaction *buf, size_t maxTransactions) {
+  size_t count = traceWrapped ? DISPLAY_TRACE_SIZE : traceNext;
+  uint16_t start = traceWrapped ? traceNext : 0;
+  size_t n;
+  for (n = 0 ; (n < count) && (n < maxTransactions) ; n++) buf[n] = trace[(start + n) % DISPLAY_TRACE_SIZE];
+  return n;
+}
+#endif
+
+/**
+ * Look up the bitmap for a character
+ */
+static uint8_t charBitmap(char c) {
+  if ((c < FONT_FIRST) || (c > FONT_LAST)) return 0;
+  return pgm_read_byte(&ledFont[c - FONT_FIRST]);
+}
+
+/**
+ * Send a frame to the display. Only the digits that have changed are sent, back to back
+ */
+static void pushFrame(const uint8_t *bitmaps, const char *chars) {
+  for (int i = 0 ; i < 4 ; i++) {
+    digitChars[i] = chars[i];
+    if ((!frameUnknown) && (frame[i] == bitmaps[i])) continue;
+    frame[i] = bitmaps[i];
+    writeDisplay(0x34+i, bitmaps[i]);
+  }
+  frameUnknown = false;
+}
+
+/**
+ * Convert text into glyphs. A '.' is merged into the decimal point of the character before it,
+ * if it has not already got one - even the last that fits. Returns the number of glyphs
+ */
+static uint8_t renderText(const char *text, uint8_t *bitmaps, char *chars, uint8_t maxGlyphs) {
+  uint8_t n = 0;
+  for ( ; *text ; text++) {
+    if ((*text == '.') && n && !(bitmaps[n-1] & 1)) {
+      bitmaps[n-1] |= 1;
+      continue;
+    }
+    if (n >= maxGlyphs) break;
+    bitmaps[n] = (*text == '.') ? 1 : charBitmap(*text);
+    chars[n++] = *text;
+  }
+  return n;
+}
 
 /**
- * Set the display brightness level (0 - 7)
+ * Set the display brightness level (0 - 7). The TM1650 is only written to if the level changes
  */
 void setDisplayBrightness(int brightness) {
   int val;
+  if ((!brightnessUnknown) && (displayBrightness == (brightness & 7))) return;
+  brightnessUnknown = false;
   displayBrightness = brightness & 7;
-  val = (((brightness+1) & 7) << 4) | 1;
-  Wire.beginTransmission(0x24); // register 0x48 DIG1CTRL
-  Wire.write(val); 
-  Wire.endTransmission();
+  val = (((brightness+1) & 7) << 4) | (displayOn ? 1 : 0);
+  writeDisplay(0x24, val); // register 0x48 DIG1CTRL
+}
+
+/**
+ * Turn the whole display off or on, keeping what it shows
+ */
+void setDisplayOn(bool on) {
+  if (on == displayOn) return;
+  displayOn = on;
+  writeDisplay(0x24, (((displayBrightness+1) & 7) << 4) | (on ? 1 : 0));
 }
 
 /**
@@ -77,6 +215,15 @@ uint8_t getDisplayBrightness() {
   return displayBrightness;
 }
 
+/**
+ * Get the characters currently on the display, as a 4 character null terminated string.
+ * The colon is not included
+ */
+void getDisplayedText(char *buf) {
+  for (int i = 0 ; i < 4 ; i++) buf[i] = digitChars[i];
+  buf[4] = 0;
+}
+
 /**
  * Initialise the display system
  */
@@ -88,72 +235,133 @@ void initDisplay(int brightness) {
 /**
  * Set a specific digit on the display
  */
-void setDigit(uint8_t digitNum, uint8_t digitChar, bool digitDP) {
-  if (digitNum == 1) digit2Char = digitChar;
-  Wire.beginTransmission(0x34+digitNum);
-  Wire.write(ledCharBitmaps[digitChar] | (digitDP ? 1 : 0));
-  Wire.endTransmission();
+void setDigit(uint8_t digitNum, char digitChar, bool digitDP) {
+  uint8_t bitmaps[4];
+  char chars[4];
+  memcpy(bitmaps, frame, sizeof(bitmaps));
+  memcpy(chars, digitChars, sizeof(chars));
+  bitmaps[digitNum] = charBitmap(digitChar) | (digitDP ? 1 : 0);
+  chars[digitNum] = digitChar;
+  pushFrame(bitmaps, chars);
 }
 
 /**
  * Set the colon on or off
  */
 void setColon(bool colon) {
-  setDigit(1, digit2Char, colon);
+  setDigit(1, digitChars[1], colon);
 }
 
 /**
- * Show characters on the display
+ * Show characters on the display. This stops any scrolling text
  */
-void setLEDSegments(uint8_t dig1, uint8_t dig2, uint8_t dig3, uint8_t dig4, bool colon) {
-  setDigit(0, dig1, false);
-  setDigit(1, dig2, colon);
-  setDigit(2, dig3, false);
-  setDigit(3, dig4, false);
+void setLEDSegments(char dig1, char dig2, char dig3, char dig4, bool colon) {
+  uint8_t bitmaps[4];
+  char chars[4] = { dig1, dig2, dig3, dig4 };
+  scrolling = false;
+  for (int i = 0 ; i < 4 ; i++) bitmaps[i] = charBitmap(chars[i]);
+  if (colon) bitmaps[1] |= 1;
+  pushFrame(bitmaps, chars);
 }
 
 /**
  * Clear the display
  */
 void clearLEDSegments() {
-  setLEDSegments(LED_CHAR_SPACE, LED_CHAR_SPACE, LED_CHAR_SPACE, LED_CHAR_SPACE, false);
+  setLEDSegments(' ', ' ', ' ', ' ', false);
+}
+
+/**
+ * Show up to 4 characters of text on the display, left justified. This stops any scrolling text
+ */
+void showText(const char *text) {
+  uint8_t bitmaps[4] = { 0, 0, 0, 0 };
+  char chars[4] = { ' ', ' ', ' ', ' ' };
+  scrolling = false;
+  renderText(text, bitmaps, chars, 4);
+  pushFrame(bitmaps, chars);
+}
+
+/**
+ * Scroll text across the display, from right to left, moving one character every stepMillis.
+ * The scrolling is done by displayPoll()
+ */
+void scrollText(const char *text, uint16_t stepMillis) {
+  memset(scrollGlyphs, 0, 3);
+  memset(scrollChars, ' ', 3);
+  scrollLength = 3 + renderText(text, scrollGlyphs + 3, scrollChars + 3, SCROLL_MAX_GLYPHS - 3);
+  scrollPosition = 0;
+  scrollStepMillis = stepMillis;
+  scrolling = true;
+  pushFrame(scrollGlyphs, scrollChars);
+  lastScrollStep = millis();
+}
+
+/**
+ * Is there text scrolling across the display?
+ */
+bool displayIsScrolling() {
+  return scrolling;
+}
+
+/**
+ * Display polling loop - moves any scrolling text along
+ */
+void displayPoll() {
+  uint8_t bitmaps[4];
+  char chars[4];
+  if (!scrolling) return;
+  if ((millis() - lastScrollStep) < scrollStepMillis) return;
+  lastScrollStep += scrollStepMillis;
+  if (++scrollPosition >= scrollLength) {
+    scrolling = false;
+    clearLEDSegments();
+    return;
+  }
+  for (int i = 0 ; i < 4 ; i++) {
+    uint8_t p = scrollPosition + i;
+    bitmaps[i] = (p < scrollLength) ? scrollGlyphs[p] : 0;
+    chars[i] = (p < scrollLength) ? scrollChars[p] : ' ';
+  }
+  pushFrame(bitmaps, chars);
 }
 
 /**
  * Show the hours and minutes on the display
  */
 void showTime(uint8_t h, uint8_t m) {
+  char tens;
   if (h < 10) {
-    setDigit(0, LED_CHAR_SPACE, false);
+    tens = ' ';
   } else if (h < 13) {
-    setDigit(0, 1, false);
+    tens = '1';
   } else if (cfgBitIsSet(CFG_MASK_24H)) {
-    setDigit(0, (h > 19) ? 2 : 1, false);
+    tens = (h > 19) ? '2' : '1';
   } else if (h < 22) {
-    setDigit(0, LED_CHAR_SPACE, false);
+    tens = ' ';
   } else {
-    setDigit(0, 1, false);
+    tens = '1';
   }
-  setDigit(1, h % 10, true);
-  setDigit(2, m/10, false);
-  setDigit(3, m % 10, false);
+  setLEDSegments(tens, '0' + h % 10, '0' + m/10, '0' + m % 10, true);
+}
+
+/**
+ * Show a number of up to 3 digits, right justified, after a leading character
+ */
+static void showLeadAndUInt8(char lead, uint8_t v) {
+  setLEDSegments(lead, (v < 100) ? ' ' : '0' + v/100, (v < 10) ? ' ' : '0' + (v/10)%10, '0' + v % 10);
 }
 
 /**
  * Show an integer value on the display - used in showing our IP address
  */
 void showUInt8(uint8_t v) {
-  setDigit(0, LED_CHAR_SPACE, false);
-  if (v < 100) {
-    setDigit(1, LED_CHAR_SPACE, false);
-  } else {
-    setDigit(1, v/100, false);
-  }
-  if (v < 10) {
-    setDigit(2, LED_CHAR_SPACE, false);
-  } else {
-    setDigit(2, (v/10)%10, false);
-  }
-  setDigit(3, v % 10, false);
+  showLeadAndUInt8(' ', v);
 }
 
+/**
+ * Show a percentage (0 - 100) on the display, as "P" followed by the number - used for update progress
+ */
+void showPercentage(uint8_t v) {
+  showLeadAndUInt8('P', v);
+}
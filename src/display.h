@@ -2,26 +2,38 @@
 #define _DISPLAY_H_
 
 #include <Arduino.h>
+#include "debug.h"
 
-#define LED_CHAR_SPACE 10
-#define LED_CHAR_C 11
-#define LED_CHAR_o 12
-#define LED_CHAR_n 13
-#define LED_CHAR_F 14
-#define LED_CHAR_b 15
-#define LED_CHAR_t 16
-#define LED_CHAR_P 17
-#define LED_CHAR_S 18
-#define LED_CHAR_y 19
 #define LED_DEFAULT_BRIGHTNESS 7
+#define LED_SCROLL_MILLIS 300
+#define DISPLAY_TRACE_SIZE 256
+
+// One recorded write to the TM1650 - the trace is a sequence of these, 6 bytes each, little endian
+typedef struct __attribute__((packed)) DisplayTransaction_t {
+  uint32_t timestamp; // millis()
+  uint8_t address;
+  uint8_t value;
+} DisplayTransaction;
 
 void setDisplayBrightness(int brightness);       // Sets brightness level 0 .. 7
 uint8_t getDisplayBrightness();
+void setDisplayOn(bool on);
+void getDisplayedText(char *buf);              // buf must hold at least 5 characters
 void initDisplay(int brightness);
+void displayPoll();
+void setDigit(uint8_t digitNum, char digitChar, bool digitDP);
 void setColon(bool colon);
-void setLEDSegments(uint8_t dig1, uint8_t dig2, uint8_t dig3, uint8_t dig4, bool colon = false);
+void setLEDSegments(char dig1, char dig2, char dig3, char dig4, bool colon = false);
 void clearLEDSegments();
+void showText(const char *text);
+void scrollText(const char *text, uint16_t stepMillis = LED_SCROLL_MILLIS);
+bool displayIsScrolling();
+uint32_t getDisplayTransactionCount();
+#ifdef DISPLAY_TRACE
+size_t getDisplayTrace(DisplayTransaction *buf, size_t maxTransactions);
+#endif
 void showTime(uint8_t h, uint8_t m);
 void showUInt8(uint8_t v);
+void showPercentage(uint8_t v);
 
 #endif
@@ -0,0 +1,112 @@
+// events.cpp - live status of the clock, pushed to web browsers as Server-Sent Events on /events
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include "events.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "wifi.h"
+#include "debug.h"
+
+// Changes within this period of the last event are coalesced into the next one
+#define EVENTS_MIN_INTERVAL_MILLIS 250
+// Limits on what the clients can cost us. Each queued message holds one status record (about 50 bytes)
+#define EVENTS_MAX_CLIENTS 4
+#define EVENTS_MAX_QUEUED 4
+// How often the status is checked for changes
+#define EVENTS_POLL_MILLIS 50
+
+typedef struct Status_t {
+    char display[5];
+    uint8_t brightness;
+    bool synced;
+    bool wifi;
+} Status;
+
+static AsyncEventSource events("/events");
+static Status lastSent;
+static bool forceSend = true;
+static unsigned long lastSendMillis = 0;
+static unsigned long lastPollMillis = 0;
+static EventsStats stats;
+static uint32_t polls = 0;
+static uint64_t pollMicrosTotal = 0;
+static uint64_t sendMicrosTotal = 0;
+
+/**
+ * Get the current status of the clock
+ */
+static void getStatus(Status *status) {
+    getDisplayedText(status->display);
+    status->brightness = getDisplayBrightness();
+    status->synced = timeIsSynced();
+    status->wifi = WiFi.isConnected();
+}
+
+/**
+ * Called when a browser connects to /events
+ */
+static void onConnect(AsyncEventSourceClient *client) {
+    if (events.count() > EVENTS_MAX_CLIENTS) {
+        DEBUG("Too many event clients - closing\n")
+        client->close();
+        return;
+    }
+    forceSend = true; // The new client needs to know the current status
+}
+
+/**
+ * Initialise the live status events
+ */
+void initEvents(AsyncWebServer &server) {
+    events.onConnect(onConnect);
+    server.addHandler(&events);
+}
+
+/**
+ * Events polling loop - sends the status to all clients when it changes
+ *
+ * Changes are coalesced so that no client gets more than one event per EVENTS_MIN_INTERVAL_MILLIS,
+ * and nothing is sent while the clients' queues are backed up. Since we always send the latest
+ * status rather than each change, anything skipped is picked up by the next event
+ */
+void eventsPoll() {
+    Status status;
+    char record[64];
+    unsigned long start;
+    if ((millis() - lastPollMillis) < EVENTS_POLL_MILLIS) return;
+    lastPollMillis = millis();
+    if (!events.count()) return;
+    if ((millis() - lastSendMillis) < EVENTS_MIN_INTERVAL_MILLIS) return;
+    start = micros();
+    getStatus(&status);
+    if (!forceSend && !memcmp(&status, &lastSent, sizeof(Status))) {
+        pollMicrosTotal += micros() - start;
+        polls++;
+        return;
+    }
+    if (events.avgPacketsWaiting() >= EVENTS_MAX_QUEUED) {
+        stats.skipped++;
+        return;
+    }
+    // The signal strength goes along with the other changes, but doesn't cause an event by itself
+    snprintf_P(record, sizeof(record), PSTR("{\"d\":\"%s\",\"b\":%u,\"s\":%u,\"w\":%u,\"r\":%d}"),
+        status.display, status.brightness, status.synced, status.wifi, getWiFiRSSI());
+    events.send(record, "status");
+    sendMicrosTotal += micros() - start;
+    stats.sent++;
+    lastSent = status;
+    forceSend = false;
+    lastSendMillis = millis();
+}
+
+/**
+ * What the events have cost since boot
+ */
+void getEventsStats(EventsStats *ans) {
+    *ans = stats;
+    ans->clients = events.count();
+    ans->pollMicros = polls ? pollMicrosTotal / polls : 0;
+    ans->sendMicros = stats.sent ? sendMicrosTotal / stats.sent : 0;
+}
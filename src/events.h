@@ -0,0 +1,18 @@
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+#include <ESPAsyncWebServer.h>
+
+typedef struct EventsStats_t {
+    uint32_t clients;          // Connected now
+    uint32_t sent;             // Events sent, each to every client
+    uint32_t skipped;          // Changes held back because the clients were backed up
+    uint32_t pollMicros;       // Average time for eventsPoll() to check the status, with clients connected
+    uint32_t sendMicros;       // Average time to format an event and queue it for every client
+} EventsStats;
+
+void initEvents(AsyncWebServer &server);
+void eventsPoll();
+void getEventsStats(EventsStats *stats);
+
+#endif
@@ -0,0 +1,248 @@
+// leap.cpp - leap seconds, and what the display does about them
+//
+// The SNTP client doesn't tell us about leap seconds, so every few hours (every half hour on the
+// last day of a month) we ask our NTP server ourselves and look at the leap indicator in its
+// answer. NTP broadcasts carry it too. A warning means the last minute of the month, UTC, has 61
+// (or 59) seconds. The system clock, like any Unix clock, has no second 60, so what happens is up
+// to CFG_LEAP -
+//
+//   LEAP_STEP      the system clock is stepped back at midnight, and the display shows 23:59 for
+//                  the extra second - still ticking once a second
+//   LEAP_SMEAR     the system clock is stepped the same way, but the display runs slow (or fast) by
+//                  1/86400 for the 24 hours around midnight, as Google's and Amazon's servers do,
+//                  so it never moves by a whole second
+//   LEAP_UPSTREAM  nothing is done - the clock follows whatever its NTP server does. Right for a
+//                  smearing server, which never sends a warning. Otherwise the next sync after
+//                  midnight moves the clock by a second, which timekeeping.cpp slews out
+//
+// The stepping and the smear are applied by timekeeping.cpp, through leapStepDue() and
+// getLeapSmearMicros().
+//
+// Ref: RFC 5905 section 7.3, https://developers.google.com/time/smear
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <sntp.h>
+#include <time.h>
+#include "leap.h"
+#include "config.h"
+#include "timekeeping.h"
+#include "syslog.h"
+#include "debug.h"
+
+#define LEAP_NTP_PORT 123
+#define LEAP_NTP_PACKET_SIZE 48
+#define LEAP_CHECK_MILLIS (6UL * 3600UL * 1000UL)
+#define LEAP_LAST_DAY_CHECK_MILLIS (30UL * 60UL * 1000UL)
+#define LEAP_REPLY_TIMEOUT_MILLIS 5000UL
+#define LEAP_SMEAR_HALF_SECONDS 43200L   // The smear runs from noon to noon, UTC
+#define LEAP_IGNORE_SECONDS 86400L       // Warnings from servers that haven't caught up after a leap
+
+static WiFiUDP udp;
+static bool checked = false;
+static bool waiting = false;
+static unsigned long lastCheck = 0;
+static uint8_t nonce[8];                 // Our transmit timestamp - the reply must echo it
+static uint8_t policy = LEAP_STEP;
+static bool policyLoaded = false;
+static uint32_t configGeneration = 0;
+static int8_t pending = 0;               // 1 to insert a second, -1 to remove one
+static time_t leapTime = 0;              // Midnight UTC, when the leap happens
+static time_t smearStart = 0;
+static time_t smearEnd = 0;
+static bool stepped = false;             // Has the system clock been stepped for it?
+static time_t lastLeapTime = 0;
+
+/**
+ * Days from 1970-01-01 to a date
+ *
+ * Ref: http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ */
+static int32_t daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= (month <= 2) ? 1 : 0;
+    int era = year / 400;
+    unsigned yoe = year - era * 400;
+    unsigned doy = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/**
+ * Midnight UTC at the end of this month - when a leap second announced now happens
+ */
+static time_t endOfMonth(time_t now) {
+    struct tm *utc = gmtime(&now);
+    int year = utc->tm_year + 1900 + ((utc->tm_mon == 11) ? 1 : 0);
+    return (time_t)daysFromCivil(year, (utc->tm_mon + 1) % 12 + 1, 1) * 86400;
+}
+
+/**
+ * Is it the last day of a month, UTC?
+ */
+static bool isLastDayOfMonth(time_t now) {
+    now += 86400;
+    return gmtime(&now)->tm_mday == 1;
+}
+
+/**
+ * Called with the leap indicator from each answer or broadcast from an NTP server that has the time
+ */
+void leapIndicatorReceived(uint8_t indicator) {
+    time_t now;
+    time_t half;
+    int8_t direction;
+    if (!timeIsSynced() || stepped || (indicator > 2)) return;
+    now = time(0);
+    if (!indicator) {
+        // Once the smear has started, stopping it would move the display - see it through
+        if (!pending || ((policy == LEAP_SMEAR) && (now >= smearStart))) return;
+        DEBUG("Leap second cancelled\n")
+        logMessage(SYSLOG_NOTICE, "leap", "Leap second cancelled");
+        pending = 0;
+        return;
+    }
+    if (lastLeapTime && (now < lastLeapTime + LEAP_IGNORE_SECONDS)) return;
+    direction = (indicator == 1) ? 1 : -1;
+    if ((pending == direction) && (leapTime == endOfMonth(now))) return;
+    pending = direction;
+    leapTime = endOfMonth(now);
+    // If we hear about it late, the smear is shorter, and steeper
+    half = min((time_t)LEAP_SMEAR_HALF_SECONDS, leapTime - now);
+    smearStart = leapTime - half;
+    smearEnd = leapTime + half;
+    DEBUG("Leap second %d at %lu\n", pending, (unsigned long)leapTime)
+    logMessage(SYSLOG_NOTICE, "leap", "Leap second to be %s at %lu", (pending > 0) ? "inserted" : "removed",
+        (unsigned long)leapTime);
+}
+
+/**
+ * Ask our NTP server for its leap indicator
+ */
+static void sendQuery() {
+    uint8_t packet[LEAP_NTP_PACKET_SIZE];
+    const ip_addr_t *server = sntp_getserver(0);
+    lastCheck = millis();
+    checked = true;
+    if (!server || !ip_addr_get_ip4_u32(server) || !WiFi.isConnected()) return;
+    if (!udp.begin(0)) return; // Any free port
+    memset(packet, 0, sizeof(packet));
+    packet[0] = (0 << 6) | (4 << 3) | 3;                 // No leap warning, version 4, client mode
+    for (uint8_t i = 0 ; i < sizeof(nonce) ; i++) nonce[i] = random(256);
+    memcpy(packet + 40, nonce, sizeof(nonce));
+    if (!udp.beginPacket(IPAddress(ip_addr_get_ip4_u32(server)), LEAP_NTP_PORT)) {
+        udp.stop();
+        return;
+    }
+    udp.write(packet, sizeof(packet));
+    waiting = udp.endPacket();
+    if (!waiting) udp.stop();
+}
+
+/**
+ * Look for the answer to sendQuery()
+ */
+static void readReply() {
+    uint8_t packet[LEAP_NTP_PACKET_SIZE];
+    int size = udp.parsePacket();
+    if (!size) {
+        if ((millis() - lastCheck) >= LEAP_REPLY_TIMEOUT_MILLIS) {
+            DEBUG("No answer to the leap second check\n")
+            udp.stop();
+            waiting = false;
+        }
+        return;
+    }
+    if ((size < LEAP_NTP_PACKET_SIZE) || (udp.read(packet, sizeof(packet)) != sizeof(packet))) return;
+    if (((packet[0] & 7) != 4) || memcmp(packet + 24, nonce, sizeof(nonce))) return;
+    udp.stop();
+    waiting = false;
+    // An unsynchronised server sends 3 in the leap indicator, or stratum 0 (a kiss code)
+    if ((packet[1] > 0) && (packet[1] < 16)) leapIndicatorReceived(packet[0] >> 6);
+}
+
+/**
+ * Leap second polling loop
+ */
+void leapPoll() {
+    time_t now;
+    if (!policyLoaded || (configGeneration != getConfigGeneration())) {
+        policy = getInt8Config(CFG_LEAP, LEAP_STEP);
+        if (policy > LEAP_UPSTREAM) policy = LEAP_STEP;
+        configGeneration = getConfigGeneration();
+        policyLoaded = true;
+    }
+    if (!timeIsSynced()) return;
+    now = time(0);
+    if (pending && (stepped || (policy == LEAP_UPSTREAM)) && (now >= ((policy == LEAP_SMEAR) ? smearEnd : leapTime))) {
+        DEBUG("Leap second over\n")
+        lastLeapTime = leapTime;
+        pending = 0;
+        stepped = false;
+    }
+    if (waiting) {
+        readReply();
+    } else if (!checked || ((millis() - lastCheck) >= (isLastDayOfMonth(now) ? LEAP_LAST_DAY_CHECK_MILLIS : LEAP_CHECK_MILLIS))) {
+        sendQuery();
+    }
+}
+
+uint8_t getLeapPolicy() {
+    return policy;
+}
+
+/**
+ * The leap second coming up - 1 for an extra second, -1 for one fewer, 0 for none
+ */
+int8_t getLeapPending() {
+    return pending;
+}
+
+/**
+ * The leap indicator for NTP packets we send - 1 or 2 before a leap, 0 otherwise
+ */
+uint8_t getLeapIndicator() {
+    return (pending && !stepped) ? ((pending > 0) ? 1 : 2) : 0;
+}
+
+/**
+ * Should the system clock be stepped for a leap second now? Returns the seconds to take off it (1
+ * or -1), or 0. Called by timekeepingPoll(), which then steps it
+ */
+int8_t leapStepDue(time_t now) {
+    // A removed second is 23:59:59 - the clock goes straight from 23:59:58 to midnight
+    if (!pending || stepped || (policy == LEAP_UPSTREAM) || (now < leapTime - ((pending < 0) ? 1 : 0))) return 0;
+    stepped = true;
+    logMessage(SYSLOG_NOTICE, "leap", "Leap second %s", (pending > 0) ? "inserted" : "removed");
+    return pending;
+}
+
+/**
+ * The system clock has just been set, moving it by offsetMicros. Was that our NTP server putting in
+ * the leap second, before leapStepDue() got to it? If so, it counts as the step
+ */
+bool leapStepTaken(int64_t offsetMicros, time_t now) {
+    int64_t error = offsetMicros + pending * 1000000LL;
+    if (!pending || stepped || (policy == LEAP_UPSTREAM)) return false;
+    if ((now < leapTime - 2) || (now > leapTime + 2) || (error > 500000LL) || (error < -500000LL)) return false;
+    stepped = true;
+    logMessage(SYSLOG_NOTICE, "leap", "Leap second %s by the NTP server", (pending > 0) ? "inserted" : "removed");
+    return true;
+}
+
+/**
+ * With LEAP_SMEAR, what to add to the system clock, in microseconds, to get the time to show
+ *
+ * Over the smear the displayed time runs at (length - leap) / length of real time, so it has lost
+ * (or gained) half a second at midnight, when the system clock is stepped by a whole one, and is
+ * back with the system clock at the end
+ */
+int32_t getLeapSmearMicros(const struct timeval &now) {
+    int64_t elapsed;
+    int64_t length;
+    if (!pending || (policy != LEAP_SMEAR) || (now.tv_sec < smearStart)) return 0;
+    // Real time since the smear started - once stepped, the system clock is a second out from that
+    elapsed = (int64_t)(now.tv_sec - smearStart) * 1000000LL + now.tv_usec + (stepped ? pending * 1000000LL : 0);
+    length = smearEnd - smearStart + pending;
+    if (elapsed >= length * 1000000LL) return 0;
+    return stepped ? pending * (1000000LL - elapsed / length) : -pending * (elapsed / length);
+}
@@ -0,0 +1,21 @@
+#ifndef _LEAP_H_
+#define _LEAP_H_
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+// What to do about a leap second - CFG_LEAP
+#define LEAP_STEP 0        // Show 23:59 for one more (or one less) second at midnight UTC
+#define LEAP_SMEAR 1       // Spread the second over the 24 hours around midnight UTC
+#define LEAP_UPSTREAM 2    // Leave it to the NTP server - e.g. one that smears it itself
+
+void leapPoll();
+void leapIndicatorReceived(uint8_t indicator);
+uint8_t getLeapPolicy();
+int8_t getLeapPending();
+uint8_t getLeapIndicator();
+int8_t leapStepDue(time_t now);
+bool leapStepTaken(int64_t offsetMicros, time_t now);
+int32_t getLeapSmearMicros(const struct timeval &now);
+
+#endif
@@ -5,6 +5,8 @@
 
 #define LED_PIN 2
 
+static bool ledOn = false;
+
 /**
  * Initialise the LED on the back of the display
  */
@@ -18,6 +20,7 @@ void initRedLED() {
  */
 void setRedLEDOn() {
   digitalWrite(LED_PIN, LOW); // active low
+  ledOn = true;
 }
 
 /**
@@ -25,4 +28,12 @@ void setRedLEDOn() {
  */
 void setRedLEDOff() {
   digitalWrite(LED_PIN, HIGH); // active low
+  ledOn = false;
+}
+
+/**
+ * Is the LED on the back of the display on?
+ */
+bool redLEDIsOn() {
+  return ledOn;
 }
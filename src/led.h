@@ -5,5 +5,6 @@
 void initRedLED();
 void setRedLEDOn();
 void setRedLEDOff();
+bool redLEDIsOn();
 
 #endif
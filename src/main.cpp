@@ -9,21 +9,45 @@
 #include "wifi.h"
 #include "debug.h"
 #include "ota.h"
+#include "discovery.h"
+#include "events.h"
+#include "brightness.h"
+#include "commands.h"
+#include "ntpserver.h"
+#include "ntpdns.h"
+#include "bench.h"
+#include "alarms.h"
+#include "timer.h"
+#include "syslog.h"
+#include "mqtt.h"
+#include "stats.h"
+#include "leap.h"
+#include "power.h"
+#include "version.h"
 
 // Callback for when the "UP" button is pressed
 void upPressedCB() {
-  setDisplayBrightness(getDisplayBrightness()+1);
-  setInt8Config(CFG_DEFAULT_BRIGHTNESS, getDisplayBrightness());
+  if (timerIsActive()) {
+    timerUpPressed();
+    return;
+  }
+  setBrightness(getDisplayBrightness()+1);
 }
 
 // Callback for when the "DOWN" button is pressed
 void downPressedCB() {
-  setDisplayBrightness(getDisplayBrightness()-1);
-  setInt8Config(CFG_DEFAULT_BRIGHTNESS, getDisplayBrightness());
+  if (timerIsActive()) {
+    timerDownPressed();
+    return;
+  }
+  setBrightness(getDisplayBrightness()-1);
 }
 
 // Callback for when the "SET" button is pressed
-void setPressedCB() {}
+void setPressedCB() {
+  if (acknowledgeAlarm()) return;
+  setTimerMode((getTimerMode() + 1) % 3); // Time, stopwatch, countdown
+}
 
 void setup() {
 #ifdef DEBUGGING
@@ -34,21 +58,43 @@ void setup() {
   initRedLED();
   DEBUG("Init Config\n")
   initConfig();
+  DEBUG("Init statistics\n")
+  initStats();
   DEBUG("Init buttons\n")
   buttonSetup();
   if (buttonPressed(DOWN_BUTTON_PIN)) resetConfig();
   DEBUG("Init display\n")
   initDisplay(getInt8Config(CFG_DEFAULT_BRIGHTNESS, LED_DEFAULT_BRIGHTNESS));
-  setLEDSegments(LED_CHAR_b, LED_CHAR_o, LED_CHAR_o, LED_CHAR_t);
+  showText("boot");
+  initBrightnessSchedule();
+  initNTPAddressCache();
   DEBUG("Init WiFi\n")
   initWiFi();
   DEBUG("Init Webserver\n")
   initWebserver();
+  logMessage(SYSLOG_NOTICE, "boot", "Version " FIRMWARE_VERSION ", reset reason: %s", ESP.getResetReason().c_str());
+  mqttEvent("boot", ESP.getResetReason().c_str());
 }
 
 void loop() {
+  commandPoll();
+  wifiPoll();
+  displayPoll();
+  timerPoll();
   timekeepingPoll(); // This will initialise the timekeeping if/when we have a WiFi connection
+  leapPoll();
+  benchPoll();
+  alarmPoll();
   buttonScan();
   otaPoll();
-  delay(10);
+  discoveryPoll();
+  eventsPoll();
+  brightnessPoll();
+  ntpServerPoll();
+  ntpAddressPoll();
+  syslogPoll();
+  mqttPoll();
+  statsPoll();
+  powerPoll();
+  powerSleep(); // Until the display next changes, unless something needs loop() sooner
 }
@@ -0,0 +1,394 @@
+// mqtt.cpp - publish the clock's state to an MQTT broker, and take commands from it
+//
+// With a broker set in CFG_MQTT_BROKER, the clock publishes under "303clock/<hostname>/" -
+//
+//   status  "online", or "offline" as its will (retained)
+//   state   JSON - whether the time is synced, the last NTP offset, RSSI, free heap, brightness (retained)
+//   event   JSON - restarts, alarms, configuration changes
+//
+// and takes commands published to "303clock/<hostname>/set/brightness" (0 .. 7), ".../set/restart",
+// and ".../set/config" (form parameters, as for POST /config). Retained commands are ignored, so a
+// stale one can't restart the clock over and over.
+//
+// State changes are coalesced - state is published at most every few seconds, with whatever it is
+// by then. Events wait in a small queue while we are offline, QoS 1 ones until the broker has
+// acknowledged them, and the oldest are dropped if it fills. Reconnection attempts back off, with
+// each wait chosen at random so a fleet of clocks doesn't reconnect all at once when a broker
+// comes back. Nothing is sent in the last part of each second, so the display's tick is never
+// held up.
+//
+// The client's callbacks run in the network stack's context, so, like the web server, they only
+// set flags or queue commands for loop()
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <AsyncMqttClient.h>
+#include <time.h>
+#include "mqtt.h"
+#include "commands.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "debug.h"
+
+#define MQTT_QUEUE_SIZE 8                    // Events held for sending - must be a power of 2
+#define MQTT_EVENT_LENGTH 96
+#define MQTT_TOPIC_LENGTH 64
+#define MQTT_HOST_MAX_LENGTH 64
+#define MQTT_KEEPALIVE_SECONDS 60
+// Each wait before reconnecting is chosen at random between half and all of the backoff, which
+// doubles after each failure
+#define MQTT_BACKOFF_MIN_MILLIS 2000UL
+#define MQTT_BACKOFF_MAX_MILLIS 300000UL
+#define MQTT_STABLE_MILLIS 60000UL           // Connected this long, the backoff starts again from the minimum
+#define MQTT_CONNECT_TIMEOUT_MILLIS 30000UL
+#define MQTT_FIRST_CONNECT_MILLIS 5000UL     // The first connection is spread over this long after WiFi comes up
+// State is published at most every MQTT_STATE_MIN_MILLIS, and at least every MQTT_STATE_MAX_MILLIS
+#define MQTT_STATE_MIN_MILLIS 5000UL
+#define MQTT_STATE_MAX_MILLIS 60000UL
+#define MQTT_STATE_CHECK_MILLIS 1000UL
+#define MQTT_RSSI_CHANGE 5                   // Smaller changes than these aren't worth publishing
+#define MQTT_HEAP_CHANGE 1024
+#define MQTT_MAX_PER_POLL 2
+#define MQTT_TICK_WINDOW_MILLIS 800UL        // How far into each second we may send
+#define MQTT_MAX_COMMAND_LENGTH 1024
+
+typedef struct MqttState_t {
+  bool synced;
+  int32_t offset;
+  int8_t rssi;
+  uint32_t heap;
+  uint8_t brightness;
+} MqttState;
+
+typedef struct MqttEvent_t {
+  uint8_t qos;
+  bool sent;
+  volatile bool acked;
+  uint16_t packetId;                         // Kept from the first attempt, for resending QoS 1
+  char payload[MQTT_EVENT_LENGTH];
+} MqttEvent;
+
+static AsyncMqttClient client;
+static MqttEvent events[MQTT_QUEUE_SIZE];
+static uint8_t head = 0;                     // Next event to write
+static uint8_t tail = 0;                     // Oldest event not yet done with
+static MqttStats stats;
+// The broker and our topics, worked out again whenever the configuration changes. The client
+// keeps pointers to these
+static bool configured = false;
+static uint32_t configGeneration = 0;
+static char host[MQTT_HOST_MAX_LENGTH];
+static char clientId[32];
+static char baseTopic[MQTT_TOPIC_LENGTH];
+static char statusTopic[MQTT_TOPIC_LENGTH];
+// Connection state
+static volatile bool connectedFlag = false;  // Set by the callbacks, handled by mqttPoll()
+static volatile bool disconnectedFlag = false;
+static bool connecting = false;
+static bool wasOnline = false;
+static unsigned long connectStartedAt = 0;
+static unsigned long connectedAt = 0;
+static unsigned long nextAttemptAt = 0;
+static unsigned long backoffMillis = MQTT_BACKOFF_MIN_MILLIS;
+// Published state
+static MqttState lastState;
+static MqttState publishedState;
+static bool statePublished = false;
+static uint16_t stateChanges = 0;            // Since the state was last published
+static unsigned long lastStateCheck = 0;
+static unsigned long lastStatePublish = 0;
+static String command;                       // Command payload, which may arrive in pieces
+
+/**
+ * Queue an event to be published to ".../event". Must be called from loop()
+ */
+void mqttEvent(const char *name, const char *detail, uint8_t qos) {
+  MqttEvent *event;
+  if (!host[0] && configured) return;
+  if ((uint8_t)(head - tail) >= MQTT_QUEUE_SIZE) {
+    tail++; // Drop the oldest
+    stats.dropped++;
+  }
+  event = &events[head & (MQTT_QUEUE_SIZE - 1)];
+  event->qos = qos;
+  event->sent = false;
+  event->acked = false;
+  event->packetId = 0;
+  snprintf_P(event->payload, MQTT_EVENT_LENGTH, PSTR("{\"event\":\"%s\",\"detail\":\"%s\",\"time\":%ld}"),
+    name, detail, timeIsSynced() ? (long)time(0) : 0L);
+  head++;
+}
+
+/**
+ * Undo the URL encoding of a form parameter
+ */
+static String urlDecode(const String &encoded) {
+  String decoded;
+  decoded.reserve(encoded.length());
+  for (unsigned int i = 0 ; i < encoded.length() ; i++) {
+    char c = encoded.charAt(i);
+    if ((c == '%') && (i + 2 < encoded.length())) {
+      c = (char)strtol(encoded.substring(i + 1, i + 3).c_str(), 0, 16);
+      i += 2;
+    } else if (c == '+') {
+      c = ' ';
+    }
+    decoded.concat(c);
+  }
+  return decoded;
+}
+
+/**
+ * Split form parameters, "name=value&name=value ..."
+ */
+static CommandParams *parseForm(const String &form) {
+  CommandParams *params = new CommandParams();
+  int start = 0;
+  while (start < (int)form.length()) {
+    int end = form.indexOf('&', start);
+    int equals = form.indexOf('=', start);
+    if (end < 0) end = form.length();
+    if ((equals < 0) || (equals > end)) equals = end;
+    if (!params->add(urlDecode(form.substring(start, equals)),
+        urlDecode((equals < end) ? form.substring(equals + 1, end) : String()))) break;
+    start = end + 1;
+  }
+  return params;
+}
+
+static void onConnect(bool sessionPresent) {
+  connectedFlag = true;
+}
+
+static void onDisconnect(AsyncMqttClientDisconnectReason reason) {
+  DEBUG("MQTT disconnected - reason %u\n", (uint8_t)reason)
+  disconnectedFlag = true;
+}
+
+/**
+ * The broker has acknowledged a QoS 1 event
+ */
+static void onPublish(uint16_t packetId) {
+  for (uint8_t i = tail ; i != head ; i++) {
+    MqttEvent &event = events[i & (MQTT_QUEUE_SIZE - 1)];
+    if (event.sent && (event.packetId == packetId)) event.acked = true;
+  }
+}
+
+/**
+ * A command has arrived, or part of one
+ */
+static void onMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties,
+    size_t len, size_t index, size_t total) {
+  const char *name = strrchr(topic, '/');
+  if (properties.retain || !name || (total > MQTT_MAX_COMMAND_LENGTH)) return;
+  if (index == 0) command = String();
+  for (size_t i = 0 ; i < len ; i++) command.concat(payload[i]);
+  if (index + len < total) return;
+  name++;
+  DEBUG("MQTT command %s: %s\n", name, command.c_str())
+  if (!strcmp(name, "brightness")) {
+    queueCommand(COMMAND_SET_BRIGHTNESS, constrain(command.toInt(), 0, 7));
+  } else if (!strcmp(name, "restart")) {
+    queueCommand(COMMAND_RESTART);
+  } else if (!strcmp(name, "config")) {
+    CommandParams *params = parseForm(command);
+    bool restart = params->has("restart");
+    if (queueCommand(COMMAND_APPLY_CONFIG, 0, params) && restart) queueCommand(COMMAND_RESTART);
+  }
+}
+
+/**
+ * Pick up the broker from the stored configuration - "host" or "host:port"
+ */
+static void configure() {
+  String value = getStringConfig(CFG_MQTT_BROKER);
+  String hostname = getStringConfig(CFG_HOSTNAME, String("303Clock"));
+  uint16_t port = MQTT_DEFAULT_PORT;
+  int colon = value.indexOf(':');
+  if (!configured) {
+    client.onConnect(onConnect);
+    client.onDisconnect(onDisconnect);
+    client.onPublish(onPublish);
+    client.onMessage(onMessage);
+  }
+  if (client.connected() || connecting) client.disconnect(true);
+  connecting = false;
+  configGeneration = getConfigGeneration();
+  configured = true;
+  if (colon >= 0) {
+    port = value.substring(colon + 1).toInt();
+    value.remove(colon);
+  }
+  strncpy(host, value.c_str(), MQTT_HOST_MAX_LENGTH - 1);
+  host[MQTT_HOST_MAX_LENGTH - 1] = 0;
+  snprintf(clientId, sizeof(clientId), "%s-%06x", hostname.c_str(), ESP.getChipId());
+  snprintf(baseTopic, sizeof(baseTopic), "303clock/%s/", hostname.c_str());
+  snprintf(statusTopic, sizeof(statusTopic), "%sstatus", baseTopic);
+  client.setServer(host, port);
+  client.setClientId(clientId);
+  client.setKeepAlive(MQTT_KEEPALIVE_SECONDS);
+  client.setWill(statusTopic, 1, true, "offline");
+  statePublished = false;
+}
+
+/**
+ * Publish to a topic under ours. Returns 0 if the client has no room for it just now
+ */
+static uint16_t publish(const char *subtopic, uint8_t qos, bool retain, const char *payload,
+    bool dup = false, uint16_t packetId = 0) {
+  char topic[MQTT_TOPIC_LENGTH];
+  snprintf(topic, sizeof(topic), "%s%s", baseTopic, subtopic);
+  return client.publish(topic, qos, retain, payload, 0, dup, packetId);
+}
+
+/**
+ * We have just connected to the broker
+ */
+static void connected() {
+  char topic[MQTT_TOPIC_LENGTH];
+  DEBUG("MQTT connected to %s\n", host)
+  connecting = false;
+  connectedAt = millis();
+  stats.connects++;
+  snprintf(topic, sizeof(topic), "%sset/+", baseTopic);
+  client.subscribe(topic, 1);
+  client.publish(statusTopic, 1, true, "online");
+  statePublished = false; // Publish it again, in case it changed while we were away
+}
+
+/**
+ * We have lost the broker, or failed to connect to it. Wait before trying again
+ */
+static void disconnected() {
+  unsigned long wait;
+  connecting = false;
+  // QoS 1 events not yet acknowledged are sent again
+  for (uint8_t i = tail ; i != head ; i++) {
+    MqttEvent &event = events[i & (MQTT_QUEUE_SIZE - 1)];
+    if (event.qos && !event.acked) event.sent = false;
+  }
+  if (connectedAt && ((millis() - connectedAt) >= MQTT_STABLE_MILLIS)) backoffMillis = MQTT_BACKOFF_MIN_MILLIS;
+  connectedAt = 0;
+  wait = backoffMillis / 2 + random(backoffMillis / 2 + 1);
+  nextAttemptAt = millis() + wait;
+  backoffMillis = min(backoffMillis * 2, MQTT_BACKOFF_MAX_MILLIS);
+  DEBUG("MQTT reconnecting in %lu ms\n", wait)
+}
+
+static void sampleState(MqttState *state) {
+  state->synced = timeIsSynced();
+  state->offset = getLastSyncOffset();
+  state->rssi = WiFi.RSSI();
+  state->heap = ESP.getFreeHeap();
+  state->brightness = getDisplayBrightness();
+}
+
+/**
+ * Are two samples different enough to be worth publishing?
+ */
+static bool stateChanged(const MqttState &a, const MqttState &b) {
+  return (a.synced != b.synced) || (a.offset != b.offset) || (a.brightness != b.brightness)
+    || (abs(a.rssi - b.rssi) >= MQTT_RSSI_CHANGE) || (abs((int32_t)(a.heap - b.heap)) >= MQTT_HEAP_CHANGE);
+}
+
+/**
+ * Publish the state if it has changed, or hasn't been published for a while. Returns false if the
+ * client has no room for it just now
+ */
+static bool publishState() {
+  MqttState state;
+  char payload[128];
+  if (!statePublished || ((millis() - lastStateCheck) >= MQTT_STATE_CHECK_MILLIS)) {
+    lastStateCheck = millis();
+    sampleState(&state);
+    if (stateChanged(state, lastState)) stateChanges++;
+    lastState = state;
+  }
+  if (statePublished) {
+    if ((millis() - lastStatePublish) < MQTT_STATE_MIN_MILLIS) return true;
+    if (!stateChanged(lastState, publishedState) && ((millis() - lastStatePublish) < MQTT_STATE_MAX_MILLIS)) return true;
+  }
+  snprintf_P(payload, sizeof(payload), PSTR("{\"synced\":%s,\"offset\":%d,\"syncAge\":%lu,\"rssi\":%d,\"heap\":%u,\"brightness\":%u,\"uptime\":%lu}"),
+    lastState.synced ? "true" : "false", lastState.offset, lastState.synced ? millisSinceSync() / 1000 : 0UL,
+    lastState.rssi, lastState.heap, lastState.brightness, millis() / 1000);
+  if (!publish("state", 0, true, payload)) return false;
+  if (stateChanges > 1) stats.coalesced += stateChanges - 1;
+  stateChanges = 0;
+  publishedState = lastState;
+  statePublished = true;
+  lastStatePublish = millis();
+  stats.published++;
+  return true;
+}
+
+/**
+ * MQTT polling loop
+ */
+void mqttPoll() {
+  uint8_t budget = MQTT_MAX_PER_POLL;
+  if (!configured || (configGeneration != getConfigGeneration())) configure();
+  if (!host[0]) {
+    tail = head; // Nowhere to send them
+    return;
+  }
+  if (connectedFlag) {
+    connectedFlag = false;
+    connected();
+  }
+  if (disconnectedFlag) {
+    disconnectedFlag = false;
+    disconnected();
+  }
+  if (!client.connected()) {
+    if (!WiFi.isConnected()) {
+      wasOnline = false;
+      return;
+    }
+    if (!wasOnline) {
+      // Spread the first attempt, so clocks that were waiting for WiFi don't all connect at once
+      wasOnline = true;
+      nextAttemptAt = millis() + random(MQTT_FIRST_CONNECT_MILLIS);
+    }
+    if (connecting && ((millis() - connectStartedAt) >= MQTT_CONNECT_TIMEOUT_MILLIS)) {
+      client.disconnect(true);
+      disconnected();
+    }
+    if (!connecting && ((long)(millis() - nextAttemptAt) >= 0)) {
+      DEBUG("MQTT connecting to %s\n", host)
+      connecting = true;
+      connectStartedAt = millis();
+      client.connect();
+    }
+    return;
+  }
+  if (timeIsSynced() && (millisSinceTick() >= MQTT_TICK_WINDOW_MILLIS)) return;
+  // Events first, oldest first
+  for (uint8_t i = tail ; (i != head) && budget ; i++) {
+    MqttEvent &event = events[i & (MQTT_QUEUE_SIZE - 1)];
+    uint16_t packetId;
+    if (event.sent) continue;
+    packetId = publish("event", event.qos, false, event.payload, event.packetId != 0, event.packetId);
+    if (!packetId) return;
+    if (event.qos) event.packetId = packetId;
+    event.sent = true;
+    stats.published++;
+    budget--;
+  }
+  while ((tail != head) && events[tail & (MQTT_QUEUE_SIZE - 1)].sent
+      && (!events[tail & (MQTT_QUEUE_SIZE - 1)].qos || events[tail & (MQTT_QUEUE_SIZE - 1)].acked)) tail++;
+  if (budget) publishState();
+}
+
+bool mqttConnected() {
+  return client.connected();
+}
+
+/**
+ * How many connections and messages there have been since boot
+ */
+void getMqttStats(MqttStats *ans) {
+  *ans = stats;
+  ans->queued = head - tail;
+}
@@ -0,0 +1,21 @@
+#ifndef _MQTT_H_
+#define _MQTT_H_
+
+#include <Arduino.h>
+
+#define MQTT_DEFAULT_PORT 1883
+
+typedef struct MqttStats_t {
+  uint32_t connects;
+  uint32_t published;        // Messages handed to the broker
+  uint32_t coalesced;        // State changes folded into a later publish
+  uint32_t dropped;          // Events lost because the offline queue was full
+  uint8_t queued;            // Events waiting to be sent or acknowledged
+} MqttStats;
+
+void mqttEvent(const char *name, const char *detail, uint8_t qos = 1);
+void mqttPoll();
+bool mqttConnected();
+void getMqttStats(MqttStats *stats);
+
+#endif
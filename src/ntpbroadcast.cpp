@@ -0,0 +1,158 @@
+// ntpbroadcast.cpp - keep time from NTP broadcasts on the local network, instead of polling servers
+//
+// Once the normal (unicast) SNTP client has the time, we wait for the first broadcast (or 224.0.1.1
+// multicast) packet, measure the round trip to the server that sent it with one client/server
+// exchange, then stop the unicast client and set the clock from that server's broadcasts, allowing
+// for half of the round trip. Broadcasts from any other address are ignored. If the broadcasts stop,
+// the unicast client is started up again.
+//
+// Ref: RFC 5905 section 8 and RFC 4330 section 5
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <sntp.h>
+#include <sys/time.h>
+#include "ntpbroadcast.h"
+#include "ntpserver.h"
+#include "config.h"
+#include "timekeeping.h"
+#include "leap.h"
+#include "debug.h"
+
+// Give up on broadcasts, and go back to polling, if none have arrived for this long
+#define NTP_BROADCAST_TIMEOUT_MILLIS (10UL * 60UL * 1000UL)
+// How long to wait for the answer to the round trip measurement
+#define NTP_CALIBRATION_TIMEOUT_MILLIS 5000UL
+// Offsets smaller than this are left alone, so the displayed seconds don't jitter
+#define NTP_BROADCAST_STEP_MICROS 20000L
+
+#define STATE_OFF 0            // Not enabled, or the unicast client has not got the time yet
+#define STATE_WAITING 1        // Waiting for the first broadcast, to find its server
+#define STATE_CALIBRATING 2    // Measuring the round trip to the broadcast server
+#define STATE_LISTENING 3      // Keeping time from its broadcasts
+#define STATE_FALLBACK 4       // Broadcasts stopped - the unicast client is running again
+
+static uint8_t state = STATE_OFF;
+static IPAddress broadcastServer;     // The server we calibrated against, and the only one we listen to
+static struct timeval calibrationSent;
+static unsigned long calibrationSentMillis = 0;
+static unsigned long lastBroadcastMillis = 0;
+static unsigned long fallbackMillis = 0;
+static int32_t oneWayDelayMicros = 0;
+
+/**
+ * Read an NTP timestamp from a packet, as a Unix time in microseconds
+ */
+static int64_t getTimestampMicros(const uint8_t *p) {
+    uint32_t seconds = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    uint32_t fraction = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    return (int64_t)(seconds - NTP_UNIX_OFFSET) * 1000000LL + (((uint64_t)fraction * 1000000ULL) >> 32);
+}
+
+/**
+ * A timeval as microseconds
+ */
+static int64_t toMicros(const struct timeval &tv) {
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/**
+ * Does a packet come from a server that has the time?
+ */
+static bool isSynchronised(const uint8_t *packet) {
+    return ((packet[0] >> 6) != 3) && (packet[1] > 0) && (packet[1] < 16);
+}
+
+/**
+ * Start the unicast SNTP client again
+ */
+static void fallBack() {
+    DEBUG("No NTP broadcasts - going back to polling servers\n")
+    sntp_init();
+    fallbackMillis = millis();
+    state = STATE_FALLBACK;
+}
+
+/**
+ * Called with each NTP server (mode 4) or broadcast (mode 5) packet received
+ */
+void ntpBroadcastReceived(const uint8_t *packet, const struct timeval &received, const IPAddress &from) {
+    uint8_t mode = packet[0] & 7;
+    if (!isSynchronised(packet)) return;
+    if ((mode == 5) && (state == STATE_WAITING)) {
+        // The round trip has to be to the server whose broadcasts we will be using, not to the
+        // (probably much further away) unicast one
+        if (sendNTPRequest(from, &calibrationSent)) {
+            broadcastServer = from;
+            calibrationSentMillis = millis();
+            state = STATE_CALIBRATING;
+            DEBUG("NTP broadcast from %s - measuring the round trip\n", from.toString().c_str())
+        }
+    } else if ((mode == 4) && (state == STATE_CALIBRATING) && (from == broadcastServer)) {
+        // Our round trip measurement - check it is the answer to what we sent
+        int64_t t1 = toMicros(calibrationSent);
+        int64_t originate = getTimestampMicros(packet + 24);
+        int64_t t2 = getTimestampMicros(packet + 32);
+        int64_t t3 = getTimestampMicros(packet + 40);
+        int64_t t4 = toMicros(received);
+        int64_t delay;
+        if ((originate < t1 - 1) || (originate > t1 + 1)) return; // Allow for rounding through the NTP fraction
+        delay = (t4 - t1) - (t3 - t2);
+        oneWayDelayMicros = (delay > 0) ? (int32_t)(delay / 2) : 0;
+        leapIndicatorReceived(packet[0] >> 6);
+        DEBUG("NTP round trip %ld us - now listening for broadcasts\n", (long)delay)
+        sntp_stop();
+        lastBroadcastMillis = millis();
+        state = STATE_LISTENING;
+    } else if ((mode == 5) && (state == STATE_LISTENING) && (from == broadcastServer)) {
+        int64_t offset = getTimestampMicros(packet + 40) + oneWayDelayMicros - toMicros(received);
+        lastBroadcastMillis = millis();
+        leapIndicatorReceived(packet[0] >> 6);
+        if ((offset > NTP_BROADCAST_STEP_MICROS) || (offset < -NTP_BROADCAST_STEP_MICROS)) {
+            struct timeval now;
+            int64_t corrected;
+            gettimeofday(&now, 0);
+            corrected = toMicros(now) + offset;
+            now.tv_sec = corrected / 1000000LL;
+            now.tv_usec = corrected % 1000000LL;
+            DEBUG("NTP broadcast - stepping by %ld us\n", (long)offset)
+            settimeofday(&now, 0);
+        }
+        noteTimeSync();
+    }
+}
+
+/**
+ * NTP broadcast polling loop - called by ntpServerPoll()
+ */
+void ntpBroadcastPoll() {
+    if (!cfgBitIsSet(CFG_MASK_NTP_BROADCAST)) {
+        if (state == STATE_LISTENING) sntp_init();
+        state = STATE_OFF;
+        return;
+    }
+    switch (state) {
+        case STATE_OFF:
+            if (timeIsSynced()) state = STATE_WAITING;
+            break;
+        case STATE_CALIBRATING:
+            // Try again with the next broadcast - from whichever server sends it
+            if ((millis() - calibrationSentMillis) >= NTP_CALIBRATION_TIMEOUT_MILLIS) state = STATE_WAITING;
+            break;
+        case STATE_LISTENING:
+            if ((millis() - lastBroadcastMillis) >= NTP_BROADCAST_TIMEOUT_MILLIS) fallBack();
+            break;
+        case STATE_FALLBACK:
+            // Once the unicast client has synced again, measure the round trip again and go back to listening
+            if (millisSinceSync() < (millis() - fallbackMillis)) state = STATE_OFF;
+            break;
+        default: ;
+    }
+}
+
+/**
+ * Are we keeping time from broadcasts?
+ */
+bool ntpBroadcastListening() {
+    return state == STATE_LISTENING;
+}
@@ -0,0 +1,11 @@
+#ifndef _NTPBROADCAST_H_
+#define _NTPBROADCAST_H_
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+void ntpBroadcastPoll();
+void ntpBroadcastReceived(const uint8_t *packet, const struct timeval &received, const IPAddress &from);
+bool ntpBroadcastListening();
+
+#endif
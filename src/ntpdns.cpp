@@ -0,0 +1,163 @@
+// ntpdns.cpp - remember the addresses of the NTP servers, so we don't have to look them up after a restart
+//
+// The addresses are kept in RTC memory, which survives a restart (but not a power cut). The SNTP
+// client is given the remembered addresses straight away, and the names are looked up again as
+// soon as DHCP gives us an address. After that they are looked up every few minutes - lwIP's own
+// DNS table answers those without a query until the record's TTL runs out.
+//
+// Each address is kept with its age, saved every minute, and isn't used once it is more than
+// NTP_DNS_MAX_AGE_MILLIS old - if the names can't be looked up for that long, the SNTP client goes
+// back to the names. The time the clock was down for isn't counted: a restart takes a few seconds,
+// and a power cut clears the RTC memory anyway.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+#include <lwip/dns.h>
+#include <sntp.h>
+#include "ntpdns.h"
+#include "config.h"
+#include "debug.h"
+
+// The core keeps its OTA command in the first 128 bytes of the user RTC memory
+#define NTP_DNS_RTC_OFFSET 32          // In 4 byte blocks
+#define NTP_DNS_MAGIC 0x4e545032UL     // "NTP2"
+#define NTP_DNS_REFRESH_MILLIS (10UL * 60UL * 1000UL)
+#define NTP_DNS_MAX_AGE_MILLIS (60UL * 60UL * 1000UL)
+#define NTP_DNS_SAVE_MILLIS 60000UL    // How often the ages are saved - RTC memory doesn't wear
+#define NTP_SERVER_NAME_MAX_LENGTH 64
+
+typedef struct NTPAddressCache_t {
+    uint32_t magic;
+    uint32_t crc;                          // Of the rest of the structure
+    uint32_t nameCRC[NTP_SERVER_COUNT];    // So addresses are forgotten when the names are changed
+    uint32_t address[NTP_SERVER_COUNT];    // In network order, 0 if unknown
+    uint32_t ageSeconds[NTP_SERVER_COUNT]; // Since each was looked up, when the cache was saved
+} NTPAddressCache;
+
+static const char *serverTags[NTP_SERVER_COUNT] = { CFG_NTP_SERVER_1, CFG_NTP_SERVER_2, CFG_NTP_SERVER_3 };
+static char serverNames[NTP_SERVER_COUNT][NTP_SERVER_NAME_MAX_LENGTH];
+static NTPAddressCache cache;
+static WiFiEventHandler gotIPHandler;
+static bool sntpUsingCache = false;     // Whether useCachedNTPAddresses() has been called
+static bool restored = false;           // Whether any addresses were remembered from before a restart
+static volatile bool cacheChanged = false;
+static unsigned long lastRefresh = 0;
+static unsigned long lastSave = 0;
+static unsigned long resolvedAt[NTP_SERVER_COUNT]; // millis() when each address was last looked up
+
+/**
+ * The checksum stored with the cache
+ */
+static uint32_t cacheCRC() {
+    return crc32(cache.nameCRC, sizeof(cache) - offsetof(NTPAddressCache, nameCRC));
+}
+
+/**
+ * Point the SNTP client at an address rather than a name
+ */
+static void setSNTPAddress(uint8_t index) {
+    ip_addr_t address;
+    ip_addr_set_ip4_u32(&address, cache.address[index]);
+    sntp_setservername(index, 0);
+    sntp_setserver(index, &address);
+}
+
+/**
+ * Called by lwIP when a name has been looked up
+ */
+static void foundCB(const char *name, const ip_addr_t *address, void *arg) {
+    uint8_t index = (uint8_t)(uintptr_t)arg;
+    uint32_t value;
+    if (!address || !IP_IS_V4(address)) return;
+    value = ip_addr_get_ip4_u32(address);
+    resolvedAt[index] = millis();
+    if (value == cache.address[index]) return;
+    DEBUG("NTP server %s is now %s\n", name, IPAddress(value).toString().c_str())
+    cache.address[index] = value;
+    cacheChanged = true;
+    if (sntpUsingCache) setSNTPAddress(index);
+}
+
+/**
+ * Look up all the NTP server names. Names in lwIP's table are answered at once
+ */
+static void resolveAll() {
+    lastRefresh = millis();
+    for (uint8_t i = 0 ; i < NTP_SERVER_COUNT ; i++) {
+        ip_addr_t address;
+        if (!serverNames[i][0]) continue;
+        if (dns_gethostbyname(serverNames[i], &address, foundCB, (void *)(uintptr_t)i) == ERR_OK) {
+            foundCB(serverNames[i], &address, (void *)(uintptr_t)i);
+        }
+    }
+}
+
+/**
+ * Initialise the NTP address cache, which must be done before the wifi is started
+ */
+void initNTPAddressCache() {
+    NTPAddressCache stored;
+    bool valid = ESP.rtcUserMemoryRead(NTP_DNS_RTC_OFFSET, (uint32_t *)&stored, sizeof(stored));
+    cache = stored;
+    valid = valid && (stored.magic == NTP_DNS_MAGIC) && (stored.crc == cacheCRC());
+    if (!valid) memset(&cache, 0, sizeof(cache));
+    for (uint8_t i = 0 ; i < NTP_SERVER_COUNT ; i++) {
+        String name = getStringConfig(serverTags[i]);
+        uint32_t nameCRC;
+        strncpy(serverNames[i], name.c_str(), NTP_SERVER_NAME_MAX_LENGTH - 1);
+        serverNames[i][NTP_SERVER_NAME_MAX_LENGTH - 1] = 0;
+        nameCRC = crc32(serverNames[i], strlen(serverNames[i]));
+        if ((cache.nameCRC[i] != nameCRC) || (cache.ageSeconds[i] >= NTP_DNS_MAX_AGE_MILLIS / 1000UL)) {
+            cache.nameCRC[i] = nameCRC;
+            cache.address[i] = 0;
+        }
+        resolvedAt[i] = millis() - cache.ageSeconds[i] * 1000UL;
+        if (serverNames[i][0] && cache.address[i]) restored = true;
+    }
+    // Look the names up as soon as DHCP has finished, even if setup() is still waiting for the connection
+    gotIPHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP &event) { resolveAll(); });
+}
+
+/**
+ * Give the SNTP client any remembered addresses in place of the names. Called once the SNTP client
+ * has been configured with the names
+ */
+void useCachedNTPAddresses() {
+    sntpUsingCache = true;
+    for (uint8_t i = 0 ; i < NTP_SERVER_COUNT ; i++) {
+        if (!serverNames[i][0] || !cache.address[i]) continue;
+        setSNTPAddress(i);
+    }
+    DEBUG("NTP addresses %s\n", restored ? "remembered from before the restart" : "not remembered")
+}
+
+/**
+ * NTP address polling loop - keeps the addresses fresh, forgets any that are too old, and saves them
+ * when they change
+ */
+void ntpAddressPoll() {
+    if (WiFi.isConnected() && ((millis() - lastRefresh) >= NTP_DNS_REFRESH_MILLIS)) resolveAll();
+    for (uint8_t i = 0 ; i < NTP_SERVER_COUNT ; i++) {
+        if (!cache.address[i] || ((millis() - resolvedAt[i]) < NTP_DNS_MAX_AGE_MILLIS)) continue;
+        DEBUG("NTP server %s not looked up for too long - forgetting its address\n", serverNames[i])
+        cache.address[i] = 0;
+        cacheChanged = true;
+        if (sntpUsingCache && serverNames[i][0]) sntp_setservername(i, serverNames[i]);
+    }
+    if (cacheChanged || ((millis() - lastSave) >= NTP_DNS_SAVE_MILLIS)) {
+        cacheChanged = false;
+        lastSave = millis();
+        for (uint8_t i = 0 ; i < NTP_SERVER_COUNT ; i++) cache.ageSeconds[i] = (millis() - resolvedAt[i]) / 1000UL;
+        cache.magic = NTP_DNS_MAGIC;
+        cache.crc = cacheCRC();
+        ESP.rtcUserMemoryWrite(NTP_DNS_RTC_OFFSET, (uint32_t *)&cache, sizeof(cache));
+    }
+}
+
+/**
+ * Did the SNTP client start with addresses remembered from before the restart?
+ */
+bool ntpAddressCacheUsed() {
+    return restored;
+}
@@ -0,0 +1,13 @@
+#ifndef _NTPDNS_H_
+#define _NTPDNS_H_
+
+#include <Arduino.h>
+
+#define NTP_SERVER_COUNT 3
+
+void initNTPAddressCache();
+void useCachedNTPAddresses();
+void ntpAddressPoll();
+bool ntpAddressCacheUsed();
+
+#endif
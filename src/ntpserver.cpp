@@ -0,0 +1,184 @@
+// ntpserver.cpp - serve our time to other devices on the local network, over SNTP
+//
+// This also owns the NTP port for ntpbroadcast.cpp, which is passed the broadcasts and server replies
+//
+// Ref: RFC 4330
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <sntp.h>
+#include <sys/time.h>
+#include "ntpserver.h"
+#include "ntpbroadcast.h"
+#include "config.h"
+#include "timekeeping.h"
+#include "leap.h"
+#include "wifi.h"
+#include "debug.h"
+
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+#define NTP_MULTICAST_GROUP IPAddress(224, 0, 1, 1)
+// The servers we sync from don't tell us their stratum, and pool servers are usually stratum 2
+#define NTP_SERVER_STRATUM 3
+#define NTP_SERVER_PRECISION -10      // log2 seconds - about a millisecond
+// If we haven't synced for this long, we no longer claim to have the time - our crystal could be a
+// few tenths of a second out by then. Clients are told we are unsynchronised (RFC 4330 section 5)
+#define NTP_SERVER_MAX_UNSYNCED_MILLIS (4UL * 60UL * 60UL * 1000UL)
+#define NTP_UNSYNCED_STRATUM 16
+#define NTP_LEAP_UNSYNCHRONISED 3
+// Rate limit - a bucket of tokens, refilled at NTP_SERVER_MAX_PER_SECOND up to NTP_SERVER_BURST
+#define NTP_SERVER_MAX_PER_SECOND 20
+#define NTP_SERVER_BURST 10
+// Most requests answered per call, so a flood can't hold up loop(). Dropping one is only reading
+// it, so more are read - enough to keep the socket's queue from growing under a flood, which would
+// have the requests answered seconds after they were sent, with a time that far out
+#define NTP_SERVER_MAX_PER_POLL 2
+#define NTP_SERVER_MAX_READ_PER_POLL 16
+
+static WiFiUDP udp;
+static bool listening = false;
+static bool multicast = false;        // Whether the socket has joined the NTP group
+static uint8_t tokens = NTP_SERVER_BURST;
+static unsigned long lastRefill = 0;
+static uint32_t requestsServed = 0;
+static uint32_t requestsDropped = 0;
+
+/**
+ * Write a 32 bit value into a packet, big endian
+ */
+static void putUInt32(uint8_t *p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/**
+ * Write the current time into a packet as an NTP timestamp
+ */
+static void putTimestamp(uint8_t *p, const struct timeval &tv) {
+    putUInt32(p, tv.tv_sec + NTP_UNIX_OFFSET);
+    putUInt32(p + 4, (uint32_t)(((uint64_t)tv.tv_usec << 32) / 1000000UL));
+}
+
+/**
+ * Write a duration into a packet in NTP short format (16.16 seconds)
+ */
+static void putShortDuration(uint8_t *p, unsigned long millis) {
+    putUInt32(p, (uint32_t)(((uint64_t)millis << 16) / 1000UL));
+}
+
+/**
+ * Answer one request
+ */
+static void answer(uint8_t *packet, const struct timeval &received) {
+    struct timeval now;
+    struct timeval reference;
+    unsigned long sinceSync = millisSinceSync();
+    uint8_t version = (packet[0] >> 3) & 7;
+    const ip_addr_t *upstream = sntp_getserver(0);
+    bool stale = sinceSync >= NTP_SERVER_MAX_UNSYNCED_MILLIS;
+    uint32_t refid;
+
+    memcpy(packet + 24, packet + 40, 8);                 // Originate timestamp is the client's transmit
+    // Any leap warning (or that we are unsynchronised), client's version, server mode
+    packet[0] = ((stale ? NTP_LEAP_UNSYNCHRONISED : getLeapIndicator()) << 6) | (version << 3) | 4;
+    packet[1] = stale ? NTP_UNSYNCED_STRATUM : NTP_SERVER_STRATUM;
+    // packet[2] - poll interval - is left as the client sent it
+    packet[3] = (uint8_t)NTP_SERVER_PRECISION;
+    putShortDuration(packet + 4, 50);                    // Root delay - a typical round trip to the pool
+    // Root dispersion grows by 15 ppm (the usual crystal tolerance) of the time since our last sync
+    putShortDuration(packet + 8, 10 + (sinceSync / 1000UL) * 15 / 1000UL);
+    refid = upstream ? ip_addr_get_ip4_u32(upstream) : 0;
+    memcpy(packet + 12, &refid, 4);                      // Reference ID is our server's address, already in network order
+    reference = received;
+    reference.tv_sec -= sinceSync / 1000UL;
+    putTimestamp(packet + 16, reference);
+    putTimestamp(packet + 32, received);
+    gettimeofday(&now, 0);
+    putTimestamp(packet + 40, now);
+    udp.beginPacket(udp.remoteIP(), udp.remotePort());
+    udp.write(packet, NTP_PACKET_SIZE);
+    udp.endPacket();
+}
+
+/**
+ * Send a client mode request to a server, returning the time it was sent
+ */
+bool sendNTPRequest(const IPAddress &server, struct timeval *sent) {
+    uint8_t packet[NTP_PACKET_SIZE];
+    if (!listening) return false;
+    memset(packet, 0, sizeof(packet));
+    packet[0] = (0 << 6) | (4 << 3) | 3;                 // No leap warning, version 4, client mode
+    gettimeofday(sent, 0);
+    putTimestamp(packet + 40, *sent);
+    if (!udp.beginPacket(server, NTP_PORT)) return false;
+    udp.write(packet, NTP_PACKET_SIZE);
+    return udp.endPacket();
+}
+
+/**
+ * NTP server polling loop
+ *
+ * Only answers once we have the time ourselves, and says it is unsynchronised if it has gone
+ * NTP_SERVER_MAX_UNSYNCED_MILLIS without a sync since. Requests beyond the rate limit are dropped.
+ * When listening for broadcasts, the port is open whether or not we are serving
+ */
+void ntpServerPoll() {
+    uint8_t packet[NTP_PACKET_SIZE];
+    unsigned long refill;
+    bool serving = cfgBitIsSet(CFG_MASK_NTP_SERVER) && timeIsSynced();
+    bool broadcasts = cfgBitIsSet(CFG_MASK_NTP_BROADCAST);
+
+    if ((!serving && !broadcasts) || !WiFi.isConnected() || (listening && (broadcasts != multicast))) {
+        if (listening) {
+            udp.stop();
+            listening = false;
+        }
+        ntpBroadcastPoll();
+        return;
+    }
+    if (!listening) {
+        // Joining the group still leaves the socket listening for unicast and broadcast packets
+        listening = broadcasts ? udp.beginMulticast(WiFi.localIP(), NTP_MULTICAST_GROUP, NTP_PORT) : udp.begin(NTP_PORT);
+        multicast = broadcasts;
+        DEBUG("NTP port %s\n", listening ? "opened" : "failed to open")
+        return;
+    }
+    ntpBroadcastPoll();
+    refill = (millis() - lastRefill) * NTP_SERVER_MAX_PER_SECOND / 1000UL;
+    if (refill) {
+        tokens = min((unsigned long)NTP_SERVER_BURST, tokens + refill);
+        lastRefill = millis();
+    }
+    for (int i = 0, answered = 0 ; (i < NTP_SERVER_MAX_READ_PER_POLL) && (answered < NTP_SERVER_MAX_PER_POLL) ; i++) {
+        struct timeval received;
+        int size = udp.parsePacket();
+        if (!size) return;
+        gettimeofday(&received, 0);
+        if ((size < NTP_PACKET_SIZE) || (udp.read(packet, NTP_PACKET_SIZE) != NTP_PACKET_SIZE)) continue;
+        if ((packet[0] & 7) != 3) {
+            ntpBroadcastReceived(packet, received, udp.remoteIP());
+            continue;
+        }
+        if (!serving) continue;
+        if (!tokens) {
+            requestsDropped++;
+            continue;
+        }
+        tokens--;
+        answer(packet, received);
+        requestsServed++;
+        answered++;
+    }
+}
+
+/**
+ * How many requests have been answered, and how many dropped by the rate limit, since boot
+ */
+void getNTPServerCounts(uint32_t *served, uint32_t *dropped) {
+    *served = requestsServed;
+    *dropped = requestsDropped;
+}
@@ -0,0 +1,13 @@
+#ifndef _NTPSERVER_H_
+#define _NTPSERVER_H_
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+#define NTP_UNIX_OFFSET 2208988800UL  // Seconds from 1900 (NTP) to 1970 (Unix)
+
+void ntpServerPoll();
+void getNTPServerCounts(uint32_t *served, uint32_t *dropped);
+bool sendNTPRequest(const IPAddress &server, struct timeval *sent);
+
+#endif
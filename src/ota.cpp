@@ -1,19 +1,176 @@
 #include <Arduino.h>
 #include <ArduinoOTA.h>
+#include <Updater.h>
+#include <bearssl/bearssl_hash.h>
 #include "ota.h"
 #include "wifi.h"
 #include "config.h"
+#include "display.h"
+#include "commands.h"
+#include "syslog.h"
+#include "debug.h"
+
+// How long to wait after a successful update before restarting, so the HTTP response can get out
+#define OTA_REBOOT_DELAY_MILLIS 1000
 
 static bool isSetup = false;
+static bool rebootPending = false;
+static unsigned long rebootRequestedAt = 0;
+
+// State of the HTTP update currently in progress
+static br_sha256_context shaContext;
+static uint8_t expectedSHA[32];
+static size_t expectedBytes = 0;
+static size_t bytesReceived = 0;
+static unsigned long startMillis = 0;
+static unsigned long durationMillis = 0;
+static int8_t lastPercent = -1;
+
+/**
+ * Work out the update progress as a percentage. Returns -1 if it hasn't changed
+ */
+static int8_t progressChange(unsigned int done, unsigned int total) {
+    int8_t percent;
+    if (!total) return -1;
+    percent = (int8_t)(((uint64_t)done * 100) / total);
+    if (percent > 100) percent = 100;
+    if (percent == lastPercent) return -1;
+    return lastPercent = percent;
+}
+
+/**
+ * Show the update progress on the display, for ArduinoOTA which runs in loop()
+ */
+static void showProgress(unsigned int done, unsigned int total) {
+    int8_t percent = progressChange(done, total);
+    if (percent >= 0) showPercentage(percent);
+}
+
+/**
+ * Have loop() show the update progress on the display, for updates over HTTP
+ */
+static void queueProgress(unsigned int done, unsigned int total) {
+    int8_t percent = progressChange(done, total);
+    if (percent >= 0) queueCommand(COMMAND_SHOW_PROGRESS, percent);
+}
+
+/**
+ * Convert a hex digit to its value, or -1 if it isn't one
+ */
+static int hexValue(char c) {
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Start an update over HTTP
+ *
+ * totalBytes is our best guess at the image size, used only for the progress display.
+ * sha256 is the hex SHA-256 of the uploaded (possibly gzip-compressed) image, which must be given
+ */
+bool otaHTTPBegin(size_t totalBytes, const String &sha256) {
+    uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    if (sha256.length() != 64) return false;
+    for (int i = 0 ; i < 32 ; i++) {
+        int hi = hexValue(sha256.charAt(i*2));
+        int lo = hexValue(sha256.charAt(i*2+1));
+        if ((hi < 0) || (lo < 0)) return false;
+        expectedSHA[i] = (hi << 4) | lo;
+    }
+    DEBUG("HTTP OTA starting, %u bytes expected, %u available\n", totalBytes, maxSketchSpace)
+    // The ESP8266 updater recognises gzip images by their magic and the bootloader inflates them
+    // while copying into place, so compressed images are streamed straight into flash as they arrive
+    Update.runAsync(true);
+    if (!Update.begin(maxSketchSpace, U_FLASH)) return false;
+    br_sha256_init(&shaContext);
+    expectedBytes = totalBytes;
+    bytesReceived = 0;
+    lastPercent = -1;
+    startMillis = millis();
+    queueProgress(0, 1);
+    return true;
+}
+
+/**
+ * Write the next chunk of an HTTP update
+ */
+bool otaHTTPWrite(uint8_t *data, size_t len) {
+    if (Update.hasError()) return false;
+    br_sha256_update(&shaContext, data, len);
+    if (Update.write(data, len) != len) return false;
+    bytesReceived += len;
+    queueProgress(bytesReceived, expectedBytes);
+    return true;
+}
+
+/**
+ * Finish an HTTP update. The new image is only committed if the SHA-256 matches
+ */
+bool otaHTTPEnd() {
+    uint8_t actualSHA[32];
+    durationMillis = millis() - startMillis;
+    br_sha256_out(&shaContext, actualSHA);
+    if (Update.hasError() || memcmp(actualSHA, expectedSHA, sizeof(actualSHA))) {
+        DEBUG("HTTP OTA failed - error %u\n", Update.getError())
+        logMessage(SYSLOG_ERR, "ota", "Update failed - error %u", Update.getError());
+        Update.end(false); // The image is incomplete as far as the updater knows, so this discards it
+        return false;
+    }
+    if (!Update.end(true)) return false;
+    DEBUG("HTTP OTA complete, %u bytes in %lu ms\n", bytesReceived, durationMillis)
+    logMessage(SYSLOG_NOTICE, "ota", "Update complete, %u bytes in %lu ms - restarting", bytesReceived, durationMillis);
+    queueProgress(1, 1);
+    scheduleRestart();
+    return true;
+}
+
+/**
+ * Abandon an HTTP update part way through - the uploader went away. What was written is discarded
+ */
+void otaHTTPAbort() {
+    DEBUG("HTTP OTA abandoned after %u bytes\n", bytesReceived)
+    if (Update.isRunning()) Update.end(false);
+}
+
+/**
+ * Restart the clock shortly, once any HTTP response in progress has had a chance to go out
+ */
+void scheduleRestart() {
+    rebootPending = true;
+    rebootRequestedAt = millis();
+}
+
+/**
+ * Number of bytes received by the last HTTP update
+ */
+size_t otaBytesReceived() {
+    return bytesReceived;
+}
+
+/**
+ * How long the last HTTP update took, in milliseconds
+ */
+unsigned long otaDurationMillis() {
+    return durationMillis;
+}
 
 void otaPoll() {
+    if (rebootPending) {
+        if ((millis() - rebootRequestedAt) >= OTA_REBOOT_DELAY_MILLIS) ESP.restart();
+        return;
+    }
     if (isSetup) {
         ArduinoOTA.handle();
     } else if (hasWiFiConnection()) {
         if (hasConfig(CFG_HOSTNAME)) {
             ArduinoOTA.setHostname(getStringConfig(CFG_HOSTNAME).c_str());
         }
+        ArduinoOTA.onStart([]() { lastPercent = -1; showProgress(0, 1); });
+        ArduinoOTA.onProgress(showProgress);
+        ArduinoOTA.onError([](ota_error_t error) { clearLEDSegments(); });
         ArduinoOTA.begin();
         isSetup = true;
     }
-}
\ No newline at end of file
+}
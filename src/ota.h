@@ -1,6 +1,15 @@
 #ifndef _OTA_H_
 #define _OTA_H_
 
+#include <Arduino.h>
+
 void otaPoll();
+bool otaHTTPBegin(size_t totalBytes, const String &sha256);
+bool otaHTTPWrite(uint8_t *data, size_t len);
+bool otaHTTPEnd();
+void otaHTTPAbort();
+void scheduleRestart();
+size_t otaBytesReceived();
+unsigned long otaDurationMillis();
 
 #endif
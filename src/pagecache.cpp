@@ -0,0 +1,214 @@
+// pagecache.cpp - send a templated page without working out every placeholder each time
+//
+// The page only depends on the stored configuration, so the placeholder values are worked out once
+// per configuration generation and kept, along with where they go in the template. Sending the page
+// is then a matter of copying alternate slices of the template (from flash) and of the kept values.
+// Only the values are held in memory, not the whole page.
+//
+// Placeholders follow ESPAsyncWebServer's rules - "%NAME%", with "%%" for a literal "%"
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+#include <ESPAsyncWebServer.h>
+#include "pagecache.h"
+#include "config.h"
+#include "version.h"
+#include "debug.h"
+
+// The longest placeholder name ESPAsyncWebServer looks for
+#define PAGE_PLACEHOLDER_MAX_LENGTH 32
+
+// A slice of either the template or the kept values
+typedef struct __attribute__((packed)) PageSegment_t {
+  uint16_t offset;
+  uint16_t length;
+  bool fromTemplate;
+} PageSegment;
+
+typedef struct PageCache_t {
+  PGM_P page;
+  uint32_t generation;
+  size_t length;              // Of the whole page as sent
+  char etag[32];
+  std::vector<PageSegment> segments;
+  String values;
+} PageCache;
+
+// A page being sent
+typedef struct PageCursor_t {
+  std::shared_ptr<PageCache> cache;
+  size_t segment;
+  size_t offset;              // Within the segment
+  unsigned long startMicros;
+  bool hit;
+} PageCursor;
+
+// Shared with any responses still being sent, so it can be replaced while they finish
+static std::shared_ptr<PageCache> current;
+static PageCacheStats stats;
+static uint64_t hitMicrosTotal = 0;
+static uint64_t missMicrosTotal = 0;
+// The template last hashed, and its hash - templates are in flash, so only change with the firmware
+static PGM_P hashedPage = 0;
+static uint32_t pageHash = 0;
+
+/**
+ * An FNV-1a hash of a template, so a firmware build that changes the page without changing the
+ * version still changes the ETag
+ */
+static uint32_t templateHash(PGM_P page) {
+  uint32_t hash = 2166136261UL;
+  if (page == hashedPage) return pageHash;
+  for (PGM_P p = page ; pgm_read_byte(p) ; p++) {
+    hash ^= pgm_read_byte(p);
+    hash *= 16777619UL;
+  }
+  hashedPage = page;
+  pageHash = hash;
+  return hash;
+}
+
+/**
+ * Add a slice of the template to the cache
+ */
+static void addTemplateSegment(PageCache *cache, size_t start, size_t end) {
+  if (end <= start) return;
+  cache->segments.push_back({ (uint16_t)start, (uint16_t)(end - start), true });
+  cache->length += end - start;
+}
+
+/**
+ * Work out all the placeholder values in a page
+ */
+static std::shared_ptr<PageCache> buildCache(PGM_P page, AwsTemplateProcessor processor) {
+  std::shared_ptr<PageCache> cache = std::make_shared<PageCache>();
+  size_t length = strlen_P(page);
+  size_t start = 0;
+  size_t i = 0;
+  cache->page = page;
+  cache->generation = getConfigGeneration();
+  cache->length = 0;
+  snprintf(cache->etag, sizeof(cache->etag), "\"" FIRMWARE_VERSION "-%08x%08x\"", templateHash(page), getConfigHash());
+  while (i < length) {
+    size_t end;
+    char name[PAGE_PLACEHOLDER_MAX_LENGTH + 1];
+    if (pgm_read_byte(page + i) != '%') {
+      i++;
+      continue;
+    }
+    if (pgm_read_byte(page + i + 1) == '%') {
+      // A literal "%" - keep the first one, skip the second
+      addTemplateSegment(cache.get(), start, i + 1);
+      start = i = i + 2;
+      continue;
+    }
+    for (end = i + 1 ; (end < length) && (end - i <= PAGE_PLACEHOLDER_MAX_LENGTH) ; end++) {
+      if (pgm_read_byte(page + end) == '%') break;
+    }
+    if ((end >= length) || (pgm_read_byte(page + end) != '%')) {
+      i++; // Not a placeholder, so just a "%"
+      continue;
+    }
+    addTemplateSegment(cache.get(), start, i);
+    memcpy_P(name, page + i + 1, end - i - 1);
+    name[end - i - 1] = 0;
+    {
+      String value = processor(String(name));
+      if (value.length()) {
+        cache->segments.push_back({ (uint16_t)cache->values.length(), (uint16_t)value.length(), false });
+        cache->values.concat(value);
+        cache->length += value.length();
+      }
+    }
+    start = i = end + 1;
+  }
+  addTemplateSegment(cache.get(), start, length);
+  cache->segments.shrink_to_fit();
+  DEBUG("Page cache built - %u segments, %u bytes of values\n", cache->segments.size(), cache->values.length())
+  return cache;
+}
+
+/**
+ * Fill a buffer with the next part of a page
+ */
+static size_t fillPage(PageCursor *cursor, uint8_t *buf, size_t maxLen) {
+  const PageCache *cache = cursor->cache.get();
+  size_t len = 0;
+  if (cursor->startMicros) {
+    uint32_t elapsed = micros() - cursor->startMicros;
+    if (cursor->hit) hitMicrosTotal += elapsed; else missMicrosTotal += elapsed;
+    cursor->startMicros = 0;
+  }
+  while ((len < maxLen) && (cursor->segment < cache->segments.size())) {
+    const PageSegment &segment = cache->segments[cursor->segment];
+    size_t n = min(maxLen - len, (size_t)(segment.length - cursor->offset));
+    if (segment.fromTemplate) {
+      memcpy_P(buf + len, cache->page + segment.offset + cursor->offset, n);
+    } else {
+      memcpy(buf + len, cache->values.c_str() + segment.offset + cursor->offset, n);
+    }
+    len += n;
+    cursor->offset += n;
+    if (cursor->offset == segment.length) {
+      cursor->segment++;
+      cursor->offset = 0;
+    }
+  }
+  return len;
+}
+
+/**
+ * Send a templated page, from the cache if the configuration hasn't changed since it was built.
+ * Clients that already have this version of the page are told so (304)
+ */
+void sendCachedPage(AsyncWebServerRequest *request, PGM_P page, AwsTemplateProcessor processor) {
+  std::shared_ptr<PageCursor> cursor = std::make_shared<PageCursor>();
+  AsyncWebServerResponse *response;
+  cursor->startMicros = micros();
+  cursor->hit = current && (current->page == page) && (current->generation == getConfigGeneration());
+  if (!cursor->hit) current = buildCache(page, processor);
+  if (request->hasHeader("If-None-Match") && (request->header("If-None-Match") == current->etag)) {
+    stats.notModified++;
+    request->send(304);
+    return;
+  }
+  if (cursor->hit) stats.hits++; else stats.misses++;
+  cursor->cache = current;
+  cursor->segment = 0;
+  cursor->offset = 0;
+  response = request->beginResponse("text/html", current->length, [cursor](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+    return fillPage(cursor.get(), buf, maxLen);
+  });
+  response->addHeader("ETag", current->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+/**
+ * Work out a page from scratch and throw it away, returning its length - for benchmarking.
+ * The cache is left alone
+ */
+size_t renderPageToNull(PGM_P page, AwsTemplateProcessor processor) {
+  PageCursor cursor;
+  uint8_t buf[256];
+  size_t total = 0;
+  size_t len;
+  cursor.cache = buildCache(page, processor);
+  cursor.segment = 0;
+  cursor.offset = 0;
+  cursor.startMicros = 0;
+  cursor.hit = false;
+  while ((len = fillPage(&cursor, buf, sizeof(buf)))) total += len;
+  return total;
+}
+
+/**
+ * How well the cache is doing
+ */
+void getPageCacheStats(PageCacheStats *ans) {
+  *ans = stats;
+  ans->bytes = current ? sizeof(PageCache) + current->segments.capacity() * sizeof(PageSegment) + current->values.length() : 0;
+  ans->hitMicros = stats.hits ? hitMicrosTotal / stats.hits : 0;
+  ans->missMicros = stats.misses ? missMicrosTotal / stats.misses : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _PAGECACHE_H_
+#define _PAGECACHE_H_
+
+#include <ESPAsyncWebServer.h>
+
+typedef struct PageCacheStats_t {
+  uint32_t hits;             // Pages sent from the cache
+  uint32_t misses;           // Pages that needed the cache building first
+  uint32_t notModified;      // 304 replies to clients that already had the page
+  size_t bytes;              // Heap used by the cache
+  uint32_t hitMicros;        // Average time to the first byte of the page
+  uint32_t missMicros;
+} PageCacheStats;
+
+void sendCachedPage(AsyncWebServerRequest *request, PGM_P page, AwsTemplateProcessor processor);
+void getPageCacheStats(PageCacheStats *stats);
+size_t renderPageToNull(PGM_P page, AwsTemplateProcessor processor);
+
+#endif
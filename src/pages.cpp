@@ -0,0 +1,164 @@
+// pages.cpp - what the display shows each second, when it is showing the time
+//
+// The display can rotate through the pages in pages.h, each shown for as many seconds as its
+// CFG_PAGE_ setting (0 leaves it out). Where the rotation is is worked out from the time itself, so
+// clocks on the same network turn their pages together, and there is no state to lose.
+//
+// localtime() has the DST rules to work through every time it is called, so the local calendar is
+// worked out once and kept until the next local midnight - or a DST change, if one comes first.
+// Pages are drawn with the display's own functions, which only send the digits that have changed.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <time.h>
+#include "pages.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "debug.h"
+
+#define PAGE_SYNC_MAX_MINUTES 999
+
+typedef struct Calendar_t {
+  time_t from;                   // UTC, the span it holds for
+  time_t until;
+  int32_t offset;                // Local time minus UTC, in seconds
+  uint8_t day;                   // 1 .. 31
+  uint8_t month;                 // 1 .. 12
+  uint8_t weekday;               // 0 (Sunday) .. 6
+} Calendar;
+
+static const char *pageTags[PAGE_COUNT] = { CFG_PAGE_TIME, CFG_PAGE_DATE, CFG_PAGE_WEEKDAY, CFG_PAGE_SYNC, CFG_PAGE_IP };
+static const char weekdays[7][4] PROGMEM = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static uint8_t pageSeconds[PAGE_COUNT];
+static uint16_t cycleSeconds = 0;
+static bool pagesLoaded = false;
+static uint32_t pagesGeneration = 0;
+static Calendar calendar;
+static uint32_t calendarGeneration = 0;
+
+/**
+ * Local time minus UTC at t, in seconds - leaving the local time in *local
+ */
+static int32_t utcOffset(time_t t, struct tm *local) {
+  int32_t offset;
+  *local = *localtime(&t);
+  offset = (local->tm_hour * 3600L + local->tm_min * 60L + local->tm_sec) - (int32_t)(t % 86400);
+  // Timezones run from 12 hours behind UTC to 14 ahead
+  if (offset > 14 * 3600L) offset -= 86400L;
+  if (offset < -12 * 3600L) offset += 86400L;
+  return offset;
+}
+
+/**
+ * Work out the calendar for now, and how long it holds for
+ */
+static void loadCalendar(time_t now) {
+  struct tm local;
+  struct tm later;
+  time_t midnight;
+  calendar.offset = utcOffset(now, &local);
+  calendar.day = local.tm_mday;
+  calendar.month = local.tm_mon + 1;
+  calendar.weekday = local.tm_wday;
+  calendar.from = now;
+  midnight = now + 86400L - (local.tm_hour * 3600L + local.tm_min * 60L + local.tm_sec);
+  calendar.until = midnight;
+  if (utcOffset(midnight - 1, &later) != calendar.offset) {
+    // A DST change before midnight - find the second it happens
+    time_t before = now;
+    time_t after = midnight - 1;
+    while ((after - before) > 1) {
+      time_t middle = before + (after - before) / 2;
+      if (utcOffset(middle, &later) == calendar.offset) before = middle; else after = middle;
+    }
+    calendar.until = after;
+  }
+  calendarGeneration = getConfigGeneration();
+  DEBUG("Calendar %u/%u, offset %d, until %lu\n", calendar.day, calendar.month, calendar.offset,
+      (unsigned long)calendar.until)
+}
+
+/**
+ * Read the page settings, when they have changed
+ */
+static void loadPages() {
+  uint8_t seconds[PAGE_COUNT];
+  for (uint8_t i = 0 ; i < PAGE_COUNT ; i++) {
+    seconds[i] = max(getInt8Config(pageTags[i], (i == PAGE_TIME) ? PAGE_DEFAULT_TIME_SECONDS : 0), (int8_t)0);
+  }
+  setPageSeconds(seconds);
+}
+
+/**
+ * Show an IP address octet, right justified, with a decimal point after all but the last
+ */
+static void showOctet(uint8_t octet, bool last) {
+  char text[6];
+  snprintf_P(text, sizeof(text), last ? PSTR("%4u") : PSTR("%4u."), octet);
+  showText(text);
+}
+
+/**
+ * Show the page that is due at now - called by timekeepingPoll() at the start of each second
+ */
+void showPage(time_t now) {
+  uint16_t position;
+  uint8_t page = PAGE_TIME;
+  char text[6];
+  if (!pagesLoaded || (pagesGeneration != getConfigGeneration())) loadPages();
+  if ((now < calendar.from) || (now >= calendar.until) || (calendarGeneration != getConfigGeneration())) {
+    loadCalendar(now);
+  }
+  if (cycleSeconds) {
+    position = now % cycleSeconds;
+    for (page = 0 ; position >= pageSeconds[page] ; page++) position -= pageSeconds[page];
+  }
+  switch (page) {
+    case PAGE_DATE:
+      snprintf_P(text, sizeof(text), PSTR("%2u%02u"), calendar.day, calendar.month);
+      showText(text);
+      break;
+    case PAGE_WEEKDAY:
+      strcpy_P(text, weekdays[calendar.weekday]);
+      showText(text);
+      break;
+    case PAGE_SYNC:
+      if ((millisSinceSync() / 60000UL) > PAGE_SYNC_MAX_MINUTES) {
+        showText("S---");
+      } else {
+        snprintf_P(text, sizeof(text), PSTR("S%3lu"), millisSinceSync() / 60000UL);
+        showText(text);
+      }
+      break;
+    case PAGE_IP:
+      if (WiFi.isConnected()) {
+        showOctet(WiFi.localIP()[position % 4], (position % 4) == 3);
+      } else {
+        showText("----");
+      }
+      break;
+    default: {
+      int32_t seconds = (int32_t)((now + calendar.offset) % 86400L);
+      showTime(seconds / 3600, (seconds / 60) % 60);
+      break;
+    }
+  }
+}
+
+/**
+ * Change how long each page is shown for, in seconds - PAGE_COUNT of them - until the configuration
+ * next changes. All 0 shows the time all the time, and no seconds at all goes back to the
+ * configuration
+ */
+void setPageSeconds(const uint8_t *seconds) {
+  if (!seconds) {
+    pagesLoaded = false;
+    return;
+  }
+  memcpy(pageSeconds, seconds, sizeof(pageSeconds));
+  cycleSeconds = 0;
+  for (uint8_t i = 0 ; i < PAGE_COUNT ; i++) cycleSeconds += pageSeconds[i];
+  pagesGeneration = getConfigGeneration();
+  pagesLoaded = true;
+}
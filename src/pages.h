@@ -0,0 +1,20 @@
+#ifndef _PAGES_H_
+#define _PAGES_H_
+
+#include <Arduino.h>
+#include <time.h>
+
+// The pages the display can rotate through, in order. Each is shown for the seconds configured for it
+#define PAGE_TIME 0        // Hours and minutes
+#define PAGE_DATE 1        // Day of the month, then the month
+#define PAGE_WEEKDAY 2
+#define PAGE_SYNC 3        // Minutes since the time was last set
+#define PAGE_IP 4          // Our IP address, an octet a second
+#define PAGE_COUNT 5
+
+#define PAGE_DEFAULT_TIME_SECONDS 10
+
+void showPage(time_t now);
+void setPageSeconds(const uint8_t *seconds);
+
+#endif
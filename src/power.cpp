@@ -0,0 +1,177 @@
+// power.cpp - let the radio and the CPU sleep while the clock has nothing to do
+//
+// The clock needs the network for an NTP poll an hour and the odd visit to its web pages, and the
+// display changes twice a second. So with CFG_POWER -
+//
+//   POWER_AWAKE  the radio is never put to sleep, and loop() runs every 10ms
+//   POWER_MODEM  the radio sleeps between the access point's DTIM beacons, waking for every
+//                POWER_LISTEN_INTERVAL'th one, and loop() sleeps until the display next changes
+//
+// The SDK's light sleep, which also stops the CPU, isn't used. The buttons' CHANGE interrupts can't
+// wake it (GPIO wakeup is level triggered, and would have to be re-armed for each edge), so a press
+// would wait for the next beacon.
+//
+// A button interrupt or a queued command wakes loop() at once - see powerWake(). The radio is kept
+// on around each NTP poll, so the reply isn't held up at the access point (which would make the
+// time late), until the time has been set, and for POWER_ACTIVE_MILLIS after anything is asked of
+// the web server. Serving time, or taking it from broadcasts, needs packets timestamped as they
+// arrive, so keeps everything awake.
+//
+// The SDK doesn't say when the radio is actually on, so radioOnMillis is the time it has been kept
+// on; in radioSleepMillis it was only on for the beacons it listened to.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+#include "power.h"
+#include "config.h"
+#include "timekeeping.h"
+#include "buttons.h"
+#include "display.h"
+#include "alarms.h"
+#include "timer.h"
+#include "debug.h"
+
+#define POWER_LISTEN_INTERVAL 3           // In DTIM periods - 300ms with the usual beacon and a DTIM of 1
+#define POWER_ACTIVE_MILLIS 30000UL       // Radio on after each request, for the ones that follow
+#define POWER_NTP_INTERVAL_MILLIS 3600000UL // How often the SNTP client asks - SNTP_UPDATE_DELAY
+#define POWER_NTP_EARLY_MILLIS 5000UL     // Radio on this long before the poll is due
+#define POWER_LOOP_MILLIS 10UL            // loop() period while it is kept awake
+#define POWER_MAX_SLEEP_MILLIS 1000UL
+
+static uint8_t policy = POWER_MODEM;
+static bool policyLoaded = false;
+static uint32_t configGeneration = 0;
+static bool radioSet = false;             // Has the sleep mode been set yet?
+static bool radioSleeping = false;
+static volatile bool wakeRequested = false;
+static volatile unsigned long lastActivity = 0;
+static volatile bool active = false;
+static unsigned long lastAccount = 0;
+static unsigned long minuteStart = 0;
+static uint32_t wakeupsThisMinute = 0;
+static unsigned long lastSleepMillis = 0;
+static PowerStats stats;
+
+/**
+ * Should the radio be kept on?
+ */
+static bool radioWanted() {
+  if ((policy == POWER_AWAKE) || !WiFi.isConnected() || (WiFi.getMode() != WIFI_STA)) return true;
+  if (cfgBitIsSet(CFG_MASK_NTP_SERVER) || cfgBitIsSet(CFG_MASK_NTP_BROADCAST)) return true;
+  // Until the time is set, and from just before each NTP poll until it has been answered
+  if (!timeIsSynced() || (millisSinceSync() >= POWER_NTP_INTERVAL_MILLIS - POWER_NTP_EARLY_MILLIS)) return true;
+  if (active && ((millis() - lastActivity) < POWER_ACTIVE_MILLIS)) return true;
+  active = false;
+  return false;
+}
+
+/**
+ * Does loop() have to keep running every POWER_LOOP_MILLIS?
+ */
+static bool loopWanted() {
+  if ((policy == POWER_AWAKE) || cfgBitIsSet(CFG_MASK_NTP_SERVER) || cfgBitIsSet(CFG_MASK_NTP_BROADCAST)) return true;
+  return buttonsBusy() || displayIsScrolling() || alarmIsRinging() || timerIsActive();
+}
+
+/**
+ * The configured policy - one of the POWER_ values. The light sleep setting there used to be is
+ * treated as POWER_MODEM
+ */
+uint8_t getPowerPolicy() {
+  uint8_t configured = getInt8Config(CFG_POWER, POWER_MODEM);
+  return (configured > POWER_MODEM) ? POWER_MODEM : configured;
+}
+
+/**
+ * Power management polling loop - puts the radio to sleep, or wakes it, as needed
+ */
+void powerPoll() {
+  unsigned long now = millis();
+  bool sleep;
+  if (!policyLoaded || (configGeneration != getConfigGeneration())) {
+    policy = getPowerPolicy();
+    configGeneration = getConfigGeneration();
+    policyLoaded = true;
+    radioSet = false;
+  }
+  if (radioSleeping) {
+    stats.radioSleepMillis += now - lastAccount;
+  } else {
+    stats.radioOnMillis += now - lastAccount;
+  }
+  lastAccount = now;
+  if ((now - minuteStart) >= 60000UL) {
+    stats.wakeupsPerMinute = wakeupsThisMinute;
+    wakeupsThisMinute = 0;
+    minuteStart = now;
+  }
+  sleep = !radioWanted();
+  if (radioSet && (sleep == radioSleeping)) return;
+  if (sleep) {
+    // The listen interval counts DTIM beacons, so the radio wakes for the buffered broadcasts
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP, POWER_LISTEN_INTERVAL);
+  } else {
+    WiFi.setSleepMode(WIFI_NONE_SLEEP);
+  }
+  DEBUG("Radio %s\n", sleep ? "sleeping" : "on")
+  radioSleeping = sleep;
+  radioSet = true;
+}
+
+/**
+ * Called at the end of loop(), to wait until there is something to do - the next display change,
+ * or sooner if powerWake() is called
+ */
+void powerSleep() {
+  unsigned long wait = POWER_LOOP_MILLIS;
+  unsigned long start;
+  // Anything that wakes us from here on ends the wait at once
+  wakeRequested = false;
+  if (timerIsRunning()) {
+    wait = 1; // Timer frames are due every 20ms, and shouldn't be late
+  } else if (!loopWanted()) {
+    wait = millisUntilTick();
+    if (!wait) wait = POWER_LOOP_MILLIS;
+    wait = min(wait, POWER_MAX_SLEEP_MILLIS);
+  }
+  start = millis();
+  esp_delay(wait, []() { return !wakeRequested; });
+  lastSleepMillis = millis() - start;
+  stats.loopSleepMillis += lastSleepMillis;
+  stats.wakeups++;
+  wakeupsThisMinute++;
+}
+
+/**
+ * Have loop() run now, rather than when its wait is up. Called from the button interrupt handler, so
+ * must be in IRAM
+ */
+void IRAM_ATTR powerWake() {
+  if (!wakeRequested) stats.earlyWakes++;
+  wakeRequested = true;
+  esp_schedule();
+}
+
+/**
+ * Someone is using the clock over the network - keep the radio on for a while, so they aren't kept
+ * waiting for beacons. Called from the web server's and MQTT client's callbacks
+ */
+void notePowerActivity() {
+  lastActivity = millis();
+  active = true;
+  powerWake();
+}
+
+/**
+ * How long loop() slept for, the last time round, in milliseconds
+ */
+unsigned long getLastSleepMillis() {
+  return lastSleepMillis;
+}
+
+void getPowerStats(PowerStats *result) {
+  *result = stats;
+  result->policy = policy;
+  result->radioSleeping = radioSleeping;
+}
@@ -0,0 +1,29 @@
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <Arduino.h>
+
+// How hard to save power - CFG_POWER
+#define POWER_AWAKE 0      // The radio is always on, and loop() runs every 10ms
+#define POWER_MODEM 1      // The radio sleeps between beacons, and loop() between display changes
+
+typedef struct PowerStats_t {
+  uint8_t policy;
+  bool radioSleeping;
+  uint32_t radioOnMillis;          // Since boot, time the radio has been kept on
+  uint32_t radioSleepMillis;       // and time it has been let sleep between beacons
+  uint32_t loopSleepMillis;        // Time loop() has spent waiting for something to do
+  uint32_t wakeups;                // Times loop() has woken
+  uint32_t wakeupsPerMinute;       // in the last full minute
+  uint32_t earlyWakes;             // Woken before time, by a button or a request
+} PowerStats;
+
+uint8_t getPowerPolicy();
+void powerPoll();
+void powerSleep();
+void powerWake();
+void notePowerActivity();
+unsigned long getLastSleepMillis();
+void getPowerStats(PowerStats *stats);
+
+#endif
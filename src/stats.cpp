@@ -0,0 +1,385 @@
+// stats.cpp - long term statistics, kept in flash across restarts and power cuts
+//
+// The counters live in a log in a region of flash kept for them by the linker script (_STATS_start
+// to _STATS_end - see ld/). Rather than rewriting a fixed place, which would wear out one sector,
+// each change is appended as a 16 byte record, and the latest record for a counter wins. The
+// sectors are used in turn. When one fills up, the next is started with a snapshot of every
+// counter, after which the sector after that holds nothing that isn't superseded, and is erased
+// in the background ready for next time. So every sector is erased equally often, and then only
+// once per few hundred changes.
+//
+// A record whose CRC doesn't match - e.g. cut short by a power cut - is skipped. An older sector
+// is only erased once the snapshot in the newest is complete, so nothing is lost if the power goes
+// while writing one.
+//
+// Erasing a sector stops the CPU for tens of milliseconds, so erases and writes are only done just
+// after the display has ticked over to a new second. Changes are written at most once a minute,
+// and the uptime every 15 minutes.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+#include <user_interface.h>
+#include <time.h>
+#include "stats.h"
+#include "timekeeping.h"
+#include "wifi.h"
+#include "power.h"
+#include "debug.h"
+
+#define STATS_SECTOR_SIZE 4096
+#define STATS_MAX_SECTORS 16
+#define STATS_RECORDS_PER_SECTOR (STATS_SECTOR_SIZE / sizeof(StatsRecord))
+#define STATS_FLASH_BASE 0x40200000        // Where the flash is mapped in the address space
+// Record types
+#define STATS_RECORD_HEADER 1               // First in each sector - value is the sequence number, value2 the erase count
+#define STATS_RECORD_COUNTER 2              // id is the counter
+#define STATS_RECORD_DAY 3                  // day is the day, value the brightness changes that day
+#define STATS_RECORD_SNAPSHOT_END 4         // Every counter has been written to this sector
+#define STATS_RECORD_ERASED 5               // id is a sector that's been erased, value its erase count
+// When to write
+#define STATS_SAVE_MILLIS 60000UL
+#define STATS_UPTIME_SAVE_MILLIS 900000UL
+#define STATS_TICK_WINDOW_MILLIS 50UL
+// What counts as a sync failure - not having the time set for this long
+#define STATS_SYNC_LATE_MILLIS (3UL * 3600UL * 1000UL)
+#define STATS_FIRST_SYNC_MILLIS (10UL * 60UL * 1000UL)
+
+typedef struct StatsRecord_t {
+  uint8_t type;
+  uint8_t id;
+  uint16_t day;
+  uint32_t value;
+  uint32_t value2;
+  uint32_t crc;                             // Of everything before it
+} StatsRecord;
+
+// From the linker script - both 0 if it doesn't set aside a region
+extern "C" uint32_t _STATS_start __attribute__((weak));
+extern "C" uint32_t _STATS_end __attribute__((weak));
+
+static uint32_t regionStart = 0;            // Offset in the flash
+static uint8_t sectorCount = 0;
+static uint32_t sectorErases[STATS_MAX_SECTORS];
+static uint32_t values[STATS_COUNTERS];
+static uint32_t storedValues[STATS_COUNTERS];
+static StatsDay days[STATS_DAYS];           // Indexed by day % STATS_DAYS
+static uint16_t storedDayChanges[STATS_DAYS];
+static uint16_t undatedBrightnessChanges = 0; // Before we know what day it is
+// The log
+static uint8_t active = 0;
+static uint16_t writeSlot = 0;              // Next free record in the active sector
+static uint32_t sequence = 0;
+static bool snapshotComplete = false;
+static bool spareErased = false;            // Is the sector after the active one ready?
+static uint32_t appends = 0;
+// Polling
+static unsigned long lastPoll = 0;
+static unsigned long uptimeMillis = 0;      // Not yet added to the uptime
+static unsigned long lastSave = 0;
+static unsigned long lastUptimeSave = 0;
+static uint16_t lastReconnects = 0;
+static bool syncLate = false;
+
+static uint32_t sectorAddress(uint8_t sector) {
+  return regionStart + sector * STATS_SECTOR_SIZE;
+}
+
+static bool readRecord(uint8_t sector, uint16_t slot, StatsRecord *record) {
+  return ESP.flashRead(sectorAddress(sector) + slot * sizeof(StatsRecord), (uint32_t *)record, sizeof(StatsRecord));
+}
+
+static bool isValid(const StatsRecord &record) {
+  return record.crc == crc32(&record, offsetof(StatsRecord, crc));
+}
+
+static bool isBlank(const StatsRecord &record) {
+  const uint32_t *words = (const uint32_t *)&record;
+  for (size_t i = 0 ; i < sizeof(StatsRecord) / 4 ; i++) {
+    if (words[i] != 0xffffffff) return false;
+  }
+  return true;
+}
+
+static bool sectorIsBlank(uint8_t sector) {
+  StatsRecord record;
+  for (uint16_t slot = 0 ; slot < STATS_RECORDS_PER_SECTOR ; slot++) {
+    if (!readRecord(sector, slot, &record) || !isBlank(record)) return false;
+  }
+  return true;
+}
+
+static void eraseSector(uint8_t sector) {
+  DEBUG("Erasing statistics sector %u\n", sector)
+  ESP.flashEraseSector(sectorAddress(sector) / STATS_SECTOR_SIZE);
+  sectorErases[sector]++;
+}
+
+/**
+ * Write a record to the next free slot of the active sector
+ */
+static bool append(uint8_t type, uint8_t id, uint16_t day, uint32_t value, uint32_t value2 = 0xffffffff) {
+  StatsRecord record = { type, id, day, value, value2, 0 };
+  if (writeSlot >= STATS_RECORDS_PER_SECTOR) return false;
+  record.crc = crc32(&record, offsetof(StatsRecord, crc));
+  // The slot is used up even if this fails, as it may be partly written
+  writeSlot++;
+  appends++;
+  return ESP.flashWrite(sectorAddress(active) + (writeSlot - 1) * sizeof(StatsRecord), (uint32_t *)&record, sizeof(StatsRecord));
+}
+
+static void appendCounter(uint8_t counter) {
+  if (append(STATS_RECORD_COUNTER, counter, 0, values[counter])) storedValues[counter] = values[counter];
+}
+
+static void appendDay(uint8_t index) {
+  if (append(STATS_RECORD_DAY, 0, days[index].day, days[index].brightnessChanges)) {
+    storedDayChanges[index] = days[index].brightnessChanges;
+  }
+}
+
+/**
+ * Write every counter to the active sector, then mark the snapshot complete
+ */
+static void writeSnapshot() {
+  for (uint8_t i = 0 ; i < STATS_COUNTERS ; i++) appendCounter(i);
+  for (uint8_t i = 0 ; i < STATS_DAYS ; i++) {
+    if (days[i].day) appendDay(i);
+  }
+  snapshotComplete = append(STATS_RECORD_SNAPSHOT_END, 0, 0, 0);
+}
+
+/**
+ * Move on to the next sector, which must be erased
+ */
+static void startNextSector() {
+  active = (active + 1) % sectorCount;
+  writeSlot = 0;
+  sequence++;
+  snapshotComplete = false;
+  spareErased = false;
+  append(STATS_RECORD_HEADER, 0, 0, sequence, sectorErases[active]);
+  writeSnapshot();
+  DEBUG("Statistics now in sector %u, sequence %u\n", active, sequence)
+}
+
+/**
+ * Apply the records in a sector to the counters. Returns the first free slot
+ */
+static uint16_t replaySector(uint8_t sector, bool *ended) {
+  StatsRecord record;
+  uint16_t slot;
+  *ended = false;
+  for (slot = 1 ; slot < STATS_RECORDS_PER_SECTOR ; slot++) {
+    if (!readRecord(sector, slot, &record) || isBlank(record)) break;
+    if (!isValid(record)) continue;
+    if ((record.type == STATS_RECORD_COUNTER) && (record.id < STATS_COUNTERS)) {
+      values[record.id] = storedValues[record.id] = record.value;
+    } else if ((record.type == STATS_RECORD_DAY) && record.day) {
+      uint8_t index = record.day % STATS_DAYS;
+      if (days[index].day <= record.day) {
+        days[index].day = record.day;
+        days[index].brightnessChanges = storedDayChanges[index] = record.value;
+      }
+    } else if (record.type == STATS_RECORD_SNAPSHOT_END) {
+      *ended = true;
+    } else if ((record.type == STATS_RECORD_ERASED) && (record.id < sectorCount)) {
+      sectorErases[record.id] = max(sectorErases[record.id], record.value);
+    }
+  }
+  return slot;
+}
+
+/**
+ * Load the counters from flash, and count this boot
+ */
+void initStats() {
+  struct rst_info *reset = ESP.getResetInfoPtr();
+  uint32_t sequences[STATS_MAX_SECTORS];
+  bool used[STATS_MAX_SECTORS];
+  bool found = false;
+  if (&_STATS_start && (&_STATS_end > &_STATS_start)) {
+    regionStart = (uint32_t)(uintptr_t)&_STATS_start - STATS_FLASH_BASE;
+    sectorCount = min((uint32_t)STATS_MAX_SECTORS, (uint32_t)((uintptr_t)&_STATS_end - (uintptr_t)&_STATS_start) / STATS_SECTOR_SIZE);
+    if (sectorCount < 2) sectorCount = 0;
+  }
+  for (uint8_t i = 0 ; i < sectorCount ; i++) {
+    StatsRecord header;
+    used[i] = readRecord(i, 0, &header) && isValid(header) && (header.type == STATS_RECORD_HEADER);
+    sequences[i] = used[i] ? header.value : 0;
+    sectorErases[i] = used[i] ? header.value2 : 0;
+  }
+  // Replay the sectors oldest first
+  for (;;) {
+    int8_t oldest = -1;
+    bool ended;
+    uint16_t slot;
+    for (uint8_t i = 0 ; i < sectorCount ; i++) {
+      if (used[i] && ((oldest < 0) || (sequences[i] < sequences[oldest]))) oldest = i;
+    }
+    if (oldest < 0) break;
+    used[oldest] = false;
+    slot = replaySector(oldest, &ended);
+    found = true;
+    active = oldest;
+    writeSlot = slot;
+    sequence = sequences[oldest];
+    snapshotComplete = ended;
+  }
+  values[STATS_BOOTS]++;
+  if (reset && (reset->reason < STATS_RESET_REASON_COUNT)) values[STATS_RESET_REASONS + reset->reason]++;
+  if (!sectorCount) return;
+  if (!found) {
+    // A new store
+    active = sectorCount - 1;
+    if (!sectorIsBlank(0)) eraseSector(0);
+    startNextSector();
+  } else if (!snapshotComplete) {
+    // The power went while the snapshot was being written. It comes straight after the header, so
+    // there is room to write it again
+    writeSnapshot();
+  }
+  DEBUG("Statistics loaded from sector %u, %u records used\n", active, writeSlot)
+  lastSave = millis() - STATS_SAVE_MILLIS;
+  lastUptimeSave = millis();
+}
+
+/**
+ * Count an event - e.g. a brightness change
+ */
+void statsCount(uint8_t counter) {
+  if (counter >= STATS_COUNTERS) return;
+  values[counter]++;
+  if (counter != STATS_BRIGHTNESS_CHANGES) return;
+  if (!timeIsSynced()) {
+    undatedBrightnessChanges++;
+    return;
+  }
+  // Days since 1970 by the local calendar
+  time_t now = time(0);
+  struct tm *local = localtime(&now);
+  int y = local->tm_year + 1900 - ((local->tm_mon < 2) ? 1 : 0);
+  int era = y / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * ((local->tm_mon + 10) % 12) + 2) / 5 + local->tm_mday - 1;
+  uint16_t day = era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+  StatsDay &entry = days[day % STATS_DAYS];
+  if (entry.day != day) {
+    entry.day = day;
+    entry.brightnessChanges = 0;
+    storedDayChanges[day % STATS_DAYS] = 0xffff; // Not yet written
+  }
+  entry.brightnessChanges += 1 + undatedBrightnessChanges;
+  undatedBrightnessChanges = 0;
+}
+
+/**
+ * Have any counters other than the uptime changed since they were written?
+ */
+static bool changed() {
+  for (uint8_t i = 0 ; i < STATS_COUNTERS ; i++) {
+    if ((i != STATS_UPTIME) && (values[i] != storedValues[i])) return true;
+  }
+  for (uint8_t i = 0 ; i < STATS_DAYS ; i++) {
+    if (days[i].day && (days[i].brightnessChanges != storedDayChanges[i])) return true;
+  }
+  return false;
+}
+
+/**
+ * Write the counters that have changed
+ */
+static void save(bool uptime) {
+  uint16_t needed = 0;
+  for (uint8_t i = 0 ; i < STATS_COUNTERS ; i++) {
+    if ((values[i] != storedValues[i]) && (uptime || (i != STATS_UPTIME))) needed++;
+  }
+  for (uint8_t i = 0 ; i < STATS_DAYS ; i++) {
+    if (days[i].day && (days[i].brightnessChanges != storedDayChanges[i])) needed++;
+  }
+  if (writeSlot + needed > STATS_RECORDS_PER_SECTOR) {
+    // The snapshot at the start of the next sector writes everything
+    if (spareErased) startNextSector();
+    return;
+  }
+  for (uint8_t i = 0 ; i < STATS_COUNTERS ; i++) {
+    if ((values[i] != storedValues[i]) && (uptime || (i != STATS_UPTIME))) appendCounter(i);
+  }
+  for (uint8_t i = 0 ; i < STATS_DAYS ; i++) {
+    if (days[i].day && (days[i].brightnessChanges != storedDayChanges[i])) appendDay(i);
+  }
+}
+
+/**
+ * Statistics polling loop
+ */
+void statsPoll() {
+  unsigned long gap = millis() - lastPoll;
+  uint16_t reconnects = getWiFiReconnectCount();
+  bool late;
+  if (lastPoll) {
+    // Time spent asleep in powerSleep() isn't a stall
+    unsigned long busy = gap - min(gap, getLastSleepMillis());
+    if (busy > values[STATS_WORST_STALL]) values[STATS_WORST_STALL] = busy;
+    uptimeMillis += gap;
+    values[STATS_UPTIME] += uptimeMillis / 1000;
+    uptimeMillis %= 1000;
+  }
+  lastPoll = millis();
+  if (reconnects != lastReconnects) {
+    values[STATS_RECONNECTS] += (uint16_t)(reconnects - lastReconnects);
+    lastReconnects = reconnects;
+  }
+  late = timeIsSynced() ? (millisSinceSync() >= STATS_SYNC_LATE_MILLIS)
+    : (WiFi.isConnected() && (millis() >= STATS_FIRST_SYNC_MILLIS));
+  if (late && !syncLate) values[STATS_SYNC_FAILURES]++;
+  syncLate = late;
+
+  if (!sectorCount) return;
+  // The flash is only touched just after a tick, so the next one can't be held up
+  if (timeIsSynced() && (millisSinceTick() >= STATS_TICK_WINDOW_MILLIS)) return;
+  if (!spareErased && snapshotComplete) {
+    uint8_t spare = (active + 1) % sectorCount;
+    if (!sectorIsBlank(spare)) {
+      eraseSector(spare);
+      // Until it's in use, this is the only place its erase count is kept
+      append(STATS_RECORD_ERASED, spare, 0, sectorErases[spare]);
+    }
+    spareErased = true;
+    return; // That's enough for one tick
+  }
+  bool uptime = (millis() - lastUptimeSave) >= STATS_UPTIME_SAVE_MILLIS;
+  if (!uptime && (((millis() - lastSave) < STATS_SAVE_MILLIS) || !changed())) return;
+  lastSave = millis();
+  if (uptime) lastUptimeSave = millis();
+  save(uptime);
+}
+
+uint32_t getStatsCounter(uint8_t counter) {
+  return (counter < STATS_COUNTERS) ? values[counter] : 0;
+}
+
+/**
+ * Copy the days with brightness changes, most recent first. Returns how many there are
+ */
+uint8_t getStatsDays(StatsDay *ans) {
+  uint8_t count = 0;
+  for (uint8_t i = 0 ; i < STATS_DAYS ; i++) {
+    uint8_t j;
+    if (!days[i].day) continue;
+    for (j = count ; (j > 0) && (ans[j - 1].day < days[i].day) ; j--) ans[j] = ans[j - 1];
+    ans[j] = days[i];
+    count++;
+  }
+  return count;
+}
+
+void getStatsFlashInfo(StatsFlashInfo *info) {
+  info->sectors = sectorCount;
+  info->activeSector = active;
+  info->recordsUsed = writeSlot;
+  info->sequence = sequence;
+  info->maxErases = 0;
+  for (uint8_t i = 0 ; i < sectorCount ; i++) info->maxErases = max(info->maxErases, sectorErases[i]);
+  info->appends = appends;
+}
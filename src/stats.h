@@ -0,0 +1,40 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <Arduino.h>
+
+// The long term counters - these numbers are stored in flash, so must not change
+#define STATS_UPTIME 0             // Seconds, over the clock's life
+#define STATS_BOOTS 1
+#define STATS_RESET_REASONS 2      // .. 8, one for each of the ESP's reset reasons (REASON_DEFAULT_RST ..)
+#define STATS_RESET_REASON_COUNT 7
+#define STATS_SYNC_FAILURES 9      // Times the time hasn't been set for much longer than it should
+#define STATS_RECONNECTS 10        // WiFi reconnections
+#define STATS_WORST_STALL 11       // Longest loop() has taken, in milliseconds
+#define STATS_BRIGHTNESS_CHANGES 12
+#define STATS_COUNTERS 13
+
+#define STATS_DAYS 32              // Days of brightness changes kept
+
+typedef struct StatsDay_t {
+  uint16_t day;                    // Days since 1970, local time - 0 for an unused entry
+  uint16_t brightnessChanges;
+} StatsDay;
+
+typedef struct StatsFlashInfo_t {
+  uint8_t sectors;                 // 0 if there is no flash set aside for the statistics
+  uint8_t activeSector;
+  uint16_t recordsUsed;            // In the active sector
+  uint32_t sequence;               // Sectors filled since the store was created
+  uint32_t maxErases;              // The most any sector has been erased
+  uint32_t appends;                // Records written since boot
+} StatsFlashInfo;
+
+void initStats();
+void statsPoll();
+void statsCount(uint8_t counter);
+uint32_t getStatsCounter(uint8_t counter);
+uint8_t getStatsDays(StatsDay *days);
+void getStatsFlashInfo(StatsFlashInfo *info);
+
+#endif
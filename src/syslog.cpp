@@ -0,0 +1,181 @@
+// syslog.cpp - send events and metrics to a syslog server, over UDP
+//
+// Messages are formatted as RFC 5424 and sent one per datagram (RFC 5426) to the server named by
+// CFG_SYSLOG_HOST, if one is set. logMessage() only records the message, with the time, in a ring
+// buffer; syslogPoll() sends a few at a time, at a limited rate, so neither ever waits on the
+// network. If the buffer fills up, new messages are dropped and counted.
+//
+// logMessage() must not be called from an interrupt handler. Web server and lwIP callbacks are fine,
+// as they never run in the middle of loop()
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include "syslog.h"
+#include "config.h"
+#include "timekeeping.h"
+#include "version.h"
+#include "debug.h"
+
+#define SYSLOG_BUFFER_SIZE 16            // Messages held waiting to be sent - must be a power of 2
+#define SYSLOG_TEXT_LENGTH 96
+#define SYSLOG_MSGID_LENGTH 8
+#define SYSLOG_FACILITY 16               // local0
+// Rate limit - a bucket of tokens, refilled at SYSLOG_MAX_PER_SECOND up to SYSLOG_BURST
+#define SYSLOG_MAX_PER_SECOND 10
+#define SYSLOG_BURST 16
+#define SYSLOG_MAX_PER_POLL 4
+#define SYSLOG_METRICS_MILLIS (5UL * 60UL * 1000UL)
+#define SYSLOG_RESOLVE_MILLIS (10UL * 60UL * 1000UL)
+#define SYSLOG_HOST_MAX_LENGTH 64
+
+typedef struct SyslogRecord_t {
+  struct timeval time;
+  uint8_t severity;
+  bool synced;               // Whether the time was right when the message was logged
+  char msgid[SYSLOG_MSGID_LENGTH];
+  char text[SYSLOG_TEXT_LENGTH];
+} SyslogRecord;
+
+static SyslogRecord records[SYSLOG_BUFFER_SIZE];
+static uint8_t head = 0;                  // Next record to write
+static uint8_t tail = 0;                  // Next record to send
+static SyslogStats stats;
+static uint64_t logMicrosTotal = 0;
+static uint32_t logged = 0;
+static uint64_t sendMicrosTotal = 0;
+static WiFiUDP udp;
+static bool udpOpen = false;
+static uint8_t tokens = SYSLOG_BURST;
+static unsigned long lastRefill = 0;
+static unsigned long lastMetrics = 0;
+// The server, worked out again whenever the configuration changes
+static bool configured = false;
+static uint32_t configGeneration = 0;
+static char host[SYSLOG_HOST_MAX_LENGTH];
+static uint16_t port = SYSLOG_DEFAULT_PORT;
+static volatile uint32_t address = 0;     // In network order, 0 until resolved
+static unsigned long lastResolve = 0;
+static String hostname;
+
+/**
+ * Record a message to be sent to the syslog server. Called through logMessage()
+ */
+void logMessage_P(uint8_t severity, const char *msgid, PGM_P format, ...) {
+  unsigned long start = micros();
+  SyslogRecord *record;
+  va_list args;
+  if ((uint8_t)(head - tail) >= SYSLOG_BUFFER_SIZE) {
+    stats.dropped++;
+    return;
+  }
+  record = &records[head & (SYSLOG_BUFFER_SIZE - 1)];
+  gettimeofday(&record->time, 0);
+  record->synced = timeIsSynced();
+  record->severity = severity;
+  strncpy(record->msgid, msgid, SYSLOG_MSGID_LENGTH - 1);
+  record->msgid[SYSLOG_MSGID_LENGTH - 1] = 0;
+  va_start(args, format);
+  vsnprintf_P(record->text, SYSLOG_TEXT_LENGTH, format, args);
+  va_end(args);
+  head++;
+  logMicrosTotal += micros() - start;
+  logged++;
+}
+
+/**
+ * Called by lwIP when the server's name has been looked up
+ */
+static void foundCB(const char *, const ip_addr_t *ip, void *) {
+  if (ip && IP_IS_V4(ip)) address = ip_addr_get_ip4_u32(ip);
+}
+
+/**
+ * Pick up the server from the stored configuration - "host" or "host:port"
+ */
+static void configure() {
+  String value = getStringConfig(CFG_SYSLOG_HOST);
+  int colon = value.indexOf(':');
+  configGeneration = getConfigGeneration();
+  configured = true;
+  port = SYSLOG_DEFAULT_PORT;
+  if (colon >= 0) {
+    port = value.substring(colon + 1).toInt();
+    value.remove(colon);
+  }
+  strncpy(host, value.c_str(), SYSLOG_HOST_MAX_LENGTH - 1);
+  host[SYSLOG_HOST_MAX_LENGTH - 1] = 0;
+  address = 0;
+  lastResolve = millis() - SYSLOG_RESOLVE_MILLIS;
+  hostname = getStringConfig(CFG_HOSTNAME, String("303Clock"));
+}
+
+/**
+ * Send one record, formatted as RFC 5424
+ */
+static void send(const SyslogRecord &record) {
+  char timestamp[32] = "-";
+  // A message logged before the time was set is sent without one, even if it is set by now
+  if (record.synced) {
+    struct tm *utc = gmtime(&record.time.tv_sec);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", utc);
+    snprintf(timestamp + 19, sizeof(timestamp) - 19, ".%03luZ", (unsigned long)record.time.tv_usec / 1000);
+  }
+  udp.beginPacket(IPAddress(address), port);
+  // <PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+  udp.printf_P(PSTR("<%u>1 %s %s clock - %s - %s"), SYSLOG_FACILITY * 8 + record.severity, timestamp,
+    hostname.c_str(), record.msgid[0] ? record.msgid : "-", record.text);
+  udp.endPacket();
+}
+
+/**
+ * Syslog polling loop - sends waiting messages, and every few minutes some metrics
+ */
+void syslogPoll() {
+  unsigned long refill;
+  if (!configured || (configGeneration != getConfigGeneration())) configure();
+  if (!host[0]) {
+    tail = head; // Nowhere to send them
+    return;
+  }
+  if ((millis() - lastMetrics) >= SYSLOG_METRICS_MILLIS) {
+    lastMetrics = millis();
+    logMessage(SYSLOG_INFO, "metrics", "uptime=%lu heap=%u rssi=%d tickLate=%u dropped=%u",
+      millis() / 1000, ESP.getFreeHeap(), WiFi.RSSI(), getWorstTickLateness(), stats.dropped);
+  }
+  if (!WiFi.isConnected()) return;
+  if (!address || ((millis() - lastResolve) >= SYSLOG_RESOLVE_MILLIS)) {
+    ip_addr_t ip;
+    if ((millis() - lastResolve) >= SYSLOG_RESOLVE_MILLIS) {
+      lastResolve = millis();
+      if (dns_gethostbyname(host, &ip, foundCB, 0) == ERR_OK) foundCB(host, &ip, 0);
+    }
+    if (!address) return;
+  }
+  if (!udpOpen) udpOpen = udp.begin(0);
+  refill = (millis() - lastRefill) * SYSLOG_MAX_PER_SECOND / 1000UL;
+  if (refill) {
+    tokens = min((unsigned long)SYSLOG_BURST, tokens + refill);
+    lastRefill = millis();
+  }
+  for (int i = 0 ; (i < SYSLOG_MAX_PER_POLL) && tokens && (tail != head) ; i++) {
+    unsigned long start = micros();
+    send(records[tail & (SYSLOG_BUFFER_SIZE - 1)]);
+    sendMicrosTotal += micros() - start;
+    tail++;
+    tokens--;
+    stats.sent++;
+  }
+}
+
+/**
+ * How many messages have been sent and dropped since boot, and what recording them costs
+ */
+void getSyslogStats(SyslogStats *ans) {
+  *ans = stats;
+  ans->logMicros = logged ? logMicrosTotal / logged : 0;
+  ans->sendMicros = stats.sent ? sendMicrosTotal / stats.sent : 0;
+}
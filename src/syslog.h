@@ -0,0 +1,33 @@
+#ifndef _SYSLOG_H_
+#define _SYSLOG_H_
+
+#include <Arduino.h>
+
+// Severities, from RFC 5424
+#define SYSLOG_ERR 3
+#define SYSLOG_WARNING 4
+#define SYSLOG_NOTICE 5
+#define SYSLOG_INFO 6
+
+#define SYSLOG_DEFAULT_PORT 514
+
+typedef struct SyslogStats_t {
+  uint32_t sent;
+  uint32_t dropped;          // Records lost because the buffer was full
+  uint32_t logMicros;        // Average time for logMessage() to record a message
+  uint32_t sendMicros;       // Average time to format and send one
+} SyslogStats;
+
+// Records a message. The format must be a string literal - it is kept in flash. The compiler can't
+// see through PSTR() to check the arguments against it, so it is checked as the literal too
+#define logMessage(severity, msgid, format, ...) do { \
+    if (0) logFormatCheck(format, ##__VA_ARGS__); \
+    logMessage_P(severity, msgid, PSTR(format), ##__VA_ARGS__); \
+  } while (0)
+
+static inline void __attribute__((format(printf, 1, 2))) logFormatCheck(const char *format, ...) {}
+void logMessage_P(uint8_t severity, const char *msgid, PGM_P format, ...) __attribute__((format(printf, 3, 4)));
+void syslogPoll();
+void getSyslogStats(SyslogStats *stats);
+
+#endif
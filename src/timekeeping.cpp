@@ -1,9 +1,22 @@
 #include <Arduino.h>
 #include <sntp.h>
+#include <sys/time.h>
 #include "timekeeping.h"
 #include "config.h"
 #include "display.h"
 #include "wifi.h"
+#include "zones.h"
+#include "ntpdns.h"
+#include "timer.h"
+#include "syslog.h"
+#include "leap.h"
+#include "pages.h"
+#include "debug.h"
+
+// Changes bigger than this are shown at once
+#define CLOCK_SLEW_MAX_MICROS 2000000LL
+// How fast the displayed time catches up - 500 ppm is 1.8 seconds an hour, as ntpd slews
+#define CLOCK_SLEW_PPM 500
 
 static time_t lastDisplayUpdate = 0;
 static unsigned long lastUpdateMillis = 0;
@@ -11,6 +24,19 @@ static bool colon = false;
 static bool initialised = false;
 static volatile bool hasTime = false;
 static unsigned long hasTimeCheck = 0;
+static volatile unsigned long lastSyncMillis = 0;
+static unsigned long firstSyncMillis = 0;     // millis() when we first got the time
+static bool syncShown = false;
+static uint16_t worstLateness = 0;            // Milliseconds, since boot or the last reset
+// When the time was last set, both as the time of day and by micros64(), in microseconds
+static int64_t syncTimeMicros = 0;
+static uint64_t syncAtMicros = 0;
+static int32_t lastOffsetMillis = 0;          // How far the last setting moved the time
+// Rather than jumping when the time is set, the displayed time is slewed to it from where it was
+static int32_t slewMicros = 0;                // Displayed minus system time, as of slewFromMicros
+static uint64_t slewFromMicros = 0;
+static bool ownStep = false;                  // The clock is being stepped for a leap second
+static bool leapTick = false;                 // Show the minute before midnight again, for the extra second
 const char *ntp1 = 0;
 const char *ntp2 = 0;
 const char *ntp3 = 0;
@@ -30,23 +56,41 @@ const char *ntp3 = 0;
  * This specifies day d of week w of month m. The day d must be between 0 (Sunday) and 6.
  * The week w must be between 1 and 5; week 1 is the first week in which day d occurs,
  * and week 5 specifies the last d day in the month. The month m should be between 1 and 12.
+ *
+ * If a zone from the built-in database has been chosen, its rule is used instead
  */
 String getTimezoneString() {
     String ans;
-    int8_t i;
+    int16_t minutes;
+    if (hasConfig(CFG_ZONE)) {
+        char rule[ZONE_RULE_MAX_LENGTH];
+#ifdef DEBUGGING
+        unsigned long start = micros();
+#endif
+        bool found = getZoneRule(getStringConfig(CFG_ZONE).c_str(), rule, sizeof(rule));
+        DEBUG("Zone lookup took %lu us\n", micros() - start)
+        if (found) {
+            DEBUG("TZ is : \"%s\"\n", rule)
+            return String(rule);
+        }
+    }
     if (hasConfig(CFG_TZ_NAME)) {
         ans.concat(getStringConfig(CFG_TZ_NAME));
     } else {
         ans.concat("UNK");
     }
-    i = getInt8Config(CFG_TIMEZONE, 0);
-    if (i < 0) {
+    // POSIX offsets are the time to add to get to UTC, so are positive west of Greenwich
+    minutes = -getTimezoneMinutes();
+    if (minutes < 0) {
         ans.concat('-');
-        i = -i;
-    } else if (i > 0) {
-        ans.concat('+');
+        minutes = -minutes;
+    }
+    ans.concat(minutes / 60);
+    if (minutes % 60) {
+        ans.concat(':');
+        if ((minutes % 60) < 10) ans.concat('0');
+        ans.concat(minutes % 60);
     }
-    ans.concat(i);
     if (hasConfig(CFG_DST_NAME)) {
         String dstName = getStringConfig(CFG_DST_NAME);
         if (!dstName.isEmpty()) {
@@ -80,8 +124,7 @@ String getTimezoneString() {
  * Display the time on the LED
  */
 void displayTime(time_t now) {
-    struct tm *local = localtime(&now);
-    showTime(local->tm_hour, local->tm_min);
+    showPage(now);
     lastDisplayUpdate = now;
     lastUpdateMillis = millis();
     colon = true;
@@ -92,16 +135,83 @@ void displayTime(time_t now) {
  * when the NTP client has figured out the time
  */
 void setTimeOfDayCB() {
+    struct timeval now;
+    uint64_t nowMicros = micros64();
+    int64_t nowTimeMicros;
     DEBUG("Set time of day being called\n")
+    gettimeofday(&now, 0);
+    if (ownStep) {
+        ownStep = false; // stepForLeap() has allowed for it
+        return;
+    }
+    nowTimeMicros = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+    if (hasTime) {
+        // Where our clock would have been, had it not just been set
+        int64_t offsetMicros = nowTimeMicros - (syncTimeMicros + (int64_t)(nowMicros - syncAtMicros));
+        lastOffsetMillis = offsetMicros / 1000;
+        if (leapStepTaken(offsetMicros, now.tv_sec)) {
+            // Only the rest of the change is slewed, as for stepForLeap()
+            offsetMicros += getLeapPending() * 1000000LL;
+            leapTick = (getLeapPending() > 0) && (getLeapPolicy() == LEAP_STEP);
+        }
+        if ((offsetMicros > CLOCK_SLEW_MAX_MICROS) || (offsetMicros < -CLOCK_SLEW_MAX_MICROS)) {
+            slewMicros = 0;
+        } else {
+            slewMicros = getClockSlewMicros() - offsetMicros;
+        }
+        slewFromMicros = nowMicros;
+    }
+    syncTimeMicros = nowTimeMicros;
+    syncAtMicros = nowMicros;
+    noteTimeSync();
     if (!hasTime) {
         lastDisplayUpdate = time(0); // Start showing the time at the start of the next second
+        firstSyncMillis = millis();
         hasTime = true;
+        logMessage(SYSLOG_INFO, "sync", "Time set, %lu ms after boot", firstSyncMillis);
     }
 }
 
+/**
+ * How far the displayed time is from the system time, in microseconds, while it catches up with
+ * the last change to the system time
+ */
+int32_t getClockSlewMicros() {
+    int64_t caughtUp = (int64_t)((micros64() - slewFromMicros) * CLOCK_SLEW_PPM / 1000000ULL);
+    if (slewMicros > caughtUp) return slewMicros - caughtUp;
+    if (slewMicros < -caughtUp) return slewMicros + caughtUp;
+    return 0;
+}
+
+/**
+ * The time to show - the system time, slewed after it has been set, and with any leap second smear
+ */
+void getClockTime(struct timeval *now) {
+    int64_t micros;
+    gettimeofday(now, 0);
+    micros = (int64_t)now->tv_sec * 1000000LL + now->tv_usec + getClockSlewMicros() + getLeapSmearMicros(*now);
+    now->tv_sec = micros / 1000000LL;
+    now->tv_usec = micros % 1000000LL;
+}
+
+/**
+ * Step the system clock back (or forward) a second for a leap second
+ */
+static void stepForLeap(int8_t seconds) {
+    struct timeval now;
+    DEBUG("Stepping the clock by %d s for a leap second\n", -seconds)
+    gettimeofday(&now, 0);
+    now.tv_sec -= seconds;
+    syncTimeMicros -= seconds * 1000000LL;
+    ownStep = true;
+    settimeofday(&now, 0);
+    leapTick = (seconds > 0) && (getLeapPolicy() == LEAP_STEP);
+}
+
 // The pointers to the server names must remain valid at all times
 void addNTPServer(const char *tag) {
-    const char *server = getStringConfig(tag).c_str();
+    String value = getStringConfig(tag);
+    const char *server = value.c_str();
     char *storage;
     if (!(*server)) return;
     storage = (char*)malloc(strlen(server)+1);
@@ -120,16 +230,84 @@ void addNTPServer(const char *tag) {
  */
 void initTimekeeping() {
     DEBUG("Initialising the timekeeping system\n")
-    setLEDSegments(LED_CHAR_S, LED_CHAR_y, LED_CHAR_n, LED_CHAR_C);
     settimeofday_cb(setTimeOfDayCB);
     addNTPServer(CFG_NTP_SERVER_1);
     addNTPServer(CFG_NTP_SERVER_2);
     addNTPServer(CFG_NTP_SERVER_3);
     configTime(getTimezoneString().c_str(), ntp1, ntp2, ntp3);
+    useCachedNTPAddresses();
     initialised = true;
     hasTimeCheck = millis();
 }
 
+/**
+ * Do we have the time from an NTP server?
+ */
+bool timeIsSynced() {
+    return hasTime;
+}
+
+/**
+ * How long ago, in milliseconds, the time was last set from an NTP server
+ */
+unsigned long millisSinceSync() {
+    return millis() - lastSyncMillis;
+}
+
+/**
+ * Record that the time has just been confirmed, without it needing to be set
+ */
+void noteTimeSync() {
+    lastSyncMillis = millis();
+}
+
+/**
+ * How far, in milliseconds, the time was moved when it was last set - positive if our clock was
+ * slow. 0 until it has been set twice
+ */
+int32_t getLastSyncOffset() {
+    return lastOffsetMillis;
+}
+
+/**
+ * How long after boot, in milliseconds, we first got the time - 0 if we haven't yet
+ */
+unsigned long millisToFirstSync() {
+    return hasTime ? firstSyncMillis : 0;
+}
+
+/**
+ * The latest the display has changed after the start of a second, in milliseconds
+ */
+uint16_t getWorstTickLateness() {
+    return worstLateness;
+}
+
+void resetWorstTickLateness() {
+    worstLateness = 0;
+}
+
+/**
+ * How long ago, in milliseconds, the display last changed to show a new second
+ */
+unsigned long millisSinceTick() {
+    return millis() - lastUpdateMillis;
+}
+
+/**
+ * How long until timekeepingPoll() next has something to change on the display, in milliseconds -
+ * the colon going off, or the next second. 0 if it can't say, because the time isn't being shown
+ */
+unsigned long millisUntilTick() {
+    struct timeval now;
+    unsigned long sinceUpdate = millis() - lastUpdateMillis;
+    if (!hasTime || !lastDisplayUpdate || displayIsScrolling() || timerIsActive()) return 0;
+    if (colon) return (sinceUpdate < 500) ? 500 - sinceUpdate : 0;
+    getClockTime(&now);
+    // Just past the start of the next second, and never before timekeepingPoll() will look for it
+    return max(1000UL - now.tv_usec / 1000, (sinceUpdate < 950) ? 950 - sinceUpdate : 0UL) + 1;
+}
+
 /**
  * Timekeeping polling loop
  */
@@ -137,6 +315,7 @@ void timekeepingPoll() {
     unsigned long timeSinceUpdateMillis;
 
     if (!hasTime) {
+      // Start asking for the time straight away, even while the IP address is scrolling past
       if (hasWiFiConnection()) {
         if (!initialised) {
             initTimekeeping();
@@ -148,8 +327,25 @@ void timekeepingPoll() {
             }
         }
       }
+      if (initialised && !syncShown && !displayIsScrolling() && !timerIsActive()) {
+        showText("SynC");
+        syncShown = true;
+      }
       return;
     }
+    if (getLeapPending()) {
+        // Stepped as the displayed time reaches midnight, so the extra second gets a full tick
+        struct timeval now;
+        int8_t leap;
+        getClockTime(&now);
+        leap = leapStepDue(now.tv_sec);
+        if (leap) stepForLeap(leap);
+    }
+    if (displayIsScrolling() || timerIsActive()) {
+        leapTick = false;
+        lastDisplayUpdate = 0; // Let the text (or timer) finish before the display is taken over, then show the time at once
+        return;
+    }
     timeSinceUpdateMillis = millis() - lastUpdateMillis;
     if (timeSinceUpdateMillis < 500) {
         return; // Nothing could have changed within 500ms of last update
@@ -158,7 +354,16 @@ void timekeepingPoll() {
     } else if (timeSinceUpdateMillis < 950) {
         return; // Nothing else can happen until just before the next second
     } else {
-        time_t now = time(0);
-        if (now != lastDisplayUpdate) displayTime(now);
+        struct timeval now;
+        getClockTime(&now);
+        if ((now.tv_sec != lastDisplayUpdate) || leapTick) {
+            if (lastDisplayUpdate && (now.tv_sec > lastDisplayUpdate)) {
+                // How long after the start of the second the display changes
+                uint32_t lateness = (uint32_t)(now.tv_sec - lastDisplayUpdate - 1) * 1000UL + now.tv_usec / 1000;
+                if (lateness > worstLateness) worstLateness = min(lateness, (uint32_t)UINT16_MAX);
+            }
+            leapTick = false;
+            displayTime(now.tv_sec);
+        }
     }
 }
@@ -1,7 +1,21 @@
 #ifndef _TIMEKEEPING_H_
 #define _TIMEKEEPING_H_
 
+#include <Arduino.h>
+#include <sys/time.h>
+
 void initTimekeeping();
 void timekeepingPoll();
+bool timeIsSynced();
+unsigned long millisSinceSync();
+void noteTimeSync();
+unsigned long millisToFirstSync();
+int32_t getLastSyncOffset();
+uint16_t getWorstTickLateness();
+unsigned long millisSinceTick();
+unsigned long millisUntilTick();
+void resetWorstTickLateness();
+void getClockTime(struct timeval *now);
+int32_t getClockSlewMicros();
 
 #endif
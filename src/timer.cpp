@@ -0,0 +1,192 @@
+// timer.cpp - stopwatch and countdown timer
+//
+// While a timer is running the display is redrawn every TIMER_FRAME_MICROS, on a fixed schedule so
+// that lateness doesn't build up, and loop() only sleeps for a millisecond between passes (see
+// powerSleep() in power.cpp) so each frame is shown close to when it is due. Only the digits that
+// change are sent to the TM1650 - usually one or two - so a frame takes well under a millisecond of
+// bus time, and the WiFi and web server still get the rest.
+//
+// Under a minute the display shows seconds and hundredths, with a steady colon; from a minute it
+// shows minutes and seconds, with the colon flashing.
+
+#include <Arduino.h>
+#include "timer.h"
+#include "alarms.h"
+#include "display.h"
+#include "debug.h"
+
+#define TIMER_FRAME_MICROS 20000UL                      // 50 frames a second
+#define TIMER_MAX_MILLIS (100UL * 60UL * 1000UL - 1)    // 99:59 is the most that can be shown
+
+static uint8_t mode = TIMER_OFF;
+static bool running = false;
+static uint32_t countdownMillis = TIMER_DEFAULT_COUNTDOWN_SECONDS * 1000UL;
+static uint32_t accumulatedMillis = 0;   // Counted before the current run started
+static unsigned long startedAt = 0;      // millis() when the current run started
+static unsigned long nextFrameAt = 0;    // micros()
+static unsigned long runStartMicros = 0;
+static unsigned long runMicros = 0;      // Length of the last run, once it has stopped
+static bool redraw = false;
+static TimerStats stats;
+
+/**
+ * How long the timer has been running for, in total
+ */
+static uint32_t elapsedMillis() {
+    return accumulatedMillis + (running ? millis() - startedAt : 0);
+}
+
+/**
+ * Show a time on the display
+ */
+static void draw(uint32_t ms) {
+    uint32_t seconds = ms / 1000;
+    if (seconds < 60) {
+        uint8_t hundredths = (ms % 1000) / 10;
+        setLEDSegments('0' + seconds / 10, '0' + seconds % 10, '0' + hundredths / 10, '0' + hundredths % 10, true);
+    } else {
+        uint32_t minutes = seconds / 60;
+        seconds %= 60;
+        setLEDSegments('0' + minutes / 10, '0' + minutes % 10, '0' + seconds / 10, '0' + seconds % 10, (ms % 1000) < 500);
+    }
+}
+
+/**
+ * Change between showing the time, the stopwatch and the countdown timer. The timer is reset
+ */
+void setTimerMode(uint8_t newMode) {
+    stopTimer();
+    mode = (newMode <= TIMER_COUNTDOWN) ? newMode : TIMER_OFF;
+    accumulatedMillis = 0;
+    redraw = true;
+    DEBUG("Timer mode %u\n", mode)
+}
+
+uint8_t getTimerMode() {
+    return mode;
+}
+
+/**
+ * Start (or carry on) timing
+ */
+void startTimer() {
+    if ((mode == TIMER_OFF) || running) return;
+    if ((mode == TIMER_COUNTDOWN) && (elapsedMillis() >= countdownMillis)) accumulatedMillis = 0;
+    running = true;
+    startedAt = millis();
+    memset(&stats, 0, sizeof(stats));
+    runStartMicros = nextFrameAt = micros();
+}
+
+/**
+ * Stop timing, keeping the time so far
+ */
+void stopTimer() {
+    if (!running) return;
+    accumulatedMillis += millis() - startedAt;
+    runMicros = micros() - runStartMicros;
+    running = false;
+    redraw = true;
+}
+
+/**
+ * Stop timing, and go back to the start
+ */
+void resetTimer() {
+    stopTimer();
+    accumulatedMillis = 0;
+    redraw = true;
+}
+
+/**
+ * Set how long the countdown timer runs for, and reset it
+ */
+void setCountdownSeconds(uint32_t seconds) {
+    countdownMillis = constrain(seconds * 1000UL, 1000UL, TIMER_MAX_MILLIS);
+    if (mode == TIMER_COUNTDOWN) resetTimer();
+}
+
+/**
+ * The time on the timer - counting up for the stopwatch, or what's left of the countdown
+ */
+uint32_t getTimerMillis() {
+    uint32_t elapsed = elapsedMillis();
+    if (mode == TIMER_COUNTDOWN) return (elapsed >= countdownMillis) ? 0 : countdownMillis - elapsed;
+    return min(elapsed, (uint32_t)TIMER_MAX_MILLIS);
+}
+
+/**
+ * Is the display being used for a timer, rather than the time?
+ */
+bool timerIsActive() {
+    return mode != TIMER_OFF;
+}
+
+bool timerIsRunning() {
+    return running;
+}
+
+/**
+ * How well the display has kept up during the current (or last) run
+ */
+void getTimerStats(TimerStats *ans) {
+    unsigned long micro = running ? micros() - runStartMicros : runMicros;
+    *ans = stats;
+    ans->fpsHundredths = micro ? (uint32_t)((uint64_t)stats.frames * 100000000ULL / micro) : 0;
+}
+
+/**
+ * Timer polling loop - shows a frame whenever one is due
+ */
+void timerPoll() {
+    unsigned long late;
+    uint32_t ms;
+    if (mode == TIMER_OFF) return;
+    if (!running) {
+        if (redraw) draw(getTimerMillis());
+        redraw = false;
+        return;
+    }
+    late = micros() - nextFrameAt;
+    if ((long)late < 0) return;
+    if (late > stats.worstLateMicros) stats.worstLateMicros = late;
+    if (late >= TIMER_FRAME_MICROS) {
+        // Held up for a whole frame or more - skip the frames we missed rather than rushing to catch up
+        stats.missedFrames += late / TIMER_FRAME_MICROS;
+        nextFrameAt += (late / TIMER_FRAME_MICROS) * TIMER_FRAME_MICROS;
+    }
+    nextFrameAt += TIMER_FRAME_MICROS;
+    stats.frames++;
+    ms = getTimerMillis();
+    draw(ms);
+    if ((mode == TIMER_COUNTDOWN) && !ms) {
+        DEBUG("Countdown finished\n")
+        stopTimer();
+        startRinging();
+    }
+}
+
+/**
+ * UP starts and stops the timer
+ */
+void timerUpPressed() {
+    if (running) {
+        stopTimer();
+    } else {
+        startTimer();
+    }
+}
+
+/**
+ * DOWN resets a stopped timer. On a countdown that is already reset, it adds a minute (going back to
+ * one minute after 99)
+ */
+void timerDownPressed() {
+    if (running) return;
+    if ((mode == TIMER_COUNTDOWN) && !accumulatedMillis) {
+        uint32_t minutes = countdownMillis / 60000UL + 1;
+        setCountdownSeconds((minutes > 99) ? 60 : minutes * 60);
+    } else {
+        resetTimer();
+    }
+}
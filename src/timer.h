@@ -0,0 +1,33 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <Arduino.h>
+
+#define TIMER_OFF 0          // Showing the time
+#define TIMER_STOPWATCH 1
+#define TIMER_COUNTDOWN 2
+
+#define TIMER_DEFAULT_COUNTDOWN_SECONDS 300
+
+typedef struct TimerStats_t {
+  uint32_t frames;           // Frames shown while running, since the last start
+  uint32_t fpsHundredths;    // Achieved frame rate, in hundredths of a frame per second
+  uint32_t worstLateMicros;  // Latest a frame has been shown after it was due
+  uint32_t missedFrames;     // Frames skipped because loop() was held up for a whole frame or more
+} TimerStats;
+
+void setTimerMode(uint8_t mode);
+uint8_t getTimerMode();
+void startTimer();
+void stopTimer();
+void resetTimer();
+void setCountdownSeconds(uint32_t seconds);
+uint32_t getTimerMillis();
+bool timerIsActive();
+bool timerIsRunning();
+void getTimerStats(TimerStats *stats);
+void timerPoll();
+void timerUpPressed();
+void timerDownPressed();
+
+#endif
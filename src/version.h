@@ -0,0 +1,6 @@
+#ifndef _VERSION_H_
+#define _VERSION_H_
+
+#define FIRMWARE_VERSION "1.1.0"
+
+#endif
@@ -1,4 +1,5 @@
 #include <Arduino.h>
+#include <memory>
 #include <ESP8266WiFi.h>
 #include <ESPAsyncTCP.h>
 #include <ESPAsyncWebServer.h>
@@ -6,14 +7,140 @@
 #include "webserver.h"
 #include "display.h"
 #include "debug.h"
+#include "ota.h"
+#include "version.h"
+#include "events.h"
+#include "brightness.h"
+#include "commands.h"
+#include "zones.h"
+#include "pagecache.h"
+#include "bench.h"
+#include "alarms.h"
+#include "timer.h"
+#include "ntpdns.h"
+#include "timekeeping.h"
+#include "wifi.h"
+#include "syslog.h"
+#include "mqtt.h"
+#include "stats.h"
+#include "leap.h"
+#include "power.h"
+#include "pages.h"
+
+// Admission control for the pages that take a lot of work or memory to produce
+#define WEB_MAX_RENDERS 2              // Pages being produced at once
+#define WEB_MIN_FREE_HEAP 8192         // Below this, those pages are refused
+#define WEB_CLIENT_SLOTS 8             // Clients tracked by the rate limit
+#define WEB_CLIENT_PER_SECOND 2        // Each client's sustained rate
+#define WEB_CLIENT_BURST 4
+// Longest to wait for the benchmarks to run
+#define BENCH_TIMEOUT_MILLIS 5000UL
+
+// A client's rate limit - a bucket of tokens, refilled at WEB_CLIENT_PER_SECOND up to WEB_CLIENT_BURST
+typedef struct ClientBucket_t {
+  uint32_t address;
+  uint8_t tokens;
+  unsigned long lastRefill;
+} ClientBucket;
 
 AsyncWebServer server(80);
+static bool updateFailed = true; // Until an upload has actually started
+static AsyncWebServerRequest *updateRequest = 0; // The upload in progress - only one at a time
+static ClientBucket clients[WEB_CLIENT_SLOTS];
+static uint8_t rendersInFlight = 0;
+static uint32_t requestsRefused = 0;
 
 /**
  * Callback called when the main web page is requested
  */
 void onRoot(AsyncWebServerRequest *request);
 
+/**
+ * Take a token from a client's bucket. Clients not seen recently replace the one seen least recently
+ */
+static bool takeClientToken(uint32_t address) {
+  ClientBucket *bucket = &clients[0];
+  unsigned long refill;
+  for (uint8_t i = 0 ; i < WEB_CLIENT_SLOTS ; i++) {
+    if (clients[i].address == address) {
+      bucket = &clients[i];
+      break;
+    }
+    if ((millis() - clients[i].lastRefill) > (millis() - bucket->lastRefill)) bucket = &clients[i];
+  }
+  if (bucket->address != address) {
+    bucket->address = address;
+    bucket->tokens = WEB_CLIENT_BURST;
+    bucket->lastRefill = millis();
+  }
+  refill = (millis() - bucket->lastRefill) * WEB_CLIENT_PER_SECOND / 1000UL;
+  if (refill) {
+    bucket->tokens = min((unsigned long)WEB_CLIENT_BURST, bucket->tokens + refill);
+    bucket->lastRefill = millis();
+  }
+  if (!bucket->tokens) return false;
+  bucket->tokens--;
+  return true;
+}
+
+/**
+ * Decide whether to produce an expensive page, sending a refusal if not
+ *
+ * Pages are refused when memory is short or too many are already being sent (503), or when the
+ * client has been asking too often (429)
+ */
+static bool admitRequest(AsyncWebServerRequest *request) {
+  AsyncWebServerResponse *response;
+  if ((ESP.getFreeHeap() >= WEB_MIN_FREE_HEAP) && (rendersInFlight < WEB_MAX_RENDERS)) {
+    if (takeClientToken(request->client()->remoteIP())) {
+      rendersInFlight++;
+      notePowerActivity();
+      request->onDisconnect([]() { rendersInFlight--; });
+      return true;
+    }
+    response = request->beginResponse(429, "text/plain", "Too many requests");
+  } else {
+    response = request->beginResponse(503, "text/plain", "Busy - please try again");
+  }
+  requestsRefused++;
+  response->addHeader("Retry-After", "1");
+  request->send(response);
+  return false;
+}
+
+/**
+ * Format a timezone offset in minutes as "+H:MM"
+ */
+String formatTimezoneOffset(int16_t minutes) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%c%d:%02d", (minutes < 0) ? '-' : '+', abs(minutes) / 60, abs(minutes) % 60);
+  return String(buf);
+}
+
+/**
+ * Parse a timezone offset such as "+5:30", "-3" or "12:45" into minutes
+ */
+int16_t parseTimezoneOffset(const String &value) {
+  String offset = value;
+  int sign = 1;
+  int colon;
+  int minutes;
+  offset.trim();
+  if (offset.startsWith("-")) {
+    sign = -1;
+    offset.remove(0, 1);
+  } else if (offset.startsWith("+")) {
+    offset.remove(0, 1);
+  }
+  colon = offset.indexOf(':');
+  if (colon < 0) {
+    minutes = offset.toInt() * 60;
+  } else {
+    minutes = offset.substring(0, colon).toInt() * 60 + offset.substring(colon + 1).toInt();
+  }
+  return sign * constrain(minutes, 0, 14 * 60);
+}
+
 /**
  * Processor for the tags in our web page. Tags are delimited by percent signs - see
  * the documentation for AsyncWebServer for more information
@@ -24,12 +151,18 @@ String processor(const String& tag) {
     return getStringConfig(CFG_SSID);
   } else if (tag == "Hostname") {
     return getStringConfig(CFG_HOSTNAME, String("303Clock"));
+  } else if (tag == "APMin") {
+    return String(getInt8Config(CFG_AP_AFTER_MINUTES, WIFI_DEFAULT_AP_MINUTES));
   } else if (tag == "NTP1") {
     return getStringConfig(CFG_NTP_SERVER_1, String("0.pool.ntp.org"));
   } else if (tag == "NTP2") {
     return getStringConfig(CFG_NTP_SERVER_2, String("1.pool.ntp.org"));
   } else if (tag == "NTP3") {
     return getStringConfig(CFG_NTP_SERVER_3, String("2.pool.ntp.org"));
+  } else if (tag == "LOGHOST") {
+    return getStringConfig(CFG_SYSLOG_HOST);
+  } else if (tag == "MQTT") {
+    return getStringConfig(CFG_MQTT_BROKER);
   } else if (tag.startsWith("LED")) {
     int8_t ledLevel = tag.charAt(3)-'0';
     DEBUG("Led level %d\n", ledLevel)
@@ -44,10 +177,41 @@ String processor(const String& tag) {
     } else {
       return String();
     }
+  } else if (tag.startsWith("DIM")) {
+    Dimming_Schedule schedule;
+    char buf[8];
+    getDimmingSchedule(&schedule);
+    if (tag.startsWith("DIMMODE")) {
+      return (tag.substring(7).toInt() == schedule.mode) ? String("selected") : String();
+    } else if (tag.startsWith("DIMBRI")) {
+      return (tag.substring(6).toInt() == schedule.level) ? String("selected") : String();
+    } else if (tag == "DIMStart") {
+      snprintf(buf, sizeof(buf), "%02u:%02u", schedule.startMinute / 60, schedule.startMinute % 60);
+      return String(buf);
+    } else if (tag == "DIMEnd") {
+      snprintf(buf, sizeof(buf), "%02u:%02u", schedule.endMinute / 60, schedule.endMinute % 60);
+      return String(buf);
+    }
+  } else if ((tag == "Latitude") || (tag == "Longitude")) {
+    Dimming_Schedule schedule;
+    getDimmingSchedule(&schedule);
+    return String(((tag == "Latitude") ? schedule.latitude : schedule.longitude) / 100.0, 2);
+  } else if (tag == "CFGNTPSRV") {
+    return cfgBitIsSet(CFG_MASK_NTP_SERVER) ? String("checked") : String();
+  } else if (tag == "CFGNTPBC") {
+    return cfgBitIsSet(CFG_MASK_NTP_BROADCAST) ? String("checked") : String();
+  } else if (tag.startsWith("LEAP")) {
+    return (tag.substring(4).toInt() == getInt8Config(CFG_LEAP, LEAP_STEP)) ? String("selected") : String();
+  } else if (tag.startsWith("POWER")) {
+    return (tag.substring(5).toInt() == getPowerPolicy()) ? String("selected") : String();
+  } else if (tag.startsWith("PG")) {
+    return String(getInt8Config(tag.c_str(), (tag == CFG_PAGE_TIME) ? PAGE_DEFAULT_TIME_SECONDS : 0));
   } else if (tag == "TZName") {
     return getStringConfig(CFG_TZ_NAME, String("GMT"));
-  } else if (tag == "TZHrs") {
-    return String(getInt8Config(CFG_TIMEZONE, 0));
+  } else if (tag == "TZOffset") {
+    return formatTimezoneOffset(getTimezoneMinutes());
+  } else if (tag == "Zone") {
+    return getStringConfig(CFG_ZONE);
   } else if (tag == "DSTName") {
     return getStringConfig(CFG_DST_NAME);
   } else if (tag.startsWith("DST")) {
@@ -73,59 +237,620 @@ String processor(const String& tag) {
 /**
  * Update a stored configuration string parameter
  */
-void updateStringParam(AsyncWebServerRequest *request, const char *tag) {
-  if (!request->hasParam(tag, true)) return;
-  setStringConfig(tag, request->getParam(tag, true)->value());
+void updateStringParam(const CommandParams &params, const char *tag) {
+  if (!params.has(tag)) return;
+  setStringConfig(tag, params.get(tag));
 }
 
 /**
  * Update a stored configuration integer parameter
  */
-void updateInt8Param(AsyncWebServerRequest *request, const char *tag) {
-  if (!request->hasParam(tag, true)) return;
-  setInt8Config(tag, request->getParam(tag, true)->value().toInt());
+void updateInt8Param(const CommandParams &params, const char *tag) {
+  if (!params.has(tag)) return;
+  setInt8Config(tag, params.get(tag).toInt());
 }
 
 /**
  * Update a stored configuration DST change
  */
-void updateDSTChangeParam(AsyncWebServerRequest *request, bool isStart) {
+void updateDSTChangeParam(const CommandParams &params, bool isStart) {
   char tag[6];
   DST_Transition transition;
   tag[0]='D'; tag[1]='S'; tag[2]='T'; tag[3]=isStart?'S':'E'; tag[5]=0;
   tag[4]='W';
-  if (!request->hasParam(tag, true)) return;
-  transition.dowNumber = request->getParam(tag, true)->value().toInt();
+  if (!params.has(tag)) return;
+  transition.dowNumber = params.get(tag).toInt();
   tag[4] = 'D';
-  if (!request->hasParam(tag, true)) return;
-  transition.dow = request->getParam(tag, true)->value().toInt();
+  if (!params.has(tag)) return;
+  transition.dow = params.get(tag).toInt();
   tag[4] = 'M';
-  if (!request->hasParam(tag, true)) return;
-  transition.month = request->getParam(tag, true)->value().toInt();
+  if (!params.has(tag)) return;
+  transition.month = params.get(tag).toInt();
   tag[4] = 'T';
-  if (!request->hasParam(tag, true)) return;
-  transition.timeOfDay = request->getParam(tag, true)->value().toInt();
+  if (!params.has(tag)) return;
+  transition.timeOfDay = params.get(tag).toInt();
   setDSTConfig(transition, isStart);
 }
 
+/**
+ * Parse a "HH:MM" time into a minute of the day
+ */
+uint16_t parseMinuteOfDay(const String &value) {
+  int colon = value.indexOf(':');
+  int minute;
+  if (colon < 0) return value.toInt() * 60 % 1440;
+  minute = value.substring(0, colon).toInt() * 60 + value.substring(colon + 1).toInt();
+  return (minute < 0) ? 0 : minute % 1440;
+}
+
+/**
+ * Update the stored night dimming schedule
+ */
+void updateDimmingParams(const CommandParams &params) {
+  Dimming_Schedule schedule;
+  if (!params.has("DIMMODE")) return;
+  getDimmingSchedule(&schedule);
+  schedule.mode = params.get("DIMMODE").toInt();
+  if (schedule.mode > DIMMING_SUN) schedule.mode = DIMMING_OFF;
+  if (params.has("DIMBRI")) schedule.level = params.get("DIMBRI").toInt() & 7;
+  if (params.has("DIMS")) schedule.startMinute = parseMinuteOfDay(params.get("DIMS"));
+  if (params.has("DIME")) schedule.endMinute = parseMinuteOfDay(params.get("DIME"));
+  if (params.has("LAT")) schedule.latitude = lroundf(constrain(params.get("LAT").toFloat(), -90.0f, 90.0f) * 100);
+  if (params.has("LNG")) schedule.longitude = lroundf(constrain(params.get("LNG").toFloat(), -180.0f, 180.0f) * 100);
+  setDimmingSchedule(&schedule);
+  initBrightnessSchedule();
+}
+
 /**
  * Callback when the /brightness URL is called
  */
 void onBrightness(AsyncWebServerRequest *request) {
     if (request->params() == 1) {
         int brightness = request->getParam(0)->value().toInt();
-        setDisplayBrightness(brightness+1);
-        setInt8Config(CFG_DEFAULT_BRIGHTNESS, getDisplayBrightness());
+        queueCommand(COMMAND_SET_BRIGHTNESS, brightness+1);
     }
     request->send(200, "text/plain", "OK");
 }
 
+/**
+ * Update the stored configuration from the parameters of a form submission. Called from loop(),
+ * via the command queue
+ */
+void applyConfigParams(const CommandParams &params) {
+    updateStringParam(params, CFG_SSID);
+    // Only update the password field if a password has been provided
+    if (!params.get(CFG_PASSWORD).isEmpty()) setStringConfig(CFG_PASSWORD, params.get(CFG_PASSWORD));
+    updateStringParam(params, CFG_HOSTNAME);
+    updateInt8Param(params, CFG_AP_AFTER_MINUTES);
+    updateStringParam(params, CFG_NTP_SERVER_1);
+    updateStringParam(params, CFG_NTP_SERVER_2);
+    updateStringParam(params, CFG_NTP_SERVER_3);
+    updateStringParam(params, CFG_SYSLOG_HOST);
+    updateStringParam(params, CFG_MQTT_BROKER);
+    updateInt8Param(params, CFG_DEFAULT_BRIGHTNESS);
+    updateInt8Param(params, CFG_LEAP);
+    updateInt8Param(params, CFG_POWER);
+    updateInt8Param(params, CFG_PAGE_TIME);
+    updateInt8Param(params, CFG_PAGE_DATE);
+    updateInt8Param(params, CFG_PAGE_WEEKDAY);
+    updateInt8Param(params, CFG_PAGE_SYNC);
+    updateInt8Param(params, CFG_PAGE_IP);
+    if (params.has("TZOFF")) setInt16Config(CFG_TZ_MINUTES, parseTimezoneOffset(params.get("TZOFF")));
+    updateStringParam(params, CFG_ZONE);
+    updateStringParam(params, CFG_TZ_NAME);
+    updateStringParam(params, CFG_DST_NAME);
+    updateDSTChangeParam(params, true);
+    updateDSTChangeParam(params, false);
+    updateDimmingParams(params);
+    if (params.has("24h")) {
+      setCfgBit(CFG_MASK_24H);
+    } else {
+      clearCfgBit(CFG_MASK_24H);
+    }
+    if (params.has("ntpsrv")) {
+      setCfgBit(CFG_MASK_NTP_SERVER);
+    } else {
+      clearCfgBit(CFG_MASK_NTP_SERVER);
+    }
+    if (params.has("ntpbc")) {
+      setCfgBit(CFG_MASK_NTP_BROADCAST);
+    } else {
+      clearCfgBit(CFG_MASK_NTP_BROADCAST);
+    }
+}
+
+/**
+ * Append a string to a JSON document as a quoted, escaped value
+ */
+void appendJSONString(String &json, const String &value) {
+  json.concat('"');
+  for (unsigned int i = 0 ; i < value.length() ; i++) {
+    char c = value.charAt(i);
+    if ((c == '"') || (c == '\\')) {
+      json.concat('\\');
+      json.concat(c);
+    } else if ((uint8_t)c < 0x20) {
+      char escaped[7];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      json.concat(escaped);
+    } else {
+      json.concat(c);
+    }
+  }
+  json.concat('"');
+}
+
+/**
+ * Append a DST change ruleset to a JSON document, using the same field names as the form
+ */
+void appendJSONDST(String &json, bool isStart) {
+  DST_Transition transition = { 0, 0, 0, 0 };
+  char fields[80];
+  char c = isStart ? 'S' : 'E';
+  if (hasConfig(isStart ? CFG_DST_START : CFG_DST_END)) getDSTTransition(isStart, &transition);
+  snprintf_P(fields, sizeof(fields), PSTR(",\"DST%cW\":%u,\"DST%cD\":%u,\"DST%cM\":%u,\"DST%cT\":%u"),
+    c, transition.dowNumber, c, transition.dow, c, transition.month, c, transition.timeOfDay);
+  json.concat(fields);
+}
+
+/**
+ * Append the night dimming schedule to a JSON document, using the same field names as the form
+ */
+void appendJSONDimming(String &json) {
+  Dimming_Schedule schedule;
+  char fields[128];
+  getDimmingSchedule(&schedule);
+  snprintf_P(fields, sizeof(fields), PSTR(",\"DIMMODE\":%u,\"DIMBRI\":%u,\"DIMS\":\"%02u:%02u\",\"DIME\":\"%02u:%02u\",\"LAT\":%s%d.%02d,\"LNG\":%s%d.%02d"),
+    schedule.mode, schedule.level, schedule.startMinute / 60, schedule.startMinute % 60,
+    schedule.endMinute / 60, schedule.endMinute % 60,
+    (schedule.latitude < 0) ? "-" : "", abs(schedule.latitude) / 100, abs(schedule.latitude) % 100,
+    (schedule.longitude < 0) ? "-" : "", abs(schedule.longitude) / 100, abs(schedule.longitude) % 100);
+  json.concat(fields);
+}
+
+/**
+ * Queue a form submission to be applied to the stored configuration by loop() - by default as
+ * the whole configuration, otherwise by the given command. Returns false if it couldn't be queued
+ */
+bool queueConfigParams(AsyncWebServerRequest *request, uint8_t command = COMMAND_APPLY_CONFIG) {
+  CommandParams *params = new CommandParams();
+  for (size_t i = 0 ; i < request->params() ; i++) {
+    AsyncWebParameter *param = request->getParam(i);
+    if (param->isPost() && !params->add(param->name(), param->value())) break;
+  }
+  return queueCommand(command, 0, params);
+}
+
+/**
+ * Update the stored alarms from form parameters. For alarm n (0 .. ALARM_COUNT-1), "tn" is the
+ * time as HH:MM, "dn" the days as a bitmask (1 for Sunday .. 64 for Saturday, 0 for just once) and
+ * "en" is present if it is switched on. Alarms without a "tn" are left alone
+ */
+void applyAlarmParams(const CommandParams &params) {
+  Alarm alarms[ALARM_COUNT];
+  getAlarms(alarms);
+  for (uint8_t i = 0 ; i < ALARM_COUNT ; i++) {
+    char name[4];
+    snprintf(name, sizeof(name), "t%u", i);
+    if (!params.has(name)) continue;
+    alarms[i].minuteOfDay = parseMinuteOfDay(params.get(name));
+    name[0] = 'd';
+    alarms[i].days = params.has(name) ? params.get(name).toInt() & 0x7f : 0;
+    name[0] = 'e';
+    alarms[i].enabled = params.has(name);
+  }
+  setAlarms(alarms);
+}
+
+/**
+ * Control the stopwatch and countdown timer from form parameters - "mode" (clock, stopwatch or
+ * countdown), "seconds" for the countdown, then "action" (start, stop or reset)
+ */
+void applyTimerParams(const CommandParams &params) {
+  if (params.has("mode")) {
+    const String &mode = params.get("mode");
+    setTimerMode((mode == "stopwatch") ? TIMER_STOPWATCH : (mode == "countdown") ? TIMER_COUNTDOWN : TIMER_OFF);
+  }
+  if (params.has("seconds")) setCountdownSeconds(params.get("seconds").toInt());
+  if (params.has("action")) {
+    const String &action = params.get("action");
+    if (action == "start") {
+      startTimer();
+    } else if (action == "stop") {
+      stopTimer();
+    } else if (action == "reset") {
+      resetTimer();
+    }
+  }
+}
+
+/**
+ * Callback when the /timer URL is called
+ *
+ * A GET returns the timer's state as JSON, with how well the display kept up during the current or
+ * last run (see TimerStats). A POST takes the parameters described for applyTimerParams()
+ */
+void onTimer(AsyncWebServerRequest *request) {
+  static const char *modes[] = { "clock", "stopwatch", "countdown" };
+  TimerStats stats;
+  char body[192];
+  if (request->method() == HTTP_POST) {
+    bool queued = queueConfigParams(request, COMMAND_TIMER);
+    request->send(queued ? 202 : 503, "application/json", queued ? "{\"queued\":true}" : "{\"queued\":false}");
+    return;
+  }
+  getTimerStats(&stats);
+  snprintf_P(body, sizeof(body), PSTR("{\"mode\":\"%s\",\"running\":%s,\"ms\":%u,\"frames\":%u,\"fps\":%u.%02u,\"lateUs\":%u,\"missed\":%u}"),
+    modes[getTimerMode()], timerIsRunning() ? "true" : "false", getTimerMillis(), stats.frames,
+    stats.fpsHundredths / 100, stats.fpsHundredths % 100, stats.worstLateMicros, stats.missedFrames);
+  request->send(200, "application/json", body);
+}
+
+/**
+ * Callback when the /alarms URL is called
+ *
+ * A GET returns the alarms as JSON, along with whether one is going off and when the next one is
+ * (as a Unix time, 0 for none). A POST takes the parameters described for applyAlarmParams(), or
+ * "ack" to acknowledge a ringing alarm
+ */
+void onAlarms(AsyncWebServerRequest *request) {
+  Alarm alarms[ALARM_COUNT];
+  String json;
+  if (request->method() == HTTP_POST) {
+    bool queued = request->hasParam("ack", true) ? queueCommand(COMMAND_ACK_ALARM) : queueConfigParams(request, COMMAND_SET_ALARMS);
+    request->send(queued ? 202 : 503, "application/json", queued ? "{\"queued\":true}" : "{\"queued\":false}");
+    return;
+  }
+  getAlarms(alarms);
+  json.reserve(64 + ALARM_COUNT * 48);
+  json.concat(F("{\"ringing\":"));
+  json.concat(alarmIsRinging() ? "true" : "false");
+  json.concat(F(",\"next\":"));
+  json.concat((unsigned long)getNextAlarmTime());
+  json.concat(F(",\"alarms\":["));
+  for (uint8_t i = 0 ; i < ALARM_COUNT ; i++) {
+    char alarm[48];
+    snprintf_P(alarm, sizeof(alarm), PSTR("%s{\"t\":\"%02u:%02u\",\"d\":%u,\"e\":%s}"), i ? "," : "",
+      alarms[i].minuteOfDay / 60, alarms[i].minuteOfDay % 60, alarms[i].days, alarms[i].enabled ? "true" : "false");
+    json.concat(alarm);
+  }
+  json.concat(F("]}"));
+  request->send(200, "application/json", json);
+}
+
+/**
+ * Callback when the /config URL is called
+ *
+ * A GET returns the whole stored configuration (apart from the WiFi password) as JSON. A POST
+ * takes the same parameters as the home page form, so a complete configuration can be pushed in
+ * one request; add "restart=1" to restart the clock once it has been applied. The configuration
+ * is applied by loop() shortly after the response has been sent
+ */
+void onConfig(AsyncWebServerRequest *request) {
+  String json;
+  char hash[9];
+  if (request->method() == HTTP_POST) {
+    if (!queueConfigParams(request)) {
+      request->send(503, "application/json", "{\"queued\":false}");
+      return;
+    }
+    if (request->hasParam("restart", true)) queueCommand(COMMAND_RESTART);
+    request->send(202, "application/json", "{\"queued\":true}");
+    return;
+  }
+  if (!admitRequest(request)) return;
+  snprintf(hash, sizeof(hash), "%08x", getConfigHash());
+  json.reserve(512);
+  json.concat(F("{\"version\":\"" FIRMWARE_VERSION "\",\"cfg\":\""));
+  json.concat(hash);
+  json.concat(F("\",\"" CFG_SSID "\":"));
+  appendJSONString(json, getStringConfig(CFG_SSID));
+  json.concat(F(",\"" CFG_HOSTNAME "\":"));
+  appendJSONString(json, getStringConfig(CFG_HOSTNAME));
+  json.concat(F(",\"" CFG_AP_AFTER_MINUTES "\":"));
+  json.concat(getInt8Config(CFG_AP_AFTER_MINUTES, WIFI_DEFAULT_AP_MINUTES));
+  json.concat(F(",\"" CFG_NTP_SERVER_1 "\":"));
+  appendJSONString(json, getStringConfig(CFG_NTP_SERVER_1));
+  json.concat(F(",\"" CFG_NTP_SERVER_2 "\":"));
+  appendJSONString(json, getStringConfig(CFG_NTP_SERVER_2));
+  json.concat(F(",\"" CFG_NTP_SERVER_3 "\":"));
+  appendJSONString(json, getStringConfig(CFG_NTP_SERVER_3));
+  json.concat(F(",\"" CFG_SYSLOG_HOST "\":"));
+  appendJSONString(json, getStringConfig(CFG_SYSLOG_HOST));
+  json.concat(F(",\"" CFG_MQTT_BROKER "\":"));
+  appendJSONString(json, getStringConfig(CFG_MQTT_BROKER));
+  json.concat(F(",\"" CFG_DEFAULT_BRIGHTNESS "\":"));
+  json.concat(getInt8Config(CFG_DEFAULT_BRIGHTNESS, LED_DEFAULT_BRIGHTNESS));
+  json.concat(F(",\"24h\":"));
+  json.concat(cfgBitIsSet(CFG_MASK_24H) ? "true" : "false");
+  json.concat(F(",\"ntpsrv\":"));
+  json.concat(cfgBitIsSet(CFG_MASK_NTP_SERVER) ? "true" : "false");
+  json.concat(F(",\"ntpbc\":"));
+  json.concat(cfgBitIsSet(CFG_MASK_NTP_BROADCAST) ? "true" : "false");
+  json.concat(F(",\"" CFG_LEAP "\":"));
+  json.concat(getInt8Config(CFG_LEAP, LEAP_STEP));
+  json.concat(F(",\"" CFG_POWER "\":"));
+  json.concat(getPowerPolicy());
+  json.concat(F(",\"" CFG_PAGE_TIME "\":"));
+  json.concat(getInt8Config(CFG_PAGE_TIME, PAGE_DEFAULT_TIME_SECONDS));
+  json.concat(F(",\"" CFG_PAGE_DATE "\":"));
+  json.concat(getInt8Config(CFG_PAGE_DATE, 0));
+  json.concat(F(",\"" CFG_PAGE_WEEKDAY "\":"));
+  json.concat(getInt8Config(CFG_PAGE_WEEKDAY, 0));
+  json.concat(F(",\"" CFG_PAGE_SYNC "\":"));
+  json.concat(getInt8Config(CFG_PAGE_SYNC, 0));
+  json.concat(F(",\"" CFG_PAGE_IP "\":"));
+  json.concat(getInt8Config(CFG_PAGE_IP, 0));
+  json.concat(F(",\"" CFG_ZONE "\":"));
+  appendJSONString(json, getStringConfig(CFG_ZONE));
+  json.concat(F(",\"TZOFF\":\""));
+  json.concat(formatTimezoneOffset(getTimezoneMinutes()));
+  json.concat('"');
+  json.concat(F(",\"" CFG_TZ_NAME "\":"));
+  appendJSONString(json, getStringConfig(CFG_TZ_NAME));
+  json.concat(F(",\"" CFG_DST_NAME "\":"));
+  appendJSONString(json, getStringConfig(CFG_DST_NAME));
+  appendJSONDST(json, true);
+  appendJSONDST(json, false);
+  appendJSONDimming(json);
+  json.concat('}');
+  request->send(200, "application/json", json);
+}
+
+/**
+ * Called with each chunk of a firmware image posted to /update
+ *
+ * The image may be gzip-compressed. The "sha256" URL parameter must be given, and the image is only
+ * committed if it matches. Uploads posted while another is in progress are ignored, and answered
+ * by onUpdate()
+ */
+void onUpdateUpload(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final) {
+    if (!index) {
+        if (updateRequest || !request->hasParam("sha256")) return;
+        updateRequest = request;
+        request->onDisconnect([request]() {
+            // Gone before onUpdate() - free the updater for the next upload
+            if (updateRequest != request) return;
+            otaHTTPAbort();
+            updateRequest = 0;
+            updateFailed = true;
+        });
+        updateFailed = !otaHTTPBegin(request->contentLength(), request->getParam("sha256")->value());
+    }
+    if ((request != updateRequest) || updateFailed) return;
+    notePowerActivity();
+    if (len && !otaHTTPWrite(data, len)) updateFailed = true;
+    if (final && !updateFailed) updateFailed = !otaHTTPEnd();
+}
+
+/**
+ * Called when the firmware image posted to /update has been completely received
+ */
+void onUpdate(AsyncWebServerRequest *request) {
+    char body[64];
+    if (request != updateRequest) {
+        if (!request->hasParam("sha256")) {
+            request->send(400, "application/json", "{\"ok\":false,\"error\":\"sha256 required\"}");
+        } else if (updateRequest) {
+            request->send(409, "application/json", "{\"ok\":false,\"error\":\"update in progress\"}");
+        } else {
+            request->send(400, "application/json", "{\"ok\":false,\"error\":\"no image\"}");
+        }
+        return;
+    }
+    snprintf_P(body, sizeof(body), PSTR("{\"ok\":%s,\"bytes\":%u,\"ms\":%lu}"),
+        updateFailed ? "false" : "true", otaBytesReceived(), otaDurationMillis());
+    request->send(updateFailed ? 500 : 200, "application/json", body);
+    updateFailed = true;
+    updateRequest = 0;
+}
+
+/**
+ * Callback when the /trace URL is called. Returns the recorded display transactions as binary
+ * (see DisplayTransaction), with the total number sent since boot in the X-Transactions header
+ */
+void onTrace(AsyncWebServerRequest *request) {
+  AsyncWebServerResponse *response;
+#ifdef DISPLAY_TRACE
+  static DisplayTransaction snapshot[DISPLAY_TRACE_SIZE];
+  size_t n = getDisplayTrace(snapshot, DISPLAY_TRACE_SIZE);
+  response = request->beginResponse_P(200, "application/octet-stream", (const uint8_t *)snapshot, n * sizeof(DisplayTransaction));
+#else
+  response = request->beginResponse(200, "application/octet-stream", String());
+#endif
+  response->addHeader("X-Transactions", String(getDisplayTransactionCount()));
+  request->send(response);
+}
+
+/**
+ * Callback when the /zones URL is called. Returns the names of all the zones in the built-in
+ * database, one per line. They are streamed straight out of flash a few at a time
+ */
+void onZones(AsyncWebServerRequest *request) {
+  std::shared_ptr<uint16_t> next = std::make_shared<uint16_t>(0);
+  if (!admitRequest(request)) return;
+  request->send(request->beginChunkedResponse("text/plain", [next](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+    size_t len = 0;
+    char name[40];
+    while (*next < getZoneCount()) {
+      size_t nameLen;
+      getZoneName(*next, name, sizeof(name));
+      nameLen = strlen(name);
+      if (len + nameLen + 1 > maxLen) break;
+      memcpy(buf + len, name, nameLen);
+      buf[len + nameLen] = '\n';
+      len += nameLen + 1;
+      (*next)++;
+    }
+    return len;
+  }));
+}
+
+/**
+ * Callback when the /metrics URL is called. Returns figures for keeping an eye on the clock as JSON
+ *
+ * firstSync is how long after boot the time was first set, in milliseconds (0 until it has been),
+ * and ntpCache whether the NTP server addresses were remembered from before a restart. tickLate is
+ * the latest the display has changed after the start of a second, and refused the number of pages
+ * turned away by admission control. With "reset", tickLate starts again from 0. The page figures are
+ * for the home page cache - see PageCacheStats - the log figures for syslog - see SyslogStats - the
+ * mqtt figures for MQTT - see MqttStats - and the sse figures for /events - see EventsStats.
+ * syncOffset is how far the last NTP update moved the time, in milliseconds, and slewUs how far the
+ * displayed time still has to go to catch up with it. leap is 1 or -1 while a leap second is coming
+ * up
+ */
+void onMetrics(AsyncWebServerRequest *request) {
+  char body[704];
+  PageCacheStats page;
+  SyslogStats log;
+  MqttStats mqtt;
+  EventsStats sse;
+  getPageCacheStats(&page);
+  getSyslogStats(&log);
+  getMqttStats(&mqtt);
+  getEventsStats(&sse);
+  snprintf_P(body, sizeof(body), PSTR("{\"uptime\":%lu,\"heap\":%u,\"firstSync\":%lu,\"ntpCache\":%s,\"tickLate\":%u,\"refused\":%u"
+      ",\"pageHits\":%u,\"pageMisses\":%u,\"page304\":%u,\"pageBytes\":%u,\"pageHitUs\":%u,\"pageMissUs\":%u"
+      ",\"logSent\":%u,\"logDropped\":%u,\"logUs\":%u,\"logSendUs\":%u"
+      ",\"syncOffset\":%d,\"mqtt\":%s,\"mqttConnects\":%u,\"mqttPublished\":%u,\"mqttCoalesced\":%u"
+      ",\"mqttDropped\":%u,\"mqttQueued\":%u,\"slewUs\":%d,\"leap\":%d"
+      ",\"sseClients\":%u,\"sseSent\":%u,\"sseSkipped\":%u,\"ssePollUs\":%u,\"sseSendUs\":%u}"),
+      millis(), ESP.getFreeHeap(), millisToFirstSync(), ntpAddressCacheUsed() ? "true" : "false",
+      getWorstTickLateness(), requestsRefused, page.hits, page.misses, page.notModified, page.bytes,
+      page.hitMicros, page.missMicros, log.sent, log.dropped, log.logMicros, log.sendMicros,
+      getLastSyncOffset(), mqttConnected() ? "true" : "false", mqtt.connects, mqtt.published, mqtt.coalesced,
+      mqtt.dropped, mqtt.queued, getClockSlewMicros(), getLeapPending(),
+      sse.clients, sse.sent, sse.skipped, sse.pollMicros, sse.sendMicros);
+  if (request->hasParam("reset")) resetWorstTickLateness();
+  request->send(200, "application/json", body);
+}
+
+/**
+ * Callback when the /bench URL is called. Has the benchmarks run from loop() and, once they have,
+ * returns the results as JSON
+ */
+void onBench(AsyncWebServerRequest *request) {
+  uint32_t run = getBenchmarkRuns() + 1;
+  unsigned long started = millis();
+  std::shared_ptr<String> body = std::make_shared<String>();
+  if (!admitRequest(request)) return;
+  if (!queueCommand(COMMAND_BENCHMARK)) {
+    request->send(503, "application/json", "{\"queued\":false}");
+    return;
+  }
+  request->send(request->beginChunkedResponse("application/json", [run, started, body](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+    size_t len;
+    if (!index) {
+      if (getBenchmarkRuns() >= run) {
+        *body = getBenchmarkResults();
+      } else if ((millis() - started) < BENCH_TIMEOUT_MILLIS) {
+        return RESPONSE_TRY_AGAIN;
+      } else {
+        *body = "{\"error\":\"timeout\"}";
+      }
+    }
+    if (index >= body->length()) return 0;
+    len = min(maxLen, body->length() - index);
+    memcpy(buf, body->c_str() + index, len);
+    return len;
+  }));
+}
+
+/**
+ * Callback when the /stats URL is called. Returns the long term statistics kept in flash as JSON
+ *
+ * uptime is in seconds and worstStall in milliseconds, both over the clock's life. resets counts the
+ * boots by the reason for them, and days the brightness changes on each of the last days that had
+ * any, most recent first. flash describes the log the statistics are kept in - see StatsFlashInfo
+ */
+void onStats(AsyncWebServerRequest *request) {
+  static const char resetNames[STATS_RESET_REASON_COUNT][11] PROGMEM = {
+    "power", "hwWatchdog", "exception", "swWatchdog", "restart", "deepSleep", "external"
+  };
+  StatsDay days[STATS_DAYS];
+  StatsFlashInfo flash;
+  uint8_t dayCount = getStatsDays(days);
+  char text[112];
+  String json;
+  getStatsFlashInfo(&flash);
+  json.reserve(384 + dayCount * 36);
+  snprintf_P(text, sizeof(text), PSTR("{\"uptime\":%u,\"boots\":%u,\"resets\":{"),
+      getStatsCounter(STATS_UPTIME), getStatsCounter(STATS_BOOTS));
+  json.concat(text);
+  for (uint8_t i = 0 ; i < STATS_RESET_REASON_COUNT ; i++) {
+    snprintf_P(text, sizeof(text), PSTR("%s\"%S\":%u"), i ? "," : "", resetNames[i],
+        getStatsCounter(STATS_RESET_REASONS + i));
+    json.concat(text);
+  }
+  snprintf_P(text, sizeof(text), PSTR("},\"syncFailures\":%u,\"reconnects\":%u,\"worstStall\":%u,\"brightnessChanges\":%u"),
+      getStatsCounter(STATS_SYNC_FAILURES), getStatsCounter(STATS_RECONNECTS), getStatsCounter(STATS_WORST_STALL),
+      getStatsCounter(STATS_BRIGHTNESS_CHANGES));
+  json.concat(text);
+  json.concat(F(",\"days\":["));
+  for (uint8_t i = 0 ; i < dayCount ; i++) {
+    time_t day = (time_t)days[i].day * 86400;
+    struct tm *date = gmtime(&day);
+    snprintf_P(text, sizeof(text), PSTR("%s{\"date\":\"%04u-%02u-%02u\",\"changes\":%u}"), i ? "," : "",
+        date->tm_year + 1900, date->tm_mon + 1, date->tm_mday, days[i].brightnessChanges);
+    json.concat(text);
+  }
+  snprintf_P(text, sizeof(text), PSTR("],\"flash\":{\"sectors\":%u,\"active\":%u,\"used\":%u,\"sequence\":%u"
+      ",\"maxErases\":%u,\"appends\":%u}}"), flash.sectors, flash.activeSector, flash.recordsUsed, flash.sequence,
+      flash.maxErases, flash.appends);
+  json.concat(text);
+  request->send(200, "application/json", json);
+}
+
+/**
+ * Callback when the /power URL is called. Returns what power saving is doing as JSON - see PowerStats
+ *
+ * radio is "sleep" while the radio is let sleep between beacons, and "on" while it is kept on.
+ * The times are in milliseconds, since boot
+ */
+void onPower(AsyncWebServerRequest *request) {
+  char body[256];
+  PowerStats power;
+  getPowerStats(&power);
+  snprintf_P(body, sizeof(body), PSTR("{\"policy\":%u,\"radio\":\"%s\",\"radioOnMs\":%u,\"radioSleepMs\":%u"
+      ",\"loopSleepMs\":%u,\"wakeups\":%u,\"wakeupsPerMinute\":%u,\"earlyWakes\":%u}"),
+      power.policy, power.radioSleeping ? "sleep" : "on", power.radioOnMillis, power.radioSleepMillis,
+      power.loopSleepMillis, power.wakeups, power.wakeupsPerMinute, power.earlyWakes);
+  request->send(200, "application/json", body);
+}
+
+/**
+ * Callback when the /health URL is called - a cheap answer for monitoring, without rendering anything
+ */
+void onHealth(AsyncWebServerRequest *request) {
+  request->send(200, "application/json", timeIsSynced() ? "{\"synced\":true}" : "{\"synced\":false}");
+}
+
+/**
+ * Callback for HEAD requests, which scanners and probes use to see if we are there
+ */
+void onHead(AsyncWebServerRequest *request) {
+  request->send(200, "text/html", String());
+}
+
 /**
  * Initialise the webserver system
  */
 void initWebserver() {
+    server.on("/", HTTP_HEAD, onHead);
     server.on("/", HTTP_GET|HTTP_POST, onRoot);
     server.on("/brightness", HTTP_GET|HTTP_POST, onBrightness);
+    server.on("/update", HTTP_POST, onUpdate, onUpdateUpload);
+    server.on("/config", HTTP_GET|HTTP_POST, onConfig);
+    server.on("/trace", HTTP_GET, onTrace);
+    server.on("/zones", HTTP_GET, onZones);
+    server.on("/metrics", HTTP_GET, onMetrics);
+    server.on("/bench", HTTP_GET, onBench);
+    server.on("/alarms", HTTP_GET|HTTP_POST, onAlarms);
+    server.on("/timer", HTTP_GET|HTTP_POST, onTimer);
+    server.on("/health", HTTP_GET|HTTP_HEAD, onHealth);
+    server.on("/stats", HTTP_GET, onStats);
+    server.on("/power", HTTP_GET, onPower);
+    initEvents(server);
     server.begin();
 }
 
@@ -146,10 +871,30 @@ req.open(\"POST\",\"/brightness\");\n\
 req.setRequestHeader(\"Content-Type\",\"application/x-www-form-urlencoded\");\n\
 req.send(body);\n\
 }\n\
+window.addEventListener(\"load\", function() {\n\
+var req = new XMLHttpRequest();\n\
+req.onload = function() {\n\
+var list = document.getElementById(\"zones\");\n\
+req.responseText.split(\"\\n\").forEach(function(zone) {\n\
+if (zone) { var o = document.createElement(\"option\"); o.value = zone; list.appendChild(o); }\n\
+});\n\
+};\n\
+req.open(\"GET\",\"/zones\");\n\
+req.send();\n\
+});\n\
+if (window.EventSource) {\n\
+var events = new EventSource(\"/events\");\n\
+events.addEventListener(\"status\", function(e) {\n\
+var s = JSON.parse(e.data);\n\
+document.getElementById(\"status\").textContent = \"Showing \\\"\" + s.d + \"\\\", brightness \" + s.b +\n\
+(s.s ? \", synced\" : \", not synced\") + (s.w ? \", WiFi connected (\" + s.r + \" dBm)\" : \", WiFi not connected\");\n\
+});\n\
+}\n\
 </script>\n\
 <body vlink=\"#9999ff\" text=\"#ffffff\" link=\"#33ccff\" bgcolor=\"#666666\"\n\
 alink=\"#ff6666\">\n\
 <h1 align=\"center\">Clock configure</h1>\n\
+<p align=\"center\" id=\"status\"></p>\n\
 <form method=\"post\">\n\
 <table width=\"100%%\" cellspacing=\"2\" cellpadding=\"2\" border=\"0\">\n\
 <tbody>\n\
@@ -172,6 +917,13 @@ alink=\"#ff6666\">\n\
 </td>\n\
 </tr>\n\
 <tr>\n\
+<td valign=\"top\" align=\"right\">Configuration access point after:<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"APMIN\" value=\"%APMin%\" size=\"3\"> minutes offline\n\
+<i>(0 for never)</i><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
 <td valign=\"top\" align=\"right\"><br>\n\
 </td>\n\
 <td valign=\"top\"><br>\n\
@@ -196,6 +948,18 @@ alink=\"#ff6666\">\n\
 </td>\n\
 </tr>\n\
 <tr>\n\
+<td valign=\"top\" align=\"right\">Syslog server:<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"LOGHOST\" value=\"%LOGHOST%\" placeholder=\"host[:port]\"><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">MQTT broker:<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"MQTT\" value=\"%MQTT%\" placeholder=\"host[:port]\"><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
 <td><br>\n\
 </td>\n\
 <td><br>\n\
@@ -228,12 +992,107 @@ Bright </td>\n\
 </td>\n\
 </tr>\n\
 <tr>\n\
+<td valign=\"top\" align=\"right\">Serve time to the local network (NTP)\n\
+</td>\n\
+<td valign=\"top\"><input type=\"checkbox\" name=\"ntpsrv\" %CFGNTPSRV% />\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Take time from NTP broadcasts\n\
+</td>\n\
+<td valign=\"top\"><input type=\"checkbox\" name=\"ntpbc\" %CFGNTPBC% />\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Leap seconds:<br>\n\
+</td>\n\
+<td valign=\"top\">\n\
+<select name=\"LEAP\">\n\
+<option value=\"0\" %LEAP0%>Step at midnight UTC</option>\n\
+<option value=\"1\" %LEAP1%>Smear over 24 hours</option>\n\
+<option value=\"2\" %LEAP2%>Follow the NTP server</option>\n\
+</select>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Power saving:<br>\n\
+</td>\n\
+<td valign=\"top\">\n\
+<select name=\"POWER\">\n\
+<option value=\"0\" %POWER0%>Off</option>\n\
+<option value=\"1\" %POWER1%>Radio sleeps between beacons</option>\n\
+</select>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Display pages:<br>\n\
+</td>\n\
+<td valign=\"top\">\n\
+<input name=\"PGTIME\" value=\"%PGTIME%\" size=\"3\"> time\n\
+<input name=\"PGDATE\" value=\"%PGDATE%\" size=\"3\"> date\n\
+<input name=\"PGDAY\" value=\"%PGDAY%\" size=\"3\"> day\n\
+<input name=\"PGSYNC\" value=\"%PGSYNC%\" size=\"3\"> minutes since sync\n\
+<input name=\"PGIP\" value=\"%PGIP%\" size=\"3\"> IP address<br>\n\
+<i>(seconds each is shown for, in turn - 0 leaves a page out)</i>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
 <td valign=\"top\" align=\"right\"><br>\n\
 </td>\n\
 <td valign=\"top\"><br>\n\
 </td>\n\
 </tr>\n\
 <tr>\n\
+<td valign=\"top\" align=\"right\">Night dimming:<br>\n\
+</td>\n\
+<td valign=\"top\">\n\
+<select name=\"DIMMODE\">\n\
+<option value=\"0\" %DIMMODE0%>Off</option>\n\
+<option value=\"1\" %DIMMODE1%>At fixed times</option>\n\
+<option value=\"2\" %DIMMODE2%>Between sunset and sunrise</option>\n\
+</select>\n\
+&nbsp;to brightness&nbsp;\n\
+<select name=\"DIMBRI\">\n\
+<option value=\"0\" %DIMBRI0%>0</option>\n\
+<option value=\"1\" %DIMBRI1%>1</option>\n\
+<option value=\"2\" %DIMBRI2%>2</option>\n\
+<option value=\"3\" %DIMBRI3%>3</option>\n\
+<option value=\"4\" %DIMBRI4%>4</option>\n\
+<option value=\"5\" %DIMBRI5%>5</option>\n\
+<option value=\"6\" %DIMBRI6%>6</option>\n\
+<option value=\"7\" %DIMBRI7%>7</option>\n\
+</select>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Night time (fixed times):<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"DIMS\" value=\"%DIMStart%\" size=\"5\">\n\
+&nbsp;to&nbsp;<input name=\"DIME\" value=\"%DIMEnd%\" size=\"5\"> <i>(HH:MM)</i><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Location (sunset and sunrise):<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"LAT\" value=\"%Latitude%\" size=\"7\"> north,\n\
+<input name=\"LNG\" value=\"%Longitude%\" size=\"7\"> east <i>(degrees)</i><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\"><br>\n\
+</td>\n\
+<td valign=\"top\"><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
+<td valign=\"top\" align=\"right\">Timezone:<br>\n\
+</td>\n\
+<td valign=\"top\"><input name=\"ZONE\" value=\"%Zone%\" list=\"zones\" size=\"30\">\n\
+<datalist id=\"zones\"></datalist> <i>(e.g. Europe/Dublin - leave blank to set the\n\
+timezone by hand below)</i><br>\n\
+</td>\n\
+</tr>\n\
+<tr>\n\
 <td valign=\"top\" align=\"right\">Timezone name:<br>\n\
 </td>\n\
 <td valign=\"top\"><input name=\"TZNAM\" value=\"%TZName%\"><br>\n\
@@ -243,7 +1102,7 @@ Bright </td>\n\
 <td valign=\"top\" align=\"right\">Hours ahead (east) of\n\
 Greenwich:<br>\n\
 </td>\n\
-<td valign=\"top\"><input name=\"TZHrs\" value=\"%TZHrs%\"><br>\n\
+<td valign=\"top\"><input name=\"TZOFF\" value=\"%TZOffset%\"> <i>(e.g. +5:30)</i><br>\n\
 </td>\n\
 </tr>\n\
 <tr>\n\
@@ -396,32 +1255,21 @@ no daylight saving)</i><br>\n\
 void onRoot(AsyncWebServerRequest *request) {
     if (request->params() > 1) { // It was called with a new configuration
       DEBUG("Form submission received\n")
-      updateStringParam(request, CFG_SSID);
-      // Only update the password field if a password has been provided
-      if (request->hasParam(CFG_PASSWORD, true)) {
-        String val = request->getParam(CFG_PASSWORD, true)->value();
-        if (!val.isEmpty()) {
-          setStringConfig(CFG_PASSWORD, val);
-        }
-      }
-      updateStringParam(request, CFG_HOSTNAME);
-      updateStringParam(request, CFG_NTP_SERVER_1);
-      updateStringParam(request, CFG_NTP_SERVER_2);
-      updateStringParam(request, CFG_NTP_SERVER_3);
-      updateInt8Param(request, CFG_DEFAULT_BRIGHTNESS);
-      updateInt8Param(request, CFG_TIMEZONE);
-      updateStringParam(request, CFG_TZ_NAME);
-      updateStringParam(request, CFG_DST_NAME);
-      updateDSTChangeParam(request, true);
-      updateDSTChangeParam(request, false);
-      if (request->hasArg("24h")) {
-        setCfgBit(CFG_MASK_24H);
-      } else {
-        clearCfgBit(CFG_MASK_24H);
+      if (!queueConfigParams(request)) {
+        request->send(503, "text/plain", "Busy - please try again");
+        return;
       }
       request->send(200, "text/plain", "Need to restart the clock!");
     } else {
       DEBUG("Sending home page\n")
-      request->send_P(200, "text/html", homePageData, processor);
+      if (!admitRequest(request)) return;
+      sendCachedPage(request, homePageData, processor);
     }
 }
+
+/**
+ * Work out the home page from scratch, without sending it anywhere - for benchmarking
+ */
+size_t renderHomePage() {
+    return renderPageToNull(homePageData, processor);
+}
@@ -1,6 +1,17 @@
 #ifndef _WEBSERVER_H_
 #define _WEBSERVER_H_
 
+#include <WString.h>
+#include "commands.h"
+
+// The configuration page's template, and the processor for its placeholders
+extern const char homePageData[];
+String processor(const String& tag);
+
 void initWebserver();
+void applyConfigParams(const CommandParams &params);
+void applyAlarmParams(const CommandParams &params);
+void applyTimerParams(const CommandParams &params);
+size_t renderHomePage();
 
 #endif
@@ -4,10 +4,32 @@
 #include "config.h"
 #include "led.h"
 #include "display.h"
+#include "syslog.h"
 #include "debug.h"
 
+// How often the connectivity supervisor checks the link
+#define WIFI_POLL_MILLIS 1000UL
+// Limits on the time between reconnection attempts, which doubles after each failure
+#define WIFI_BACKOFF_MIN_MILLIS 5000UL
+#define WIFI_BACKOFF_MAX_MILLIS 300000UL
+
 static bool softAP = false;
 
+// Connectivity supervisor state
+static bool supervising = false;        // Only once we have been told which network to join
+static bool linkUp = false;
+static bool linkLost = false;
+static unsigned long linkLostAt = 0;
+static unsigned long nextAttemptAt = 0;
+static unsigned long backoffMillis = WIFI_BACKOFF_MIN_MILLIS;
+static unsigned long lastWiFiPoll = 0;
+static int8_t rssi = 0;
+static uint16_t reconnectCount = 0;
+// CFG_AP_AFTER_MINUTES, read again only when the configuration changes
+static int8_t apMinutes = WIFI_DEFAULT_AP_MINUTES;
+static bool apMinutesLoaded = false;
+static uint32_t configGeneration = 0;
+
 /**
  * Set up the ESP as a wifi access point
  */
@@ -18,7 +40,7 @@ void initAP() {
     setRedLEDOn(); // indicates that we are a wifi access point
     WiFi.softAPConfig(local_IP, gateway, subnet);
     WiFi.softAP("303Clock");
-    setLEDSegments(LED_CHAR_C, LED_CHAR_o, LED_CHAR_n, LED_CHAR_F);
+    showText("ConF");
     softAP = true;
 }
 
@@ -29,6 +51,8 @@ void initWiFi() {
     if (hasConfig(CFG_SSID)) {
         WiFi.mode(WIFI_STA);
         if (hasConfig(CFG_HOSTNAME)) WiFi.setHostname(getStringConfig(CFG_HOSTNAME).c_str());
+        WiFi.setAutoReconnect(false); // wifiPoll() does this, with backoff
+        supervising = true;
         if (hasConfig(CFG_PASSWORD)) {
             WiFi.begin(getStringConfig(CFG_SSID), getStringConfig(CFG_PASSWORD));
         } else {
@@ -37,21 +61,16 @@ void initWiFi() {
         for (int i = 0 ; i < 20 ; i++) {
             delay(500);
             if (WiFi.isConnected()) {
-                IPAddress addr = WiFi.localIP();
-                // Flash our IP address on the LED display
-                for (int j = 0 ; j < 4 ; j++) {
-                    clearLEDSegments();
-                    delay(200);
-                    showUInt8(addr[j]);
-                    delay(1000);
-                }
-                clearLEDSegments();
-                delay(200);
+                // Scroll our IP address across the LED display
+                scrollText(WiFi.localIP().toString().c_str());
                 return;
             }
         }
         DEBUG("Setting WiFi AP and STA mode\n")
         WiFi.mode(WIFI_AP_STA);
+        linkLost = true;
+        linkLostAt = millis();
+        nextAttemptAt = millis() + WIFI_BACKOFF_MIN_MILLIS;
     } else {
       DEBUG("Setting WiFi AP mode")
       WiFi.mode(WIFI_AP);
@@ -76,3 +95,77 @@ bool hasWiFiConnection() {
   }
   return WiFi.isConnected();
 }
+
+/**
+ * Wait before the next reconnection attempt. The wait is jittered by +/- 25% so that a room full
+ * of clocks don't all hit the access point at once when it comes back
+ */
+static void scheduleReconnect() {
+    nextAttemptAt = millis() + (backoffMillis * 3) / 4 + random(backoffMillis / 2);
+}
+
+/**
+ * Connectivity supervisor polling loop
+ *
+ * Watches the link to the access point. When it goes, we try to reconnect with exponential backoff,
+ * and if it stays down for long enough the configuration access point is brought back so the
+ * clock can be reconfigured. hasWiFiConnection() takes the access point down again once we are
+ * reconnected
+ */
+void wifiPoll() {
+    if (!supervising || ((millis() - lastWiFiPoll) < WIFI_POLL_MILLIS)) return;
+    lastWiFiPoll = millis();
+    if (WiFi.isConnected()) {
+        rssi = WiFi.RSSI();
+        if (!linkUp) {
+            DEBUG("WiFi link up, RSSI %d\n", rssi)
+            linkUp = true;
+            if (linkLost) reconnectCount++;
+            logMessage(SYSLOG_INFO, "wifi", "Link up, RSSI %d, %u reconnects", rssi, reconnectCount);
+            linkLost = false;
+            backoffMillis = WIFI_BACKOFF_MIN_MILLIS;
+        }
+        hasWiFiConnection();
+        return;
+    }
+    if (!linkLost) {
+        DEBUG("WiFi link lost\n")
+        logMessage(SYSLOG_WARNING, "wifi", "Link lost");
+        linkUp = false;
+        linkLost = true;
+        linkLostAt = millis();
+        scheduleReconnect();
+    }
+    if (!softAP) {
+        if (!apMinutesLoaded || (configGeneration != getConfigGeneration())) {
+            apMinutes = getInt8Config(CFG_AP_AFTER_MINUTES, WIFI_DEFAULT_AP_MINUTES);
+            configGeneration = getConfigGeneration();
+            apMinutesLoaded = true;
+        }
+        if ((apMinutes > 0) && ((millis() - linkLostAt) >= (apMinutes * 60000UL))) {
+            DEBUG("Offline for %d minutes - enabling the configuration access point\n", apMinutes)
+            WiFi.mode(WIFI_AP_STA);
+            initAP();
+        }
+    }
+    if ((long)(millis() - nextAttemptAt) >= 0) {
+        DEBUG("Trying to reconnect to WiFi\n")
+        WiFi.reconnect();
+        backoffMillis = min(backoffMillis * 2, WIFI_BACKOFF_MAX_MILLIS);
+        scheduleReconnect();
+    }
+}
+
+/**
+ * The signal strength of our link to the access point, as of when it was last checked, in dBm
+ */
+int8_t getWiFiRSSI() {
+    return rssi;
+}
+
+/**
+ * How many times the link to the access point has come back after being lost
+ */
+uint16_t getWiFiReconnectCount() {
+    return reconnectCount;
+}
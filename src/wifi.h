@@ -1,7 +1,14 @@
 #ifndef _WIFI_H_
 #define _WIFI_H_
 
+#include <Arduino.h>
+
+#define WIFI_DEFAULT_AP_MINUTES 10
+
 void initWiFi();
 bool hasWiFiConnection();
+void wifiPoll();
+int8_t getWiFiRSSI();
+uint16_t getWiFiReconnectCount();
 
 #endif
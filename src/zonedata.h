@@ -0,0 +1,962 @@
+// Generated by tools/gen_zones.py - do not edit
+
+#define ZONE_COUNT 419
+#define ZONE_RULE_COUNT 90
+#define ZONE_REGION_COUNT 15
+#define ZONE_NO_REGION 255
+
+static const char zoneRules[] PROGMEM =
+  "ACST-9:30\0"
+  "ACST-9:30ACDT,M10.1.0,M4.1.0/3\0"
+  "AEST-10\0"
+  "AEST-10AEDT,M10.1.0,M4.1.0/3\0"
+  "AKST9AKDT,M3.2.0,M11.1.0\0"
+  "AST4\0"
+  "AST4ADT,M3.2.0,M11.1.0\0"
+  "AWST-8\0"
+  "CAT-2\0"
+  "CET-1\0"
+  "CET-1CEST,M3.5.0,M10.5.0/3\0"
+  "CST-8\0"
+  "CST5CDT,M3.2.0/0,M11.1.0/1\0"
+  "CST6\0"
+  "CST6CDT,M3.2.0,M11.1.0\0"
+  "ChST-10\0"
+  "EAT-3\0"
+  "EET-2\0"
+  "EET-2EEST,M3.4.4/50,M10.4.4/50\0"
+  "EET-2EEST,M3.5.0,M10.5.0/3\0"
+  "EET-2EEST,M3.5.0/0,M10.5.0/0\0"
+  "EET-2EEST,M3.5.0/3,M10.5.0/4\0"
+  "EET-2EEST,M4.5.5/0,M10.5.4/24\0"
+  "EST5\0"
+  "EST5EDT,M3.2.0,M11.1.0\0"
+  "GMT0\0"
+  "GMT0BST,M3.5.0/1,M10.5.0\0"
+  "HKT-8\0"
+  "HST10\0"
+  "HST10HDT,M3.2.0,M11.1.0\0"
+  "IST-1GMT0,M10.5.0,M3.5.0/1\0"
+  "IST-2IDT,M3.4.4/26,M10.5.0\0"
+  "IST-5:30\0"
+  "JST-9\0"
+  "KST-9\0"
+  "MSK-3\0"
+  "MST7\0"
+  "MST7MDT,M3.2.0,M11.1.0\0"
+  "NST3:30NDT,M3.2.0,M11.1.0\0"
+  "NZST-12NZDT,M9.5.0,M4.1.0/3\0"
+  "PKT-5\0"
+  "PST-8\0"
+  "PST8PDT,M3.2.0,M11.1.0\0"
+  "SAST-2\0"
+  "SST11\0"
+  "STD-1\0"
+  "STD-10\0"
+  "STD-10:30DST-11,M10.1.0,M4.1.0\0"
+  "STD-11\0"
+  "STD-11DST,M10.1.0,M4.1.0/3\0"
+  "STD-12\0"
+  "STD-12:45DST,M9.5.0/2:45,M4.1.0/3:45\0"
+  "STD-13\0"
+  "STD-14\0"
+  "STD-3\0"
+  "STD-3:30\0"
+  "STD-4\0"
+  "STD-4:30\0"
+  "STD-5\0"
+  "STD-5:30\0"
+  "STD-5:45\0"
+  "STD-6\0"
+  "STD-6:30\0"
+  "STD-7\0"
+  "STD-8\0"
+  "STD-8:45\0"
+  "STD-9\0"
+  "STD0DST-2,M3.5.0/1,M10.5.0/3\0"
+  "STD1\0"
+  "STD10\0"
+  "STD11\0"
+  "STD1DST,M3.5.0/0,M10.5.0/1\0"
+  "STD2\0"
+  "STD2DST,M3.5.0/-1,M10.5.0/0\0"
+  "STD3\0"
+  "STD3DST,M3.2.0,M11.1.0\0"
+  "STD4\0"
+  "STD4DST,M9.1.6/24,M4.1.6/24\0"
+  "STD5\0"
+  "STD6\0"
+  "STD6DST,M9.1.6/22,M4.1.6/22\0"
+  "STD8\0"
+  "STD9\0"
+  "STD9:30\0"
+  "UTC0\0"
+  "WAT-1\0"
+  "WET0WEST,M3.5.0/1,M10.5.0\0"
+  "WIB-7\0"
+  "WIT-9\0"
+  "WITA-8\0";
+static const uint16_t zoneRuleOffsets[] PROGMEM = {
+  0, 10, 41, 49, 78, 103, 108, 131, 138, 144, 150, 177, 183, 210, 215, 238, 246, 252, 258, 289, 316, 345, 374, 404, 409, 432, 437, 462, 468, 474, 498, 525, 552, 561, 567, 573, 579, 584, 607, 633, 661, 667, 673, 696, 703, 709, 715, 722, 753, 760, 787, 794, 831, 838, 845, 851, 860, 866, 875, 881, 890, 899, 905, 914, 920, 926, 935, 941, 970, 975, 981, 987, 1014, 1019, 1047, 1052, 1075, 1080, 1108, 1113, 1118, 1146, 1151, 1156, 1164, 1169, 1175, 1201, 1207, 1213
+};
+static const char zoneRegions[] PROGMEM =
+  "Africa\0"
+  "America\0"
+  "America/Argentina\0"
+  "America/Indiana\0"
+  "America/Kentucky\0"
+  "America/North_Dakota\0"
+  "Antarctica\0"
+  "Arctic\0"
+  "Asia\0"
+  "Atlantic\0"
+  "Australia\0"
+  "Etc\0"
+  "Europe\0"
+  "Indian\0"
+  "Pacific\0";
+static const uint16_t zoneRegionOffsets[] PROGMEM = {
+  0, 7, 15, 33, 49, 66, 87, 98, 105, 110, 119, 129, 133, 140, 147
+};
+static const char zoneCities[] PROGMEM =
+  "Abidjan\0"
+  "Accra\0"
+  "Addis_Ababa\0"
+  "Algiers\0"
+  "Asmara\0"
+  "Bamako\0"
+  "Bangui\0"
+  "Banjul\0"
+  "Bissau\0"
+  "Blantyre\0"
+  "Brazzaville\0"
+  "Bujumbura\0"
+  "Cairo\0"
+  "Casablanca\0"
+  "Ceuta\0"
+  "Conakry\0"
+  "Dakar\0"
+  "Dar_es_Salaam\0"
+  "Djibouti\0"
+  "Douala\0"
+  "El_Aaiun\0"
+  "Freetown\0"
+  "Gaborone\0"
+  "Harare\0"
+  "Johannesburg\0"
+  "Juba\0"
+  "Kampala\0"
+  "Khartoum\0"
+  "Kigali\0"
+  "Kinshasa\0"
+  "Lagos\0"
+  "Libreville\0"
+  "Lome\0"
+  "Luanda\0"
+  "Lubumbashi\0"
+  "Lusaka\0"
+  "Malabo\0"
+  "Maputo\0"
+  "Maseru\0"
+  "Mbabane\0"
+  "Mogadishu\0"
+  "Monrovia\0"
+  "Nairobi\0"
+  "Ndjamena\0"
+  "Niamey\0"
+  "Nouakchott\0"
+  "Ouagadougou\0"
+  "Porto-Novo\0"
+  "Sao_Tome\0"
+  "Tripoli\0"
+  "Tunis\0"
+  "Windhoek\0"
+  "Adak\0"
+  "Anchorage\0"
+  "Anguilla\0"
+  "Antigua\0"
+  "Araguaina\0"
+  "Buenos_Aires\0"
+  "Catamarca\0"
+  "Cordoba\0"
+  "Jujuy\0"
+  "La_Rioja\0"
+  "Mendoza\0"
+  "Rio_Gallegos\0"
+  "Salta\0"
+  "San_Juan\0"
+  "San_Luis\0"
+  "Tucuman\0"
+  "Ushuaia\0"
+  "Aruba\0"
+  "Asuncion\0"
+  "Atikokan\0"
+  "Bahia\0"
+  "Bahia_Banderas\0"
+  "Barbados\0"
+  "Belem\0"
+  "Belize\0"
+  "Blanc-Sablon\0"
+  "Boa_Vista\0"
+  "Bogota\0"
+  "Boise\0"
+  "Cambridge_Bay\0"
+  "Campo_Grande\0"
+  "Cancun\0"
+  "Caracas\0"
+  "Cayenne\0"
+  "Cayman\0"
+  "Chicago\0"
+  "Chihuahua\0"
+  "Ciudad_Juarez\0"
+  "Costa_Rica\0"
+  "Coyhaique\0"
+  "Creston\0"
+  "Cuiaba\0"
+  "Curacao\0"
+  "Danmarkshavn\0"
+  "Dawson\0"
+  "Dawson_Creek\0"
+  "Denver\0"
+  "Detroit\0"
+  "Dominica\0"
+  "Edmonton\0"
+  "Eirunepe\0"
+  "El_Salvador\0"
+  "Fort_Nelson\0"
+  "Fortaleza\0"
+  "Glace_Bay\0"
+  "Goose_Bay\0"
+  "Grand_Turk\0"
+  "Grenada\0"
+  "Guadeloupe\0"
+  "Guatemala\0"
+  "Guayaquil\0"
+  "Guyana\0"
+  "Halifax\0"
+  "Havana\0"
+  "Hermosillo\0"
+  "Indianapolis\0"
+  "Knox\0"
+  "Marengo\0"
+  "Petersburg\0"
+  "Tell_City\0"
+  "Vevay\0"
+  "Vincennes\0"
+  "Winamac\0"
+  "Inuvik\0"
+  "Iqaluit\0"
+  "Jamaica\0"
+  "Juneau\0"
+  "Louisville\0"
+  "Monticello\0"
+  "Kralendijk\0"
+  "La_Paz\0"
+  "Lima\0"
+  "Los_Angeles\0"
+  "Lower_Princes\0"
+  "Maceio\0"
+  "Managua\0"
+  "Manaus\0"
+  "Marigot\0"
+  "Martinique\0"
+  "Matamoros\0"
+  "Mazatlan\0"
+  "Menominee\0"
+  "Merida\0"
+  "Metlakatla\0"
+  "Mexico_City\0"
+  "Miquelon\0"
+  "Moncton\0"
+  "Monterrey\0"
+  "Montevideo\0"
+  "Montserrat\0"
+  "Nassau\0"
+  "New_York\0"
+  "Nome\0"
+  "Noronha\0"
+  "Beulah\0"
+  "Center\0"
+  "New_Salem\0"
+  "Nuuk\0"
+  "Ojinaga\0"
+  "Panama\0"
+  "Paramaribo\0"
+  "Phoenix\0"
+  "Port-au-Prince\0"
+  "Port_of_Spain\0"
+  "Porto_Velho\0"
+  "Puerto_Rico\0"
+  "Punta_Arenas\0"
+  "Rankin_Inlet\0"
+  "Recife\0"
+  "Regina\0"
+  "Resolute\0"
+  "Rio_Branco\0"
+  "Santarem\0"
+  "Santiago\0"
+  "Santo_Domingo\0"
+  "Sao_Paulo\0"
+  "Scoresbysund\0"
+  "Sitka\0"
+  "St_Barthelemy\0"
+  "St_Johns\0"
+  "St_Kitts\0"
+  "St_Lucia\0"
+  "St_Thomas\0"
+  "St_Vincent\0"
+  "Swift_Current\0"
+  "Tegucigalpa\0"
+  "Thule\0"
+  "Tijuana\0"
+  "Toronto\0"
+  "Tortola\0"
+  "Vancouver\0"
+  "Whitehorse\0"
+  "Winnipeg\0"
+  "Yakutat\0"
+  "Casey\0"
+  "Davis\0"
+  "DumontDUrville\0"
+  "Macquarie\0"
+  "Mawson\0"
+  "McMurdo\0"
+  "Palmer\0"
+  "Rothera\0"
+  "Syowa\0"
+  "Troll\0"
+  "Vostok\0"
+  "Longyearbyen\0"
+  "Aden\0"
+  "Almaty\0"
+  "Amman\0"
+  "Anadyr\0"
+  "Aqtau\0"
+  "Aqtobe\0"
+  "Ashgabat\0"
+  "Atyrau\0"
+  "Baghdad\0"
+  "Bahrain\0"
+  "Baku\0"
+  "Bangkok\0"
+  "Barnaul\0"
+  "Beirut\0"
+  "Bishkek\0"
+  "Brunei\0"
+  "Chita\0"
+  "Colombo\0"
+  "Damascus\0"
+  "Dhaka\0"
+  "Dili\0"
+  "Dubai\0"
+  "Dushanbe\0"
+  "Famagusta\0"
+  "Gaza\0"
+  "Hebron\0"
+  "Ho_Chi_Minh\0"
+  "Hong_Kong\0"
+  "Hovd\0"
+  "Irkutsk\0"
+  "Jakarta\0"
+  "Jayapura\0"
+  "Jerusalem\0"
+  "Kabul\0"
+  "Kamchatka\0"
+  "Karachi\0"
+  "Kathmandu\0"
+  "Khandyga\0"
+  "Kolkata\0"
+  "Krasnoyarsk\0"
+  "Kuala_Lumpur\0"
+  "Kuching\0"
+  "Kuwait\0"
+  "Macau\0"
+  "Magadan\0"
+  "Makassar\0"
+  "Manila\0"
+  "Muscat\0"
+  "Nicosia\0"
+  "Novokuznetsk\0"
+  "Novosibirsk\0"
+  "Omsk\0"
+  "Oral\0"
+  "Phnom_Penh\0"
+  "Pontianak\0"
+  "Pyongyang\0"
+  "Qatar\0"
+  "Qostanay\0"
+  "Qyzylorda\0"
+  "Riyadh\0"
+  "Sakhalin\0"
+  "Samarkand\0"
+  "Seoul\0"
+  "Shanghai\0"
+  "Singapore\0"
+  "Srednekolymsk\0"
+  "Taipei\0"
+  "Tashkent\0"
+  "Tbilisi\0"
+  "Tehran\0"
+  "Thimphu\0"
+  "Tokyo\0"
+  "Tomsk\0"
+  "Ulaanbaatar\0"
+  "Urumqi\0"
+  "Ust-Nera\0"
+  "Vientiane\0"
+  "Vladivostok\0"
+  "Yakutsk\0"
+  "Yangon\0"
+  "Yekaterinburg\0"
+  "Yerevan\0"
+  "Azores\0"
+  "Bermuda\0"
+  "Canary\0"
+  "Cape_Verde\0"
+  "Faroe\0"
+  "Madeira\0"
+  "Reykjavik\0"
+  "South_Georgia\0"
+  "St_Helena\0"
+  "Stanley\0"
+  "Adelaide\0"
+  "Brisbane\0"
+  "Broken_Hill\0"
+  "Darwin\0"
+  "Eucla\0"
+  "Hobart\0"
+  "Lindeman\0"
+  "Lord_Howe\0"
+  "Melbourne\0"
+  "Perth\0"
+  "Sydney\0"
+  "UTC\0"
+  "Amsterdam\0"
+  "Andorra\0"
+  "Astrakhan\0"
+  "Athens\0"
+  "Belgrade\0"
+  "Berlin\0"
+  "Bratislava\0"
+  "Brussels\0"
+  "Bucharest\0"
+  "Budapest\0"
+  "Busingen\0"
+  "Chisinau\0"
+  "Copenhagen\0"
+  "Dublin\0"
+  "Gibraltar\0"
+  "Guernsey\0"
+  "Helsinki\0"
+  "Isle_of_Man\0"
+  "Istanbul\0"
+  "Jersey\0"
+  "Kaliningrad\0"
+  "Kirov\0"
+  "Kyiv\0"
+  "Lisbon\0"
+  "Ljubljana\0"
+  "London\0"
+  "Luxembourg\0"
+  "Madrid\0"
+  "Malta\0"
+  "Mariehamn\0"
+  "Minsk\0"
+  "Monaco\0"
+  "Moscow\0"
+  "Oslo\0"
+  "Paris\0"
+  "Podgorica\0"
+  "Prague\0"
+  "Riga\0"
+  "Rome\0"
+  "Samara\0"
+  "San_Marino\0"
+  "Sarajevo\0"
+  "Saratov\0"
+  "Simferopol\0"
+  "Skopje\0"
+  "Sofia\0"
+  "Stockholm\0"
+  "Tallinn\0"
+  "Tirane\0"
+  "Ulyanovsk\0"
+  "Vaduz\0"
+  "Vatican\0"
+  "Vienna\0"
+  "Vilnius\0"
+  "Volgograd\0"
+  "Warsaw\0"
+  "Zagreb\0"
+  "Zurich\0"
+  "Antananarivo\0"
+  "Chagos\0"
+  "Christmas\0"
+  "Cocos\0"
+  "Comoro\0"
+  "Kerguelen\0"
+  "Mahe\0"
+  "Maldives\0"
+  "Mauritius\0"
+  "Mayotte\0"
+  "Reunion\0"
+  "Apia\0"
+  "Auckland\0"
+  "Bougainville\0"
+  "Chatham\0"
+  "Chuuk\0"
+  "Easter\0"
+  "Efate\0"
+  "Fakaofo\0"
+  "Fiji\0"
+  "Funafuti\0"
+  "Galapagos\0"
+  "Gambier\0"
+  "Guadalcanal\0"
+  "Guam\0"
+  "Honolulu\0"
+  "Kanton\0"
+  "Kiritimati\0"
+  "Kosrae\0"
+  "Kwajalein\0"
+  "Majuro\0"
+  "Marquesas\0"
+  "Midway\0"
+  "Nauru\0"
+  "Niue\0"
+  "Norfolk\0"
+  "Noumea\0"
+  "Pago_Pago\0"
+  "Palau\0"
+  "Pitcairn\0"
+  "Pohnpei\0"
+  "Port_Moresby\0"
+  "Rarotonga\0"
+  "Saipan\0"
+  "Tahiti\0"
+  "Tarawa\0"
+  "Tongatapu\0"
+  "Wake\0"
+  "Wallis\0";
+// Sorted by full name
+static const ZoneEntry zoneEntries[] PROGMEM = {
+  { 0, 0, 25 }, // Africa/Abidjan
+  { 8, 0, 25 }, // Africa/Accra
+  { 14, 0, 16 }, // Africa/Addis_Ababa
+  { 26, 0, 9 }, // Africa/Algiers
+  { 34, 0, 16 }, // Africa/Asmara
+  { 41, 0, 25 }, // Africa/Bamako
+  { 48, 0, 85 }, // Africa/Bangui
+  { 55, 0, 25 }, // Africa/Banjul
+  { 62, 0, 25 }, // Africa/Bissau
+  { 69, 0, 8 }, // Africa/Blantyre
+  { 78, 0, 85 }, // Africa/Brazzaville
+  { 90, 0, 8 }, // Africa/Bujumbura
+  { 100, 0, 22 }, // Africa/Cairo
+  { 106, 0, 45 }, // Africa/Casablanca
+  { 117, 0, 10 }, // Africa/Ceuta
+  { 123, 0, 25 }, // Africa/Conakry
+  { 131, 0, 25 }, // Africa/Dakar
+  { 137, 0, 16 }, // Africa/Dar_es_Salaam
+  { 151, 0, 16 }, // Africa/Djibouti
+  { 160, 0, 85 }, // Africa/Douala
+  { 167, 0, 45 }, // Africa/El_Aaiun
+  { 176, 0, 25 }, // Africa/Freetown
+  { 185, 0, 8 }, // Africa/Gaborone
+  { 194, 0, 8 }, // Africa/Harare
+  { 201, 0, 43 }, // Africa/Johannesburg
+  { 214, 0, 8 }, // Africa/Juba
+  { 219, 0, 16 }, // Africa/Kampala
+  { 227, 0, 8 }, // Africa/Khartoum
+  { 236, 0, 8 }, // Africa/Kigali
+  { 243, 0, 85 }, // Africa/Kinshasa
+  { 252, 0, 85 }, // Africa/Lagos
+  { 258, 0, 85 }, // Africa/Libreville
+  { 269, 0, 25 }, // Africa/Lome
+  { 274, 0, 85 }, // Africa/Luanda
+  { 281, 0, 8 }, // Africa/Lubumbashi
+  { 292, 0, 8 }, // Africa/Lusaka
+  { 299, 0, 85 }, // Africa/Malabo
+  { 306, 0, 8 }, // Africa/Maputo
+  { 313, 0, 43 }, // Africa/Maseru
+  { 320, 0, 43 }, // Africa/Mbabane
+  { 328, 0, 16 }, // Africa/Mogadishu
+  { 338, 0, 25 }, // Africa/Monrovia
+  { 347, 0, 16 }, // Africa/Nairobi
+  { 355, 0, 85 }, // Africa/Ndjamena
+  { 364, 0, 85 }, // Africa/Niamey
+  { 371, 0, 25 }, // Africa/Nouakchott
+  { 382, 0, 25 }, // Africa/Ouagadougou
+  { 394, 0, 85 }, // Africa/Porto-Novo
+  { 405, 0, 25 }, // Africa/Sao_Tome
+  { 414, 0, 17 }, // Africa/Tripoli
+  { 422, 0, 9 }, // Africa/Tunis
+  { 428, 0, 8 }, // Africa/Windhoek
+  { 437, 1, 29 }, // America/Adak
+  { 442, 1, 4 }, // America/Anchorage
+  { 452, 1, 5 }, // America/Anguilla
+  { 461, 1, 5 }, // America/Antigua
+  { 469, 1, 74 }, // America/Araguaina
+  { 479, 2, 74 }, // America/Argentina/Buenos_Aires
+  { 492, 2, 74 }, // America/Argentina/Catamarca
+  { 502, 2, 74 }, // America/Argentina/Cordoba
+  { 510, 2, 74 }, // America/Argentina/Jujuy
+  { 516, 2, 74 }, // America/Argentina/La_Rioja
+  { 525, 2, 74 }, // America/Argentina/Mendoza
+  { 533, 2, 74 }, // America/Argentina/Rio_Gallegos
+  { 546, 2, 74 }, // America/Argentina/Salta
+  { 552, 2, 74 }, // America/Argentina/San_Juan
+  { 561, 2, 74 }, // America/Argentina/San_Luis
+  { 570, 2, 74 }, // America/Argentina/Tucuman
+  { 578, 2, 74 }, // America/Argentina/Ushuaia
+  { 586, 1, 5 }, // America/Aruba
+  { 592, 1, 74 }, // America/Asuncion
+  { 601, 1, 23 }, // America/Atikokan
+  { 610, 1, 74 }, // America/Bahia
+  { 616, 1, 13 }, // America/Bahia_Banderas
+  { 631, 1, 5 }, // America/Barbados
+  { 640, 1, 74 }, // America/Belem
+  { 646, 1, 13 }, // America/Belize
+  { 653, 1, 5 }, // America/Blanc-Sablon
+  { 666, 1, 76 }, // America/Boa_Vista
+  { 676, 1, 78 }, // America/Bogota
+  { 683, 1, 37 }, // America/Boise
+  { 689, 1, 37 }, // America/Cambridge_Bay
+  { 703, 1, 76 }, // America/Campo_Grande
+  { 716, 1, 23 }, // America/Cancun
+  { 723, 1, 76 }, // America/Caracas
+  { 731, 1, 74 }, // America/Cayenne
+  { 739, 1, 23 }, // America/Cayman
+  { 746, 1, 14 }, // America/Chicago
+  { 754, 1, 13 }, // America/Chihuahua
+  { 764, 1, 37 }, // America/Ciudad_Juarez
+  { 778, 1, 13 }, // America/Costa_Rica
+  { 789, 1, 74 }, // America/Coyhaique
+  { 799, 1, 36 }, // America/Creston
+  { 807, 1, 76 }, // America/Cuiaba
+  { 814, 1, 5 }, // America/Curacao
+  { 822, 1, 25 }, // America/Danmarkshavn
+  { 835, 1, 36 }, // America/Dawson
+  { 842, 1, 36 }, // America/Dawson_Creek
+  { 855, 1, 37 }, // America/Denver
+  { 862, 1, 24 }, // America/Detroit
+  { 870, 1, 5 }, // America/Dominica
+  { 879, 1, 37 }, // America/Edmonton
+  { 888, 1, 78 }, // America/Eirunepe
+  { 897, 1, 13 }, // America/El_Salvador
+  { 909, 1, 36 }, // America/Fort_Nelson
+  { 921, 1, 74 }, // America/Fortaleza
+  { 931, 1, 6 }, // America/Glace_Bay
+  { 941, 1, 6 }, // America/Goose_Bay
+  { 951, 1, 24 }, // America/Grand_Turk
+  { 962, 1, 5 }, // America/Grenada
+  { 970, 1, 5 }, // America/Guadeloupe
+  { 981, 1, 13 }, // America/Guatemala
+  { 991, 1, 78 }, // America/Guayaquil
+  { 1001, 1, 76 }, // America/Guyana
+  { 1008, 1, 6 }, // America/Halifax
+  { 1016, 1, 12 }, // America/Havana
+  { 1023, 1, 36 }, // America/Hermosillo
+  { 1034, 3, 24 }, // America/Indiana/Indianapolis
+  { 1047, 3, 14 }, // America/Indiana/Knox
+  { 1052, 3, 24 }, // America/Indiana/Marengo
+  { 1060, 3, 24 }, // America/Indiana/Petersburg
+  { 1071, 3, 14 }, // America/Indiana/Tell_City
+  { 1081, 3, 24 }, // America/Indiana/Vevay
+  { 1087, 3, 24 }, // America/Indiana/Vincennes
+  { 1097, 3, 24 }, // America/Indiana/Winamac
+  { 1105, 1, 37 }, // America/Inuvik
+  { 1112, 1, 24 }, // America/Iqaluit
+  { 1120, 1, 23 }, // America/Jamaica
+  { 1128, 1, 4 }, // America/Juneau
+  { 1135, 4, 24 }, // America/Kentucky/Louisville
+  { 1146, 4, 24 }, // America/Kentucky/Monticello
+  { 1157, 1, 5 }, // America/Kralendijk
+  { 1168, 1, 76 }, // America/La_Paz
+  { 1175, 1, 78 }, // America/Lima
+  { 1180, 1, 42 }, // America/Los_Angeles
+  { 1192, 1, 5 }, // America/Lower_Princes
+  { 1206, 1, 74 }, // America/Maceio
+  { 1213, 1, 13 }, // America/Managua
+  { 1221, 1, 76 }, // America/Manaus
+  { 1228, 1, 5 }, // America/Marigot
+  { 1236, 1, 5 }, // America/Martinique
+  { 1247, 1, 14 }, // America/Matamoros
+  { 1257, 1, 36 }, // America/Mazatlan
+  { 1266, 1, 14 }, // America/Menominee
+  { 1276, 1, 13 }, // America/Merida
+  { 1283, 1, 4 }, // America/Metlakatla
+  { 1294, 1, 13 }, // America/Mexico_City
+  { 1306, 1, 75 }, // America/Miquelon
+  { 1315, 1, 6 }, // America/Moncton
+  { 1323, 1, 13 }, // America/Monterrey
+  { 1333, 1, 74 }, // America/Montevideo
+  { 1344, 1, 5 }, // America/Montserrat
+  { 1355, 1, 24 }, // America/Nassau
+  { 1362, 1, 24 }, // America/New_York
+  { 1371, 1, 4 }, // America/Nome
+  { 1376, 1, 72 }, // America/Noronha
+  { 1384, 5, 14 }, // America/North_Dakota/Beulah
+  { 1391, 5, 14 }, // America/North_Dakota/Center
+  { 1398, 5, 14 }, // America/North_Dakota/New_Salem
+  { 1408, 1, 73 }, // America/Nuuk
+  { 1413, 1, 14 }, // America/Ojinaga
+  { 1421, 1, 23 }, // America/Panama
+  { 1428, 1, 74 }, // America/Paramaribo
+  { 1439, 1, 36 }, // America/Phoenix
+  { 1447, 1, 24 }, // America/Port-au-Prince
+  { 1462, 1, 5 }, // America/Port_of_Spain
+  { 1476, 1, 76 }, // America/Porto_Velho
+  { 1488, 1, 5 }, // America/Puerto_Rico
+  { 1500, 1, 74 }, // America/Punta_Arenas
+  { 1513, 1, 14 }, // America/Rankin_Inlet
+  { 1526, 1, 74 }, // America/Recife
+  { 1533, 1, 13 }, // America/Regina
+  { 1540, 1, 14 }, // America/Resolute
+  { 1549, 1, 78 }, // America/Rio_Branco
+  { 1560, 1, 74 }, // America/Santarem
+  { 1569, 1, 77 }, // America/Santiago
+  { 1578, 1, 5 }, // America/Santo_Domingo
+  { 1592, 1, 74 }, // America/Sao_Paulo
+  { 1602, 1, 73 }, // America/Scoresbysund
+  { 1615, 1, 4 }, // America/Sitka
+  { 1621, 1, 5 }, // America/St_Barthelemy
+  { 1635, 1, 38 }, // America/St_Johns
+  { 1644, 1, 5 }, // America/St_Kitts
+  { 1653, 1, 5 }, // America/St_Lucia
+  { 1662, 1, 5 }, // America/St_Thomas
+  { 1672, 1, 5 }, // America/St_Vincent
+  { 1683, 1, 13 }, // America/Swift_Current
+  { 1697, 1, 13 }, // America/Tegucigalpa
+  { 1709, 1, 6 }, // America/Thule
+  { 1715, 1, 42 }, // America/Tijuana
+  { 1723, 1, 24 }, // America/Toronto
+  { 1731, 1, 5 }, // America/Tortola
+  { 1739, 1, 42 }, // America/Vancouver
+  { 1749, 1, 36 }, // America/Whitehorse
+  { 1760, 1, 14 }, // America/Winnipeg
+  { 1769, 1, 4 }, // America/Yakutat
+  { 1777, 6, 64 }, // Antarctica/Casey
+  { 1783, 6, 63 }, // Antarctica/Davis
+  { 1789, 6, 46 }, // Antarctica/DumontDUrville
+  { 1804, 6, 3 }, // Antarctica/Macquarie
+  { 1814, 6, 58 }, // Antarctica/Mawson
+  { 1821, 6, 39 }, // Antarctica/McMurdo
+  { 1829, 6, 74 }, // Antarctica/Palmer
+  { 1836, 6, 74 }, // Antarctica/Rothera
+  { 1844, 6, 54 }, // Antarctica/Syowa
+  { 1850, 6, 67 }, // Antarctica/Troll
+  { 1856, 6, 58 }, // Antarctica/Vostok
+  { 1863, 7, 10 }, // Arctic/Longyearbyen
+  { 1876, 8, 54 }, // Asia/Aden
+  { 1881, 8, 58 }, // Asia/Almaty
+  { 1888, 8, 54 }, // Asia/Amman
+  { 1894, 8, 50 }, // Asia/Anadyr
+  { 1901, 8, 58 }, // Asia/Aqtau
+  { 1907, 8, 58 }, // Asia/Aqtobe
+  { 1914, 8, 58 }, // Asia/Ashgabat
+  { 1923, 8, 58 }, // Asia/Atyrau
+  { 1930, 8, 54 }, // Asia/Baghdad
+  { 1938, 8, 54 }, // Asia/Bahrain
+  { 1946, 8, 56 }, // Asia/Baku
+  { 1951, 8, 63 }, // Asia/Bangkok
+  { 1959, 8, 63 }, // Asia/Barnaul
+  { 1967, 8, 20 }, // Asia/Beirut
+  { 1974, 8, 61 }, // Asia/Bishkek
+  { 1982, 8, 64 }, // Asia/Brunei
+  { 1989, 8, 66 }, // Asia/Chita
+  { 1995, 8, 59 }, // Asia/Colombo
+  { 2003, 8, 54 }, // Asia/Damascus
+  { 2012, 8, 61 }, // Asia/Dhaka
+  { 2018, 8, 66 }, // Asia/Dili
+  { 2023, 8, 56 }, // Asia/Dubai
+  { 2029, 8, 58 }, // Asia/Dushanbe
+  { 2038, 8, 21 }, // Asia/Famagusta
+  { 2048, 8, 18 }, // Asia/Gaza
+  { 2053, 8, 18 }, // Asia/Hebron
+  { 2060, 8, 63 }, // Asia/Ho_Chi_Minh
+  { 2072, 8, 27 }, // Asia/Hong_Kong
+  { 2082, 8, 63 }, // Asia/Hovd
+  { 2087, 8, 64 }, // Asia/Irkutsk
+  { 2095, 8, 87 }, // Asia/Jakarta
+  { 2103, 8, 88 }, // Asia/Jayapura
+  { 2112, 8, 31 }, // Asia/Jerusalem
+  { 2122, 8, 57 }, // Asia/Kabul
+  { 2128, 8, 50 }, // Asia/Kamchatka
+  { 2138, 8, 40 }, // Asia/Karachi
+  { 2146, 8, 60 }, // Asia/Kathmandu
+  { 2156, 8, 66 }, // Asia/Khandyga
+  { 2165, 8, 32 }, // Asia/Kolkata
+  { 2173, 8, 63 }, // Asia/Krasnoyarsk
+  { 2185, 8, 64 }, // Asia/Kuala_Lumpur
+  { 2198, 8, 64 }, // Asia/Kuching
+  { 2206, 8, 54 }, // Asia/Kuwait
+  { 2213, 8, 11 }, // Asia/Macau
+  { 2219, 8, 48 }, // Asia/Magadan
+  { 2227, 8, 89 }, // Asia/Makassar
+  { 2236, 8, 41 }, // Asia/Manila
+  { 2243, 8, 56 }, // Asia/Muscat
+  { 2250, 8, 21 }, // Asia/Nicosia
+  { 2258, 8, 63 }, // Asia/Novokuznetsk
+  { 2271, 8, 63 }, // Asia/Novosibirsk
+  { 2283, 8, 61 }, // Asia/Omsk
+  { 2288, 8, 58 }, // Asia/Oral
+  { 2293, 8, 63 }, // Asia/Phnom_Penh
+  { 2304, 8, 87 }, // Asia/Pontianak
+  { 2314, 8, 34 }, // Asia/Pyongyang
+  { 2324, 8, 54 }, // Asia/Qatar
+  { 2330, 8, 58 }, // Asia/Qostanay
+  { 2339, 8, 58 }, // Asia/Qyzylorda
+  { 2349, 8, 54 }, // Asia/Riyadh
+  { 2356, 8, 48 }, // Asia/Sakhalin
+  { 2365, 8, 58 }, // Asia/Samarkand
+  { 2375, 8, 34 }, // Asia/Seoul
+  { 2381, 8, 11 }, // Asia/Shanghai
+  { 2390, 8, 64 }, // Asia/Singapore
+  { 2400, 8, 48 }, // Asia/Srednekolymsk
+  { 2414, 8, 11 }, // Asia/Taipei
+  { 2421, 8, 58 }, // Asia/Tashkent
+  { 2430, 8, 56 }, // Asia/Tbilisi
+  { 2438, 8, 55 }, // Asia/Tehran
+  { 2445, 8, 61 }, // Asia/Thimphu
+  { 2453, 8, 33 }, // Asia/Tokyo
+  { 2459, 8, 63 }, // Asia/Tomsk
+  { 2465, 8, 64 }, // Asia/Ulaanbaatar
+  { 2477, 8, 61 }, // Asia/Urumqi
+  { 2484, 8, 46 }, // Asia/Ust-Nera
+  { 2493, 8, 63 }, // Asia/Vientiane
+  { 2503, 8, 46 }, // Asia/Vladivostok
+  { 2515, 8, 66 }, // Asia/Yakutsk
+  { 2523, 8, 62 }, // Asia/Yangon
+  { 2530, 8, 58 }, // Asia/Yekaterinburg
+  { 2544, 8, 56 }, // Asia/Yerevan
+  { 2552, 9, 71 }, // Atlantic/Azores
+  { 2559, 9, 6 }, // Atlantic/Bermuda
+  { 2567, 9, 86 }, // Atlantic/Canary
+  { 2574, 9, 68 }, // Atlantic/Cape_Verde
+  { 2585, 9, 86 }, // Atlantic/Faroe
+  { 2591, 9, 86 }, // Atlantic/Madeira
+  { 2599, 9, 25 }, // Atlantic/Reykjavik
+  { 2609, 9, 72 }, // Atlantic/South_Georgia
+  { 2623, 9, 25 }, // Atlantic/St_Helena
+  { 2633, 9, 74 }, // Atlantic/Stanley
+  { 2641, 10, 1 }, // Australia/Adelaide
+  { 2650, 10, 2 }, // Australia/Brisbane
+  { 2659, 10, 1 }, // Australia/Broken_Hill
+  { 2671, 10, 0 }, // Australia/Darwin
+  { 2678, 10, 65 }, // Australia/Eucla
+  { 2684, 10, 3 }, // Australia/Hobart
+  { 2691, 10, 2 }, // Australia/Lindeman
+  { 2700, 10, 47 }, // Australia/Lord_Howe
+  { 2710, 10, 3 }, // Australia/Melbourne
+  { 2720, 10, 7 }, // Australia/Perth
+  { 2726, 10, 3 }, // Australia/Sydney
+  { 2733, 11, 84 }, // Etc/UTC
+  { 2737, 12, 10 }, // Europe/Amsterdam
+  { 2747, 12, 10 }, // Europe/Andorra
+  { 2755, 12, 56 }, // Europe/Astrakhan
+  { 2765, 12, 21 }, // Europe/Athens
+  { 2772, 12, 10 }, // Europe/Belgrade
+  { 2781, 12, 10 }, // Europe/Berlin
+  { 2788, 12, 10 }, // Europe/Bratislava
+  { 2799, 12, 10 }, // Europe/Brussels
+  { 2808, 12, 21 }, // Europe/Bucharest
+  { 2818, 12, 10 }, // Europe/Budapest
+  { 2827, 12, 10 }, // Europe/Busingen
+  { 2836, 12, 19 }, // Europe/Chisinau
+  { 2845, 12, 10 }, // Europe/Copenhagen
+  { 2856, 12, 30 }, // Europe/Dublin
+  { 2863, 12, 10 }, // Europe/Gibraltar
+  { 2873, 12, 26 }, // Europe/Guernsey
+  { 2882, 12, 21 }, // Europe/Helsinki
+  { 2891, 12, 26 }, // Europe/Isle_of_Man
+  { 2903, 12, 54 }, // Europe/Istanbul
+  { 2912, 12, 26 }, // Europe/Jersey
+  { 2919, 12, 17 }, // Europe/Kaliningrad
+  { 2931, 12, 35 }, // Europe/Kirov
+  { 2937, 12, 21 }, // Europe/Kyiv
+  { 2942, 12, 86 }, // Europe/Lisbon
+  { 2949, 12, 10 }, // Europe/Ljubljana
+  { 2959, 12, 26 }, // Europe/London
+  { 2966, 12, 10 }, // Europe/Luxembourg
+  { 2977, 12, 10 }, // Europe/Madrid
+  { 2984, 12, 10 }, // Europe/Malta
+  { 2990, 12, 21 }, // Europe/Mariehamn
+  { 3000, 12, 54 }, // Europe/Minsk
+  { 3006, 12, 10 }, // Europe/Monaco
+  { 3013, 12, 35 }, // Europe/Moscow
+  { 3020, 12, 10 }, // Europe/Oslo
+  { 3025, 12, 10 }, // Europe/Paris
+  { 3031, 12, 10 }, // Europe/Podgorica
+  { 3041, 12, 10 }, // Europe/Prague
+  { 3048, 12, 21 }, // Europe/Riga
+  { 3053, 12, 10 }, // Europe/Rome
+  { 3058, 12, 56 }, // Europe/Samara
+  { 3065, 12, 10 }, // Europe/San_Marino
+  { 3076, 12, 10 }, // Europe/Sarajevo
+  { 3085, 12, 56 }, // Europe/Saratov
+  { 3093, 12, 35 }, // Europe/Simferopol
+  { 3104, 12, 10 }, // Europe/Skopje
+  { 3111, 12, 21 }, // Europe/Sofia
+  { 3117, 12, 10 }, // Europe/Stockholm
+  { 3127, 12, 21 }, // Europe/Tallinn
+  { 3135, 12, 10 }, // Europe/Tirane
+  { 3142, 12, 56 }, // Europe/Ulyanovsk
+  { 3152, 12, 10 }, // Europe/Vaduz
+  { 3158, 12, 10 }, // Europe/Vatican
+  { 3166, 12, 10 }, // Europe/Vienna
+  { 3173, 12, 21 }, // Europe/Vilnius
+  { 3181, 12, 35 }, // Europe/Volgograd
+  { 3191, 12, 10 }, // Europe/Warsaw
+  { 3198, 12, 10 }, // Europe/Zagreb
+  { 3205, 12, 10 }, // Europe/Zurich
+  { 3212, 13, 16 }, // Indian/Antananarivo
+  { 3225, 13, 61 }, // Indian/Chagos
+  { 3232, 13, 63 }, // Indian/Christmas
+  { 3242, 13, 62 }, // Indian/Cocos
+  { 3248, 13, 16 }, // Indian/Comoro
+  { 3255, 13, 58 }, // Indian/Kerguelen
+  { 3265, 13, 56 }, // Indian/Mahe
+  { 3270, 13, 58 }, // Indian/Maldives
+  { 3279, 13, 56 }, // Indian/Mauritius
+  { 3289, 13, 16 }, // Indian/Mayotte
+  { 3297, 13, 56 }, // Indian/Reunion
+  { 3305, 14, 52 }, // Pacific/Apia
+  { 3310, 14, 39 }, // Pacific/Auckland
+  { 3319, 14, 48 }, // Pacific/Bougainville
+  { 3332, 14, 51 }, // Pacific/Chatham
+  { 3340, 14, 46 }, // Pacific/Chuuk
+  { 3346, 14, 80 }, // Pacific/Easter
+  { 3353, 14, 48 }, // Pacific/Efate
+  { 3359, 14, 52 }, // Pacific/Fakaofo
+  { 3367, 14, 50 }, // Pacific/Fiji
+  { 3372, 14, 50 }, // Pacific/Funafuti
+  { 3381, 14, 79 }, // Pacific/Galapagos
+  { 3391, 14, 82 }, // Pacific/Gambier
+  { 3399, 14, 48 }, // Pacific/Guadalcanal
+  { 3411, 14, 15 }, // Pacific/Guam
+  { 3416, 14, 28 }, // Pacific/Honolulu
+  { 3425, 14, 52 }, // Pacific/Kanton
+  { 3432, 14, 53 }, // Pacific/Kiritimati
+  { 3443, 14, 48 }, // Pacific/Kosrae
+  { 3450, 14, 50 }, // Pacific/Kwajalein
+  { 3460, 14, 50 }, // Pacific/Majuro
+  { 3467, 14, 83 }, // Pacific/Marquesas
+  { 3477, 14, 44 }, // Pacific/Midway
+  { 3484, 14, 50 }, // Pacific/Nauru
+  { 3490, 14, 70 }, // Pacific/Niue
+  { 3495, 14, 49 }, // Pacific/Norfolk
+  { 3503, 14, 48 }, // Pacific/Noumea
+  { 3510, 14, 44 }, // Pacific/Pago_Pago
+  { 3520, 14, 66 }, // Pacific/Palau
+  { 3526, 14, 81 }, // Pacific/Pitcairn
+  { 3535, 14, 48 }, // Pacific/Pohnpei
+  { 3543, 14, 46 }, // Pacific/Port_Moresby
+  { 3556, 14, 69 }, // Pacific/Rarotonga
+  { 3566, 14, 15 }, // Pacific/Saipan
+  { 3573, 14, 69 }, // Pacific/Tahiti
+  { 3580, 14, 50 }, // Pacific/Tarawa
+  { 3587, 14, 52 }, // Pacific/Tongatapu
+  { 3597, 14, 50 }, // Pacific/Wake
+  { 3602, 14, 50 }, // Pacific/Wallis
+};
@@ -0,0 +1,90 @@
+// zones.cpp - the built-in database of IANA timezone names and their POSIX TZ rules
+//
+// The data itself is generated by tools/gen_zones.py into zonedata.h
+
+#include <Arduino.h>
+#include "zones.h"
+
+typedef struct ZoneEntry_t {
+    uint16_t city;   // Offset into zoneCities
+    uint8_t region;  // Index into zoneRegionOffsets, or ZONE_NO_REGION
+    uint8_t rule;    // Index into zoneRuleOffsets
+} ZoneEntry;
+
+#include "zonedata.h"
+
+/**
+ * Read a zone's entry out of flash
+ */
+static ZoneEntry readEntry(uint16_t i) {
+    ZoneEntry entry;
+    memcpy_P(&entry, &zoneEntries[i], sizeof(ZoneEntry));
+    return entry;
+}
+
+/**
+ * Compare a name with a zone's full name, in the same way as strcmp()
+ */
+static int compareZone(const char *name, const ZoneEntry &entry) {
+    if (entry.region != ZONE_NO_REGION) {
+        const char *region = zoneRegions + pgm_read_word(&zoneRegionOffsets[entry.region]);
+        size_t len = strlen_P(region);
+        int c = strncmp_P(name, region, len);
+        if (c) return c;
+        name += len;
+        if (*name != '/') return (uint8_t)*name - '/';
+        name++;
+    }
+    return strcmp_P(name, zoneCities + entry.city);
+}
+
+/**
+ * Look up the POSIX TZ rule for an IANA timezone name, such as "Asia/Kolkata"
+ *
+ * Returns false if there is no such zone, or the rule doesn't fit in len characters
+ */
+bool getZoneRule(const char *name, char *rule, size_t len) {
+    int low = 0;
+    int high = ZONE_COUNT - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        ZoneEntry entry = readEntry(mid);
+        int c = compareZone(name, entry);
+        if (c < 0) {
+            high = mid - 1;
+        } else if (c > 0) {
+            low = mid + 1;
+        } else {
+            const char *found = zoneRules + pgm_read_word(&zoneRuleOffsets[entry.rule]);
+            if (strlen_P(found) >= len) return false;
+            strcpy_P(rule, found);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * How many zones are in the database
+ */
+uint16_t getZoneCount() {
+    return ZONE_COUNT;
+}
+
+/**
+ * Get the full name of a zone, in alphabetical order
+ */
+void getZoneName(uint16_t i, char *buf, size_t len) {
+    ZoneEntry entry = readEntry(i);
+    size_t n = 0;
+    buf[0] = 0;
+    if (!len) return;
+    if (entry.region != ZONE_NO_REGION) {
+        strncpy_P(buf, zoneRegions + pgm_read_word(&zoneRegionOffsets[entry.region]), len - 1);
+        buf[len - 1] = 0;
+        n = strlen(buf);
+        if (n < len - 1) buf[n++] = '/';
+    }
+    strncpy_P(buf + n, zoneCities + entry.city, len - n - 1);
+    buf[len - 1] = 0;
+}
@@ -0,0 +1,12 @@
+#ifndef _ZONES_H_
+#define _ZONES_H_
+
+#include <Arduino.h>
+
+#define ZONE_RULE_MAX_LENGTH 48 // Including the terminating null
+
+bool getZoneRule(const char *name, char *rule, size_t len);
+uint16_t getZoneCount();
+void getZoneName(uint16_t i, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,172 @@
+// test_alarms - alarms going off at local times in Europe/London, across both changes of the clocks
+//
+// The alarms are set over HTTP, as the configuration page does, and each one that goes off is
+// acknowledged with the SET button. The expected times are UTC, from the build machine's zone
+// database.
+
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "alarms.h"
+#include "buttons.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+
+#define START_UTC 1805457600LL            // Friday 2027-03-19 12:00 GMT
+#define SPRING_FORWARD_UTC 1806199200LL   // Sunday 2027-03-28 01:00 GMT becomes 02:00 BST
+#define FALL_BACK_UTC 1824944400LL        // Sunday 2027-10-31 02:00 BST becomes 01:00 GMT
+#define WEEKDAYS 0x3e                     // Monday to Friday
+#define EVERY_DAY 0x7f
+#define DAY_MILLIS (24ULL * 3600ULL * 1000ULL)
+#define RING_MILLIS (5ULL * 60ULL * 1000ULL)
+#define LATE_MICROS 1100000LL             // Alarms are checked once a loop() pass, which can be a second
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * Set alarm 0 to go off at hhmm on days (0 for once), turning the others off
+ */
+static void setAlarm(const char *hhmm, uint8_t days) {
+  std::string form = std::string("t0=") + hhmm + "&d0=" + std::to_string(days) + "&e0=on";
+  for (int i = 1 ; i < ALARM_COUNT ; i++) form += "&t" + std::to_string(i) + "=00:00";
+  TEST_ASSERT_EQUAL_INT(202, simHttp("POST", "/alarms", form).status);
+  simRun(1000);
+}
+
+/**
+ * Turn every alarm off, then jump the true time to utc - with an alarm left on, the clock would
+ * rightly go off for the ones it missed when it caught up
+ */
+static void warpTo(int64_t utc) {
+  std::string form = "t0=00:00";
+  for (int i = 1 ; i < ALARM_COUNT ; i++) form += "&t" + std::to_string(i) + "=00:00";
+  TEST_ASSERT_EQUAL_INT(202, simHttp("POST", "/alarms", form).status);
+  simRun(1000);
+  simWarp((utc - simTrueMicros() / 1000000) * 1000);
+}
+
+static void pressSet() {
+  simSetButton(SET_BUTTON_PIN, true);
+  simRun(200);
+  simSetButton(SET_BUTTON_PIN, false);
+  simRun(200);
+}
+
+/**
+ * The true UTC times, in seconds, at which the alarm went off over the next ms - each one stopped
+ * with SET
+ */
+static std::vector<int64_t> rings(uint64_t ms) {
+  std::vector<int64_t> ans;
+  uint64_t until = simMicros() + ms * 1000ULL;
+  while (simRunUntil([]() { return alarmIsRinging(); }, (until - simMicros()) / 1000)) {
+    ans.push_back(simTrueMicros());
+    pressSet();
+    TEST_ASSERT_FALSE(alarmIsRinging());
+    if (simMicros() >= until) break;
+  }
+  return ans;
+}
+
+static void checkRings(const std::vector<int64_t> &expected, const std::vector<int64_t> &got) {
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), got.size());
+  for (size_t i = 0 ; i < got.size() ; i++) {
+    TEST_ASSERT_INT64_WITHIN(LATE_MICROS / 2, expected[i] * 1000000LL + LATE_MICROS / 2, got[i]);
+  }
+}
+
+/**
+ * 07:30 on weekdays, for the two weeks around the start of BST - an hour earlier in UTC from the
+ * second week, and never at the weekend
+ */
+void test_weekdays(void) {
+  std::vector<int64_t> expected = {
+    1805700600, 1805787000, 1805873400, 1805959800, 1806046200,   // 22 .. 26 March, GMT
+    1806301800, 1806388200, 1806474600, 1806561000, 1806647400    // 29 March .. 2 April, BST
+  };
+  setAlarm("07:30", WEEKDAYS);
+  checkRings(expected, rings(14 * DAY_MILLIS));
+}
+
+/**
+ * Every day at 01:30 - which doesn't happen on the day the clocks go forward, so it goes off an
+ * hour later, at 02:30 BST
+ */
+void test_spring_forward_gap(void) {
+  std::vector<int64_t> expected = {
+    1806111000,                           // 27 March, 01:30 GMT
+    1806197400,                           // 28 March, 02:30 BST - 01:30 is skipped
+    1806280200                            // 29 March, 01:30 BST
+  };
+  warpTo(1806080000LL);                   // 26 March, 15:33 GMT
+  setAlarm("01:30", EVERY_DAY);
+  checkRings(expected, rings(3 * DAY_MILLIS));
+}
+
+/**
+ * Every day at 01:30, which happens twice the day the clocks go back - it goes off once
+ */
+void test_fall_back_repeat(void) {
+  std::vector<int64_t> got;
+  warpTo(1824820000LL);                   // 29 October, 15:26 BST
+  setAlarm("01:30", EVERY_DAY);
+  got = rings(3 * DAY_MILLIS);
+  TEST_ASSERT_EQUAL_UINT32(3, got.size());
+  TEST_ASSERT_INT64_WITHIN(LATE_MICROS, 1824856200LL * 1000000LL, got[0]);    // 30 October, 01:30 BST
+  // The first 01:30, or the second - either is right, but not both
+  TEST_ASSERT_TRUE((llabs(got[1] - 1824942600LL * 1000000LL) < LATE_MICROS) || (llabs(got[1] - 1824946200LL * 1000000LL) < LATE_MICROS));
+  TEST_ASSERT_INT64_WITHIN(LATE_MICROS, 1825032600LL * 1000000LL, got[2]);    // 1 November, 01:30 GMT
+}
+
+/**
+ * A one-shot goes off at the next 18:00, switches itself off, and stops flashing by itself after
+ * five minutes if nobody presses SET
+ */
+void test_one_shot(void) {
+  Alarm alarms[ALARM_COUNT];
+  uint64_t rang;
+  bool dark = false;
+  warpTo(1825050000LL);                   // 1 November, 06:20 GMT
+  setAlarm("18:00", 0);
+  TEST_ASSERT_EQUAL_INT64(1825092000LL, getNextAlarmTime());
+  TEST_ASSERT_TRUE(simRunUntil([]() { return alarmIsRinging(); }, DAY_MILLIS));
+  TEST_ASSERT_INT64_WITHIN(LATE_MICROS, 1825092000LL * 1000000LL, simTrueMicros());
+  rang = simMicros();
+  getAlarms(alarms);
+  TEST_ASSERT_EQUAL_UINT8(0, alarms[0].enabled);
+  TEST_ASSERT_EQUAL_INT64(0, getNextAlarmTime());
+  // Flashing, until it gives up
+  for (int i = 0 ; (i < 20) && !dark ; i++) {
+    simRun(100);
+    dark = !simDisplayLit();
+  }
+  TEST_ASSERT_TRUE(dark);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return !alarmIsRinging(); }, RING_MILLIS + 1000));
+  TEST_ASSERT_UINT64_WITHIN(1000000, RING_MILLIS * 1000ULL, simMicros() - rang);
+  TEST_ASSERT_TRUE(simDisplayLit());
+  checkRings({}, rings(2 * DAY_MILLIS));
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.end();
+  simSetTrueTime(START_UTC);
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_weekdays);
+  RUN_TEST(test_spring_forward_gap);
+  RUN_TEST(test_fall_back_repeat);
+  RUN_TEST(test_one_shot);
+  return UNITY_END();
+}
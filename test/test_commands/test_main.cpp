@@ -0,0 +1,136 @@
+// test_commands - the command queue between the web server's callbacks and loop()
+//
+// On the ESP the web server's callbacks interrupt loop() wherever it is. Here a second thread
+// stands in for the network stack, queueing thousands of commands as fast as it can while loop()
+// runs and drains them. Each command sets the brightness to the next level along, so every one of
+// them is a write to the TM1650's control register: the writes must be those levels, in the order
+// they were queued, each exactly once. A command the queue refuses is tried again, as a browser
+// would after a 503.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "commands.h"
+#include "display.h"
+#include "timekeeping.h"
+
+#define STRESS_COMMANDS 20000
+#define CONFIG_EVERY 97                   // Every so often, a whole configuration instead
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * The brightness levels sent to the TM1650 since simClearDisplayWrites()
+ */
+static std::vector<uint8_t> brightnessWrites() {
+  std::vector<uint8_t> ans;
+  for (const SimDisplayWrite &write : simDisplayWrites()) {
+    if (write.address == 0x24) ans.push_back(((write.value >> 4) + 7) & 7);
+  }
+  return ans;
+}
+
+/**
+ * A configuration form, as the home page posts it, with its own hostname
+ */
+static CommandParams *configForm(uint32_t n) {
+  CommandParams *params = new CommandParams();
+  params->add(CFG_SSID, "sim");
+  params->add(CFG_NTP_SERVER_1, "pool.ntp.org");
+  params->add(CFG_ZONE, "Europe/London");
+  params->add(CFG_HOSTNAME, String("clock") + n);
+  params->add("24h", "on");
+  return params;
+}
+
+/**
+ * A full queue refuses a command, and the ones it took are run in order
+ */
+void test_queue_full(void) {
+  uint8_t level = getDisplayBrightness();
+  std::vector<uint8_t> expected;
+  simClearDisplayWrites();
+  for (int i = 0 ; i < COMMAND_QUEUE_SIZE ; i++) {
+    level = (level + 1) & 7;
+    expected.push_back(level);
+    TEST_ASSERT_TRUE(queueCommand(COMMAND_SET_BRIGHTNESS, level));
+  }
+  TEST_ASSERT_FALSE(queueCommand(COMMAND_SET_BRIGHTNESS, (level + 1) & 7));
+  TEST_ASSERT_FALSE(queueCommand(COMMAND_APPLY_CONFIG, 0, configForm(0)));
+  commandPoll();
+  TEST_ASSERT_TRUE(brightnessWrites() == expected);
+  // And it has room again
+  TEST_ASSERT_TRUE(queueCommand(COMMAND_SET_BRIGHTNESS, level));
+  commandPoll();
+}
+
+/**
+ * Thousands of commands queued from another thread while loop() runs
+ */
+void test_concurrent_commands(void) {
+  std::atomic<bool> done(false);
+  std::vector<uint8_t> expected;
+  uint32_t refused = 0;
+  uint32_t lastConfig = 0;
+  uint8_t level = getDisplayBrightness();
+  std::thread *producer;
+  simClearDisplayWrites();
+  for (uint32_t i = 0 ; i < STRESS_COMMANDS ; i++) {
+    level = (level + 1) & 7;
+    expected.push_back(level);
+  }
+  producer = new std::thread([&]() {
+    for (uint32_t i = 0 ; i < STRESS_COMMANDS ; i++) {
+      while (!queueCommand(COMMAND_SET_BRIGHTNESS, expected[i])) {
+        refused++;
+        std::this_thread::yield();
+      }
+      if (!(i % CONFIG_EVERY)) {
+        while (!queueCommand(COMMAND_APPLY_CONFIG, 0, configForm(i))) {
+          refused++;
+          std::this_thread::yield();
+        }
+        lastConfig = i;
+      }
+    }
+    done = true;
+  });
+  while (!done) simRun(10);
+  producer->join();
+  delete producer;
+  simRun(10);
+  TEST_PRINTF("%u commands, refused %u times while the queue was full", STRESS_COMMANDS + STRESS_COMMANDS / CONFIG_EVERY + 1,
+      refused);
+  TEST_ASSERT_TRUE(brightnessWrites() == expected);
+  TEST_ASSERT_EQUAL_STRING((String("clock") + lastConfig).c_str(), getStringConfig(CFG_HOSTNAME).c_str());
+  TEST_ASSERT_EQUAL_STRING("Europe/London", getStringConfig(CFG_ZONE).c_str());
+  TEST_ASSERT_TRUE(cfgBitIsSet(CFG_MASK_24H));
+  // The clock carried on through it
+  TEST_ASSERT_TRUE(timeIsSynced());
+  simRun(2000);
+  TEST_ASSERT_TRUE(simDisplayColon() || simRunUntil([]() { return simDisplayColon(); }, 1000));
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_full);
+  RUN_TEST(test_concurrent_commands);
+  return UNITY_END();
+}
@@ -0,0 +1,197 @@
+// test_events - the live status pushed to browsers on /events
+//
+// The browsers are the simulation's: each takes the events queued for it at its own pace, so a
+// slow one backs up as it would over a poor WiFi link. The status changes when the display, the
+// brightness, the sync or the WiFi does; at most one event goes out every 250 ms, and none while
+// the browsers have 4 or more waiting on average.
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "commands.h"
+#include "display.h"
+#include "events.h"
+#include "power.h"
+#include "timekeeping.h"
+
+#define FAST_MILLIS 10                    // A browser on the LAN
+#define SLOW_MILLIS 5000                  // One that has all but gone
+#define MAX_CLIENTS 4
+#define MAX_QUEUED 4
+#define MIN_INTERVAL_MILLIS 250
+
+static std::vector<AsyncEventSourceClient *> clients;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * The value of field in an event's record, as text
+ */
+static std::string field(const String &event, const char *name) {
+  std::string record(event.c_str());
+  std::string key = std::string("\"") + name + "\":";
+  size_t start = record.find(key);
+  size_t end;
+  if (start == std::string::npos) return std::string();
+  start += key.size();
+  if (record[start] == '"') start++;
+  end = record.find_first_of("\",}", start);
+  return record.substr(start, end - start);
+}
+
+/**
+ * Set the brightness as the web server's handler does
+ */
+static void setBrightness(uint8_t level) {
+  TEST_ASSERT_TRUE(queueCommand(COMMAND_SET_BRIGHTNESS, level));
+  notePowerActivity();
+}
+
+static void closeAll() {
+  for (AsyncEventSourceClient *client : clients) client->close();
+  clients.clear();
+}
+
+/**
+ * A browser connecting is sent the status at once
+ */
+void test_status_on_connect(void) {
+  char shown[5];
+  AsyncEventSourceClient *client = simConnectEvents("/events", FAST_MILLIS);
+  clients.push_back(client);
+  TEST_ASSERT_TRUE(client->connected());
+  simRun(100);
+  TEST_ASSERT_EQUAL_UINT32(1, client->simReceived().size());
+  const String &event = client->simReceived()[0];
+  getDisplayedText(shown);
+  TEST_ASSERT_TRUE(event.startsWith("event: status\ndata: {"));
+  TEST_ASSERT_EQUAL_STRING(shown, field(event, "d").c_str());
+  TEST_ASSERT_EQUAL_STRING("1", field(event, "s").c_str());
+  TEST_ASSERT_EQUAL_STRING("1", field(event, "w").c_str());
+  TEST_PRINTF("An event is %u bytes", event.length());
+}
+
+/**
+ * Nothing is sent while nothing changes - five minutes of a 24 hour clock is five events, one for
+ * each minute shown
+ */
+void test_only_changes(void) {
+  AsyncEventSourceClient *client = clients[0];
+  size_t before;
+  EventsStats stats;
+  simRunUntil([]() {
+    struct timeval now;
+    getClockTime(&now);
+    return (now.tv_sec % 60) == 1;
+  }, 61000);
+  simRun(1000);
+  before = client->simReceived().size();
+  simRun(5 * 60000);
+  getEventsStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(5, client->simReceived().size() - before);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.skipped);
+}
+
+/**
+ * The brightness changed a hundred times a second for two seconds is coalesced into an event every
+ * 250 ms, and the last one has where it ended up
+ */
+void test_coalesced(void) {
+  AsyncEventSourceClient *client = clients[0];
+  size_t sent;
+  uint8_t level = getDisplayBrightness();
+  size_t before = client->simReceived().size();
+  for (int i = 0 ; i < 200 ; i++) {
+    level = (level + 1) & 7;
+    setBrightness(level);
+    simRun(10);
+  }
+  simRun(1000);
+  sent = client->simReceived().size() - before;
+  TEST_PRINTF("200 changes in 2 s sent as %u events", sent);
+  TEST_ASSERT_LESS_OR_EQUAL(2000 / MIN_INTERVAL_MILLIS + 1, sent);
+  TEST_ASSERT_GREATER_OR_EQUAL(2000 / MIN_INTERVAL_MILLIS - 1, sent);
+  TEST_ASSERT_EQUAL_STRING(std::to_string(level).c_str(), field(client->simReceived().back(), "b").c_str());
+}
+
+/**
+ * Only four browsers at a time - the fifth is turned away, and the four all get the events
+ */
+void test_client_limit(void) {
+  AsyncEventSourceClient *turnedAway;
+  EventsStats stats;
+  while (clients.size() < MAX_CLIENTS) clients.push_back(simConnectEvents("/events", FAST_MILLIS));
+  turnedAway = simConnectEvents("/events", FAST_MILLIS);
+  TEST_ASSERT_FALSE(turnedAway->connected());
+  getEventsStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(MAX_CLIENTS, stats.clients);
+  simRun(100);
+  for (AsyncEventSourceClient *client : clients) {
+    TEST_ASSERT_TRUE(client->connected());
+    TEST_ASSERT_EQUAL_STRING(field(clients[0]->simReceived().back(), "b").c_str(),
+        field(client->simReceived().back(), "b").c_str());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, turnedAway->simReceived().size());
+  closeAll();
+}
+
+/**
+ * Browsers that stop taking events aren't sent more than a few - each one's memory is bounded -
+ * and they catch up with the latest status when they start again
+ */
+void test_slow_clients(void) {
+  uint8_t level = getDisplayBrightness();
+  EventsStats before;
+  EventsStats after;
+  size_t most = 0;
+  getEventsStats(&before);
+  while (clients.size() < MAX_CLIENTS) clients.push_back(simConnectEvents("/events", SLOW_MILLIS));
+  for (int i = 0 ; i < 240 ; i++) {
+    level = (level + 1) & 7;
+    setBrightness(level);
+    simRun(MIN_INTERVAL_MILLIS);
+    for (AsyncEventSourceClient *client : clients) most = max(most, client->packetsWaiting());
+  }
+  getEventsStats(&after);
+  TEST_PRINTF("240 changes in 60 s to %u slow browsers: %u events, held back at %u polls, at most %u queued for one",
+      MAX_CLIENTS, after.sent - before.sent, after.skipped - before.skipped, most);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_QUEUED, most);
+  TEST_ASSERT_GREATER_THAN(200, after.skipped - before.skipped);
+  // Taking events again, they are sent the status as it is now
+  TEST_ASSERT_TRUE(simRunUntil([]() { return !clients[0]->packetsWaiting(); }, MAX_QUEUED * SLOW_MILLIS + 1000));
+  simRun(2 * SLOW_MILLIS);
+  for (AsyncEventSourceClient *client : clients) {
+    TEST_ASSERT_EQUAL_STRING(std::to_string(level).c_str(), field(client->simReceived().back(), "b").c_str());
+  }
+  closeAll();
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  // loop() every 10 ms, as the web server's requests would have it - the test changes things
+  // between passes, and can't wake it from a sleep as they do
+  prefs.putChar(CFG_POWER, POWER_AWAKE);
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_status_on_connect);
+  RUN_TEST(test_only_changes);
+  RUN_TEST(test_coalesced);
+  RUN_TEST(test_client_limit);
+  RUN_TEST(test_slow_clients);
+  return UNITY_END();
+}
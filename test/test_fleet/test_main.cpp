@@ -0,0 +1,100 @@
+// test_fleet - what tools/clockctl.py relies on: the clock advertised over mDNS with its firmware
+// version and configuration hash, and the whole configuration read and replaced through /config
+//
+// tools/sim_fleet.py runs clockctl.py itself against several of these clocks, each a program built
+// from the native environment.
+
+#include <string>
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "timekeeping.h"
+#include "version.h"
+
+#define SERVICE "_303clock._tcp"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * A string field of GET /config's JSON
+ */
+static std::string field(const std::string &json, const char *name) {
+  std::string key = std::string("\"") + name + "\":\"";
+  size_t start = json.find(key);
+  if (start == std::string::npos) return std::string();
+  start += key.size();
+  return json.substr(start, json.find('"', start) - start);
+}
+
+/**
+ * The service is advertised under the configured hostname, and its TXT records match /config
+ */
+void test_advertised(void) {
+  SimHttpResult config = simHttp("GET", "/config");
+  TEST_ASSERT_EQUAL_INT(200, config.status);
+  TEST_ASSERT_EQUAL_STRING("clock-a", WiFi.hostname().c_str());
+  TEST_ASSERT_EQUAL_STRING(FIRMWARE_VERSION, simMDNSTxt(SERVICE, "version").c_str());
+  TEST_ASSERT_EQUAL_STRING("/config", simMDNSTxt(SERVICE, "path").c_str());
+  TEST_ASSERT_EQUAL_STRING(field(config.body, "cfg").c_str(), simMDNSTxt(SERVICE, "cfg").c_str());
+  TEST_ASSERT_EQUAL_STRING("clock-a", field(config.body, CFG_HOSTNAME).c_str());
+}
+
+/**
+ * One POST replaces the configuration, and the advertised hash follows it without the service
+ * being registered again
+ */
+void test_push_config(void) {
+  std::string before = simMDNSTxt(SERVICE, "cfg");
+  SimHttpResult pushed = simHttp("POST", "/config", std::string(CFG_ZONE "=America%2FNew_York&24h=on&" CFG_PAGE_DATE "=3"));
+  SimHttpResult config;
+  TEST_ASSERT_EQUAL_INT(202, pushed.status);
+  simRun(1000);
+  config = simHttp("GET", "/config");
+  TEST_ASSERT_EQUAL_STRING("America/New_York", field(config.body, CFG_ZONE).c_str());
+  TEST_ASSERT_TRUE(config.body.find("\"24h\":true") != std::string::npos);
+  TEST_ASSERT_TRUE(config.body.find("\"" CFG_PAGE_DATE "\":3") != std::string::npos);
+  // What wasn't in the form is left as it was
+  TEST_ASSERT_EQUAL_STRING("clock-a", field(config.body, CFG_HOSTNAME).c_str());
+  TEST_ASSERT_EQUAL_STRING("sim", field(config.body, CFG_SSID).c_str());
+  TEST_ASSERT_FALSE(before == simMDNSTxt(SERVICE, "cfg"));
+  TEST_ASSERT_EQUAL_STRING(field(config.body, "cfg").c_str(), simMDNSTxt(SERVICE, "cfg").c_str());
+  // The same configuration pushed again changes nothing
+  before = simMDNSTxt(SERVICE, "cfg");
+  simHttp("POST", "/config", std::string(CFG_ZONE "=America%2FNew_York&24h=on&" CFG_PAGE_DATE "=3"));
+  simRun(1000);
+  TEST_ASSERT_EQUAL_STRING(before.c_str(), simMDNSTxt(SERVICE, "cfg").c_str());
+}
+
+/**
+ * With restart=1 the clock restarts once the configuration is applied
+ */
+void test_push_restart(void) {
+  uint32_t restarts = simRestartCount();
+  SimHttpResult pushed = simHttp("POST", "/config", std::string(CFG_ZONE "=Europe%2FLondon&24h=on&restart=1"));
+  TEST_ASSERT_EQUAL_INT(202, pushed.status);
+  TEST_ASSERT_TRUE(simRunUntil([restarts]() { return simRestartCount() > restarts; }, 10000));
+  TEST_ASSERT_EQUAL_STRING("Europe/London", getStringConfig(CFG_ZONE).c_str());
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_HOSTNAME, "clock-a");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !simMDNSTxt(SERVICE, "version").empty(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_advertised);
+  RUN_TEST(test_push_config);
+  RUN_TEST(test_push_restart);
+  return UNITY_END();
+}
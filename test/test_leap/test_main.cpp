@@ -0,0 +1,246 @@
+// test_leap - leap seconds, and the slew of small changes to the time, on a drifting clock
+//
+// Each leap second is run for the 72 hours around it, with the ESP's clock 20 ppm fast and the SNTP
+// client setting it every hour. The NTP server warns of the leap second for all of that time until
+// midnight, then steps its own clock as a Unix clock does - back a second for an inserted one,
+// on a second for a removed one.
+//
+// The display's ticks (the colon coming on) are taken from what was sent to the TM1650: every
+// minute must get one a second - 61 for the minute with an inserted second in it, 59 for one with
+// a removed second, when the clock steps - and nothing in between. With the smear the displayed
+// time is compared, every second, with the smear Google's and Amazon's servers use.
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sntp.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "leap.h"
+#include "timekeeping.h"
+
+#define BOOT_UTC 1812196800LL             // 2027-06-05 12:00:00
+#define INSERT_UTC 1814400000LL           // 2027-07-01 00:00:00, after an inserted second
+#define REMOVE_UTC 1830297600LL           // 2028-01-01 00:00:00, after a removed second
+#define SMEAR_UTC 1846022400LL            // 2028-07-01 00:00:00, after an inserted second
+#define HALF_WINDOW_SECONDS (36 * 3600LL)
+#define SMEAR_HALF_SECONDS 43200LL
+#define DRIFT_PPM 20
+#define MAX_ERROR_MICROS 75000LL          // 20 ppm over the hour between syncs is 72 ms
+#define TICK_SLACK_MICROS 10000LL
+
+typedef struct Tick_t {
+  uint64_t at;                            // simMicros()
+  std::string text;
+} Tick;
+
+typedef struct LeapRun_t {
+  uint32_t leapMinuteTicks;               // Ticks showing 23:59 at the leap second
+  int64_t worstErrorMicros;               // Displayed time against the reference
+} LeapRun;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * The display's ticks since simClearDisplayWrites(), from the writes to the TM1650
+ */
+static std::vector<Tick> ticks() {
+  std::vector<Tick> ans;
+  uint8_t digits[4] = { 0, 0, 0, 0 };
+  bool pending = false;
+  uint64_t pendingAt = 0;
+  simDisplayFrame(digits);
+  for (const SimDisplayWrite &write : simDisplayWrites()) {
+    bool colon = digits[1] & 1;
+    if (pending && (write.at != pendingAt)) {
+      std::string text;
+      for (int i = 0 ; i < 4 ; i++) text += simDecodeSegments(digits[i]);
+      ans.push_back({ pendingAt, text });
+      pending = false;
+    }
+    if ((write.address < 0x34) || (write.address > 0x37)) continue;
+    digits[write.address - 0x34] = write.value;
+    if ((write.address == 0x35) && !colon && (write.value & 1)) {
+      pending = true;
+      pendingAt = write.at;
+    }
+  }
+  if (pending) {
+    std::string text;
+    for (int i = 0 ; i < 4 ; i++) text += simDecodeSegments(digits[i]);
+    ans.push_back({ pendingAt, text });
+  }
+  return ans;
+}
+
+/**
+ * A second apart, and sixty to a minute - but for the minute that ended at leapAt (simMicros()),
+ * which had leapMinute. Returns the ticks in that minute
+ */
+static uint32_t checkTicks(uint64_t leapAt, uint32_t leapMinute) {
+  std::vector<Tick> all = ticks();
+  uint32_t leapTicks = 0;
+  size_t runStart = 0;
+  char message[96];
+  TEST_ASSERT_GREATER_THAN(60, all.size());
+  for (size_t i = 1 ; i < all.size() ; i++) {
+    int64_t gap = (int64_t)(all[i].at - all[i - 1].at);
+    snprintf(message, sizeof(message), "tick %u ('%s') came %lld us after the one before", (unsigned)i,
+        all[i].text.c_str(), (long long)gap);
+    TEST_ASSERT_INT64_WITHIN_MESSAGE(TICK_SLACK_MICROS, 1000000LL, gap, message);
+    if ((all[i].text == all[runStart].text) && (i < all.size() - 1)) continue;
+    // A whole minute, from runStart to i - 1 - the first and last are only part of one
+    if (runStart) {
+      bool leap = (all[i].at + 500000 > leapAt) && (all[i].at < leapAt + 1500000);
+      uint32_t expected = leap ? leapMinute : 60;
+      snprintf(message, sizeof(message), "'%s' shown for %u seconds", all[runStart].text.c_str(), (unsigned)(i - runStart));
+      if (i < all.size() - 1) TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, i - runStart, message);
+      if (leap) leapTicks = i - runStart;
+    }
+    runStart = i;
+  }
+  return leapTicks;
+}
+
+/**
+ * Have the clock get the time again now, from a server error micros out
+ */
+static void resync(int32_t error) {
+  simSetSNTPErrorMicros(error);
+  sntp_stop();
+  sntp_init();
+  simRun(1000);
+}
+
+/**
+ * Run the 72 hours around a leap second at leapUtc - 1 inserted, -1 removed. The displayed time is
+ * checked every second against the true time, smeared if the clock is set to smear
+ */
+static LeapRun runLeap(time_t leapUtc, int8_t leap) {
+  LeapRun ans = { 0, 0 };
+  time_t start = leapUtc - HALF_WINDOW_SECONDS;
+  int64_t trueStart;
+  uint64_t startAt;
+  uint64_t leapAt;                        // By simMicros(), when the server's clock steps
+  bool smear = getInt8Config(CFG_LEAP, LEAP_STEP) == LEAP_SMEAR;
+  simWarp((start - 120) * 1000LL - simTrueMicros() / 1000);
+  resync(0);
+  simRunUntilTrue(start * 1000000LL);
+  simLeapSecond(leapUtc, leap);
+  simSetLeapIndicator((leap > 0) ? 1 : 2);
+  simClearDisplayWrites();
+  trueStart = simTrueMicros();
+  startAt = simMicros();
+  leapAt = startAt + llround(((leapUtc - ((leap < 0) ? 1 : 0)) * 1000000LL - trueStart) * (1 + DRIFT_PPM / 1e6));
+  for (int64_t i = 0 ; i < 2 * HALF_WINDOW_SECONDS ; i++) {
+    struct timeval shown;
+    // Unix time, had there been no leap second
+    int64_t unstepped;
+    int64_t reference;
+    int64_t error;
+    simRun(1000);
+    unstepped = trueStart + llround((simMicros() - startAt) / (1 + DRIFT_PPM / 1e6));
+    if (unstepped >= leapUtc * 1000000LL) simSetLeapIndicator(0);
+    getClockTime(&shown);
+    reference = simTrueMicros();
+    if (smear) {
+      // Smeared noon to noon
+      int64_t smearStart = (leapUtc - SMEAR_HALF_SECONDS) * 1000000LL;
+      int64_t length = 2 * SMEAR_HALF_SECONDS + leap;
+      if ((unstepped >= smearStart) && (unstepped < smearStart + length * 1000000LL)) {
+        reference = smearStart + (unstepped - smearStart) * (2 * SMEAR_HALF_SECONDS) / length;
+      }
+    }
+    error = (int64_t)shown.tv_sec * 1000000LL + shown.tv_usec - reference;
+    if (error < 0) error = -error;
+    if (error > ans.worstErrorMicros) ans.worstErrorMicros = error;
+  }
+  ans.leapMinuteTicks = checkTicks(leapAt, smear ? 60 : 60 + leap);
+  TEST_ASSERT_EQUAL_INT(0, getLeapPending());
+  return ans;
+}
+
+/**
+ * Step mode, an inserted second - 23:59 is shown for 61 seconds
+ */
+void test_step_inserted(void) {
+  LeapRun run = runLeap(INSERT_UTC, 1);
+  TEST_PRINTF("23:59 shown for %u seconds, at worst %lld us from the true time", run.leapMinuteTicks,
+      (long long)run.worstErrorMicros);
+  TEST_ASSERT_EQUAL_UINT32(61, run.leapMinuteTicks);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_ERROR_MICROS, run.worstErrorMicros);
+}
+
+/**
+ * Step mode, a removed second - 23:59 is shown for 59 seconds
+ */
+void test_step_removed(void) {
+  LeapRun run = runLeap(REMOVE_UTC, -1);
+  TEST_PRINTF("23:59 shown for %u seconds, at worst %lld us from the true time", run.leapMinuteTicks,
+      (long long)run.worstErrorMicros);
+  TEST_ASSERT_EQUAL_UINT32(59, run.leapMinuteTicks);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_ERROR_MICROS, run.worstErrorMicros);
+}
+
+/**
+ * Smear mode - every minute gets its sixty ticks, and the displayed time follows the smear
+ */
+void test_smear(void) {
+  LeapRun run;
+  setInt8Config(CFG_LEAP, LEAP_SMEAR);
+  run = runLeap(SMEAR_UTC, 1);
+  TEST_PRINTF("23:59 shown for %u seconds, at worst %lld us from the smeared time", run.leapMinuteTicks,
+      (long long)run.worstErrorMicros);
+  TEST_ASSERT_EQUAL_UINT32(60, run.leapMinuteTicks);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_ERROR_MICROS, run.worstErrorMicros);
+  setInt8Config(CFG_LEAP, LEAP_STEP);
+}
+
+/**
+ * A change of up to 2 seconds is slewed in at 500 ppm, without a tick being lost or repeated. A
+ * bigger one is shown at once
+ */
+void test_slew(void) {
+  resync(0);
+  simRun(200 * 1000);
+  TEST_ASSERT_EQUAL_INT(0, getClockSlewMicros());
+  simClearDisplayWrites();
+  resync(-1500000);
+  // The display carries on from where it was, and catches up 0.5 ms a second - give or take what
+  // the clock drifted since resync(0)
+  TEST_ASSERT_INT_WITHIN(5000, 1500000, getClockSlewMicros());
+  simRun(1000 * 1000);
+  TEST_ASSERT_INT_WITHIN(5000, 1000000, getClockSlewMicros());
+  simRun(2100 * 1000);
+  TEST_ASSERT_EQUAL_INT(0, getClockSlewMicros());
+  checkTicks(0, 60);
+  resync(2500000);
+  TEST_ASSERT_EQUAL_INT(0, getClockSlewMicros());
+  resync(0);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "UTC");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.putChar(CFG_LEAP, LEAP_STEP);
+  prefs.end();
+  simSetTrueTime(BOOT_UTC);
+  simSetDriftPPM(DRIFT_PPM);
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_step_inserted);
+  RUN_TEST(test_step_removed);
+  RUN_TEST(test_smear);
+  RUN_TEST(test_slew);
+  return UNITY_END();
+}
@@ -0,0 +1,229 @@
+// test_mqtt - the MQTT client against the simulated broker, taken away and brought back
+//
+// Events wait in a queue of 8 while the broker is away, the oldest dropped when it is full, and
+// are delivered once when it is back. QoS 1 events the broker hadn't acknowledged are sent again
+// with DUP set and the same packet id. Retained commands are ignored. Each wait before reconnecting
+// is chosen at random between half and all of a backoff that doubles from 2 s up to 5 minutes, so
+// the waits should spread over the whole of each range.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "mqtt.h"
+#include "power.h"
+#include "timekeeping.h"
+
+#define TOPIC "303clock/clock-m/"
+#define QUEUE_SIZE 8
+#define CONNECT_MICROS 50000ULL           // How long the simulated broker takes to answer
+#define POLL_MICROS 20000ULL              // loop() runs every 10 ms, and may just have missed it
+#define BACKOFF_MIN_MICROS 2000000ULL
+#define BACKOFF_MAX_MICROS 300000000ULL
+#define OUTAGE_MILLIS (30ULL * 60ULL * 1000ULL)
+#define OUTAGES 6
+#define STABLE_MILLIS 120000ULL           // Connected long enough for the backoff to start again
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * The events published with a detail, from what has been published since last asked
+ */
+static std::vector<SimMqttMessage> takeEvents(const char *name) {
+  std::vector<SimMqttMessage> ans;
+  std::string key = std::string("\"event\":\"") + name + "\"";
+  for (const SimMqttMessage &message : simTakeMqtt()) {
+    if ((message.topic == TOPIC "event") && (message.payload.find(key) != std::string::npos)) ans.push_back(message);
+  }
+  return ans;
+}
+
+static std::string detail(const SimMqttMessage &message) {
+  size_t start = message.payload.find("\"detail\":\"") + 10;
+  return message.payload.substr(start, message.payload.find('"', start) - start);
+}
+
+static uint8_t queued() {
+  MqttStats stats;
+  getMqttStats(&stats);
+  return stats.queued;
+}
+
+/**
+ * Take the broker away, and wait for the client to notice. Returns when it did
+ */
+static uint64_t brokerDown() {
+  simSetMqttBroker(false);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return !mqttConnected(); }, 1000));
+  return simMicros();
+}
+
+static void brokerUp() {
+  simSetMqttBroker(true);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return mqttConnected() && !queued(); }, BACKOFF_MAX_MICROS / 1000 + 5000));
+}
+
+/**
+ * Connected, the clock says it is online and publishes its state, both retained
+ */
+void test_online(void) {
+  bool online = false;
+  bool state = false;
+  simRun(10000);
+  simSetMqttBroker(false);
+  simRun(1000);
+  simTakeMqtt();
+  brokerUp();
+  simRun(10000);
+  for (const SimMqttMessage &message : simTakeMqtt()) {
+    if (message.topic == TOPIC "status") online = (message.payload == "online") && message.retain;
+    if (message.topic == TOPIC "state") state = message.retain && (message.payload.find("\"synced\":true") != std::string::npos);
+  }
+  TEST_ASSERT_TRUE(online);
+  TEST_ASSERT_TRUE(state);
+}
+
+/**
+ * A retained command is stale - it is ignored, and only a fresh one is acted on
+ */
+void test_retained_commands(void) {
+  uint8_t brightness = getDisplayBrightness();
+  simMqttCommand(TOPIC "set/brightness", "2", true);
+  simRun(1000);
+  TEST_ASSERT_EQUAL_UINT8(brightness, getDisplayBrightness());
+  simMqttCommand(TOPIC "set/brightness", "2");
+  simRun(1000);
+  TEST_ASSERT_EQUAL_UINT8(2, getDisplayBrightness());
+  simMqttCommand(TOPIC "set/brightness", String(brightness).c_str());
+  simRun(1000);
+}
+
+/**
+ * Ten events while the broker is away - the two oldest are dropped, and the other eight are
+ * delivered in order, once each, when it comes back
+ */
+void test_offline_queue(void) {
+  MqttStats before;
+  MqttStats after;
+  std::vector<SimMqttMessage> delivered;
+  brokerDown();
+  getMqttStats(&before);
+  for (int i = 0 ; i < 10 ; i++) mqttEvent("queued", std::to_string(i).c_str());
+  getMqttStats(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.dropped + 2, after.dropped);
+  TEST_ASSERT_EQUAL_UINT8(QUEUE_SIZE, after.queued);
+  simRun(10000);
+  simTakeMqtt();
+  brokerUp();
+  simRun(10000);
+  delivered = takeEvents("queued");
+  TEST_ASSERT_EQUAL_UINT32(QUEUE_SIZE, delivered.size());
+  for (size_t i = 0 ; i < delivered.size() ; i++) {
+    TEST_ASSERT_EQUAL_STRING(std::to_string(i + 2).c_str(), detail(delivered[i]).c_str());
+    TEST_ASSERT_EQUAL_UINT8(1, delivered[i].qos);
+    TEST_ASSERT_FALSE(delivered[i].dup);
+  }
+  simRun(30000);
+  TEST_ASSERT_EQUAL_UINT32(0, takeEvents("queued").size());
+}
+
+/**
+ * An event the broker didn't acknowledge before it went is sent again, as a duplicate with the same
+ * packet id, and then no more
+ */
+void test_qos1_resend(void) {
+  std::vector<SimMqttMessage> sent;
+  uint16_t packetId;
+  simSetMqttAcks(false);
+  simTakeMqtt();
+  mqttEvent("unacked", "1");
+  simRun(2000);
+  sent = takeEvents("unacked");
+  TEST_ASSERT_EQUAL_UINT32(1, sent.size());
+  TEST_ASSERT_FALSE(sent[0].dup);
+  TEST_ASSERT_NOT_EQUAL(0, sent[0].packetId);
+  TEST_ASSERT_EQUAL_UINT8(1, queued());
+  packetId = sent[0].packetId;
+  brokerDown();
+  simSetMqttAcks(true);
+  brokerUp();
+  sent = takeEvents("unacked");
+  TEST_ASSERT_EQUAL_UINT32(1, sent.size());
+  TEST_ASSERT_TRUE(sent[0].dup);
+  TEST_ASSERT_EQUAL_UINT16(packetId, sent[0].packetId);
+  simRun(30000);
+  TEST_ASSERT_EQUAL_UINT32(0, takeEvents("unacked").size());
+}
+
+/**
+ * Half-hour outages - every wait between attempts is within its backoff range, and where in the
+ * range it falls is spread evenly
+ */
+void test_backoff(void) {
+  std::vector<double> positions;
+  uint32_t capped = 0;
+  double mean = 0;
+  uint64_t longestReconnect = 0;
+  for (int outage = 0 ; outage < OUTAGES ; outage++) {
+    uint64_t from;
+    uint64_t backoff = BACKOFF_MIN_MICROS;
+    uint64_t back;
+    std::vector<uint64_t> attempts;
+    simRun(STABLE_MILLIS);
+    simTakeMqttConnects();
+    from = brokerDown();
+    simRun(OUTAGE_MILLIS);
+    attempts = simTakeMqttConnects();
+    TEST_ASSERT_TRUE(attempts.size() > 5);
+    for (uint64_t attempt : attempts) {
+      uint64_t wait = attempt - from;
+      TEST_ASSERT_UINT64_WITHIN(backoff / 2 + POLL_MICROS, backoff * 3 / 4 + POLL_MICROS / 2, wait);
+      positions.push_back(std::max(0.0, std::min(1.0, ((double)wait - backoff / 2) / (backoff / 2))));
+      if (backoff == BACKOFF_MAX_MICROS) capped++;
+      backoff = std::min<uint64_t>(backoff * 2, BACKOFF_MAX_MICROS);
+      from = attempt + CONNECT_MICROS;
+    }
+    back = simMicros();
+    brokerUp();
+    longestReconnect = std::max<uint64_t>(longestReconnect, simMicros() - back);
+  }
+  for (double position : positions) mean += position / positions.size();
+  std::sort(positions.begin(), positions.end());
+  TEST_PRINTF("%u waits, %u at the 5 minute cap: placed %.2f .. %.2f in their ranges, mean %.2f, median %.2f; "
+    "back %.0f s at most after the broker", (unsigned)positions.size(), capped, positions.front(), positions.back(),
+    mean, positions[positions.size() / 2], longestReconnect / 1e6);
+  TEST_ASSERT_TRUE(capped > 0);
+  TEST_ASSERT_TRUE(positions.front() < 0.1);
+  TEST_ASSERT_TRUE(positions.back() > 0.9);
+  TEST_ASSERT_TRUE((mean > 0.35) && (mean < 0.65));
+  TEST_ASSERT_TRUE(longestReconnect <= BACKOFF_MAX_MICROS + CONNECT_MICROS + POLL_MICROS);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_HOSTNAME, "clock-m");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putString(CFG_MQTT_BROKER, "broker.local");
+  prefs.putChar(CFG_POWER, POWER_AWAKE);  // loop() every 10 ms, so the reconnection times are the client's own
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced() && mqttConnected(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_online);
+  RUN_TEST(test_retained_commands);
+  RUN_TEST(test_offline_queue);
+  RUN_TEST(test_qos1_resend);
+  RUN_TEST(test_backoff);
+  return UNITY_END();
+}
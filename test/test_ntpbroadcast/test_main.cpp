@@ -0,0 +1,201 @@
+// test_ntpbroadcast - keeping time from NTP broadcasts on the LAN
+//
+// The broadcast servers are the test itself: they send mode 5 packets to the clock's port 123,
+// stamped with the true time (or a time off from it, to see what the clock makes of it), over a
+// network that takes NETWORK_MILLIS each way. The clock's round trip measurement is read as it
+// leaves, and answered. loop() runs every 10 ms while broadcasts are on, so a packet is read up to
+// 10 ms after it arrives, and the clock takes that as the time it arrived.
+
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sntp.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "ntpbroadcast.h"
+#include "ntpserver.h"
+#include "timekeeping.h"
+
+#define SERVER_A IPAddress(192, 168, 1, 10)
+#define SERVER_B IPAddress(192, 168, 1, 20)
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+#define NETWORK_MILLIS 40                 // Each way
+#define READ_MICROS 10000LL               // How long a packet can wait to be read
+#define STEP_MICROS 20000LL
+#define TIMEOUT_MILLIS (10ULL * 60ULL * 1000ULL)
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void putTimestamp(uint8_t *p, int64_t unixMicros) {
+  uint32_t seconds = (uint32_t)(unixMicros / 1000000LL + NTP_UNIX_OFFSET);
+  uint32_t fraction = (uint32_t)(((unixMicros % 1000000LL) << 32) / 1000000LL);
+  for (int i = 0 ; i < 4 ; i++) {
+    p[i] = seconds >> (24 - 8 * i);
+    p[4 + i] = fraction >> (24 - 8 * i);
+  }
+}
+
+/**
+ * The clock's time against the true time
+ */
+static int64_t clockError() {
+  return simSystemMicros() - simTrueMicros();
+}
+
+/**
+ * A broadcast from server, its time errorMicros off the true time, on its way
+ */
+static void sendBroadcast(IPAddress server, int64_t errorMicros = 0) {
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = (0 << 6) | (4 << 3) | 5;    // Version 4, broadcast mode
+  packet[1] = 2;                          // Stratum
+  putTimestamp(packet + 40, simTrueMicros() + errorMicros);
+  simSendUDP(server, NTP_PORT, NTP_PORT, packet, sizeof(packet), NETWORK_MILLIS);
+}
+
+/**
+ * A broadcast, and long enough for the clock to have done what it will with it
+ */
+static void broadcast(IPAddress server, int64_t errorMicros = 0) {
+  sendBroadcast(server, errorMicros);
+  simRun(NETWORK_MILLIS + 100);
+}
+
+/**
+ * The clock's requests to a server since last asked
+ */
+static std::vector<SimPacket> requestsTo(IPAddress server) {
+  std::vector<SimPacket> ans;
+  for (const SimPacket &packet : simTakeUDP()) {
+    if ((packet.to == server) && (packet.toPort == NTP_PORT) && ((packet.data[0] & 7) == 3)) ans.push_back(packet);
+  }
+  return ans;
+}
+
+/**
+ * Answer the clock's round trip measurement, as server would - the request takes NETWORK_MILLIS to
+ * get there, and the answer as long to come back. Called just after it was sent
+ */
+static void answer(IPAddress server, const SimPacket &request) {
+  uint8_t packet[NTP_PACKET_SIZE];
+  uint32_t since = (simMicros() - request.at) / 1000;
+  int64_t arrived = simTrueMicros() - (int64_t)(simMicros() - request.at) + NETWORK_MILLIS * 1000LL;
+  memset(packet, 0, sizeof(packet));
+  packet[0] = (0 << 6) | (4 << 3) | 4;    // Server mode
+  packet[1] = 2;
+  memcpy(packet + 24, request.data.data() + 40, 8);   // Their transmit time is our originate time
+  putTimestamp(packet + 32, arrived);
+  putTimestamp(packet + 40, arrived + 500);
+  simSendUDP(server, NTP_PORT, request.fromPort, packet, sizeof(packet), 2 * NETWORK_MILLIS - since);
+  simRun(2 * NETWORK_MILLIS + 100);
+}
+
+/**
+ * Calibrate against the first broadcast's server, and check that it is now the one listened to
+ */
+static void calibrate(IPAddress server) {
+  std::vector<SimPacket> requests;
+  simTakeUDP();
+  sendBroadcast(server);
+  TEST_ASSERT_TRUE(simRunUntil([server, &requests]() { return !(requests = requestsTo(server)).empty(); }, 1000));
+  TEST_ASSERT_EQUAL_UINT32(1, requests.size());
+  TEST_ASSERT_FALSE(ntpBroadcastListening());
+  answer(server, requests[0]);
+  TEST_ASSERT_TRUE(ntpBroadcastListening());
+  TEST_ASSERT_FALSE(sntp_enabled());
+}
+
+/**
+ * The first broadcast after the clock has the time starts a round trip to the server that sent it,
+ * and once that is answered the clock listens to it instead of polling
+ */
+void test_calibrates_first_sender(void) {
+  TEST_ASSERT_TRUE(sntp_enabled());
+  TEST_ASSERT_FALSE(ntpBroadcastListening());
+  calibrate(SERVER_A);
+  // A broadcast from the same server now sets the time, rather than starting another round trip
+  broadcast(SERVER_A);
+  TEST_ASSERT_EQUAL_UINT32(0, requestsTo(SERVER_A).size());
+}
+
+/**
+ * Broadcasts from anywhere else are ignored, however far off they are
+ */
+void test_ignores_other_servers(void) {
+  int64_t before = clockError();
+  for (int i = 0 ; i < 5 ; i++) broadcast(SERVER_B, 500000);
+  TEST_ASSERT_INT64_WITHIN(1000, before, clockError());
+  TEST_ASSERT_EQUAL_UINT32(0, requestsTo(SERVER_B).size());
+  TEST_ASSERT_TRUE(ntpBroadcastListening());
+}
+
+/**
+ * A server 200 ms out sets the clock 200 ms out - not 160 ms, as it would without half the 80 ms
+ * round trip. Offsets under 20 ms are left alone, and bigger ones stepped
+ */
+void test_round_trip_and_step(void) {
+  int64_t error;
+  broadcast(SERVER_A, 200000);
+  error = clockError();
+  TEST_PRINTF("Server 200 ms out, clock %lld us out", (long long)error);
+  // The broadcast and the answer to the round trip can each wait up to 10 ms to be read
+  TEST_ASSERT_INT64_WITHIN(READ_MICROS, 200000, error);
+  // Within the step threshold, even allowing for when the packet was read - left alone
+  broadcast(SERVER_A, error + STEP_MICROS / 4);
+  TEST_ASSERT_INT64_WITHIN(1000, error, clockError());
+  broadcast(SERVER_A, error - STEP_MICROS / 4);
+  TEST_ASSERT_INT64_WITHIN(1000, error, clockError());
+  // Beyond it - stepped
+  broadcast(SERVER_A, error + 2 * STEP_MICROS);
+  TEST_ASSERT_INT64_WITHIN(READ_MICROS, error + 2 * STEP_MICROS, clockError());
+  broadcast(SERVER_A);
+  TEST_ASSERT_INT64_WITHIN(READ_MICROS, 0, clockError());
+}
+
+/**
+ * Ten minutes without a broadcast and the clock goes back to polling. Once that has the time, the
+ * next broadcast - from whichever server - is calibrated against afresh
+ */
+void test_fallback(void) {
+  uint32_t syncs = simSNTPSyncCount();
+  simRun(TIMEOUT_MILLIS - 60000);
+  TEST_ASSERT_TRUE(ntpBroadcastListening());
+  TEST_ASSERT_FALSE(sntp_enabled());
+  simRun(61000);
+  TEST_ASSERT_FALSE(ntpBroadcastListening());
+  TEST_ASSERT_TRUE(sntp_enabled());
+  TEST_ASSERT_TRUE(simRunUntil([syncs]() { return simSNTPSyncCount() > syncs; }, 60000));
+  simRun(1000);
+  calibrate(SERVER_B);
+  // Now A is the other server
+  broadcast(SERVER_A, 500000);
+  TEST_ASSERT_INT64_WITHIN(READ_MICROS, 0, clockError());
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H | CFG_MASK_NTP_BROADCAST);
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  simTestNTPServer(SERVER_A);
+  simTestNTPServer(SERVER_B);
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+  simRun(2000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_calibrates_first_sender);
+  RUN_TEST(test_ignores_other_servers);
+  RUN_TEST(test_round_trip_and_step);
+  RUN_TEST(test_fallback);
+  return UNITY_END();
+}
@@ -0,0 +1,228 @@
+// test_ntpserver - the clock serving time, from a client on the LAN and under a flood of requests
+//
+// The client is the test itself: it sends SNTP requests to the clock's port 123, timestamped with
+// the true time, and reads the clock's answers back as they leave it. The clock's rate limit is a
+// bucket of 10 tokens refilled at 20 a second, and it handles at most 2 requests a loop() pass.
+
+#include <map>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "ntpserver.h"
+#include "timekeeping.h"
+
+#define CLIENT_IP IPAddress(192, 168, 1, 77)
+#define CLIENT_PORT 50123
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+#define MAX_PER_SECOND 20
+#define BURST 10
+#define STALE_MILLIS (4ULL * 3600ULL * 1000ULL)
+
+typedef struct Answer_t {
+  uint8_t leap;
+  uint8_t stratum;
+  int64_t offsetMicros;                   // The clock's time against the true time, as the client works it out
+  uint32_t dispersionMillis;
+} Answer;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void putTimestamp(uint8_t *p, int64_t unixMicros) {
+  uint32_t seconds = (uint32_t)(unixMicros / 1000000LL + NTP_UNIX_OFFSET);
+  uint32_t fraction = (uint32_t)(((unixMicros % 1000000LL) << 32) / 1000000LL);
+  for (int i = 0 ; i < 4 ; i++) {
+    p[i] = seconds >> (24 - 8 * i);
+    p[4 + i] = fraction >> (24 - 8 * i);
+  }
+}
+
+static uint32_t getUInt32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int64_t getTimestamp(const uint8_t *p) {
+  return ((int64_t)getUInt32(p) - NTP_UNIX_OFFSET) * 1000000LL + (((uint64_t)getUInt32(p + 4) * 1000000ULL) >> 32);
+}
+
+/**
+ * Send a request, to arrive delayMillis from now. Its transmit timestamp is when it arrives - the
+ * LAN takes no time
+ */
+static void sendRequest(uint32_t delayMillis) {
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = (0 << 6) | (4 << 3) | 3;    // Version 4, client mode
+  putTimestamp(packet + 40, simTrueMicros() + delayMillis * 1000LL);
+  simSendUDP(CLIENT_IP, CLIENT_PORT, NTP_PORT, packet, sizeof(packet), delayMillis);
+}
+
+/**
+ * The clock's answers since last asked
+ */
+static std::vector<Answer> answers() {
+  std::vector<Answer> ans;
+  for (const SimPacket &packet : simTakeUDP()) {
+    const uint8_t *p = packet.data.data();
+    Answer answer;
+    int64_t t1, t2, t3, t4;
+    if ((packet.to != CLIENT_IP) || (packet.toPort != CLIENT_PORT) || (packet.data.size() < NTP_PACKET_SIZE)) continue;
+    TEST_ASSERT_EQUAL_UINT8(4, p[0] & 7);                // Server mode
+    t1 = getTimestamp(p + 24);                           // Our transmit time, echoed
+    t2 = getTimestamp(p + 32);
+    t3 = getTimestamp(p + 40);
+    t4 = simTrueMicros() - (int64_t)(simMicros() - packet.at);
+    answer.leap = p[0] >> 6;
+    answer.stratum = p[1];
+    answer.offsetMicros = ((t2 - t1) + (t3 - t4)) / 2;
+    answer.dispersionMillis = (uint32_t)(((uint64_t)getUInt32(p + 8) * 1000ULL) >> 16);
+    ans.push_back(answer);
+  }
+  return ans;
+}
+
+/**
+ * Before the clock has the time, it doesn't answer
+ */
+void test_silent_until_synced(void) {
+  TEST_ASSERT_TRUE(simRunUntil([]() { return simWiFiConnected(); }, 30000));
+  simRun(2000);
+  for (int i = 0 ; i < 5 ; i++) sendRequest(i * 100);
+  simRun(2000);
+  TEST_ASSERT_FALSE(timeIsSynced());
+  TEST_ASSERT_EQUAL_UINT32(0, answers().size());
+  simSetSNTPReachable(true);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000));
+  simRun(2000);
+}
+
+/**
+ * A client polling at a sensible rate gets every answer, with the clock's time
+ */
+void test_answers(void) {
+  uint32_t served;
+  uint32_t dropped;
+  uint32_t servedBefore;
+  uint32_t droppedBefore;
+  int64_t worst = 0;
+  std::vector<Answer> got;
+  getNTPServerCounts(&servedBefore, &droppedBefore);
+  simTakeUDP();
+  for (int i = 0 ; i < 60 ; i++) sendRequest(i * 1000);
+  simRun(61000);
+  got = answers();
+  getNTPServerCounts(&served, &dropped);
+  TEST_ASSERT_EQUAL_UINT32(60, got.size());
+  TEST_ASSERT_EQUAL_UINT32(60, served - servedBefore);
+  TEST_ASSERT_EQUAL_UINT32(0, dropped - droppedBefore);
+  for (const Answer &answer : got) {
+    TEST_ASSERT_EQUAL_UINT8(0, answer.leap);
+    TEST_ASSERT_EQUAL_UINT8(3, answer.stratum);
+    // Our clock is set from a perfect server, so this is just how precisely we answer. A request
+    // waits for the next loop() pass, up to 10 ms, and is timestamped when it is read - so half that
+    // wait shows as offset
+    TEST_ASSERT_INT64_WITHIN(6000, 0, answer.offsetMicros);
+    TEST_ASSERT_LESS_THAN(100, answer.dispersionMillis);
+    worst = max(worst, (int64_t)llabs(answer.offsetMicros));
+  }
+  TEST_PRINTF("60 answers, at worst %lld us out", (long long)worst);
+}
+
+/**
+ * A thousand requests a second for ten seconds: the rate limit holds, the rest are dropped, and the
+ * display still ticks on time
+ */
+void test_flood(void) {
+  uint32_t served;
+  uint32_t dropped;
+  uint32_t servedBefore;
+  uint32_t droppedBefore;
+  size_t replies;
+  getNTPServerCounts(&servedBefore, &droppedBefore);
+  simTakeUDP();
+  simRun(1000);                           // Let the bucket fill
+  resetWorstTickLateness();
+  for (int i = 0 ; i < 10000 ; i++) sendRequest(i);
+  simRun(10000);
+  replies = answers().size();
+  getNTPServerCounts(&served, &dropped);
+  served -= servedBefore;
+  dropped -= droppedBefore;
+  TEST_PRINTF("10000 requests in 10 s: %u answered, %u dropped, worst tick %u ms late", served, dropped,
+      getWorstTickLateness());
+  TEST_ASSERT_EQUAL_UINT32(served, replies);
+  TEST_ASSERT_INT_WITHIN(MAX_PER_SECOND, MAX_PER_SECOND * 10 + BURST, served);
+  // The rest are dropped as fast as they come, rather than left queued to be answered late
+  TEST_ASSERT_GREATER_THAN(9700, dropped);
+  TEST_ASSERT_LESS_THAN(10, getWorstTickLateness());
+  // And anything left over is gone a moment later
+  simRun(1000);
+  answers();
+  getNTPServerCounts(&served, &dropped);
+  TEST_ASSERT_EQUAL_UINT32(10000, served - servedBefore + dropped - droppedBefore);
+}
+
+/**
+ * Four hours without a sync, and the clock says it is unsynchronised - and then that it isn't,
+ * after the next sync. Root dispersion grows in between
+ */
+void test_stale(void) {
+  std::vector<Answer> got;
+  uint32_t dispersion;
+  simSetSNTPReachable(false);
+  simRun(1000);
+  sendRequest(0);
+  simRun(1000);
+  got = answers();
+  TEST_ASSERT_EQUAL_UINT32(1, got.size());
+  dispersion = got[0].dispersionMillis;
+  simRun(STALE_MILLIS - millisSinceSync() - 60000);
+  sendRequest(0);
+  simRun(1000);
+  got = answers();
+  TEST_ASSERT_EQUAL_UINT32(1, got.size());
+  TEST_ASSERT_EQUAL_UINT8(0, got[0].leap);
+  TEST_ASSERT_EQUAL_UINT8(3, got[0].stratum);
+  // 15 ppm of four hours is 216 ms
+  TEST_ASSERT_INT_WITHIN(5, dispersion + 213, got[0].dispersionMillis);
+  simRun(60000);
+  sendRequest(0);
+  simRun(1000);
+  got = answers();
+  TEST_ASSERT_EQUAL_UINT32(1, got.size());
+  TEST_ASSERT_EQUAL_UINT8(3, got[0].leap);
+  TEST_ASSERT_EQUAL_UINT8(16, got[0].stratum);
+  simSetSNTPReachable(true);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return millisSinceSync() < 1000; }, 60000));
+  sendRequest(0);
+  simRun(1000);
+  got = answers();
+  TEST_ASSERT_EQUAL_UINT32(1, got.size());
+  TEST_ASSERT_EQUAL_UINT8(0, got[0].leap);
+  TEST_ASSERT_EQUAL_UINT8(3, got[0].stratum);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H | CFG_MASK_NTP_SERVER);
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  simSetSNTPReachable(false);             // Until test_silent_until_synced() has asked
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_silent_until_synced);
+  RUN_TEST(test_answers);
+  RUN_TEST(test_flood);
+  RUN_TEST(test_stale);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+// test_pagecache - the configuration page from the cache, against the page worked out afresh
+//
+// The reference is the template substituted the way ESPAsyncWebServer does it: "%NAME%" is the
+// processor's value for NAME, "%%" is "%", and a "%" without another within 32 characters is left
+// as it is. Each configuration gives a new generation of the cache; the page sent must match the
+// reference byte for byte, and its length the Content-Length.
+
+#include <string>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "pagecache.h"
+#include "timekeeping.h"
+#include "version.h"
+#include "webserver.h"
+
+#define PLACEHOLDER_MAX_LENGTH 32         // TEMPLATE_PARAM_NAME_LENGTH in ESPAsyncWebServer
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * The page as ESPAsyncWebServer's own template processing would send it
+ */
+static std::string reference() {
+  std::string page(homePageData);
+  std::string ans;
+  size_t i = 0;
+  while (i < page.size()) {
+    size_t end = page.find('%', i + 1);
+    if ((page[i] != '%') || (end == std::string::npos) || (end - i > PLACEHOLDER_MAX_LENGTH)) {
+      ans += page[i++];
+      continue;
+    }
+    if (end == i + 1) {
+      ans += '%';
+    } else {
+      ans += processor(String(page.substr(i + 1, end - i - 1).c_str())).c_str();
+    }
+    i = end + 1;
+  }
+  return ans;
+}
+
+/**
+ * GET / - a second apart, so the client's rate limit doesn't come into it
+ */
+static SimHttpResult getPage(const std::string &etag = std::string()) {
+  SimHttpResult ans;
+  simRun(1000);
+  if (etag.empty()) {
+    ans = simHttp("GET", "/");
+  } else {
+    ans = simHttp("GET", "/", std::string(), { { "If-None-Match", etag } });
+  }
+  return ans;
+}
+
+static void checkPage(const char *what) {
+  SimHttpResult page = getPage();
+  std::string expected = reference();
+  char message[96];
+  size_t first = 0;
+  TEST_ASSERT_EQUAL_INT(200, page.status);
+  while ((first < expected.size()) && (first < page.body.size()) && (expected[first] == page.body[first])) first++;
+  snprintf(message, sizeof(message), "%s: differs from byte %u", what, (unsigned)first);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected.size(), page.body.size(), message);
+  TEST_ASSERT_TRUE_MESSAGE(expected == page.body, message);
+  TEST_ASSERT_EQUAL_STRING(std::to_string(page.body.size()).c_str(), page.header("Content-Length").c_str());
+  TEST_ASSERT_EQUAL_UINT32(page.body.size(), renderPageToNull(homePageData, processor));
+}
+
+/**
+ * Configurations that exercise every kind of placeholder - text, numbers, checkboxes and
+ * selections - and values with "%" in them, which must not be substituted again
+ */
+void test_byte_for_byte(void) {
+  checkPage("as booted");
+  setStringConfig(CFG_HOSTNAME, "clock-%SSID%-100%");
+  setStringConfig(CFG_SSID, "a 32 character SSID, the longest");
+  checkPage("with % in the values");
+  setCfgBit(CFG_MASK_24H);
+  setCfgBit(CFG_MASK_NTP_SERVER);
+  setInt8Config(CFG_DEFAULT_BRIGHTNESS, 3);
+  setInt8Config(CFG_PAGE_DATE, 4);
+  setStringConfig(CFG_ZONE, "Australia/Lord_Howe");
+  setStringConfig(CFG_SYSLOG_HOST, "logs.example.com");
+  checkPage("with checkboxes and selections");
+  setStringConfig(CFG_ZONE, "");
+  setStringConfig(CFG_TZ_NAME, "EST");
+  setStringConfig(CFG_DST_NAME, "EDT");
+  setInt16Config(CFG_TZ_MINUTES, -300);
+  checkPage("with a POSIX-style zone");
+}
+
+/**
+ * The ETag is the firmware version, a hash of the template and the configuration's hash. A
+ * browser that has the page gets a 304 until the configuration changes
+ */
+void test_etag(void) {
+  SimHttpResult page = getPage();
+  SimHttpResult again;
+  PageCacheStats before;
+  PageCacheStats after;
+  uint32_t hash = 2166136261UL;
+  char expected[32];
+  for (const char *p = homePageData ; *p ; p++) hash = (hash ^ (uint8_t)*p) * 16777619UL;
+  snprintf(expected, sizeof(expected), "\"" FIRMWARE_VERSION "-%08x%08x\"", hash, getConfigHash());
+  TEST_ASSERT_EQUAL_STRING(expected, page.header("ETag").c_str());
+  getPageCacheStats(&before);
+  again = getPage(page.header("ETag"));
+  TEST_ASSERT_EQUAL_INT(304, again.status);
+  TEST_ASSERT_EQUAL_UINT32(0, again.body.size());
+  again = getPage();
+  TEST_ASSERT_EQUAL_INT(200, again.status);
+  getPageCacheStats(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.notModified + 1, after.notModified);
+  TEST_ASSERT_EQUAL_UINT32(before.hits + 1, after.hits);
+  TEST_ASSERT_EQUAL_UINT32(before.misses, after.misses);
+  // A change, and the page is worked out again with a new tag
+  setInt8Config(CFG_DEFAULT_BRIGHTNESS, 5);
+  again = getPage(page.header("ETag"));
+  TEST_ASSERT_EQUAL_INT(200, again.status);
+  TEST_ASSERT_FALSE(again.header("ETag") == page.header("ETag"));
+  getPageCacheStats(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.misses + 1, after.misses);
+  TEST_PRINTF("Page %u bytes, %u bytes cached", again.body.size(), after.bytes);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_byte_for_byte);
+  RUN_TEST(test_etag);
+  return UNITY_END();
+}
@@ -0,0 +1,186 @@
+// test_pages - the display's pages, and the local calendar they keep between midnights
+//
+// pages.cpp works the local date, weekday and UTC offset out once and keeps them until the next
+// local midnight or DST change. Here every second of the four days around each DST change in 2027
+// is shown, a page at a time, and checked against what localtime() says for that second - in the
+// clock's own zone, so this checks the cache rather than the zone rules (test_timewarp does those).
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "pages.h"
+#include "timekeeping.h"
+
+String getTimezoneString();
+
+#define YEAR_UTC 1798761600LL             // 2027-01-01 00:00:00
+#define WINDOW_SECONDS (2 * 86400LL)
+
+static const char *zones[] = {
+  "Europe/London", "America/New_York", "America/St_Johns", "Asia/Kolkata", "Australia/Lord_Howe",
+  "Pacific/Chatham"
+};
+static const char *weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static uint8_t weekdayFrames[7][4];       // The segments for each - the simulation only reads digits
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * Change the zone, as it would be after a restart with the new configuration
+ */
+static void useZone(const char *zone) {
+  setStringConfig(CFG_ZONE, zone);
+  setenv("TZ", getTimezoneString().c_str(), 1);
+  tzset();
+}
+
+/**
+ * Show only one page
+ */
+static void onlyPage(uint8_t page) {
+  uint8_t seconds[PAGE_COUNT] = { 0 };
+  seconds[page] = 1;
+  setPageSeconds(seconds);
+}
+
+/**
+ * What the page should show at t, from localtime()
+ */
+static std::string expectedText(uint8_t page, time_t t) {
+  struct tm local = *localtime(&t);
+  char text[8];
+  switch (page) {
+    case PAGE_DATE:
+      snprintf(text, sizeof(text), "%2u%02u", local.tm_mday, local.tm_mon + 1);
+      break;
+    case PAGE_WEEKDAY:
+      snprintf(text, sizeof(text), "%s", weekdays[local.tm_wday]);
+      break;
+    default:
+      snprintf(text, sizeof(text), "%2u%02u", local.tm_hour, local.tm_min);
+      break;
+  }
+  return text;
+}
+
+/**
+ * Is the display showing text - digits read back, or a weekday's segments?
+ */
+static bool showing(const std::string &text) {
+  uint8_t frame[4];
+  for (int i = 0 ; i < 7 ; i++) {
+    if (text != weekdays[i]) continue;
+    simDisplayFrame(frame);
+    return !memcmp(frame, weekdayFrames[i], sizeof(frame));
+  }
+  return simDisplayText() == text.c_str();
+}
+
+/**
+ * The seconds the zone's UTC offset changes during 2027, as localtime() has them
+ */
+static std::vector<time_t> changes() {
+  std::vector<time_t> ans;
+  time_t t = YEAR_UTC;
+  long offset = localtime(&t)->tm_gmtoff;
+  for (t = YEAR_UTC + 3600 ; t < YEAR_UTC + 365 * 86400LL ; t += 3600) {
+    time_t before = t - 3600;
+    time_t after = t;
+    if (localtime(&t)->tm_gmtoff == offset) continue;
+    while ((after - before) > 1) {
+      time_t middle = before + (after - before) / 2;
+      if (localtime(&middle)->tm_gmtoff == offset) before = middle; else after = middle;
+    }
+    ans.push_back(after);
+    offset = localtime(&t)->tm_gmtoff;
+  }
+  return ans;
+}
+
+/**
+ * The time, date and weekday pages, every second of two days either side of each change
+ */
+void test_calendar(void) {
+  uint32_t checked = 0;
+  for (const char *zone : zones) {
+    std::vector<time_t> windows;
+    uint32_t wrong = 0;
+    std::string firstWrong;
+    useZone(zone);
+    windows = changes();
+    if (windows.empty()) windows.push_back(YEAR_UTC + 180 * 86400LL);   // No DST - a midsummer's day
+    for (uint8_t page : { PAGE_TIME, PAGE_DATE, PAGE_WEEKDAY }) {
+      onlyPage(page);
+      for (time_t window : windows) {
+        for (time_t t = window - WINDOW_SECONDS ; t < window + WINDOW_SECONDS ; t++) {
+          std::string expected = expectedText(page, t);
+          showPage(t);
+          checked++;
+          if (showing(expected)) continue;
+          if (!wrong++) {
+            firstWrong = std::to_string(t) + " page " + std::to_string(page) + " showed '" + simDisplayText().c_str() +
+                "', expected '" + expected + "'";
+          }
+        }
+      }
+    }
+    TEST_PRINTF("%s: %u changes, %u seconds wrong", zone, (unsigned)changes().size(), wrong);
+    TEST_ASSERT_EQUAL_MESSAGE(0, wrong, (std::string(zone) + " " + firstWrong).c_str());
+  }
+  TEST_ASSERT_GREATER_THAN(6000000, checked);
+  setPageSeconds(nullptr);
+}
+
+/**
+ * The page is worked out from the time, so it is the same whenever a clock starts, and a page set to
+ * 0 seconds is left out. The IP address page shows an octet a second
+ */
+void test_rotation(void) {
+  uint8_t seconds[PAGE_COUNT] = { 3, 0, 1, 0, 4 };   // 8 seconds: time, weekday, IP
+  IPAddress ip = WiFi.localIP();
+  char octet[8];
+  useZone("Europe/London");
+  setPageSeconds(seconds);
+  for (time_t t = YEAR_UTC ; t < YEAR_UTC + 16 ; t++) {
+    uint32_t position = t % 8;
+    showPage(t);
+    if (position < 3) {
+      TEST_ASSERT_TRUE(showing(expectedText(PAGE_TIME, t)));
+    } else if (position < 4) {
+      TEST_ASSERT_TRUE(showing(expectedText(PAGE_WEEKDAY, t)));
+    } else {
+      snprintf(octet, sizeof(octet), "%4u", ip[position - 4]);
+      TEST_ASSERT_EQUAL_STRING(octet, simDisplayText().c_str());
+    }
+  }
+  setPageSeconds(nullptr);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.end();
+  simSetTrueTime(YEAR_UTC);
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+  for (int i = 0 ; i < 7 ; i++) {
+    showText(weekdays[i]);
+    simDisplayFrame(weekdayFrames[i]);
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_calendar);
+  RUN_TEST(test_rotation);
+  return UNITY_END();
+}
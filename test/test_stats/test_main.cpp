@@ -0,0 +1,131 @@
+// test_stats - ten years of the statistics log, on simulated NOR flash
+//
+// The clock is run through ten years, restarted every week and losing its power every month. It is
+// only woken around each 15 minute uptime save - in between it sleeps through (simOversleep()), so
+// the years take seconds. The flash is NOR: a write can only clear bits, and each sector's erases
+// are counted.
+//
+// A restart here is initStats() again, which rebuilds the counters from the flash as a boot would;
+// the rest of the firmware carries on as it was.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <user_interface.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "stats.h"
+#include "timekeeping.h"
+
+#define START_UTC 1735689600LL            // 2025-01-01 00:00:00
+#define YEARS 10
+#define DAY_MILLIS (24ULL * 3600ULL * 1000ULL)
+#define SAVE_MILLIS (15ULL * 60ULL * 1000ULL) // STATS_UPTIME_SAVE_MILLIS
+#define AWAKE_MILLIS 3000ULL
+#define STATS_FIRST_SECTOR (0xF3000 / 4096)   // _STATS_start in ld/eagle.flash.1m.stats.ld
+#define STATS_SECTORS 8
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint32_t boots = 1;
+static uint32_t powerCuts = 0;
+static uint32_t erasesBefore[STATS_SECTORS];
+
+/**
+ * Run for a day - asleep apart from a few seconds around each uptime save
+ */
+static void runDay() {
+  for (uint64_t done = 0 ; done < DAY_MILLIS ; done += SAVE_MILLIS) {
+    simOversleep(SAVE_MILLIS - AWAKE_MILLIS);
+    simRun(SAVE_MILLIS);
+  }
+}
+
+static void restart(uint32_t reason) {
+  simSetResetReason(reason);
+  if (reason == REASON_DEFAULT_RST) {
+    simPowerCut();
+    powerCuts++;
+  }
+  initStats();
+  boots++;
+}
+
+/**
+ * Ten years, restarting every Sunday and losing the power on the first of every month
+ */
+void test_ten_years(void) {
+  StatsFlashInfo info;
+  uint32_t least = UINT32_MAX;
+  uint32_t most = 0;
+  for (uint8_t i = 0 ; i < STATS_SECTORS ; i++) erasesBefore[i] = simFlashErases(STATS_FIRST_SECTOR + i);
+  for (uint32_t day = 1 ; day <= YEARS * 36525 / 100 ; day++) {
+    time_t now = START_UTC + day * 86400LL;
+    struct tm date;
+    runDay();
+    gmtime_r(&now, &date);
+    if (date.tm_mday == 1) {
+      restart(REASON_DEFAULT_RST);
+    } else if (date.tm_wday == 0) {
+      restart(REASON_SOFT_RESTART);
+    }
+  }
+  for (uint8_t i = 0 ; i < STATS_SECTORS ; i++) {
+    uint32_t erases = simFlashErases(STATS_FIRST_SECTOR + i) - erasesBefore[i];
+    least = min(least, erases);
+    most = max(most, erases);
+  }
+  getStatsFlashInfo(&info);
+  TEST_PRINTF("%u boots (%u power cuts), %u sectors used, erased %u .. %u times each", boots, powerCuts,
+      info.sequence, least, most);
+  // Written only to erased flash, and the sectors worn evenly
+  TEST_ASSERT_EQUAL_UINT32(0, simFlashBitViolations());
+  TEST_ASSERT_EQUAL_UINT32(STATS_SECTORS, info.sectors);
+  TEST_ASSERT_LESS_OR_EQUAL(1, most - least);
+  TEST_ASSERT_EQUAL_UINT32(most, info.maxErases);
+  // Nowhere near the 100,000 erases the flash is good for
+  TEST_ASSERT_LESS_OR_EQUAL(YEARS * 40, most);
+  TEST_ASSERT_GREATER_OR_EQUAL(YEARS * 10, least);
+  // Nothing outside the region is touched
+  for (uint32_t sector = 0 ; sector < 256 ; sector++) {
+    if ((sector < STATS_FIRST_SECTOR) || (sector >= STATS_FIRST_SECTOR + STATS_SECTORS)) {
+      TEST_ASSERT_EQUAL_UINT32(0, simFlashErases(sector));
+    }
+  }
+}
+
+/**
+ * The counters came through every restart
+ */
+void test_counters_kept(void) {
+  uint64_t seconds;
+  // Long enough for the last boot to be saved
+  simRun(2 * 60 * 1000);
+  restart(REASON_SOFT_RESTART);
+  seconds = simMicros() / 1000000ULL;
+  TEST_ASSERT_EQUAL_UINT32(boots, getStatsCounter(STATS_BOOTS));
+  TEST_ASSERT_EQUAL_UINT32(powerCuts + 1, getStatsCounter(STATS_RESET_REASONS + REASON_DEFAULT_RST));
+  TEST_ASSERT_EQUAL_UINT32(boots - powerCuts - 1, getStatsCounter(STATS_RESET_REASONS + REASON_SOFT_RESTART));
+  // Up to 15 minutes of uptime is lost at each power cut
+  TEST_ASSERT_LESS_OR_EQUAL(seconds, getStatsCounter(STATS_UPTIME));
+  TEST_ASSERT_GREATER_OR_EQUAL(seconds - (powerCuts + 1) * SAVE_MILLIS / 1000, getStatsCounter(STATS_UPTIME));
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.end();
+  simSetTrueTime(START_UTC);
+  setup();
+  simRunUntil([]() { return timeIsSynced(); }, 30000);
+  simRun(DAY_MILLIS - simMicros() / 1000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_ten_years);
+  RUN_TEST(test_counters_kept);
+  return UNITY_END();
+}
@@ -0,0 +1,216 @@
+// test_timer - the stopwatch and countdown timer, and how steadily its frames reach the display
+//
+// Frames are due every 20 ms. Each loop() pass here takes 1 to 1.4 ms of work, as a busy clock's do,
+// and some are held up for 30 ms at a time, as by a flash erase or a slow web request. The frame
+// rate and jitter are measured from the TM1650 writes themselves - the time each new hundredths digit
+// is sent - and checked against what GET /timer reports.
+
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "alarms.h"
+#include "buttons.h"
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+#include "timer.h"
+
+#define FRAME_MICROS 20000ULL
+#define RUN_MILLIS 20000ULL
+#define STALL_MICROS 30000ULL
+#define LAST_DIGIT 0x37                   // The TM1650's address for the rightmost digit
+
+typedef struct Frames_t {
+  std::vector<uint64_t> at;               // simMicros() of each frame
+  uint32_t worstLateMicros;               // Behind the 20 ms schedule from the first frame
+  uint32_t worstJitterMicros;             // Furthest a gap between frames is from 20 ms, away from stalls
+  uint32_t fpsHundredths;
+} Frames;
+
+static uint32_t randomState = 43;
+static std::vector<uint64_t> stalls;      // simMicros() each stall started
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint32_t nextRandom() {
+  randomState = randomState * 1103515245UL + 12345UL;
+  return randomState >> 8;
+}
+
+/**
+ * Run for ms, each loop() pass taking 1 to 1.4 ms, and one in stallEvery (if any) held up for
+ * another 30 ms
+ */
+static void runBusy(uint64_t ms, uint32_t stallEvery) {
+  simRunUntil([stallEvery]() {
+    simSetLoopCostMicros(1000 + nextRandom() % 401);
+    if (stallEvery && !(nextRandom() % stallEvery)) {
+      stalls.push_back(simMicros());
+      simAdvanceMicros(STALL_MICROS);
+    }
+    return false;
+  }, ms);
+  simSetLoopCostMicros(50);
+}
+
+static SimHttpResult timerCommand(const char *form) {
+  SimHttpResult ans = simHttp("POST", "/timer", std::string(form));
+  TEST_ASSERT_EQUAL_INT(202, ans.status);
+  simRun(100);
+  return ans;
+}
+
+/**
+ * A field of GET /timer's JSON, as a number
+ */
+static double timerField(const char *name) {
+  SimHttpResult status = simHttp("GET", "/timer");
+  std::string key = std::string("\"") + name + "\":";
+  size_t start = status.body.find(key);
+  TEST_ASSERT_EQUAL_INT(200, status.status);
+  TEST_ASSERT_TRUE(start != std::string::npos);
+  return strtod(status.body.c_str() + start + key.size(), nullptr);
+}
+
+/**
+ * Was there a stall between from and to?
+ */
+static bool stalled(uint64_t from, uint64_t to) {
+  for (uint64_t at : stalls) {
+    if ((at >= from) && (at < to)) return true;
+  }
+  return false;
+}
+
+/**
+ * The frames sent to the display since the writes were last cleared. The schedule is taken from
+ * the first frame, so the lateness is relative to that one's
+ */
+static Frames frames() {
+  Frames ans = { {}, 0, 0, 0 };
+  for (const SimDisplayWrite &w : simDisplayWrites()) {
+    if (w.address == LAST_DIGIT) ans.at.push_back(w.at);
+  }
+  TEST_ASSERT_TRUE(ans.at.size() > 1);
+  for (size_t i = 1 ; i < ans.at.size() ; i++) {
+    uint64_t due = ans.at[0] + ((ans.at[i] - ans.at[0] + FRAME_MICROS / 2) / FRAME_MICROS) * FRAME_MICROS;
+    uint64_t gap = ans.at[i] - ans.at[i - 1];
+    if ((ans.at[i] > due) && (ans.at[i] - due > ans.worstLateMicros)) ans.worstLateMicros = ans.at[i] - due;
+    if (((i < 2) || !stalled(ans.at[i - 2], ans.at[i])) && (llabs((int64_t)gap - (int64_t)FRAME_MICROS) > ans.worstJitterMicros)) {
+      ans.worstJitterMicros = llabs((int64_t)gap - (int64_t)FRAME_MICROS);
+    }
+  }
+  ans.fpsHundredths = (ans.at.size() - 1) * 100000000ULL / (ans.at.back() - ans.at[0]);
+  return ans;
+}
+
+/**
+ * A stopwatch on a busy clock - 50 frames a second, each within a loop() pass of when it was due
+ */
+void test_frame_rate(void) {
+  Frames shown;
+  timerCommand("mode=stopwatch&action=start");
+  simClearDisplayWrites();
+  runBusy(RUN_MILLIS, 0);
+  shown = frames();
+  TEST_PRINTF("Busy: %u.%02u fps, worst %u us late, jitter %u us", shown.fpsHundredths / 100, shown.fpsHundredths % 100,
+    shown.worstLateMicros, shown.worstJitterMicros);
+  TEST_ASSERT_UINT32_WITHIN(5, 5000, shown.fpsHundredths);
+  // A frame can wait for the rest of a pass, and the 1 ms sleep after it
+  TEST_ASSERT_LESS_THAN_UINT32(2500, shown.worstLateMicros);
+  TEST_ASSERT_LESS_THAN_UINT32(2500, shown.worstJitterMicros);
+  TEST_ASSERT_LESS_THAN_UINT32(2500, (uint32_t)timerField("lateUs"));
+  TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)timerField("missed"));
+  TEST_ASSERT_TRUE(timerField("fps") > 49.9);
+  timerCommand("action=stop");
+}
+
+/**
+ * Held up now and then - a stall costs at most one frame, which is skipped rather than sent in a
+ * burst afterwards, and the frames after it are back on the schedule
+ */
+void test_stalls(void) {
+  Frames shown;
+  uint32_t missed;
+  timerCommand("action=reset");
+  timerCommand("action=start");
+  simClearDisplayWrites();
+  stalls.clear();
+  runBusy(RUN_MILLIS, 500);
+  shown = frames();
+  missed = (uint32_t)timerField("missed");
+  TEST_PRINTF("With %u stalls: %u.%02u fps, %u frames missed, jitter %u us away from them", (unsigned)stalls.size(),
+    shown.fpsHundredths / 100, shown.fpsHundredths % 100, missed, shown.worstJitterMicros);
+  TEST_ASSERT_TRUE(stalls.size() > 10);
+  TEST_ASSERT_TRUE(missed > 0);
+  TEST_ASSERT_TRUE(missed <= stalls.size());
+  // Every frame was either shown or counted as missed
+  TEST_ASSERT_UINT32_WITHIN(2, RUN_MILLIS * 1000ULL / FRAME_MICROS, shown.at.size() + missed);
+  TEST_ASSERT_TRUE(shown.fpsHundredths > 4800);
+  TEST_ASSERT_LESS_THAN_UINT32(STALL_MICROS + 2500, shown.worstLateMicros);
+  TEST_ASSERT_LESS_THAN_UINT32(2500, shown.worstJitterMicros);
+  // A frame shown late is followed by one on time, so a short gap - but never two in a row
+  for (size_t i = 2 ; i < shown.at.size() ; i++) {
+    TEST_ASSERT_TRUE((shown.at[i] - shown.at[i - 1] > FRAME_MICROS * 3 / 4) || (shown.at[i - 1] - shown.at[i - 2] > FRAME_MICROS * 3 / 4));
+  }
+  timerCommand("action=stop");
+}
+
+/**
+ * What's shown is the time on the timer - SS and hundredths under a minute, MM:SS after
+ */
+void test_display(void) {
+  timerCommand("mode=stopwatch&action=reset");
+  TEST_ASSERT_EQUAL_STRING("0000", simDisplayText().c_str());
+  timerCommand("action=start");
+  runBusy(12345, 0);
+  timerCommand("action=stop");
+  TEST_ASSERT_UINT32_WITHIN(30, 12345 + 100, getTimerMillis());   // And the 100 ms after the start command
+  TEST_ASSERT_EQUAL_STRING("12", simDisplayText().substring(0, 2).c_str());
+  TEST_ASSERT_TRUE(simDisplayColon());
+  timerCommand("action=start");
+  runBusy(60000, 0);
+  timerCommand("action=stop");
+  TEST_ASSERT_EQUAL_STRING("0112", simDisplayText().c_str());
+}
+
+/**
+ * A countdown from HTTP rings when it gets to 0000, and SET stops it
+ */
+void test_countdown(void) {
+  uint64_t start = simMicros();
+  timerCommand("mode=countdown&seconds=5&action=start");
+  TEST_ASSERT_TRUE(simRunUntil([]() { return alarmIsRinging(); }, 6000));
+  TEST_ASSERT_UINT64_WITHIN(FRAME_MICROS + 1000, 5000000ULL, simMicros() - start);
+  TEST_ASSERT_FALSE(timerIsRunning());
+  TEST_ASSERT_EQUAL_UINT32(0, getTimerMillis());
+  simSetButton(SET_BUTTON_PIN, true);
+  simRun(200);
+  simSetButton(SET_BUTTON_PIN, false);
+  simRun(200);
+  TEST_ASSERT_FALSE(alarmIsRinging());
+  timerCommand("mode=clock");
+  TEST_ASSERT_FALSE(timerIsActive());
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_rate);
+  RUN_TEST(test_stalls);
+  RUN_TEST(test_display);
+  RUN_TEST(test_countdown);
+  return UNITY_END();
+}
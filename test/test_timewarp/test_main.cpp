@@ -0,0 +1,255 @@
+// test_timewarp - the clock run natively on virtual time, through eleven years of DST changes
+//
+// One simulated clock is booted, and its display compared every second with what the host's zone
+// database says the local time is - for ten minutes either side of every DST change from 2025 to
+// 2035, and of every new year, in each of the zones below. The clock works the time out from the
+// POSIX rules in its own zone table, so this checks those as well as the timekeeping and display.
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sntp.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "timekeeping.h"
+
+String getTimezoneString();
+
+#define FIRST_YEAR_UTC 1735689600LL       // 2025-01-01 00:00:00
+#define LAST_YEAR_UTC 2082758400LL        // 2036-01-01 00:00:00
+#define WINDOW_SECONDS 600
+#define MIN_SPEEDUP 10000
+
+static const char *zones[] = {
+  "Europe/London", "Europe/Dublin", "America/New_York", "America/St_Johns", "Asia/Kolkata",
+  "Australia/Sydney", "Australia/Lord_Howe", "Pacific/Chatham"
+};
+
+typedef struct Transition_t {
+  int64_t at;                             // UTC
+  int32_t offset;                         // Local time minus UTC from then on, in seconds
+} Transition;
+
+// How long the clock has been run for (rather than warped), and how long that took
+static uint64_t runMicros = 0;
+static std::chrono::steady_clock::duration hostTime(0);
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * Run the clock until the true time reaches t (UTC, in microseconds), timing it
+ */
+static void runUntilTrue(int64_t t) {
+  auto start = std::chrono::steady_clock::now();
+  uint64_t from = simMicros();
+  simRunUntilTrue(t);
+  runMicros += simMicros() - from;
+  hostTime += std::chrono::steady_clock::now() - start;
+}
+
+/**
+ * Skip to shortly before t, without running the clock
+ */
+static void warpTo(int64_t t) {
+  int64_t ms = (t * 1000000LL - simTrueMicros()) / 1000;
+  if (ms > 0) simWarp(ms);
+}
+
+/**
+ * The zone's offsets over the years being tested, from the host's zone database. The first is the
+ * offset at the start
+ */
+static std::vector<Transition> hostTransitions(const char *zone) {
+  std::vector<Transition> ans;
+  std::string saved = getenv("TZ") ? getenv("TZ") : "";
+  std::string tz = std::string(":") + zone;
+  struct tm local;
+  time_t t = FIRST_YEAR_UTC;
+  setenv("TZ", tz.c_str(), 1);
+  tzset();
+  localtime_r(&t, &local);
+  ans.push_back({ FIRST_YEAR_UTC, (int32_t)local.tm_gmtoff });
+  for (t = FIRST_YEAR_UTC + 3600 ; t < LAST_YEAR_UTC ; t += 3600) {
+    time_t before = t - 3600;
+    time_t after = t;
+    localtime_r(&t, &local);
+    if (local.tm_gmtoff == ans.back().offset) continue;
+    while ((after - before) > 1) {
+      time_t middle = before + (after - before) / 2;
+      struct tm m;
+      localtime_r(&middle, &m);
+      if (m.tm_gmtoff == ans.back().offset) before = middle; else after = middle;
+    }
+    ans.push_back({ after, (int32_t)local.tm_gmtoff });
+  }
+  setenv("TZ", saved.c_str(), 1);
+  tzset();
+  return ans;
+}
+
+/**
+ * What the display should show at UTC t, in 24 hour mode
+ */
+static std::string expectedText(const std::vector<Transition> &transitions, int64_t t) {
+  int32_t offset = transitions[0].offset;
+  char text[5];
+  int32_t seconds;
+  for (const Transition &transition : transitions) if (transition.at <= t) offset = transition.offset;
+  seconds = (int32_t)(((t + offset) % 86400 + 86400) % 86400);
+  snprintf(text, sizeof(text), "%c%c%c%c", (seconds < 36000) ? ' ' : '0' + seconds / 36000,
+      '0' + (seconds / 3600) % 10, '0' + (seconds / 600) % 6, '0' + (seconds / 60) % 10);
+  return text;
+}
+
+/**
+ * Change the zone, as it would be after a restart with the new configuration
+ */
+static void useZone(const char *zone) {
+  setStringConfig(CFG_ZONE, zone);
+  setenv("TZ", getTimezoneString().c_str(), 1);
+  tzset();
+}
+
+/**
+ * Put the true time back to t, and have the clock pick it up
+ */
+static void resetTrueTime(time_t t) {
+  simSetTrueTime(t);
+  sntp_stop();
+  sntp_init();
+  simRun(2000);
+}
+
+/**
+ * The clock gets the time, and starts showing it at the next second
+ */
+void test_first_sync_starts_display(void) {
+  static const std::vector<Transition> utc = { { FIRST_YEAR_UTC, 0 } };
+  TEST_ASSERT_TRUE(simRunUntil([]() { return timeIsSynced(); }, 30000));
+  TEST_ASSERT_GREATER_THAN(0, millisToFirstSync());
+  TEST_ASSERT_LESS_THAN(5000, millisToFirstSync());
+  // Once the IP address has scrolled past
+  TEST_ASSERT_TRUE(simRunUntil([]() {
+    return simDisplayText() == expectedText(utc, simTrueMicros() / 1000000LL).c_str();
+  }, 30000));
+}
+
+/**
+ * The colon comes on with each new second and goes off half a second later
+ */
+void test_colon_cadence(void) {
+  std::vector<int64_t> on;
+  std::vector<int64_t> off;
+  bool colon = simDisplayColon();
+  uint64_t base = simMicros();
+  int64_t trueBase = simTrueMicros();
+  simRun(1500);
+  simClearDisplayWrites();
+  base = simMicros();
+  trueBase = simTrueMicros();
+  simRun(60000);
+  for (const SimDisplayWrite &write : simDisplayWrites()) {
+    int64_t at = trueBase + (int64_t)(write.at - base);
+    if ((write.address != 0x35) || ((write.value & 1) == colon)) continue;
+    colon = write.value & 1;
+    (colon ? on : off).push_back(at);
+  }
+  TEST_ASSERT_INT_WITHIN(1, 60, on.size());
+  TEST_ASSERT_INT_WITHIN(1, 60, off.size());
+  for (size_t i = 0 ; i < on.size() ; i++) {
+    // Just after the start of the second - the display is woken for it
+    TEST_ASSERT_LESS_THAN(5000, on[i] % 1000000LL);
+    if (i) TEST_ASSERT_INT_WITHIN(5000, 1000000, on[i] - on[i - 1]);
+  }
+  for (int64_t at : off) {
+    auto lit = std::upper_bound(on.begin(), on.end(), at);
+    if (lit == on.begin()) continue;
+    TEST_ASSERT_INT_WITHIN(5000, 500000, at - *(lit - 1));
+  }
+}
+
+/**
+ * The SNTP client keeps the time hourly, with the ESP's clock drifting in between
+ */
+void test_hourly_sync_keeps_time(void) {
+  uint32_t syncs = simSNTPSyncCount();
+  resetWorstTickLateness();
+  simSetDriftPPM(40);
+  runUntilTrue(simTrueMicros() + 6 * 3600 * 1000000LL);
+  TEST_ASSERT_INT_WITHIN(1, 6, simSNTPSyncCount() - syncs);
+  TEST_ASSERT_LESS_THAN(3600000UL + 1000, millisSinceSync());
+  // 40 ppm is 144 ms an hour, and the display slews to the new time rather than jumping
+  TEST_ASSERT_INT64_WITHIN(150000, simTrueMicros(), simSystemMicros());
+  TEST_ASSERT_LESS_THAN(10, getWorstTickLateness());
+  simSetDriftPPM(0);
+}
+
+/**
+ * The display follows the host's zone database through every change, in every zone
+ */
+void test_zone_transitions(void) {
+  uint32_t checked = 0;
+  for (const char *zone : zones) {
+    std::vector<Transition> transitions = hostTransitions(zone);
+    std::vector<int64_t> windows;
+    uint32_t wrong = 0;
+    std::string firstWrong;
+    for (size_t i = 1 ; i < transitions.size() ; i++) windows.push_back(transitions[i].at);
+    for (int year = 2026 ; year <= 2035 ; year++) {
+      struct tm newYear = { 0, 0, 0, 1, 0, year - 1900 };
+      windows.push_back(timegm(&newYear));
+    }
+    std::sort(windows.begin(), windows.end());
+    useZone(zone);
+    resetTrueTime(FIRST_YEAR_UTC);
+    for (int64_t window : windows) {
+      warpTo(window - WINDOW_SECONDS - 2);
+      runUntilTrue((window - WINDOW_SECONDS) * 1000000LL);
+      for (int64_t t = window - WINDOW_SECONDS ; t < window + WINDOW_SECONDS ; t++) {
+        std::string expected = expectedText(transitions, t);
+        runUntilTrue(t * 1000000LL + 500000);
+        checked++;
+        if (simDisplayText() == expected.c_str()) continue;
+        if (!wrong++) firstWrong = std::to_string(t) + " showed '" + simDisplayText().c_str() + "', expected '" + expected + "'";
+      }
+    }
+    TEST_PRINTF("%s: %u changes, %u seconds wrong", zone, (unsigned)transitions.size() - 1, wrong);
+    TEST_ASSERT_EQUAL_MESSAGE(0, wrong, (std::string(zone) + " " + firstWrong).c_str());
+  }
+  TEST_ASSERT_GREATER_THAN(250000, checked);
+}
+
+/**
+ * The simulation runs fast enough to cover years of changes in a test run
+ */
+void test_speed(void) {
+  double hostSeconds = std::chrono::duration<double>(hostTime).count();
+  double speedup = runMicros / 1e6 / hostSeconds;
+  TEST_PRINTF("%.0f hours simulated in %.2f s - %.0fx real time", runMicros / 3.6e9, hostSeconds, speedup);
+  TEST_ASSERT_GREATER_OR_EQUAL(MIN_SPEEDUP, (long long)speedup);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "UTC");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.end();
+  simSetTrueTime(FIRST_YEAR_UTC - 5);
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_first_sync_starts_display);
+  RUN_TEST(test_colon_cadence);
+  RUN_TEST(test_hourly_sync_keeps_time);
+  RUN_TEST(test_zone_transitions);
+  RUN_TEST(test_speed);
+  return UNITY_END();
+}
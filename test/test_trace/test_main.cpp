@@ -0,0 +1,169 @@
+// test_trace - what the display driver sends to the TM1650, against golden traces and a budget
+//
+// Each scenario's writes to the display are recorded as DisplayTransactions (the format /trace
+// returns), timed from the start of the scenario, and compared with golden/<scenario>.trace. A
+// scenario that sends more than its budget of transactions fails, whatever its golden says.
+//
+// A golden file is the number of transactions, the CRC-32 of them all, then the first
+// GOLDEN_MAX_STORED of them - long scenarios are checked in full by the CRC, and transaction by
+// transaction as far as that goes. After an intended change to what the display is sent, run the
+// tests with TRACE_UPDATE=1 in the environment to write new goldens, and check in the difference.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "timekeeping.h"
+
+#define GOLDEN_DIR "test/test_trace/golden/"
+#define GOLDEN_MAX_STORED 1024
+#define BOOT_UTC 1781524770LL             // 2026-06-15 11:59:30
+#define SPRING_FORWARD_UTC 1806195600LL   // 2027-03-28 01:00:00, when London goes to BST
+
+// Most transactions each scenario may take
+#define BOOT_BUDGET 120                   // "boot", then the IP address scrolled across
+#define SYNC_BUDGET 40                    // "SynC", then the first 10 seconds of the time
+#define DAY_BUDGET 178000                 // Colon on and off each second, and the digits that change
+#define DST_BUDGET 2500                   // 10 minutes either side of the change
+
+typedef struct Golden_t {
+  uint32_t count;
+  uint32_t crc;
+  std::vector<DisplayTransaction> stored;
+} Golden;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint64_t scenarioStart = 0;
+
+static void startScenario() {
+  simClearDisplayWrites();
+  scenarioStart = simMicros();
+}
+
+/**
+ * The scenario's writes to the TM1650, as /trace would give them
+ */
+static std::vector<DisplayTransaction> recorded() {
+  std::vector<DisplayTransaction> ans;
+  for (const SimDisplayWrite &write : simDisplayWrites()) {
+    ans.push_back({ (uint32_t)((write.at - scenarioStart) / 1000), write.address, write.value });
+  }
+  return ans;
+}
+
+static bool readGolden(const char *scenario, Golden *golden) {
+  std::string path = std::string(GOLDEN_DIR) + scenario + ".trace";
+  FILE *f = fopen(path.c_str(), "rb");
+  size_t n;
+  if (!f) return false;
+  n = fread(&golden->count, sizeof(uint32_t), 1, f) + fread(&golden->crc, sizeof(uint32_t), 1, f);
+  golden->stored.resize(std::min(golden->count, (uint32_t)GOLDEN_MAX_STORED));
+  n += fread(golden->stored.data(), sizeof(DisplayTransaction), golden->stored.size(), f);
+  fclose(f);
+  return n == golden->stored.size() + 2;
+}
+
+static void writeGolden(const char *scenario, const std::vector<DisplayTransaction> &trace) {
+  std::string path = std::string(GOLDEN_DIR) + scenario + ".trace";
+  FILE *f = fopen(path.c_str(), "wb");
+  uint32_t count = trace.size();
+  uint32_t crc = crc32(trace.data(), trace.size() * sizeof(DisplayTransaction));
+  TEST_ASSERT_NOT_NULL(f);
+  fwrite(&count, sizeof(count), 1, f);
+  fwrite(&crc, sizeof(crc), 1, f);
+  fwrite(trace.data(), sizeof(DisplayTransaction), std::min(trace.size(), (size_t)GOLDEN_MAX_STORED), f);
+  fclose(f);
+}
+
+/**
+ * Check the scenario's trace against its budget and golden
+ */
+static void checkScenario(const char *scenario, uint32_t budget) {
+  std::vector<DisplayTransaction> trace = recorded();
+  Golden golden;
+  char message[96];
+  TEST_PRINTF("%s: %u transactions, budget %u", scenario, (unsigned)trace.size(), budget);
+  TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(budget, trace.size(), "over the scenario's bus budget");
+  if (getenv("TRACE_UPDATE")) {
+    writeGolden(scenario, trace);
+    return;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(readGolden(scenario, &golden), "no golden trace - run with TRACE_UPDATE=1");
+  for (size_t i = 0 ; (i < golden.stored.size()) && (i < trace.size()) ; i++) {
+    const DisplayTransaction &want = golden.stored[i];
+    const DisplayTransaction &got = trace[i];
+    if ((want.timestamp == got.timestamp) && (want.address == got.address) && (want.value == got.value)) continue;
+    snprintf(message, sizeof(message), "transaction %u: expected %02x=%02x at %u ms, was %02x=%02x at %u ms",
+        (unsigned)i, want.address, want.value, want.timestamp, got.address, got.value, got.timestamp);
+    TEST_FAIL_MESSAGE(message);
+  }
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(golden.count, trace.size(), "number of transactions");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(golden.crc, crc32(trace.data(), trace.size() * sizeof(DisplayTransaction)),
+      "trace differs after the stored transactions");
+}
+
+/**
+ * Power up, connect, and scroll the IP address
+ */
+void test_boot(void) {
+  startScenario();
+  setup();
+  TEST_ASSERT_TRUE(simRunUntil([]() { return !displayIsScrolling(); }, 30000));
+  checkScenario("boot", BOOT_BUDGET);
+}
+
+/**
+ * Get the time, and show it
+ */
+void test_sync(void) {
+  startScenario();
+  TEST_ASSERT_TRUE(simRunUntil([]() { return timeIsSynced(); }, 30000));
+  simRun(10000);
+  checkScenario("sync", SYNC_BUDGET);
+}
+
+/**
+ * A whole day, with the hourly syncs
+ */
+void test_day(void) {
+  startScenario();
+  simRun(24 * 3600 * 1000ULL);
+  checkScenario("day", DAY_BUDGET);
+}
+
+/**
+ * The clocks go forward
+ */
+void test_dst_change(void) {
+  simWarp((SPRING_FORWARD_UTC - 600) * 1000LL - simTrueMicros() / 1000);
+  simRun(2000);
+  startScenario();
+  simRunUntilTrue((SPRING_FORWARD_UTC + 600) * 1000000LL);
+  checkScenario("dst", DST_BUDGET);
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_BOOL_CONFIGS, CFG_MASK_24H);
+  prefs.end();
+  simSetTrueTime(BOOT_UTC);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_boot);
+  RUN_TEST(test_sync);
+  RUN_TEST(test_day);
+  RUN_TEST(test_dst_change);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+// test_wifi - the connectivity supervisor, and how long the clock takes to recover from outages
+//
+// The access point is taken away for a while and brought back, again and again, and the time from
+// its return to the clock being connected again is measured - its time to recover. That is mostly
+// down to the reconnection backoff: attempts start 5 s apart and double up to 5 minutes, each
+// jittered by +/- 25%, and joining takes the simulation's 3 s.
+
+#include <algorithm>
+#include <vector>
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <Preferences.h>
+#include <sim.h>
+#include <unity.h>
+#include "config.h"
+#include "display.h"
+#include "stats.h"
+#include "timekeeping.h"
+#include "wifi.h"
+
+#define CONNECT_MILLIS 3000
+#define BACKOFF_MAX_MILLIS 300000ULL
+// The longest a recovery can take - the longest jittered wait, joining, and the supervisor's poll
+#define RECOVERY_MAX_MILLIS (BACKOFF_MAX_MILLIS * 5 / 4 + CONNECT_MILLIS + 1000)
+#define AP_AFTER_MINUTES 10
+#define FLEET_SIZE 20
+
+typedef struct Outage_t {
+  uint64_t millis;
+  uint8_t times;
+} Outage;
+
+static const Outage outages[] = {
+  { 3000, 10 }, { 30000, 10 }, { 2 * 60000, 10 }, { 10 * 60000, 5 }, { 30 * 60000, 5 }, { 2 * 3600000, 3 }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * Take the access point away for ms, then bring it back. Returns how long the clock took to
+ * reconnect, in milliseconds
+ */
+static uint64_t outage(uint64_t ms) {
+  uint64_t back;
+  simSetAccessPoint(false);
+  simRun(ms);
+  simSetAccessPoint(true);
+  back = simMicros();
+  TEST_ASSERT_TRUE(simRunUntil([]() { return simWiFiConnected(); }, RECOVERY_MAX_MILLIS * 2));
+  return (simMicros() - back) / 1000;
+}
+
+/**
+ * Recovery times over outages from seconds to hours
+ */
+void test_time_to_recover(void) {
+  uint64_t total = 0;
+  uint32_t count = 0;
+  uint16_t reconnects = getWiFiReconnectCount();
+  uint32_t counted = getStatsCounter(STATS_RECONNECTS);
+  for (const Outage &o : outages) {
+    std::vector<uint64_t> times;
+    for (uint8_t i = 0 ; i < o.times ; i++) {
+      times.push_back(outage(o.millis));
+      // Up long enough for the supervisor to see it, and for the time to be set again
+      simRun(5000);
+    }
+    std::sort(times.begin(), times.end());
+    for (uint64_t t : times) total += t;
+    count += times.size();
+    TEST_PRINTF("%5.0f s outage: recovered in %.1f .. %.1f s", o.millis / 1000.0, times.front() / 1000.0,
+        times.back() / 1000.0);
+    TEST_ASSERT_LESS_OR_EQUAL(RECOVERY_MAX_MILLIS, times.back());
+    // Short outages are over before the backoff has grown - the first attempts are 5 s apart
+    if (o.millis <= 3000) TEST_ASSERT_LESS_OR_EQUAL(5000 * 5 / 4 + CONNECT_MILLIS + 1000, times.back());
+  }
+  TEST_PRINTF("Mean time to recover %.1f s over %u outages", total / 1000.0 / count, count);
+  TEST_ASSERT_EQUAL_UINT32(reconnects + count, getWiFiReconnectCount());
+  TEST_ASSERT_EQUAL_UINT32(counted + count, getStatsCounter(STATS_RECONNECTS));
+}
+
+/**
+ * After APMIN minutes offline the configuration access point comes back, and it goes again once
+ * the clock has reconnected. The time is kept throughout, and set again afterwards
+ */
+void test_access_point(void) {
+  uint32_t syncs;
+  simSetAccessPoint(false);
+  simRun((AP_AFTER_MINUTES * 60 - 10) * 1000ULL);
+  TEST_ASSERT_FALSE(WiFi.getMode() & WIFI_AP);
+  simRun(12000);
+  TEST_ASSERT_TRUE(WiFi.getMode() & WIFI_AP);
+  TEST_ASSERT_TRUE(WiFi.softAPIP() != IPAddress());
+  syncs = simSNTPSyncCount();
+  simSetAccessPoint(true);
+  TEST_ASSERT_TRUE(simRunUntil([]() { return simWiFiConnected(); }, RECOVERY_MAX_MILLIS));
+  simRun(2000);
+  TEST_ASSERT_FALSE(WiFi.getMode() & WIFI_AP);
+  TEST_ASSERT_TRUE(timeIsSynced());
+  simRun(3600 * 1000ULL);
+  TEST_ASSERT_GREATER_THAN(syncs, simSNTPSyncCount());
+  TEST_ASSERT_LESS_THAN(3600000UL, millisSinceSync());
+}
+
+/**
+ * A fleet of clocks losing the same access point for half an hour don't all come back at once. The
+ * clocks are the same one in turn, each with its own random numbers, as each ESP has
+ */
+void test_fleet_spread(void) {
+  std::vector<uint64_t> times;
+  for (uint32_t clock = 1 ; clock <= FLEET_SIZE ; clock++) {
+    randomSeed(clock * 2654435761UL);
+    times.push_back(outage(30 * 60000ULL));
+    simRun(5000);
+  }
+  std::sort(times.begin(), times.end());
+  TEST_PRINTF("%u clocks back over %.1f .. %.1f s", FLEET_SIZE, times.front() / 1000.0, times.back() / 1000.0);
+  // The backoff is at its 5 minute cap by then, and the jitter has each clock trying every 225 to
+  // 375 s on its own schedule - so they come back over minutes, not together
+  TEST_ASSERT_GREATER_THAN(60000, times.back() - times.front());
+}
+
+int main(int argc, char **argv) {
+  Preferences prefs;
+  prefs.begin("303Clock");
+  prefs.putString(CFG_SSID, "sim");
+  prefs.putString(CFG_NTP_SERVER_1, "pool.ntp.org");
+  prefs.putString(CFG_ZONE, "Europe/London");
+  prefs.putChar(CFG_AP_AFTER_MINUTES, AP_AFTER_MINUTES);
+  prefs.end();
+  simSetTrueTime(1781524770LL);           // 2026-06-15 11:59:30
+  simSetConnectMillis(CONNECT_MILLIS);
+  setup();
+  simRunUntil([]() { return timeIsSynced() && !displayIsScrolling(); }, 60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_time_to_recover);
+  RUN_TEST(test_access_point);
+  RUN_TEST(test_fleet_spread);
+  return UNITY_END();
+}
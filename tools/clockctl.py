@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Find and manage a fleet of clocks.
+
+Clocks advertise a "_303clock._tcp" mDNS service carrying their firmware
+version and a hash of their configuration. This tool lists them, and pushes a
+configuration or a firmware image to many of them in parallel.
+
+    tools/clockctl.py list
+    tools/clockctl.py push-config site.json --restart
+    tools/clockctl.py push-firmware .pio/build/esp01_1m/firmware.bin -j 4
+    tools/clockctl.py --hosts 10.0.0.5,10.0.0.6 list
+
+Discovery needs the "zeroconf" Python package. Without it, give --hosts.
+The configuration file is a JSON object using the same field names that
+GET /config returns.
+"""
+
+import argparse
+import concurrent.futures
+import json
+import sys
+import time
+import urllib.parse
+import urllib.request
+
+import ota_upload
+
+SERVICE = "_303clock._tcp.local."
+
+
+def discover(timeout):
+    """Browse mDNS for clocks, returning a list of (address, TXT record dict)"""
+    try:
+        from zeroconf import ServiceBrowser, Zeroconf
+    except ImportError:
+        sys.exit("mDNS discovery needs the zeroconf package (pip install zeroconf), or use --hosts")
+
+    found = {}
+
+    class Listener:
+        def add_service(self, zc, type_, name):
+            info = zc.get_service_info(type_, name)
+            if info and info.parsed_addresses():
+                txt = {k.decode(): (v or b"").decode() for k, v in info.properties.items()}
+                found[name] = (f"{info.parsed_addresses()[0]}:{info.port}", txt)
+
+        def update_service(self, zc, type_, name):
+            self.add_service(zc, type_, name)
+
+        def remove_service(self, zc, type_, name):
+            found.pop(name, None)
+
+    zc = Zeroconf()
+    try:
+        ServiceBrowser(zc, SERVICE, Listener())
+        time.sleep(timeout)
+    finally:
+        zc.close()
+    return sorted(found.values())
+
+
+def get_config(host, timeout=10):
+    with urllib.request.urlopen(f"http://{host}/config", timeout=timeout) as resp:
+        return json.loads(resp.read().decode())
+
+
+def push_config(host, config, restart, timeout=10):
+    """Post a whole configuration in one request, returning the clock's new config hash
+
+    The clock applies the configuration shortly after replying, so the hash is read back
+    afterwards. If the clock is restarting, there is nothing to read back."""
+    fields = {}
+    for key, value in config.items():
+        if key in ("version", "cfg"):
+            continue
+        if isinstance(value, bool):
+            if value:
+                fields[key] = "on"
+            continue
+        fields[key] = str(value)
+    if restart:
+        fields["restart"] = "1"
+    body = urllib.parse.urlencode(fields).encode()
+    with urllib.request.urlopen(f"http://{host}/config", data=body, timeout=timeout) as resp:
+        if not json.loads(resp.read().decode()).get("queued"):
+            raise RuntimeError("clock did not accept the configuration")
+    if restart:
+        return "restarting"
+    time.sleep(0.5)
+    return get_config(host, timeout)["cfg"]
+
+
+def run_all(hosts, job, jobs):
+    """Run job(host) for every host with at most `jobs` in flight, printing each outcome"""
+    failures = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs) as pool:
+        futures = {pool.submit(job, host): host for host in hosts}
+        for future in concurrent.futures.as_completed(futures):
+            host = futures[future]
+            try:
+                print(f"{host}: {future.result()}")
+            except Exception as e:
+                failures += 1
+                print(f"{host}: FAILED: {e}", file=sys.stderr)
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--hosts", help="comma separated clock addresses, instead of mDNS discovery")
+    parser.add_argument("--browse", type=float, default=3.0, help="seconds to spend on mDNS discovery")
+    parser.add_argument("-j", "--jobs", type=int, default=8, help="clocks to work on at once")
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("list")
+    cfg = sub.add_parser("push-config")
+    cfg.add_argument("file")
+    cfg.add_argument("--restart", action="store_true")
+    fw = sub.add_parser("push-firmware")
+    fw.add_argument("file")
+    args = parser.parse_args()
+
+    if args.hosts:
+        hosts = args.hosts.split(",")
+        txts = {h: get_config(h) for h in hosts} if args.command == "list" else {}
+    else:
+        clocks = discover(args.browse)
+        hosts = [host for host, _ in clocks]
+        txts = dict(clocks)
+
+    if args.command == "list":
+        for host in hosts:
+            txt = txts.get(host, {})
+            print(f"{host}\tversion {txt.get('version', '?')}\tcfg {txt.get('cfg', '?')}")
+        return 0
+    if args.command == "push-config":
+        with open(args.file) as f:
+            config = json.load(f)
+        return run_all(hosts, lambda h: push_config(h, config, args.restart), args.jobs)
+    image = ota_upload.load_image(args.file)
+
+    def flash(host):
+        sent, seconds, reply = ota_upload.upload(host, image)
+        if not reply.get("ok"):
+            raise RuntimeError(f"clock rejected the image: {reply.get('error', 'no reason given')}")
+        return f"{sent} bytes in {seconds:.1f} s"
+    return run_all(hosts, flash, args.jobs)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Generate src/zonedata.h, the built-in timezone database, from the host's tzdata.
+
+Each zone listed in zone.tab (plus Etc/UTC) is looked up in the compiled
+zoneinfo files, and the POSIX TZ rule from the end of the file is stored
+against the zone's name. To keep it small -
+
+- identical rules are stored once, and zones refer to them by index
+- the region part of each name ("Europe", "America/Argentina" ...) is stored
+  once, and zones refer to it by index
+- entries are sorted by full name, so the clock can binary search them
+
+Quoted abbreviations such as "<+0530>", which the ESP8266 C library may not
+parse, are replaced by plain letters - the clock never shows them.
+
+    tools/gen_zones.py [--zoneinfo /usr/share/zoneinfo] > src/zonedata.h
+
+With --check, each generated rule is compared against the real zone using
+the build host's C library, over a spread of instants across three years.
+A few zones (Morocco, Palestine) have future transitions listed individually
+in tzdata that no POSIX rule can express, so they are reported as mismatches.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+QUOTED = re.compile(r"<[^>]*>")
+
+
+def load_zones(zoneinfo):
+    names = {"Etc/UTC"}
+    with open(os.path.join(zoneinfo, "zone.tab")) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            names.add(line.split("\t")[2].strip())
+    zones = {}
+    for name in sorted(names):
+        with open(os.path.join(zoneinfo, name), "rb") as f:
+            footer = f.read().rstrip(b"\n").rsplit(b"\n", 1)[-1].decode()
+        if not footer:
+            sys.exit(f"{name} has no POSIX rule - tzdata is too old")
+        zones[name] = plain_rule(footer)
+    return zones
+
+
+def plain_rule(rule):
+    """Replace quoted abbreviations, which are the first and second names in the rule"""
+    replacements = iter(["STD", "DST"])
+    return QUOTED.sub(lambda m: next(replacements), rule)
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '\\0"'
+
+
+def generate(zones):
+    rules = sorted(set(zones.values()))
+    regions = sorted({name.rsplit("/", 1)[0] for name in zones if "/" in name})
+    if len(rules) > 255 or len(regions) > 254:
+        sys.exit("too many rules or regions for 8 bit indices")
+    if max(len(r) for r in rules) >= 48:
+        sys.exit("a rule is too long for ZONE_RULE_MAX_LENGTH in zones.h")
+    rule_offsets, offset = [], 0
+    for rule in rules:
+        rule_offsets.append(offset)
+        offset += len(rule) + 1
+    region_offsets, offset = [], 0
+    for region in regions:
+        region_offsets.append(offset)
+        offset += len(region) + 1
+    cities, entries, offset = [], [], 0
+    for name in sorted(zones):
+        region, city = name.rsplit("/", 1) if "/" in name else (None, name)
+        entries.append((offset, regions.index(region) if region else 255, rules.index(zones[name]), name))
+        cities.append(city)
+        offset += len(city) + 1
+
+    out = ["// Generated by tools/gen_zones.py - do not edit", "",
+           f"#define ZONE_COUNT {len(entries)}", f"#define ZONE_RULE_COUNT {len(rules)}",
+           f"#define ZONE_REGION_COUNT {len(regions)}", "#define ZONE_NO_REGION 255", ""]
+    out.append("static const char zoneRules[] PROGMEM =")
+    out += [f"  {c_string(r)}" for r in rules]
+    out[-1] += ";"
+    out.append("static const uint16_t zoneRuleOffsets[] PROGMEM = {")
+    out.append("  " + ", ".join(map(str, rule_offsets)))
+    out.append("};")
+    out.append("static const char zoneRegions[] PROGMEM =")
+    out += [f"  {c_string(r)}" for r in regions]
+    out[-1] += ";"
+    out.append("static const uint16_t zoneRegionOffsets[] PROGMEM = {")
+    out.append("  " + ", ".join(map(str, region_offsets)))
+    out.append("};")
+    out.append("static const char zoneCities[] PROGMEM =")
+    out += [f"  {c_string(c)}" for c in cities]
+    out[-1] += ";"
+    out.append("// Sorted by full name")
+    out.append("static const ZoneEntry zoneEntries[] PROGMEM = {")
+    out += [f"  {{ {o}, {reg}, {rule} }}, // {name}" for o, reg, rule, name in entries]
+    out.append("};")
+    size = sum(len(r) + 1 for r in rules) + 2 * len(rules) + sum(len(r) + 1 for r in regions) \
+        + 2 * len(regions) + sum(len(c) + 1 for c in cities) + 4 * len(entries)
+    print(f"{len(entries)} zones, {len(rules)} rules, {len(regions)} regions, {size} bytes", file=sys.stderr)
+    return "\n".join(out) + "\n"
+
+
+def check(zones):
+    """Compare each rule against the real zone using the host C library"""
+    import time
+    failures = 0
+    instants = range(1735689600, 1735689600 + 3 * 366 * 86400, 86400 * 7 + 3607)
+    for name, rule in sorted(zones.items()):
+        results = []
+        for tz in (name, rule):
+            os.environ["TZ"] = tz
+            time.tzset()
+            results.append([time.localtime(t)[:6] for t in instants])
+        if results[0] != results[1]:
+            failures += 1
+            print(f"MISMATCH {name}: {rule}", file=sys.stderr)
+    print(f"{len(zones) - failures} of {len(zones)} zones match", file=sys.stderr)
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--zoneinfo", default="/usr/share/zoneinfo")
+    parser.add_argument("--check", action="store_true", help="check the rules against the host C library")
+    args = parser.parse_args()
+    zones = load_zones(args.zoneinfo)
+    if args.check:
+        return check(zones)
+    sys.stdout.write(generate(zones))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Report each module's memory use from the linker map, and check it against a budget.
+
+Every input section in the map is put down to the module it came from - a
+source file in src/, or a library - and counted as
+
+    flash   code and constants that stay in flash (.irom0.text, PROGMEM)
+    iram    code in instruction RAM (.text - IRAM_ATTR functions)
+    data    initialised variables - in RAM, with a copy in flash
+    rodata  constants in RAM - string literals and tables without PROGMEM
+    bss     zeroed variables
+
+"ram" is data + rodata + bss, all of which comes out of the heap the clock
+has left. The build writes the map with "pio run -t memory", which runs
+
+    tools/memory_report.py .pio/build/esp01_1m/firmware.map --budget tools/memory_budget.json
+
+and fails if any module, or the total, is over its budget. The totals are the
+ESP8266's own limits (see README.md). A module without a budget of its own gets
+the "default" one (DEFAULT_BUDGET if the file has none), so new RAM or IRAM use
+has to be budgeted for. --update sets a RAM and IRAM budget for each of our
+modules from the map, with some headroom - run it on the map of a real build.
+Libraries only count towards the total (--all lists them).
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import sys
+
+KINDS = ("flash", "iram", "data", "rodata", "bss")
+DEFAULT_BUDGET = {"ram": 1024, "iram": 0}   # For a module added since the budgets were last set
+# Output sections in the ESP8266 linker script, and what they hold
+SECTIONS = {
+    ".irom0.text": "flash",
+    ".text": "iram",
+    ".text1": "iram",
+    ".data": "data",
+    ".rodata": "rodata",
+    ".bss": "bss",
+    ".noinit": "bss",
+}
+INPUT = re.compile(r"^ (\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$")
+ARCHIVE = re.compile(r"([^/\\]+)\.a\(([^)]+)\)$")
+
+
+def module_name(path):
+    """src/display.cpp.o -> display, .../libESPAsyncTCP.a(AsyncTCP.cpp.o) -> ESPAsyncTCP"""
+    m = ARCHIVE.search(path)
+    if m:
+        return m.group(1)[3:] if m.group(1).startswith("lib") else m.group(1)
+    name = os.path.basename(path)
+    for suffix in (".o", ".cpp", ".c", ".S"):
+        if name.endswith(suffix):
+            name = name[:-len(suffix)]
+    return name
+
+
+def parse_map(lines):
+    """Returns {module: {kind: bytes}}, and the set of modules that are our own source files"""
+    usage = collections.defaultdict(lambda: dict.fromkeys(KINDS, 0))
+    ours = set()
+    in_map, kind, pending = False, None, None
+    for line in lines:
+        line = line.rstrip("\n")
+        if not in_map:
+            in_map = line.startswith("Linker script and memory map")
+            continue
+        if line and not line[0].isspace():
+            # An output section, e.g. ".text           0x40100000     0x6f5c"
+            kind = SECTIONS.get(line.split()[0])
+            pending = None
+            continue
+        if kind is None:
+            continue
+        if re.match(r"^ \.\S+$", line):
+            pending = line.strip()  # The input section's name was too long, the rest is on the next line
+            continue
+        m = INPUT.match(line)
+        if not m:
+            pending = None
+            continue
+        name = m.group(1) or pending
+        pending = None
+        size = int(m.group(3), 16)
+        if not name or name.startswith("*") or not size:
+            continue
+        path = m.group(4).strip()
+        usage[module_name(path)][kind] += size
+        if not ARCHIVE.search(path) and re.search(r"(^|[/\\])src[/\\]", path):
+            ours.add(module_name(path))
+    return usage, ours
+
+
+def ram(use):
+    return use["data"] + use["rodata"] + use["bss"]
+
+
+def over(use, budget):
+    """The ways use exceeds budget - which may give any of the kinds, and "ram" """
+    problems = []
+    for kind in KINDS + ("ram",):
+        if kind in budget:
+            value = ram(use) if kind == "ram" else use[kind]
+            if value > budget[kind]:
+                problems.append(f"{kind} {value} > {budget[kind]}")
+    return problems
+
+
+def report(usage, ours, budget, everything):
+    totals = dict.fromkeys(KINDS, 0)
+    modules = budget.get("modules", {})
+    default = budget.get("default", DEFAULT_BUDGET) if budget else {}
+    failures = []
+    print(f"{'module':24}" + "".join(f"{k:>9}" for k in KINDS) + f"{'ram':>9}")
+    for name in sorted(usage, key=lambda n: -(ram(usage[n]) + usage[n]["iram"])):
+        use = usage[name]
+        for kind in KINDS:
+            totals[kind] += use[kind]
+        if name not in ours and not everything:
+            continue
+        print(f"{name:24}" + "".join(f"{use[k]:9}" for k in KINDS) + f"{ram(use):9}")
+        if name in ours:
+            failures += [f"{name}: {p}" for p in over(use, modules.get(name, default))]
+    print(f"{'total':24}" + "".join(f"{totals[k]:9}" for k in KINDS) + f"{ram(totals):9}")
+    failures += [f"total: {p}" for p in over(totals, budget.get("total", {}))]
+    return failures
+
+
+def update(usage, ours, budget, headroom):
+    """Set the limits of each of our modules to its current use plus headroom percent - RAM and
+    IRAM, unless the budget already limits other kinds. Modules that have gone are dropped"""
+    def limit(value):
+        return (int(value * (1 + headroom / 100)) + 63) // 64 * 64
+    modules = budget.get("modules", {})
+    budget["modules"] = {}
+    for name in sorted(ours):
+        limits = modules.get(name, dict.fromkeys(("ram", "iram"), 0))
+        for kind in limits:
+            limits[kind] = limit(ram(usage[name]) if kind == "ram" else usage[name][kind])
+        budget["modules"][name] = limits
+    budget.setdefault("default", dict(DEFAULT_BUDGET))
+    return budget
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map")
+    parser.add_argument("--budget", help="JSON budget to check against")
+    parser.add_argument("--all", action="store_true", help="list every library as well as our modules")
+    parser.add_argument("--update", type=float, metavar="PERCENT",
+                        help="set the module budgets from this map, with this much headroom")
+    args = parser.parse_args()
+
+    with open(args.map) as f:
+        usage, ours = parse_map(f)
+    if not usage:
+        sys.exit(f"{args.map}: no sections found - is it a GNU ld map?")
+    budget = {}
+    if args.budget:
+        with open(args.budget) as f:
+            budget = json.load(f)
+    if args.update is not None:
+        if not budget:
+            sys.exit("--update needs --budget")
+        with open(args.budget, "w") as f:
+            json.dump(update(usage, ours, budget, args.update), f, indent=2)
+            f.write("\n")
+        print(f"updated {args.budget}")
+    failures = report(usage, ours, budget, args.all)
+    for failure in failures:
+        print(f"OVER BUDGET {failure}", file=sys.stderr)
+    if failures and budget and not budget.get("modules"):
+        print(f"{args.budget} has no module budgets yet - set them from this map with --update 10", file=sys.stderr)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""A minimal MQTT 3.1.1 broker, for trying out the clocks' MQTT support.
+
+Accepts any client, keeps retained messages, passes publishes on to matching
+subscribers (QoS 0 and 1, with "+" and "#" wildcards) and prints everything
+it sees, including each client's connection times - so the spread of
+reconnections after an outage can be seen.
+
+    tools/mqtt_broker.py [--port 1883] [--outage 60:30] [--no-ack 3]
+
+--outage EVERY:FOR drops every connection and refuses new ones for FOR
+seconds, every EVERY seconds. --no-ack N leaves every Nth QoS 1 publish
+unacknowledged, so the clock has to send it again after reconnecting.
+Lines typed on stdin as "topic payload" are published to the clients, e.g.
+
+    303clock/kitchen/set/brightness 3
+"""
+
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 12, 13, 14
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def packet(kind, flags, body):
+    return bytes([kind << 4 | flags]) + encode_length(len(body)) + body
+
+
+def mqtt_string(s):
+    data = s.encode()
+    return struct.pack("!H", len(data)) + data
+
+
+def matches(pattern, topic):
+    p, t = pattern.split("/"), topic.split("/")
+    for i, part in enumerate(p):
+        if part == "#":
+            return True
+        if i >= len(t) or (part != "+" and part != t[i]):
+            return False
+    return len(p) == len(t)
+
+
+class Broker:
+    def __init__(self, no_ack):
+        self.clients = {}          # writer -> (client id, [(pattern, qos)])
+        self.retained = {}
+        self.refusing = False
+        self.no_ack = no_ack
+        self.qos1_count = 0
+        self.started = time.monotonic()
+        self.next_id = 1
+
+    def log(self, text):
+        print(f"{time.monotonic() - self.started:9.3f} {text}", flush=True)
+
+    def deliver(self, topic, payload, retain=False):
+        if retain:
+            if payload:
+                self.retained[topic] = payload
+            else:
+                self.retained.pop(topic, None)
+        for writer, (_, subs) in list(self.clients.items()):
+            qos = max((q for p, q in subs if matches(p, topic)), default=None)
+            if qos is not None:
+                self.send_publish(writer, topic, payload, min(qos, 1), False)
+
+    def send_publish(self, writer, topic, payload, qos, retain):
+        body = mqtt_string(topic)
+        if qos:
+            body += struct.pack("!H", self.next_id)
+            self.next_id = self.next_id % 65535 + 1
+        writer.write(packet(PUBLISH, qos << 1 | (1 if retain else 0), body + payload))
+
+    async def read_packet(self, reader):
+        header = (await reader.readexactly(1))[0]
+        length, shift = 0, 0
+        while True:
+            byte = (await reader.readexactly(1))[0]
+            length |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header >> 4, header & 15, await reader.readexactly(length)
+
+    async def handle(self, reader, writer):
+        client_id = "?"
+        try:
+            kind, _, body = await self.read_packet(reader)
+            if kind != CONNECT:
+                return
+            # Protocol name and level, connect flags, keepalive, then the client id
+            name_length = struct.unpack("!H", body[:2])[0]
+            flags = body[2 + name_length + 1]
+            offset = 2 + name_length + 4
+            id_length = struct.unpack("!H", body[offset:offset + 2])[0]
+            client_id = body[offset + 2:offset + 2 + id_length].decode()
+            offset += 2 + id_length
+            will = None
+            if flags & 4:
+                will_topic_length = struct.unpack("!H", body[offset:offset + 2])[0]
+                will_topic = body[offset + 2:offset + 2 + will_topic_length].decode()
+                offset += 2 + will_topic_length
+                will_length = struct.unpack("!H", body[offset:offset + 2])[0]
+                will = (will_topic, body[offset + 2:offset + 2 + will_length], bool(flags & 32))
+            if self.refusing:
+                self.log(f"{client_id} refused (outage)")
+                writer.write(packet(CONNACK, 0, b"\x00\x03"))  # Server unavailable
+                await writer.drain()
+                return
+            self.log(f"{client_id} connected")
+            writer.write(packet(CONNACK, 0, b"\x00\x00"))
+            self.clients[writer] = (client_id, [])
+            while True:
+                kind, flags, body = await self.read_packet(reader)
+                if kind == PUBLISH:
+                    qos = (flags >> 1) & 3
+                    topic_length = struct.unpack("!H", body[:2])[0]
+                    topic = body[2:2 + topic_length].decode()
+                    offset = 2 + topic_length
+                    if qos:
+                        packet_id = body[offset:offset + 2]
+                        offset += 2
+                    payload = body[offset:]
+                    dup = " DUP" if flags & 8 else ""
+                    self.log(f"{client_id} -> {topic} qos{qos}{dup}{' retained' if flags & 1 else ''}: "
+                             f"{payload.decode(errors='replace')}")
+                    if qos:
+                        self.qos1_count += 1
+                        if self.no_ack and self.qos1_count % self.no_ack == 0:
+                            self.log(f"  (not acknowledging {int.from_bytes(packet_id, 'big')})")
+                        else:
+                            writer.write(packet(PUBACK, 0, packet_id))
+                    self.deliver(topic, payload, bool(flags & 1))
+                elif kind == SUBSCRIBE:
+                    packet_id, offset, granted = body[:2], 2, bytearray()
+                    while offset < len(body):
+                        length = struct.unpack("!H", body[offset:offset + 2])[0]
+                        pattern = body[offset + 2:offset + 2 + length].decode()
+                        qos = min(body[offset + 2 + length], 1)
+                        offset += 3 + length
+                        self.clients[writer][1].append((pattern, qos))
+                        granted.append(qos)
+                        self.log(f"{client_id} subscribed to {pattern}")
+                    writer.write(packet(SUBACK, 0, packet_id + bytes(granted)))
+                    for topic, payload in self.retained.items():
+                        if any(matches(p, topic) for p, _ in self.clients[writer][1]):
+                            self.send_publish(writer, topic, payload, 0, True)
+                elif kind == PINGREQ:
+                    writer.write(packet(PINGRESP, 0, b""))
+                elif kind == DISCONNECT:
+                    will = None
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if writer in self.clients:
+                del self.clients[writer]
+                self.log(f"{client_id} disconnected")
+                if will:
+                    self.deliver(*will)
+            writer.close()
+
+    async def outages(self, every, length):
+        while True:
+            await asyncio.sleep(every)
+            self.log(f"outage for {length} s")
+            self.refusing = True
+            for writer in list(self.clients):
+                writer.close()
+            await asyncio.sleep(length)
+            self.refusing = False
+            self.log("outage over")
+
+    async def console(self):
+        loop = asyncio.get_running_loop()
+        while True:
+            line = await loop.run_in_executor(None, sys.stdin.readline)
+            if not line:
+                return
+            topic, _, payload = line.strip().partition(" ")
+            if topic:
+                self.log(f"console -> {topic}: {payload}")
+                self.deliver(topic, payload.encode())
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--outage", help="EVERY:FOR seconds")
+    parser.add_argument("--no-ack", type=int, default=0, help="leave every Nth QoS 1 publish unacknowledged")
+    args = parser.parse_args()
+
+    broker = Broker(args.no_ack)
+    server = await asyncio.start_server(broker.handle, args.bind, args.port)
+    broker.log(f"listening on {args.bind}:{args.port}")
+    tasks = [asyncio.create_task(broker.console())]
+    if args.outage:
+        every, length = (float(x) for x in args.outage.split(":"))
+        tasks.append(asyncio.create_task(broker.outages(every, length)))
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
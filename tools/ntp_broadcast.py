@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Stand in for an NTP broadcast server, to try out the clock's broadcast mode.
+
+Sends a broadcast (mode 5) packet with the host's time every few seconds,
+and answers client requests, so a clock can measure its round trip before
+it starts listening. Port 123 normally needs root.
+
+    sudo tools/ntp_broadcast.py [--to 255.255.255.255] [--interval 16]
+
+Use --to 224.0.1.1 to send to the NTP multicast group instead. Stop it, and
+after ten minutes the clock goes back to polling its servers.
+"""
+
+import argparse
+import select
+import socket
+import struct
+import sys
+import time
+
+NTP_PORT = 123
+NTP_UNIX_OFFSET = 2208988800
+STRATUM = 2
+
+
+def timestamp(t):
+    """A Unix time as a 64 bit NTP timestamp"""
+    seconds = int(t)
+    return struct.pack("!II", seconds + NTP_UNIX_OFFSET, int((t - seconds) * (1 << 32)))
+
+
+def packet(mode, version=4, originate=b"\0" * 8, received=None):
+    now = time.time()
+    header = struct.pack("!BBbbII4s", (version << 3) | mode, STRATUM, 6, -20, 0, 0, b"LOCL")
+    return header + timestamp(now - 1) + originate + (received or timestamp(now)) + timestamp(time.time())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--to", default="255.255.255.255", help="broadcast or multicast address")
+    parser.add_argument("--interval", type=float, default=16.0, help="seconds between broadcasts")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    sock.bind(("", NTP_PORT))
+    next_broadcast = time.monotonic()
+    while True:
+        if time.monotonic() >= next_broadcast:
+            sock.sendto(packet(5), (args.to, NTP_PORT))
+            next_broadcast += args.interval
+        ready, _, _ = select.select([sock], [], [], max(0, next_broadcast - time.monotonic()))
+        if not ready:
+            continue
+        data, peer = sock.recvfrom(512)
+        received = timestamp(time.time())
+        if len(data) >= 48 and data[0] & 7 == 3:
+            sock.sendto(packet(4, (data[0] >> 3) & 7, data[40:48], received), peer)
+            print(f"answered {peer[0]}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Upload firmware to a clock over HTTP.
+
+The image is gzip-compressed (unless it already is) and posted to /update along
+with its SHA-256. The bytes sent and the time taken are reported, alongside the
+figures the clock itself measured.
+
+    tools/ota_upload.py 192.168.1.50 .pio/build/esp01_1m/firmware.bin
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+import uuid
+
+
+def build_multipart(image):
+    boundary = uuid.uuid4().hex
+    head = (
+        f"--{boundary}\r\n"
+        'Content-Disposition: form-data; name="firmware"; filename="firmware.bin.gz"\r\n'
+        "Content-Type: application/octet-stream\r\n\r\n"
+    ).encode()
+    tail = f"\r\n--{boundary}--\r\n".encode()
+    return boundary, head + image + tail
+
+
+def upload(host, image, timeout=120):
+    """Post an image to a clock, returning (bytes sent, seconds taken, clock's JSON reply)"""
+    sha = hashlib.sha256(image).hexdigest()
+    boundary, body = build_multipart(image)
+    req = urllib.request.Request(
+        f"http://{host}/update?sha256={sha}",
+        data=body,
+        headers={"Content-Type": f"multipart/form-data; boundary={boundary}"},
+    )
+    start = time.monotonic()
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as resp:
+            reply = json.loads(resp.read().decode())
+    except urllib.error.HTTPError as e:
+        reply = json.loads(e.read().decode())
+    return len(body), time.monotonic() - start, reply
+
+
+def load_image(path, compress=True):
+    with open(path, "rb") as f:
+        image = f.read()
+    if compress and image[:2] != b"\x1f\x8b":
+        image = gzip.compress(image, compresslevel=9)
+    return image
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("firmware")
+    parser.add_argument("--no-compress", action="store_true", help="send the image as-is")
+    args = parser.parse_args()
+
+    image = load_image(args.firmware, not args.no_compress)
+    try:
+        sent, seconds, reply = upload(args.host, image)
+    except Exception as e:
+        print(f"{args.host}: upload failed: {e}", file=sys.stderr)
+        return 1
+    if not reply.get("ok"):
+        print(f"{args.host}: clock rejected the image: {reply.get('error', 'no reason given')}", file=sys.stderr)
+        return 1
+    print(f"{args.host}: sent {sent} bytes in {seconds:.2f} s ({sent / seconds / 1024:.1f} KiB/s); "
+          f"clock wrote {reply['bytes']} bytes in {reply['ms']} ms")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
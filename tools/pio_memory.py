@@ -0,0 +1,21 @@
+# PlatformIO extra script - writes a linker map, and adds the "memory" target, which reports each
+# module's memory use and fails if it is over budget. See tools/memory_report.py
+#
+#     pio run -t memory
+
+Import("env")
+
+import os
+
+map_file = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+env.Append(LINKFLAGS=["-Wl,-Map," + map_file])
+
+env.AddCustomTarget(
+    name="memory",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions='"$PYTHONEXE" "%s" "%s" --budget "%s"' % (
+        os.path.join("$PROJECT_DIR", "tools", "memory_report.py"), map_file,
+        os.path.join("$PROJECT_DIR", "tools", "memory_budget.json")),
+    title="Memory budget",
+    description="Report each module's flash, IRAM and RAM use, and check it against tools/memory_budget.json",
+)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Run clockctl.py against a fleet of simulated clocks.
+
+Starts several clocks built from the native environment ("pio run -e native"),
+each on its own port of 127.0.0.1, then has clockctl.py list them and push a
+configuration to them all, and checks that every clock took it. With
+--firmware, the image is pushed to them all as well.
+
+    pio run -e native
+    tools/sim_fleet.py [--clocks 8] [-j 4] [--config site.json] [--firmware firmware.bin]
+
+The simulated clocks can't be found over mDNS, so clockctl.py is given their
+addresses with --hosts; test/test_fleet checks what they advertise.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+PROGRAM = os.path.join(TOOLS, "..", ".pio", "build", "native", "program")
+DEFAULT_CONFIG = {"ZONE": "America/New_York", "24h": True, "PGDATE": 3}
+
+
+def get_config(host):
+    with urllib.request.urlopen(f"http://{host}/config", timeout=10) as resp:
+        return json.loads(resp.read().decode())
+
+
+def wait_up(host, timeout=10):
+    deadline = time.monotonic() + timeout
+    while True:
+        try:
+            return get_config(host)
+        except OSError:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.1)
+
+
+def clockctl(hosts, jobs, *args):
+    command = [sys.executable, os.path.join(TOOLS, "clockctl.py"), "--hosts", ",".join(hosts), "-j", str(jobs)]
+    print("$", " ".join(["clockctl.py"] + command[2:] + list(args)))
+    return subprocess.run(command + list(args)).returncode
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--clocks", type=int, default=8)
+    parser.add_argument("-j", "--jobs", type=int, default=4, help="clocks clockctl.py works on at once")
+    parser.add_argument("--port", type=int, default=8301, help="the first clock's port")
+    parser.add_argument("--program", default=PROGRAM)
+    parser.add_argument("--config", help="JSON configuration to push, as clockctl.py takes it")
+    parser.add_argument("--firmware", help="an image to push as well")
+    args = parser.parse_args()
+
+    config = DEFAULT_CONFIG
+    if args.config:
+        with open(args.config) as f:
+            config = json.load(f)
+    hosts = [f"127.0.0.1:{args.port + i}" for i in range(args.clocks)]
+    clocks = [subprocess.Popen([args.program, "--port", str(args.port + i), "--hostname", f"sim{i + 1}"])
+              for i in range(args.clocks)]
+    failures = 0
+    try:
+        before = {host: wait_up(host)["cfg"] for host in hosts}
+        failures += clockctl(hosts, args.jobs, "list") != 0
+        with tempfile.NamedTemporaryFile("w", suffix=".json", delete=False) as f:
+            json.dump(config, f)
+        start = time.monotonic()
+        failures += clockctl(hosts, args.jobs, "push-config", f.name) != 0
+        print(f"pushed to {len(hosts)} clocks in {time.monotonic() - start:.1f} s")
+        os.unlink(f.name)
+        for host in hosts:
+            got = get_config(host)
+            wrong = [key for key, value in config.items() if got.get(key) != value]
+            if wrong or got["cfg"] == before[host]:
+                failures += 1
+                print(f"{host}: configuration not applied: {', '.join(wrong) or 'hash unchanged'}", file=sys.stderr)
+        if args.firmware:
+            failures += clockctl(hosts, args.jobs, "push-firmware", args.firmware) != 0
+    finally:
+        for clock in clocks:
+            clock.terminate()
+            clock.wait()
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
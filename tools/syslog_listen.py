@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Receive a clock's syslog messages, and check they are well formed.
+
+Listens for RFC 5424 messages over UDP and prints them, one a line. Any
+datagram that doesn't parse as RFC 5424 is reported. Set the clock's syslog
+server to this machine (and the port, if not 514), then
+
+    tools/syslog_listen.py [--port 5514] [--count 20]
+
+With --count, it stops after that many messages and prints how many were
+received, how many were malformed, and the gaps between them - the clock
+sends at most 10 a second. The clock's own counts of messages sent and
+dropped are in its /metrics.
+"""
+
+import argparse
+import re
+import socket
+import sys
+import time
+
+# <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+MESSAGE = re.compile(r"<(\d{1,3})>1 (\S+) (\S+) (\S+) (\S+) (\S+) (-|\[.*?\])(?: (.*))?$", re.S)
+TIMESTAMP = re.compile(r"-|\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d(\.\d{1,6})?(Z|[+-]\d\d:\d\d)$")
+SEVERITIES = ["emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"]
+
+
+def parse(data):
+    """Split a message into its fields, returning None if it isn't valid RFC 5424"""
+    try:
+        text = data.decode("utf-8")
+    except UnicodeDecodeError:
+        return None
+    m = MESSAGE.match(text)
+    if not m or int(m.group(1)) > 191 or not TIMESTAMP.match(m.group(2)):
+        return None
+    pri = int(m.group(1))
+    return {"facility": pri >> 3, "severity": SEVERITIES[pri & 7], "timestamp": m.group(2),
+            "host": m.group(3), "app": m.group(4), "msgid": m.group(6), "msg": m.group(8) or ""}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=514)
+    parser.add_argument("--count", type=int, help="stop after this many messages")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    received, malformed, arrivals = 0, 0, []
+    while args.count is None or received < args.count:
+        data, (address, _) = sock.recvfrom(2048)
+        arrivals.append(time.monotonic())
+        received += 1
+        fields = parse(data)
+        if fields is None:
+            malformed += 1
+            print(f"{address} MALFORMED {data!r}")
+            continue
+        print(f"{address} {fields['timestamp']} {fields['host']} {fields['severity']:7} "
+              f"{fields['msgid']}: {fields['msg']}")
+    gaps = [b - a for a, b in zip(arrivals, arrivals[1:])]
+    print(f"{received} received, {malformed} malformed", file=sys.stderr)
+    if gaps:
+        print(f"gaps {min(gaps) * 1000:.1f} ms shortest, {sum(gaps) / len(gaps) * 1000:.1f} ms average",
+              file=sys.stderr)
+    return 1 if malformed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
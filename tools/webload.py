@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Load a clock's web server and see whether it keeps time.
+
+Requests a page from several threads at once for a while, then reports the
+request throughput, the answers by status code, and the latest the clock's
+display changed after the start of a second while under load (from
+/metrics, which is reset first).
+
+    tools/webload.py clock.local [--path /] [--clients 8] [--seconds 30]
+"""
+
+import argparse
+import collections
+import concurrent.futures
+import json
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+
+def get(url, timeout=10):
+    try:
+        with urllib.request.urlopen(url, timeout=timeout) as resp:
+            resp.read()
+            return resp.status
+    except urllib.error.HTTPError as e:
+        return e.code
+    except OSError:
+        return "error"
+
+
+def metrics(host, reset=False):
+    url = f"http://{host}/metrics" + ("?reset=1" if reset else "")
+    with urllib.request.urlopen(url, timeout=10) as resp:
+        return json.loads(resp.read().decode())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--path", default="/")
+    parser.add_argument("--clients", type=int, default=8, help="requests in flight at once")
+    parser.add_argument("--seconds", type=float, default=30.0)
+    args = parser.parse_args()
+
+    before = metrics(args.host, reset=True)
+    statuses = collections.Counter()
+    lock = threading.Lock()
+    deadline = time.monotonic() + args.seconds
+
+    def client():
+        while time.monotonic() < deadline:
+            status = get(f"http://{args.host}{args.path}")
+            with lock:
+                statuses[status] += 1
+
+    start = time.monotonic()
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.clients) as pool:
+        for future in [pool.submit(client) for _ in range(args.clients)]:
+            future.result()
+    elapsed = time.monotonic() - start
+    after = metrics(args.host)
+
+    total = sum(statuses.values())
+    print(f"{total} requests in {elapsed:.1f} s - {total / elapsed:.1f} per second")
+    for status, count in sorted(statuses.items(), key=str):
+        print(f"  {status}: {count}")
+    print(f"refused by the clock: {after['refused'] - before['refused']}")
+    print(f"worst display lateness: {after['tickLate']} ms")
+    print(f"free heap afterwards: {after['heap']} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())